@@ -41,6 +41,7 @@
 #include <compiler/expression/expression_list.h>
 #include <compiler/expression/array_pair_expression.h>
 #include <util/process.h>
+#include <util/job_queue.h>
 #include <runtime/base/rtti_info.h>
 #include <runtime/ext/ext_json.h>
 
@@ -51,14 +52,15 @@ using namespace boost;
 ///////////////////////////////////////////////////////////////////////////////
 // initialization
 
+__thread AnalysisResult::Cursor *AnalysisResult::s_cursor = NULL;
+
 AnalysisResult::AnalysisResult()
   : BlockScope("Root", "", StatementPtr(), BlockScope::ProgramScope),
     m_package(NULL), m_parseOnDemand(false), m_phase(AnalyzeInclude),
     m_newlyInferred(0), m_dynamicClass(false), m_dynamicFunction(false),
     m_classForcedVariants(false), m_optCounter(0),
     m_scalarArraysCounter(0), m_paramRTTICounter(0),
-    m_insideScalarArray(false), m_inExpression(false),
-    m_wrappedExpression(false),
+    m_insideScalarArray(false),
     m_scalarArraySortedAvgLen(0), m_scalarArraySortedIndex(0),
     m_scalarArraySortedSumLen(0), m_scalarArrayCompressedTextSize(0),
     m_system(false) {
@@ -77,7 +79,8 @@ void AnalysisResult::appendExtraCode(const std::string &code) {
 
 void AnalysisResult::setFileScope(FileScopePtr fileScope) {
   ASSERT(fileScope);
-  m_file = fileScope;
+  Lock lock(m_mutex);
+  cursor().file = fileScope;
 
   StringToFileScopePtrMap::const_iterator iter =
     m_files.find(fileScope->getName());
@@ -91,6 +94,7 @@ void AnalysisResult::setFileScope(FileScopePtr fileScope) {
 
 FileScopePtr AnalysisResult::findFileScope(const std::string &name,
                                            bool parseOnDemand) {
+  Lock lock(m_mutex);
   StringToFileScopePtrMap::const_iterator iter = m_files.find(name);
   if (iter != m_files.end()) return iter->second;
 
@@ -100,10 +104,10 @@ FileScopePtr AnalysisResult::findFileScope(const std::string &name,
     return FileScopePtr();
   }
 
-  FileScopePtr curr = m_file;
+  FileScopePtr curr = cursor().file;
   if (parseOnDemand && m_parseOnDemand &&
       m_package && m_package->parse(name.c_str())) {
-    m_file = curr;
+    cursor().file = curr;
     iter = m_files.find(name);
     ASSERT(iter != m_files.end());
     return iter->second;
@@ -112,58 +116,64 @@ FileScopePtr AnalysisResult::findFileScope(const std::string &name,
 }
 
 void AnalysisResult::pushScope(BlockScopePtr scope) {
-  m_scope = scope;
-  m_scopes.push_back(scope);
+  Cursor &c = cursor();
+  c.scope = scope;
+  c.scopes.push_back(scope);
   if (scope->is(BlockScope::FileScope)) {
-    m_file = dynamic_pointer_cast<HPHP::FileScope>(scope);
+    c.file = dynamic_pointer_cast<HPHP::FileScope>(scope);
   }
 }
 
 void AnalysisResult::popScope() {
-  ASSERT(!m_scopes.empty());
-  m_scopes.pop_back();
-  if (m_scopes.empty()) {
-    m_scope.reset();
+  Cursor &c = cursor();
+  ASSERT(!c.scopes.empty());
+  c.scopes.pop_back();
+  if (c.scopes.empty()) {
+    c.scope.reset();
   } else {
-    m_scope = m_scopes.back();
+    c.scope = c.scopes.back();
   }
 }
 
 void AnalysisResult::pushStatement(StatementPtr stmt) {
-  m_stmt = stmt;
-  m_stmts.push_back(stmt);
+  Cursor &c = cursor();
+  c.stmt = stmt;
+  c.stmts.push_back(stmt);
 }
 
 void AnalysisResult::popStatement() {
-  ASSERT(!m_stmts.empty());
-  m_stmts.pop_back();
-  if (m_stmts.empty()) {
-    m_stmt.reset();
+  Cursor &c = cursor();
+  ASSERT(!c.stmts.empty());
+  c.stmts.pop_back();
+  if (c.stmts.empty()) {
+    c.stmt.reset();
   } else {
-    m_stmt = m_stmts.back();
+    c.stmt = c.stmts.back();
   }
 }
 
 StatementPtr AnalysisResult::getStatementForSilencer() const {
   // Because of how we parse if/else statements, we need
   // to handle them differently
-  if (m_stmt && m_stmt->is(Statement::KindOfIfBranchStatement)) {
-    if (m_stmts.size() < 3)
+  const Cursor &c = cursor();
+  if (c.stmt && c.stmt->is(Statement::KindOfIfBranchStatement)) {
+    if (c.stmts.size() < 3)
       return StatementPtr();
     // If the current statement is an IfBranchStatement, we want to
     // return the enclosing IfStatement. The parser guarantees that
     // each IfBranchStatement is the grandchild of the enclosing
     // IfStatement.
-    ASSERT(m_stmts[m_stmts.size()-3]->is(Statement::KindOfIfStatement));
-    return m_stmts[m_stmts.size()-3];
+    ASSERT(c.stmts[c.stmts.size()-3]->is(Statement::KindOfIfStatement));
+    return c.stmts[c.stmts.size()-3];
   }
-  return m_stmt;
+  return c.stmt;
 }
 
 ClassScopePtr AnalysisResult::getClassScope() const {
-  for (int i = m_scopes.size() - 1; i >= 0; i--) {
+  const BlockScopePtrVec &scopes = cursor().scopes;
+  for (int i = scopes.size() - 1; i >= 0; i--) {
     ClassScopePtr classScope =
-      dynamic_pointer_cast<HPHP::ClassScope>(m_scopes[i]);
+      dynamic_pointer_cast<HPHP::ClassScope>(scopes[i]);
     if (classScope) return classScope;
   }
   return ClassScopePtr();
@@ -381,6 +391,7 @@ void AnalysisResult::countReturnTypes(std::map<std::string, int> &counts) {
 }
 
 void AnalysisResult::addNonFinal(const std::string &className) {
+  Lock lock(m_mutex);
   m_nonFinalClasses.insert(className);
 }
 
@@ -396,6 +407,7 @@ bool AnalysisResult::needStaticArray(ClassScopePtr cls) {
 // static analysis functions
 
 bool AnalysisResult::declareFunction(FunctionScopePtr funcScope) {
+  Lock lock(m_mutex);
   string fname = funcScope->getName();
   // System functions override
   if (m_functions.find(fname) != m_functions.end()) {
@@ -419,6 +431,7 @@ bool AnalysisResult::declareFunction(FunctionScopePtr funcScope) {
 }
 
 bool AnalysisResult::declareClass(ClassScopePtr classScope) {
+  Lock lock(m_mutex);
   string cname = classScope->getName();
   // System classes override
   if (m_systemClasses.find(cname) != m_systemClasses.end()) {
@@ -445,10 +458,12 @@ bool AnalysisResult::declareClass(ClassScopePtr classScope) {
 
 void AnalysisResult::declareUnknownClass(const std::string &name) {
   ASSERT(name == Util::toLower(name));
+  Lock lock(m_mutex);
   m_classDecs.operator[](name);
 }
 
 bool AnalysisResult::declareConst(FileScopePtr fs, const string &name) {
+  Lock lock(m_mutex);
   if (getConstants()->isPresent(name) ||
       m_constDecs.find(name) != m_constDecs.end()) {
     m_constRedeclared.insert(name);
@@ -464,6 +479,7 @@ bool AnalysisResult::declareConst(FileScopePtr fs, const string &name) {
 
 void AnalysisResult::link(FileScopePtr user, FileScopePtr provider) {
   if (user != provider) {
+    Lock lock(m_mutex);
     add_edge(user->vertex(), provider->vertex(), m_depGraph);
   }
 }
@@ -543,6 +559,7 @@ bool AnalysisResult::isSystemConstant(const std::string &constName) {
 }
 
 void AnalysisResult::addCallee(StatementPtr stmt) {
+  Lock lock(m_mutex);
   if (m_calleesAdded.find(stmt) == m_calleesAdded.end()) {
     m_callees.push_back(stmt);
     m_calleesAdded.insert(stmt);
@@ -754,19 +771,15 @@ void AnalysisResult::analyzeProgramFinal() {
 }
 
 void AnalysisResult::inferTypes(int maxPass /* = 100 */) {
-  AnalysisResultPtr ar = shared_from_this();
   setPhase(FirstInference);
   int lastInferred = 0;
   bool lastInference = false;
   for (int i = 0; i < maxPass; i++) {
     m_newlyInferred = 0;
-    for (StringToFileScopePtrMap::const_iterator iter = m_files.begin();
-         iter != m_files.end(); ++iter) {
-      FileScopePtr file = iter->second;
-      pushScope(file);
-      file->inferTypes(ar);
-      popScope();
-    }
+    // The first round declares symbols and the last one reports errors, in
+    // file order; rounds in between only refine types.
+    processFiles(&FileScope::inferTypes,
+                 m_phase != FirstInference && m_phase != LastInference);
     if (lastInference) {
       return;
     }
@@ -784,6 +797,94 @@ void AnalysisResult::inferTypes(int maxPass /* = 100 */) {
   ASSERT(false);
 }
 
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+class AnalysisJob {
+public:
+  AnalysisJob(AnalysisResultPtr a, void (FileScope::*p)(AnalysisResultPtr))
+    : ar(a), pass(p) {}
+
+  AnalysisResultPtr ar;
+  void (FileScope::*pass)(AnalysisResultPtr);
+
+  Mutex mutex;
+  std::string error; // first one any worker ran into
+};
+
+class AnalysisWorker : public JobQueueWorker<FileScopePtr> {
+public:
+  virtual void onThreadEnter() {
+    AnalysisResult::s_cursor = &m_cursor;
+  }
+
+  virtual void doJob(FileScopePtr file) {
+    AnalysisJob *job = (AnalysisJob*)m_opaque;
+    try {
+      job->ar->pushScope(file);
+      ((*file).*(job->pass))(job->ar);
+      job->ar->popScope();
+      return;
+    } catch (Exception &e) {
+      setError(job, file, e.getMessage());
+    } catch (std::exception &e) {
+      setError(job, file, e.what());
+    } catch (...) {
+      setError(job, file, "unknown exception");
+    }
+    m_cursor = AnalysisResult::Cursor();
+  }
+
+  virtual void onThreadExit() {
+    AnalysisResult::s_cursor = NULL;
+  }
+
+private:
+  AnalysisResult::Cursor m_cursor;
+
+  static void setError(AnalysisJob *job, FileScopePtr file,
+                       const std::string &msg) {
+    Lock lock(job->mutex);
+    if (job->error.empty()) {
+      job->error = file->getName() + ": " + msg;
+    }
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+void AnalysisResult::processFiles(void (FileScope::*pass)(AnalysisResultPtr),
+                                  bool parallel) {
+  AnalysisResultPtr ar = shared_from_this();
+  if (!parallel || Option::AnalysisThreadCount <= 1 || m_files.size() <= 1) {
+    for (StringToFileScopePtrMap::const_iterator iter = m_files.begin();
+         iter != m_files.end(); ++iter) {
+      FileScopePtr file = iter->second;
+      pushScope(file);
+      ((*file).*pass)(ar);
+      popScope();
+    }
+    return;
+  }
+
+  AnalysisJob job(ar, pass);
+  {
+    JobQueueDispatcher<FileScopePtr, AnalysisWorker>
+      dispatcher(Option::AnalysisThreadCount, &job);
+    dispatcher.start();
+    for (StringToFileScopePtrMap::const_iterator iter = m_files.begin();
+         iter != m_files.end(); ++iter) {
+      dispatcher.enqueue(iter->second);
+    }
+    dispatcher.stop();
+  }
+  SymbolTable::CommitNewSymbols();
+  if (!job.error.empty()) {
+    throw Exception("%s", job.error.c_str());
+  }
+}
+
 static void dumpVisitor(AnalysisResultPtr ar, StatementPtr s, void *data) {
   s->dump(0, ar);
 }
@@ -808,20 +909,15 @@ void AnalysisResult::visitFiles(void (*cb)(AnalysisResultPtr,
 // optimization functions
 
 void AnalysisResult::preOptimize(int maxPass /* = 100 */) {
-  AnalysisResultPtr ar = shared_from_this();
   int lastOptCounter;
   int i;
   setPhase(FirstPreOptimize);
   while (true) {
     for (i = 0; i < maxPass; i++) {
       lastOptCounter = m_optCounter;
-      for (StringToFileScopePtrMap::const_iterator iter = m_files.begin();
-           iter != m_files.end(); ++iter) {
-        FileScopePtr file = iter->second;
-        pushScope(file);
-        file->preOptimize(ar);
-        popScope();
-      }
+      // serial: constants are folded from other files' declarations, which
+      // their own files' passes rewrite at the same time
+      processFiles(&FileScope::preOptimize, false);
       if (lastOptCounter == m_optCounter) break;
     }
     ASSERT(i <= 100);
@@ -834,19 +930,13 @@ void AnalysisResult::preOptimize(int maxPass /* = 100 */) {
 }
 
 void AnalysisResult::postOptimize(int maxPass /* = 100 */) {
-  AnalysisResultPtr ar = shared_from_this();
   setPhase(AnalysisResult::PostOptimize);
   int lastOptCounter;
   int i;
   for (i = 0; i < maxPass; i++) {
     lastOptCounter = m_optCounter;
-    for (StringToFileScopePtrMap::const_iterator iter = m_files.begin();
-         iter != m_files.end(); ++iter) {
-      FileScopePtr file = iter->second;
-      pushScope(file);
-      file->postOptimize(ar);
-      popScope();
-    }
+    // scalar array ids are handed out in file order
+    processFiles(&FileScope::postOptimize, false);
     if (lastOptCounter == m_optCounter) break;
   }
   ASSERT(i <= 100);
@@ -1761,6 +1851,55 @@ AnalysisResult::getFuncTableBucket(FunctionScopePtr func) {
   return m_funcTable[index];
 }
 
+/**
+ * get_dynamic_call_target() for DynamicCallCache: the few_args entry point of
+ * every user function invoke() may call, as long as it is always the same.
+ */
+void AnalysisResult::outputCPPDynamicCallTargets(CodeGenerator &cg) {
+  vector<const char *> targets;
+  map<string, int> indices;
+  if (Option::DynamicCallCaches) {
+    for (CodeGenerator::MapIntToStringVec::const_iterator it =
+           m_funcTable.begin(); it != m_funcTable.end(); it++) {
+      for (unsigned int i = 0; i < it->second.size(); i++) {
+        const char *name = it->second[i];
+        if (m_functions.find(name) != m_functions.end()) {
+          continue; // separable extension
+        }
+        FunctionScopePtr func = findFunction(name);
+        if (!func || func->isRedeclaring() || func->inPseudoMain()) continue;
+        indices[name] = targets.size();
+        targets.push_back(name);
+        cg_printf("Variant %s%s_few_args(int count", Option::InvokePrefix,
+                  cg.formatLabel(name).c_str());
+        for (int i = 0; i < Option::InvokeFewArgsCount; i++) {
+          cg_printf(", CVarRef a%d", i);
+        }
+        cg_printf(");\n");
+      }
+    }
+  }
+
+  cg_indentBegin("const DynamicCallTarget *get_dynamic_call_target"
+                 "(const char *s, int64 hash) {\n");
+  if (!targets.empty()) {
+    cg_indentBegin("static const DynamicCallTarget targets[] = {\n");
+    for (unsigned int i = 0; i < targets.size(); i++) {
+      cg_printf("{ \"%s\", &%s%s_few_args },\n", targets[i],
+                Option::InvokePrefix, cg.formatLabel(targets[i]).c_str());
+    }
+    cg_indentEnd("};\n");
+    for (JumpTable fit(cg, targets, true, true, false); fit.ready();
+         fit.next()) {
+      const char *name = fit.key();
+      cg_printf("HASH_GUARD(0x%016llXLL, %s) return &targets[%d];\n",
+                hash_string_i(name), name, indices[name]);
+    }
+  }
+  cg_printf("return NULL;\n");
+  cg_indentEnd("}\n");
+}
+
 void AnalysisResult::outputCPPDynamicTables(CodeGenerator::Output output) {
   AnalysisResultPtr ar = shared_from_this();
   bool system = output == CodeGenerator::SystemCPP;
@@ -1890,6 +2029,7 @@ void AnalysisResult::outputCPPDynamicTables(CodeGenerator::Output output) {
       }
       cg_indentEnd("}\n");
 
+      outputCPPDynamicCallTargets(cg);
       outputCPPEvalInvokeTable(cg, ar);
     }
     cg.namespaceEnd();
@@ -2271,8 +2411,8 @@ void AnalysisResult::outputCPPScalarArrayDecl(CodeGenerator &cg) {
 }
 
 bool AnalysisResult::wrapExpressionBegin(CodeGenerator &cg) {
-  if (!m_wrappedExpression) {
-    m_wrappedExpression = true;
+  if (!cursor().wrappedExpression) {
+    cursor().wrappedExpression = true;
     cg_indentBegin("{\n");
     return true;
   }
@@ -2280,8 +2420,8 @@ bool AnalysisResult::wrapExpressionBegin(CodeGenerator &cg) {
 }
 
 bool AnalysisResult::wrapExpressionEnd(CodeGenerator &cg) {
-  if (m_wrappedExpression) {
-    m_wrappedExpression = false;
+  if (cursor().wrappedExpression) {
+    cursor().wrappedExpression = false;
     cg_indentEnd("}\n");
     return true;
   }
@@ -24,6 +24,8 @@
 #include <compiler/analysis/function_container.h>
 #include <compiler/package.h>
 #include <compiler/analysis/method_slot.h>
+#include <util/lock.h>
+#include <util/atomic.h>
 #include <boost/graph/adjacency_list.hpp>
 
 namespace HPHP {
@@ -116,7 +118,10 @@ public:
   }
   CodeErrorPtr getCodeError() {
     if (!m_codeError) {
-      m_codeError = CodeErrorPtr(new CodeError(shared_from_this()));
+      Lock lock(m_mutex);
+      if (!m_codeError) {
+        m_codeError = CodeErrorPtr(new CodeError(shared_from_this()));
+      }
     }
     return m_codeError;
   }
@@ -138,7 +143,7 @@ public:
                   void *data);
   void preOptimize(int maxPass = 100);
   void postOptimize(int maxPass = 100);
-  void incOptCounter() { m_optCounter++; }
+  void incOptCounter() { atomic_inc(m_optCounter); }
   template<typename T>
   bool preOptimize(boost::shared_ptr<T> &before) {
     if (before) {
@@ -146,7 +151,7 @@ public:
         (before->preOptimize(shared_from_this()));
       if (after) {
         before = after;
-        m_optCounter++;
+        incOptCounter();
         return true;
       }
     }
@@ -159,7 +164,7 @@ public:
         (before->postOptimize(shared_from_this()));
       if (after) {
         before = after;
-        m_optCounter++;
+        incOptCounter();
         return true;
       }
     }
@@ -171,7 +176,7 @@ public:
    * are inferred.
    */
   void incNewlyInferred() {
-    m_newlyInferred++;
+    atomic_inc(m_newlyInferred);
   }
 
   void containsDynamicFunctionCall() { m_dynamicFunction = true;}
@@ -220,20 +225,22 @@ public:
   void outputCPPClassStaticInitializerFlags(CodeGenerator &cg,
                                             bool constructor);
   void outputCPPClassDeclaredFlags(CodeGenerator &cg);
-  bool inExpression() { return m_inExpression; }
-  void setInExpression(bool in) { m_inExpression = in; }
+  bool inExpression() { return cursor().inExpression; }
+  void setInExpression(bool in) { cursor().inExpression = in; }
   bool wrapExpressionBegin(CodeGenerator &);
   bool wrapExpressionEnd(CodeGenerator &);
-  LoopStatementPtr getLoopStatement() const { return m_loopStatement; }
+  LoopStatementPtr getLoopStatement() const {
+    return cursor().loopStatement;
+  }
   void setLoopStatement(LoopStatementPtr loop) {
-    m_loopStatement = loop;
+    cursor().loopStatement = loop;
   }
 
   /**
    * Parser creates a FileScope upon parsing a new file.
    */
   void setFileScope(FileScopePtr fileScope);
-  FileScopePtr getFileScope() { return m_file;}
+  FileScopePtr getFileScope() { return cursor().file;}
   FileScopePtr findFileScope(const std::string &name, bool parseOnDemand);
   const StringToFileScopePtrMap &getAllFiles() { return m_files;}
   const std::vector<FileScopePtr> &getAllFilesVector() {
@@ -247,7 +254,7 @@ public:
    */
   void pushScope(BlockScopePtr scope);
   void popScope();
-  BlockScopePtr getScope() const { return m_scope;}
+  BlockScopePtr getScope() const { return cursor().scope;}
   ClassScopePtr getClassScope() const;
   FunctionScopePtr getFunctionScope() const;
 
@@ -257,7 +264,12 @@ public:
    */
   void pushStatement(StatementPtr stmt);
   void popStatement();
-  StatementPtr getStatement() const { return m_stmt; }
+  StatementPtr getStatement() const { return cursor().stmt; }
+
+  /**
+   * Whether the calling thread is running a pass over files in parallel.
+   */
+  bool inParallelPass() const { return s_cursor != NULL;}
   StatementPtr getStatementForSilencer() const;
 
   /**
@@ -378,7 +390,6 @@ private:
   CodeErrorPtr m_codeError;
   StringToFileScopePtrMap m_files;
   FileScopePtrVec m_fileScopes;
-  FileScopePtr m_file;
   std::string m_extraCode;
 
   StringToClassScopePtrMap m_systemClasses;
@@ -394,11 +405,40 @@ private:
   bool m_dynamicFunction;
   bool m_classForcedVariants;
 
-  BlockScopePtrVec m_scopes;
-  BlockScopePtr m_scope;
+  /**
+   * Where a pass is in the syntax trees: the scope and statement stacks and
+   * a few flags for code generation. Each thread running a pass over files
+   * in parallel has its own; otherwise it's m_cursor.
+   */
+  class Cursor {
+  public:
+    Cursor() : inExpression(false), wrappedExpression(false) {}
+
+    BlockScopePtrVec scopes;
+    BlockScopePtr scope;
+    FileScopePtr file;
+    StatementPtrVec stmts;
+    StatementPtr stmt;
+    LoopStatementPtr loopStatement;
+    bool inExpression;
+    bool wrappedExpression;
+  };
+  friend class AnalysisWorker;
+  mutable Cursor m_cursor;
+  static __thread Cursor *s_cursor;
+  Cursor &cursor() const { return s_cursor ? *s_cursor : m_cursor;}
+
+  /**
+   * Runs one pass over all files in m_files order. With parallel, files are
+   * handed out to Option::AnalysisThreadCount threads instead, which is only
+   * safe for passes whose outcome doesn't depend on the order files are
+   * visited in.
+   */
+  void processFiles(void (FileScope::*pass)(AnalysisResultPtr),
+                    bool parallel);
 
-  StatementPtrVec m_stmts;
-  StatementPtr m_stmt;
+  // guards what passes running in parallel add to, e.g., m_callees
+  Mutex m_mutex;
 
   StatementPtrVec m_callees;
   StatementPtrSet m_calleesAdded;
@@ -413,10 +453,6 @@ private:
   int m_paramRTTICounter;
 
   bool m_insideScalarArray;
-  bool m_inExpression;
-  bool m_wrappedExpression;
-
-  LoopStatementPtr m_loopStatement;
 public:
   struct ScalarArrayExp {
     int id;
@@ -488,6 +524,7 @@ private:
   void outputCPPClassIncludes(CodeGenerator &cg);
   void outputCPPExtClassImpl(CodeGenerator &cg);
   void outputCPPDynamicTables(CodeGenerator::Output output);
+  void outputCPPDynamicCallTargets(CodeGenerator &cg);
   void outputCPPDynamicTablesHeader(CodeGenerator &cg,
                                     bool includeGlobalVars = true,
                                     bool includes = true,
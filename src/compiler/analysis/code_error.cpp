@@ -96,6 +96,7 @@ void CodeError::record(ConstructPtr construct, Type::KindOf expected,
 void CodeError::record(ErrorInfoPtr errorInfo) {
   ASSERT(errorInfo->m_error >= 0 && errorInfo->m_error < ErrorCount);
 
+  Lock lock(m_mutex);
   ErrorInfoMap &errorMap = m_errors[errorInfo->m_error];
   ErrorInfoMap::const_iterator iter = errorMap.find(errorInfo->m_construct1);
   if (iter == errorMap.end()) {
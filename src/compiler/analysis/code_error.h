@@ -20,6 +20,7 @@
 #include <compiler/hphp.h>
 #include <util/json.h>
 #include <compiler/analysis/type.h>
+#include <util/lock.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -97,6 +98,7 @@ private:
 
   typedef std::map<ConstructPtr, ErrorInfoPtr> ErrorInfoMap;
   std::vector<ErrorInfoMap> m_errors;
+  Mutex m_mutex;
   mutable bool m_verbose;
 
   void record(ErrorInfoPtr errorInfo);
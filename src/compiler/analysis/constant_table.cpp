@@ -42,6 +42,7 @@ ConstantTable::ConstantTable(BlockScope &blockScope)
 TypePtr ConstantTable::add(const std::string &name, TypePtr type,
                            ExpressionPtr exp, AnalysisResultPtr ar,
                            ConstructPtr construct) {
+  Lock lock(m_mutex);
 
   if (name == "true" || name == "false") {
     return Type::Boolean;
@@ -69,12 +70,14 @@ TypePtr ConstantTable::add(const std::string &name, TypePtr type,
 }
 
 void ConstantTable::setDynamic(AnalysisResultPtr ar, const std::string &name) {
+  Lock lock(m_mutex);
   m_dynamic.insert(name);
   setType(ar, name, Type::Variant, true);
 }
 
 void ConstantTable::setValue(AnalysisResultPtr ar, const std::string &name,
                              ExpressionPtr value) {
+  Lock lock(m_mutex);
   m_values[name] = value;
 }
 
@@ -117,6 +120,7 @@ TypePtr ConstantTable::check(const std::string &name, TypePtr type,
                              ConstructPtr construct,
                              const std::vector<std::string> &bases,
                              BlockScope *&defScope) {
+  Lock lock(m_mutex);
   TypePtr actualType;
   defScope = NULL;
   if (name == "true" || name == "false") {
@@ -237,6 +237,7 @@ void DependencyGraph::add(KindOf kindOf, const string &program,
   ASSERT(kindOf >= 0 && kindOf < KindOfCount);
   ASSERT(!childName.empty());
   ASSERT(!parentName.empty());
+  Lock lock(m_mutex);
   clearCache(kindOf);
 
   DependencyPtrVecPtr &dependencies =
@@ -297,6 +298,7 @@ void DependencyGraph::addParent(KindOf kindOf, const std::string &program,
   ASSERT(kindOf >= 0 && kindOf < KindOfCount);
   ASSERT(!parentName.empty());
 
+  Lock lock(m_mutex);
   DependencyPtr &dep = m_parents[kindOf][parentName];
   if (!dep) {
     dep = DependencyPtr(new Dependency());
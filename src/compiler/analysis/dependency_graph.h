@@ -22,6 +22,7 @@
 #include <util/db_query.h>
 #include <util/db_conn.h>
 #include <compiler/hphp_unique.h>
+#include <util/lock.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -191,6 +192,7 @@ private:
   std::vector<DependencyMapMap> m_reverses; // child -> parent
   std::vector<StringToDependencyPtrMap> m_parents;
   int m_total;
+  Mutex m_mutex;
 
   // cached recursive children
   mutable std::vector<StringConstructMapMap> m_allChildren;
@@ -158,10 +158,12 @@ void FileScope::addConstant(const string &name, TypePtr type,
 void FileScope::addIncludeDependency(AnalysisResultPtr ar,
                                      const string &file, bool byInlined) {
   ar->addIncludeDependency(shared_from_this(), file);
+  Lock lock(m_usedMutex);
   if (byInlined) m_usedIncludesInline.insert(file);
 }
 void FileScope::addClassDependency(AnalysisResultPtr ar,
                                    const string &classname) {
+  Lock lock(m_usedMutex);
   if (m_usedClasses.find(classname) == m_usedClasses.end()) {
     m_usedClasses.insert(classname);
     ar->addClassDependency(shared_from_this(), classname);
@@ -170,10 +172,12 @@ void FileScope::addClassDependency(AnalysisResultPtr ar,
 void FileScope::addFunctionDependency(AnalysisResultPtr ar,
                                       const string &funcname, bool byInlined) {
   ar->addFunctionDependency(shared_from_this(), funcname);
+  Lock lock(m_usedMutex);
   if (byInlined) m_usedFuncsInline.insert(funcname);
 }
 void FileScope::addConstantDependency(AnalysisResultPtr ar,
                                       const string &decname) {
+  Lock lock(m_usedMutex);
   if (m_usedConsts.find(decname) == m_usedConsts.end()) {
     m_usedConsts.insert(decname);
     ar->addConstantDependency(shared_from_this(), decname);
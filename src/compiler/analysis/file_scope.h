@@ -22,6 +22,7 @@
 #include <compiler/analysis/code_error.h>
 #include <compiler/code_generator.h>
 #include <boost/graph/adjacency_list.hpp>
+#include <util/lock.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -204,6 +205,7 @@ private:
   std::set<std::string> m_usedClasses;
   std::set<std::string> m_usedConsts;
   std::set<std::string> m_usedIncludesInline;
+  Mutex m_usedMutex; // the m_used* sets above
   std::set<std::string> m_usedLiteralStrings;
   std::string m_pseudoMainName;
   std::set<std::string> m_pseudoMainVariables;
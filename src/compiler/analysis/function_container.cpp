@@ -96,6 +96,20 @@ void FunctionContainer::outputCPPJumpTableSupport
       const char *name = iter->first.c_str();
       if (funcs) funcs->push_back(name);
 
+      if (!systemcpp && Option::DynamicCallCaches) {
+        // e.g. i_foo_few_args(...) for DynamicCallCache to call directly
+        cg_indentBegin("Variant %s%s_few_args(int count",
+                       Option::InvokePrefix, cg.formatLabel(name).c_str());
+        for (int i = 0; i < Option::InvokeFewArgsCount; i++) {
+          cg_printf(", CVarRef a%d", i);
+        }
+        cg_printf(") {\n");
+        func->outputCPPDynamicInvoke(cg, ar, funcPrefix,
+                                     cg.formatLabel(name).c_str(), false,
+                                     true);
+        cg_indentEnd("}\n");
+      }
+
       if (!systemcpp) {
         vector<const char *> &bucket = ar->getFuncTableBucket(func);
         if (bucket.size() == 1) {
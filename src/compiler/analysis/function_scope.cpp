@@ -438,6 +438,7 @@ int FunctionScope::inferParamTypes(AnalysisResultPtr ar, ConstructPtr exp,
 TypePtr FunctionScope::setParamType(AnalysisResultPtr ar, int index,
                                     TypePtr type) {
   ASSERT(index >= 0 && index < (int)m_paramTypes.size());
+  Lock lock(m_typeMutex);
   TypePtr paramType = m_paramTypes[index];
 
   if (!paramType) paramType = NEW_TYPE(Some);
@@ -456,6 +457,7 @@ TypePtr FunctionScope::setParamType(AnalysisResultPtr ar, int index,
 
 TypePtr FunctionScope::getParamType(int index) {
   ASSERT(index >= 0 && index < (int)m_paramTypes.size());
+  Lock lock(m_typeMutex);
   TypePtr paramType = m_paramTypes[index];
   if (!paramType) {
     paramType = NEW_TYPE(Some);
@@ -504,6 +506,7 @@ void FunctionScope::setReturnType(AnalysisResultPtr ar, TypePtr type) {
   // no change can be made to virtual function's prototype
   if (m_overriding) return;
 
+  Lock lock(m_typeMutex);
   if (m_returnType) {
     type = Type::Coerce(ar, m_returnType, type);
     if (type && !Type::SameType(m_returnType, type)) {
@@ -20,6 +20,7 @@
 #include <compiler/analysis/block_scope.h>
 #include <util/json.h>
 #include <compiler/option.h>
+#include <util/lock.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -174,7 +175,10 @@ public:
    * What is the inferred type of this function's return.
    */
   void setReturnType(AnalysisResultPtr ar, TypePtr type);
-  TypePtr getReturnType() const { return m_returnType;}
+  TypePtr getReturnType() const {
+    Lock lock(m_typeMutex);
+    return m_returnType;
+  }
 
   void setOptFunction(FunctionOptPtr fn) { m_optFunction = fn; }
   FunctionOptPtr getOptFunction() const { return m_optFunction; }
@@ -397,6 +401,7 @@ private:
   bool m_refReturn; // whether it's "function &get_reference()"
   std::vector<bool> m_refs;
   TypePtr m_returnType;
+  mutable Mutex m_typeMutex; // m_paramTypes and m_returnType
   ModifierExpressionPtr m_modifiers;
   bool m_virtual;
   bool m_perfectVirtual;
@@ -37,6 +37,17 @@ void SymbolTable::CountTypes(std::map<std::string, int> &counts) {
   }
 }
 
+void SymbolTable::CommitNewSymbols() {
+  for (unsigned int i = 0; i < AllSymbolTables.size(); i++) {
+    SymbolTablePtr table = AllSymbolTables[i];
+    Lock lock(table->m_mutex);
+    table->m_symbols.insert(table->m_symbols.end(),
+                            table->m_newSymbols.begin(),
+                            table->m_newSymbols.end());
+    table->m_newSymbols.clear();
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 SymbolTable::SymbolTable(BlockScope &blockScope) : m_blockScope(blockScope) {
@@ -59,6 +70,7 @@ void SymbolTable::import(SymbolTablePtr src) {
 }
 
 bool SymbolTable::isPresent(const std::string &name) const {
+  Lock lock(m_mutex);
   return m_declarations.find(name) != m_declarations.end();
 }
 
@@ -69,6 +81,7 @@ bool SymbolTable::isSystem(const std::string &name) const {
 ///////////////////////////////////////////////////////////////////////////////
 
 TypePtr SymbolTable::getType(const std::string &name, bool coerced) {
+  Lock lock(m_mutex);
   if (coerced) {
     StringToTypePtrMap::const_iterator iter = m_coerced.find(name);
     if (iter != m_coerced.end()) return iter->second;
@@ -89,10 +102,12 @@ TypePtr SymbolTable::getFinalType(const std::string &name) {
 }
 
 bool SymbolTable::isExplicitlyDeclared(const std::string &name) const {
+  Lock lock(m_mutex);
   return m_values.find(name) != m_values.end();
 }
 
 ConstructPtr SymbolTable::getDeclaration(const std::string &name) {
+  Lock lock(m_mutex);
   StringToConstructPtrMap::const_iterator iter = m_declarations.find(name);
   if (iter == m_declarations.end()) {
     return ConstructPtr();
@@ -101,6 +116,7 @@ ConstructPtr SymbolTable::getDeclaration(const std::string &name) {
 }
 
 ConstructPtr SymbolTable::getValue(const std::string &name) {
+  Lock lock(m_mutex);
   StringToConstructPtrMap::const_iterator iter = m_values.find(name);
   if (iter == m_values.end()) {
     return ConstructPtr();
@@ -126,11 +142,16 @@ TypePtr SymbolTable::coerceTo(AnalysisResultPtr ar,
 
 TypePtr SymbolTable::setType(AnalysisResultPtr ar, const std::string &name,
                              TypePtr type, bool coerced) {
+  Lock lock(m_mutex);
   TypePtr oldType = getType(name, true);
   if (!oldType) oldType = NEW_TYPE(Some);
 
   if (m_declarations.find(name) == m_declarations.end()) {
-    m_symbols.push_back(name);
+    if (ar->inParallelPass()) {
+      m_newSymbols.insert(name);
+    } else {
+      m_symbols.push_back(name);
+    }
     m_declarations[name] = ConstructPtr();
   }
   if (type) {
@@ -146,6 +167,7 @@ TypePtr SymbolTable::setType(AnalysisResultPtr ar, const std::string &name,
 }
 
 void SymbolTable::getSymbols(vector<string> &syms) {
+  Lock lock(m_mutex);
   BOOST_FOREACH(string sym, m_symbols) {
     syms.push_back(sym);
   }
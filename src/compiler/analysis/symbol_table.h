@@ -20,6 +20,7 @@
 #include <compiler/hphp.h>
 #include <util/json.h>
 #include <util/util.h>
+#include <util/lock.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -40,6 +41,11 @@ class SymbolTable : public boost::enable_shared_from_this<SymbolTable>,
 public:
   static SymbolTablePtrVec AllSymbolTables; // for stats purpose
   static void CountTypes(std::map<std::string, int> &counts);
+  /**
+   * Appends symbols first seen by a parallel pass to their tables, sorted,
+   * so m_symbols comes out the same no matter how threads interleaved.
+   */
+  static void CommitNewSymbols();
   BlockScope *getScope() const { return &m_blockScope; }
 
 public:
@@ -114,6 +120,8 @@ protected:
   StringToConstructPtrMap m_values; // explicit declarations
   StringToTypePtrMap m_coerced; // symbols that have been coerced
   StringToTypePtrMap m_rtypes;  // r-value types for m_symbols
+  std::set<std::string> m_newSymbols; // not in m_symbols until committed
+  mutable Mutex m_mutex; // for passes running over files in parallel
 
   TypePtr coerceTo(AnalysisResultPtr ar, StringToTypePtrMap &typeMap,
                    const std::string &name, TypePtr type);
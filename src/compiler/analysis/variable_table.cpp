@@ -268,6 +268,7 @@ ConstructPtr VariableTable::getStaticInitVal(string varName) {
 
 bool VariableTable::setStaticInitVal(string varName,
                                      ConstructPtr value) {
+  Lock lock(m_mutex);
   bool exists = (m_staticInitVal.find(varName) != m_staticInitVal.end());
   m_staticInitVal[varName] = value;
   return exists;
@@ -280,6 +281,7 @@ ConstructPtr VariableTable::getClassInitVal(string varName) {
 }
 
 bool VariableTable::setClassInitVal(string varName, ConstructPtr value) {
+  Lock lock(m_mutex);
   bool exists = (m_clsInitVal.find(varName) != m_clsInitVal.end());
   m_clsInitVal[varName] = value;
   return exists;
@@ -289,6 +291,7 @@ bool VariableTable::setClassInitVal(string varName, ConstructPtr value) {
 
 TypePtr VariableTable::addParam(const string &name, TypePtr type,
                                 AnalysisResultPtr ar, ConstructPtr construct) {
+  Lock lock(m_mutex);
   if (m_parameters.find(name) == m_parameters.end()) {
     int index = m_parameters.size();
     m_parameters[name] = index;
@@ -299,6 +302,7 @@ TypePtr VariableTable::addParam(const string &name, TypePtr type,
 void VariableTable::addStaticVariable(const string &name,
                                       AnalysisResultPtr ar,
                                       bool member /* = false */) {
+  Lock lock(m_mutex);
   if (isGlobalTable(ar)) {
     return; // a static variable at global scope is the same as non-static
   }
@@ -318,6 +322,7 @@ void VariableTable::addStaticVariable(const string &name,
   sgi->func = member ? FunctionScopePtr() : ar->getFunctionScope();
 
   string id = StaticGlobalInfo::getName(sgi->cls, sgi->func, name);
+  Lock globalLock(globalVariables->m_mutex);
   ASSERT(globalVariables->m_staticGlobals.find(id) ==
          globalVariables->m_staticGlobals.end());
   globalVariables->m_staticGlobals[id] = sgi;
@@ -328,6 +333,7 @@ TypePtr VariableTable::add(const string &name, TypePtr type,
                            ConstructPtr construct,
                            ModifierExpressionPtr modifiers,
                            bool checkError /* = true */) {
+  Lock lock(m_mutex);
   if (getAttribute(InsideStaticStatement)) {
     addStaticVariable(name, ar);
     if (ar->needStaticArray(ar->getClassScope())) {
@@ -382,6 +388,7 @@ TypePtr VariableTable::add(const string &name, TypePtr type,
 TypePtr VariableTable::checkVariable(const string &name, TypePtr type,
                                      bool coerce, AnalysisResultPtr ar,
                                      ConstructPtr construct, int &properties) {
+  Lock lock(m_mutex);
   properties = 0;
 
   // Variable used in pseudomain
@@ -424,6 +431,7 @@ TypePtr VariableTable::checkVariable(const string &name, TypePtr type,
 TypePtr VariableTable::checkProperty(const string &name, TypePtr type,
                                      bool coerce, AnalysisResultPtr ar,
                                      ConstructPtr construct, int &properties) {
+  Lock lock(m_mutex);
   properties = VariablePresent;
   if (m_declarations.find(name) == m_declarations.end()) {
     ClassScopePtr parent = findParent(ar, name);
@@ -461,6 +469,7 @@ TypePtr VariableTable::checkProperty(const string &name, TypePtr type,
 bool VariableTable::checkRedeclared(const string &name,
                                     Statement::KindOf kindOf)
 {
+  Lock lock(m_mutex);
   ASSERT(kindOf == Statement::KindOfStaticStatement ||
          kindOf == Statement::KindOfGlobalStatement);
   if (kindOf == Statement::KindOfStaticStatement && isPresent(name)) {
@@ -482,23 +491,28 @@ bool VariableTable::checkRedeclared(const string &name,
 }
 
 void VariableTable::addLocalGlobal(const string &name) {
+  Lock lock(m_mutex);
   m_localGlobal.insert(name);
 }
 
 void VariableTable::addNestedStatic(const string &name) {
+  Lock lock(m_mutex);
   m_nestedStatic.insert(name);
 }
 
 void VariableTable::addLvalParam(const string &name) {
+  Lock lock(m_mutex);
   m_lvalParam.insert(name);
 }
 
 void VariableTable::addUsed(const string &name) {
+  Lock lock(m_mutex);
   m_used.insert(name);
 }
 
 void VariableTable::addNeeded(const string &name)
 {
+  Lock lock(m_mutex);
   m_needed.insert(name);
 }
 
@@ -516,10 +530,15 @@ void VariableTable::clearUsed()
 }
 
 void VariableTable::forceVariants(AnalysisResultPtr ar) {
+  Lock lock(m_mutex);
   if (!m_allVariants) {
     for (unsigned int i = 0; i < m_symbols.size(); i++) {
       setType(ar, m_symbols[i], Type::Variant, true);
     }
+    for (set<string>::const_iterator iter = m_newSymbols.begin();
+         iter != m_newSymbols.end(); ++iter) {
+      setType(ar, *iter, Type::Variant, true);
+    }
     m_allVariants = true;
 
     ClassScopePtr parent = m_blockScope.getParentScope(ar);
@@ -531,6 +550,7 @@ void VariableTable::forceVariants(AnalysisResultPtr ar) {
 
 void VariableTable::forceVariant(AnalysisResultPtr ar,
                                  const string &name) {
+  Lock lock(m_mutex);
   if (m_declarations.find(name) != m_declarations.end()) {
     setType(ar, name, Type::Variant, true);
   }
@@ -538,6 +558,7 @@ void VariableTable::forceVariant(AnalysisResultPtr ar,
 
 TypePtr VariableTable::setType(AnalysisResultPtr ar, const string &name,
                                TypePtr type, bool coerce) {
+  Lock lock(m_mutex);
   if (m_allVariants) type = Type::Variant;
   TypePtr ret = SymbolTable::setType(ar, name, type, coerce || m_allVariants);
   if (!ret) return ret;
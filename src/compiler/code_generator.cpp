@@ -65,6 +65,7 @@ CodeGenerator::CodeGenerator(std::ostream *primary,
 
   if (filename) m_filename = *filename;
   m_translatePredefined = false;
+  m_annotate = Option::FlAnnotate;
 }
 
 void CodeGenerator::useStream(Stream stream) {
@@ -95,7 +95,7 @@ public:
                              bool caseInsensitive);
 
 public:
-  CodeGenerator() {} // only for creating a dummy code generator
+  CodeGenerator() : m_annotate(false) {} // only for creating a dummy one
   CodeGenerator(std::ostream *primary, Output output = PickledPHP,
                 std::string *filename = NULL);
 
@@ -194,6 +194,8 @@ public:
 
   bool translatePredefined() { return m_translatePredefined; }
   void translatePredefined(bool flag) { m_translatePredefined = flag; }
+  bool annotate() const { return m_annotate; }
+  void annotate(bool flag) { m_annotate = flag; }
 
   int checkLiteralString(const std::string &str, int &index,
                          AnalysisResultPtr ar);
@@ -224,6 +226,7 @@ private:
   int m_phpLineNo;
 
   bool m_translatePredefined; // translate predefined constants in PHP output
+  bool m_annotate; // annotate output with compiler file-line info
 
   void print(const char *fmt, va_list ap);
   void print(const std::string &msg);
@@ -231,7 +234,7 @@ private:
 
 #define STR(x) #x
 #define XSTR(x) STR(x)
-#define FLANN(stream,func,nl) (Option::FlAnnotate ?                           \
+#define FLANN(stream,func,nl) (stream.annotate() ?                            \
                stream.printf("/* %s:" XSTR(__LINE__) "*/"nl, __func__):       \
                void()), stream.func
 #define cg_printf FLANN(cg,printf,"")
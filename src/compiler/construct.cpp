@@ -64,12 +64,14 @@ int Construct::getContainedEffects() const {
 std::string Construct::getText(bool useCache /* = false */,
                                bool translate /* = false */,
                                AnalysisResultPtr ar
-                               /* = AnalysisResultPtr() */) {
+                               /* = AnalysisResultPtr() */,
+                               bool annotate /* = true */) {
   std::string &text = m_text;
   if (useCache && !text.empty()) return text;
   ostringstream o;
   CodeGenerator cg(&o, CodeGenerator::PickledPHP);
   cg.translatePredefined(translate);
+  if (!annotate) cg.annotate(false);
   outputPHP(cg, ar);
   text = o.str();
   return text;
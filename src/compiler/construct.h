@@ -125,10 +125,12 @@ public:
   virtual void serialize(JSON::OutputStream &out) const;
 
   /**
-   * Get canonicalized PHP source code for this construct.
+   * Get canonicalized PHP source code for this construct. Without annotate,
+   * it has no compiler file-line comments even when Option::FlAnnotate is on.
    */
   std::string getText(bool useCache = false, bool translate = false,
-                      AnalysisResultPtr ar = AnalysisResultPtr());
+                      AnalysisResultPtr ar = AnalysisResultPtr(),
+                      bool annotate = true);
 
   void addHphpNote(const std::string &s);
   bool hasHphpNote(const std::string &s) const {
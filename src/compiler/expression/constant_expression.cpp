@@ -146,10 +146,8 @@ ExpressionPtr ConstantExpression::preOptimize(AnalysisResultPtr ar) {
         if (value->is(Expression::KindOfScalarExpression)) {
           ScalarExpressionPtr exp =
             dynamic_pointer_cast<ScalarExpression>(Clone(value));
-          bool annotate = Option::FlAnnotate;
-          Option::FlAnnotate = false; // avoid nested comments on getText
-          exp->setComment(getText());
-          Option::FlAnnotate = annotate;
+          // avoid nested comments
+          exp->setComment(getText(false, false, AnalysisResultPtr(), false));
           exp->setLocation(getLocation());
           m_valid = true;
           return exp;
@@ -157,10 +155,8 @@ ExpressionPtr ConstantExpression::preOptimize(AnalysisResultPtr ar) {
           // inline the value
           ConstantExpressionPtr exp =
             dynamic_pointer_cast<ConstantExpression>(Clone(value));
-          bool annotate = Option::FlAnnotate;
-          Option::FlAnnotate = false; // avoid nested comments on getText
-          exp->setComment(getText());
-          Option::FlAnnotate = annotate;
+          // avoid nested comments
+          exp->setComment(getText(false, false, AnalysisResultPtr(), false));
           exp->setLocation(getLocation());
           m_valid = true;
           return exp;
@@ -21,7 +21,9 @@
 #include <compiler/expression/simple_variable.h>
 #include <compiler/analysis/function_scope.h>
 #include <compiler/analysis/class_scope.h>
+#include <compiler/analysis/file_scope.h>
 #include <util/util.h>
+#include <util/hash.h>
 #include <compiler/option.h>
 #include <compiler/analysis/variable_table.h>
 
@@ -59,11 +61,20 @@ void DynamicFunctionCall::analyzeProgram(AnalysisResultPtr ar) {
   }
   m_nameExp->analyzeProgram(ar);
   if (m_params) {
-    m_params->markParams(false);
+    m_params->markParams(canUseCallCache(ar));
     m_params->analyzeProgram(ar);
   }
 }
 
+/**
+ * $f(...) calls with few enough arguments go through a DynamicCallCache.
+ */
+bool DynamicFunctionCall::canUseCallCache(AnalysisResultPtr ar) const {
+  return Option::DynamicCallCaches && !ar->isSystem() &&
+    !m_class && m_className.empty() &&
+    (!m_params || m_params->getCount() <= Option::InvokeFewArgsCount);
+}
+
 ExpressionPtr DynamicFunctionCall::preOptimize(AnalysisResultPtr ar) {
   return FunctionCall::preOptimize(ar);
 }
@@ -168,6 +179,35 @@ void DynamicFunctionCall::outputCPPImpl(CodeGenerator &cg,
       cg_printf(")");
       return;
     }
+  } else if (canUseCallCache(ar)) {
+    // e.g. $f($a, 1), arguments go the way o_invoke_few_args() takes them;
+    // sites sharing an id share a cache, which only costs hits
+    int id = ((hash_string(ar->getFileScope()->getName().c_str()) & 0x7FFF)
+              << 16) | (cg.createNewId(ar) & 0xFFFF);
+    int count = m_params ? m_params->getCount() : 0;
+    int refs = 0;
+    for (int i = 0; i < count; i++) {
+      ExpressionPtr param = (*m_params)[i];
+      if (param->hasContext(Expression::RefValue) && param->isRefable()) {
+        refs |= 1 << i;
+      }
+    }
+    cg_printf("DynamicCallSite<%d>::Cache.invoke(", id);
+    if (m_nameExp->is(Expression::KindOfSimpleVariable)) {
+      m_nameExp->outputCPP(cg, ar);
+    } else {
+      cg_printf("(");
+      m_nameExp->outputCPP(cg, ar);
+      cg_printf(")");
+    }
+    cg_printf(", 0x%X, %d", refs, count);
+    if (count) {
+      cg_printf(", ");
+      FunctionScope::outputCPPArguments(m_params, cg, ar, 0, false);
+    }
+    cg_printf(")");
+    if (linemap) cg_printf(")");
+    return;
   } else {
     cg_printf("invoke(");
   }
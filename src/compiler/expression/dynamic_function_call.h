@@ -31,6 +31,9 @@ public:
                       ExpressionPtr cls);
 
   DECLARE_BASE_EXPRESSION_VIRTUAL_FUNCTIONS;
+
+private:
+  bool canUseCallCache(AnalysisResultPtr ar) const;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
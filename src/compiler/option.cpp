@@ -140,6 +140,7 @@ bool Option::SeparateCompLib = false;
 bool Option::UseNamedLiteralString = true;
 int Option::LiteralStringFileCount = 50;
 bool Option::AnalyzePerfectVirtuals = true;
+int Option::AnalysisThreadCount = 0;
 
 std::string Option::RTTIOutputFile;
 std::string Option::RTTIDirectory;
@@ -169,6 +170,7 @@ std::string Option::ProgramName;
 bool Option::EnableXHP = false;
 
 int Option::InvokeFewArgsCount = 6;
+bool Option::DynamicCallCaches = true;
 bool Option::PrecomputeLiteralStrings = true;
 bool Option::FlattenInvoke = true;
 int Option::InlineFunctionThreshold = -1;
@@ -332,6 +334,7 @@ void Option::Load(Hdf &config) {
   if (LiteralStringFileCount <= 0) LiteralStringFileCount = 1;
   ScalarArrayOverflowLimit = config["ScalarArrayOverflowLimit"].getInt32(2000);
   if (ScalarArrayOverflowLimit <= 0) ScalarArrayOverflowLimit = 2000;
+  AnalysisThreadCount = config["AnalysisThreadCount"].getInt32(0);
   FlibDirectory = config["FlibDirectory"].getString();
   EnableXHP = config["EnableXHP"].getBool();
   RTTIOutputFile = config["RTTIOutputFile"].getString();
@@ -346,6 +349,11 @@ void Option::Load(Hdf &config) {
   LocalCopyProp      = config["LocalCopyProp"].getBool(true);
   StringLoopOpts     = config["StringLoopOpts"].getBool(true);
   AutoInline         = config["AutoInline"].getBool(false);
+  DynamicCallCaches  = config["DynamicCallCaches"].getBool(true);
+  if (!DynamicInvokeFunctions.empty() || EnableEval == FullEval) {
+    // the same name may call different functions over time
+    DynamicCallCaches = false;
+  }
 
   OnLoad();
 }
@@ -112,6 +112,7 @@ public:
   static int LiteralStringFileCount;
   static bool LiteralStringCompression;
   static bool AnalyzePerfectVirtuals;
+  static int AnalysisThreadCount;
 
   /**
    * RTTI profiling metadata output file
@@ -300,6 +301,7 @@ public:
    * Optimizations
    */
   static int InvokeFewArgsCount;
+  static bool DynamicCallCaches;
   static bool PrecomputeLiteralStrings;
   static bool FlattenInvoke;
   static int InlineFunctionThreshold;
@@ -32,6 +32,7 @@
 #include <util/db_query.h>
 #include <util/exception.h>
 #include <util/preprocess.h>
+#include <util/hash.h>
 
 using namespace HPHP;
 using namespace std;
@@ -341,13 +342,7 @@ bool Package::parseImpl(const char *fileName) {
   ASSERT(fileName);
   if (fileName[0] == 0) return false;
 
-  string fullPath;
-  if (fileName[0] == '/') {
-    fullPath = fileName;
-  } else {
-    fullPath = m_root + fileName;
-  }
-
+  string fullPath = getFullPath(fileName);
   struct stat sb;
   if (stat(fullPath.c_str(), &sb)) {
     Logger::Error("Unable to stat file %s", fullPath.c_str());
@@ -389,6 +384,96 @@ bool Package::parseImpl(const char *fileName) {
   return true;
 }
 
+string Package::getFullPath(const char *fileName) const {
+  if (fileName[0] == '/') return fileName;
+  return m_root + fileName;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int64 hash_file(const string &path) {
+  ifstream f(path.c_str());
+  stringstream ss;
+  ss << f.rdbuf();
+  string content = ss.str();
+  return hash_string(content.data(), content.size());
+}
+
+bool Package::saveInputCache(const char *filename, const string &key) const {
+  string tmp = string(filename) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (!f) {
+    Logger::Error("Unable to open %s: %s", tmp.c_str(), strerror(errno));
+    return false;
+  }
+  fprintf(f, "%s\n", key.c_str());
+
+  hphp_const_char_set done;
+  for (unsigned int i = 0; i < m_files.size(); i++) {
+    const char *fileName = m_files.at(i);
+    if (!done.insert(fileName).second) continue;
+    string fullPath = getFullPath(fileName);
+    struct stat sb;
+    if (stat(fullPath.c_str(), &sb)) continue;
+    fprintf(f, "%llx %lld %lld %s\n", hash_file(fullPath),
+            (int64)sb.st_size, (int64)sb.st_mtime, fileName);
+  }
+
+  bool ok = !ferror(f);
+  if (fclose(f) != 0) ok = false;
+  if (!ok || rename(tmp.c_str(), filename) != 0) {
+    Logger::Error("Unable to write %s", filename);
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Package::checkInputCache(const char *filename, const string &key) const {
+  FILE *f = fopen(filename, "r");
+  if (!f) return false;
+
+  bool upToDate = true;
+  set<string> cached;
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len = getline(&line, &cap, f);
+  if (len <= 0 || string(line, len - 1) != key) {
+    Logger::Info("compiler or options changed since last compilation");
+    upToDate = false;
+  }
+  while (upToDate && (len = getline(&line, &cap, f)) > 0) {
+    line[len - 1] = '\0';
+    int64 hash, size, mtime;
+    int pos = 0;
+    if (sscanf(line, "%llx %lld %lld %n", &hash, &size, &mtime, &pos) != 3 ||
+        pos == 0) {
+      upToDate = false;
+      break;
+    }
+    const char *fileName = line + pos;
+    cached.insert(fileName);
+    string fullPath = getFullPath(fileName);
+    struct stat sb;
+    if (stat(fullPath.c_str(), &sb) || sb.st_size != size ||
+        (sb.st_mtime != mtime && hash_file(fullPath) != hash)) {
+      Logger::Info("%s changed since last compilation", fileName);
+      upToDate = false;
+    }
+  }
+  free(line);
+  fclose(f);
+
+  for (unsigned int i = 0; upToDate && i < m_files.size(); i++) {
+    const char *fileName = m_files.at(i);
+    if (cached.find(fileName) == cached.end()) {
+      Logger::Info("%s added since last compilation", fileName);
+      upToDate = false;
+    }
+  }
+  return upToDate;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 void Package::saveStatsToFile(const char *filename, int totalSeconds) const {
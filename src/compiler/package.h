@@ -68,6 +68,20 @@ public:
   const std::string& getRoot() const { return m_root;}
   FileCachePtr getFileCache();
 
+  /**
+   * For --skip-unchanged, which only short-cuts a build where nothing
+   * changed; there is no per-file reuse. Saves every file parsed, including
+   * ones parsed on demand, with its size, mtime and content hash. key stands
+   * for everything else the output depends on (options, compiler binary).
+   */
+  bool saveInputCache(const char *filename, const std::string &key) const;
+
+  /**
+   * Whether all files added so far were parsed last time, and none of the
+   * files parsed last time has changed since, under the same key.
+   */
+  bool checkInputCache(const char *filename, const std::string &key) const;
+
   static void setHookHandler(void (*hookHandler)(Package *package,
                                                  const char *path,
                                                  HphpHookUniqueId id)) {
@@ -97,6 +111,7 @@ private:
                             DependencyGraph::KindOf kindOf);
 
   bool parseImpl(const char *fileName);
+  std::string getFullPath(const char *fileName) const;
 
   // hook
   static void (*m_hookHandler)(Package *package, const char *path,
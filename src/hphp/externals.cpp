@@ -15,6 +15,7 @@
 */
 
 #include <runtime/base/complex_types.h>
+#include <runtime/base/dynamic_call_cache.h>
 
 using namespace std;
 
@@ -39,6 +40,11 @@ Variant invoke(const char* function,
   return true;
 }
 
+const DynamicCallTarget *get_dynamic_call_target(const char *s,
+                                                 int64 hash) {
+  return NULL;
+}
+
 Variant invoke_static_method(const char* cls, MethodIndex methodIndex,
                              const char *function,
                              CArrRef params, bool fatal /* = true */) {
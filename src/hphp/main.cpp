@@ -36,9 +36,11 @@
 #include <util/util.h>
 #include <util/timer.h>
 #include <util/hdf.h>
+#include <util/hash.h>
 
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
 #include <dlfcn.h>
 
 using namespace HPHP;
@@ -51,6 +53,8 @@ struct ProgramOptions {
   string outputDir;
   string outputFile;
   string syncDir;
+  bool skipUnchanged;
+  string inputCacheKey;
   vector<string> config;
   string configDir;
   vector<string> confStrings;
@@ -93,6 +97,7 @@ struct ProgramOptions {
 };
 
 int prepareOptions(ProgramOptions &po, int argc, char **argv);
+string inputCacheKey(const ProgramOptions &po, int argc, char **argv);
 void createOutputDirectory(ProgramOptions &po);
 int process(const ProgramOptions &po);
 int lintTarget(const ProgramOptions &po);
@@ -230,6 +235,11 @@ int prepareOptions(ProgramOptions &po, int argc, char **argv) {
      "Files will be created in this directory first, then sync with output "
      "directory without overwriting identical files. Great for incremental "
      "compilation and build.")
+    ("skip-unchanged", value<bool>(&po.skipUnchanged)->default_value(false),
+     "no-op build shortcut: skip parsing and generating code when no input "
+     "file has changed since the last compilation into the same output "
+     "directory; any change still recompiles everything, and generated "
+     "files are synced, so unchanged ones keep their timestamps")
     ("optimize-level", value<int>(&po.optimizeLevel)->default_value(1),
      "optimization level")
     ("gen-stats", value<bool>(&po.genStats)->default_value(false),
@@ -310,6 +320,10 @@ int prepareOptions(ProgramOptions &po, int argc, char **argv) {
     return 1;
   }
 
+  if (po.skipUnchanged) {
+    po.inputCacheKey = inputCacheKey(po, argc, argv);
+  }
+
   // log level
   if (po.logLevel != -1) {
     Logger::LogLevel = (Logger::LogLevelType)po.logLevel;
@@ -459,6 +473,36 @@ int prepareOptions(ProgramOptions &po, int argc, char **argv) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Everything besides input files that generated code depends on: the
+ * command line, config files and the compiler binary itself.
+ */
+string inputCacheKey(const ProgramOptions &po, int argc, char **argv) {
+  string key;
+  for (int i = 1; i < argc; i++) {
+    key += argv[i];
+    key += '\0';
+  }
+  for (unsigned int i = 0; i < po.config.size(); i++) {
+    ifstream f(po.config[i].c_str());
+    stringstream ss;
+    ss << f.rdbuf();
+    key += ss.str();
+  }
+  struct stat sb;
+  if (stat("/proc/self/exe", &sb) == 0) {
+    key.append((const char *)&sb.st_size, sizeof(sb.st_size));
+    key.append((const char *)&sb.st_mtime, sizeof(sb.st_mtime));
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%llx", hash_string(key.data(), key.size()));
+  return buf;
+}
+
+static string inputCachePath(const ProgramOptions &po) {
+  return po.outputDir + "/hphp_inputs.cache";
+}
+
 int process(const ProgramOptions &po) {
   if (po.coredump) {
 #if defined(__APPLE__)
@@ -544,6 +588,14 @@ int process(const ProgramOptions &po) {
         }
       }
     }
+    if (po.skipUnchanged && po.target == "cpp" && po.filecache.empty() &&
+        !po.genStats && po.dbStats.empty() &&
+        package.checkInputCache(inputCachePath(po).c_str(),
+                                po.inputCacheKey)) {
+      Logger::Info("no input changed since last compilation");
+      if (!po.syncDir.empty()) boost::filesystem::remove_all(po.syncDir);
+      return 0;
+    }
     if (po.target != "filecache") {
       if (!package.parse()) {
         return 1;
@@ -576,6 +628,10 @@ int process(const ProgramOptions &po) {
   } else if (po.target == "cpp") {
     ret = cppTarget(po, ar);
     fatalErrorOnly = true;
+    // after cppTarget(), because syncing deletes files not generated
+    if (ret == 0 && po.skipUnchanged) {
+      package.saveInputCache(inputCachePath(po).c_str(), po.inputCacheKey);
+    }
   } else if (po.target == "run") {
     ret = runTargetCheck(po, ar);
     fatalErrorOnly = true;
@@ -908,6 +964,14 @@ void createOutputDirectory(ProgramOptions &po) {
   }
   mkdir(po.outputDir.c_str(), 0777);
 
+  if (po.skipUnchanged && po.syncDir.empty()) {
+    // generate elsewhere first, so unchanged files keep their timestamps
+    string dir = po.outputDir;
+    while (dir.size() > 1 && dir[dir.size() - 1] == '/') {
+      dir.resize(dir.size() - 1);
+    }
+    po.syncDir = dir + ".sync";
+  }
   if (!po.syncDir.empty()) {
     Logger::Info("re-creating sync directory %s ...", po.syncDir.c_str());
     boost::filesystem::remove_all(po.syncDir);
@@ -718,6 +718,92 @@ DefineFunction(
     ),
   ));
 
+DefineFunction(
+  array(
+    'name'   => "mysql_async_query_start",
+    'desc'   => "Sends a query without waiting for its result, so queries on other connections can run at the same time. Other mysql functions called on the connection before mysql_async_query_result() throw the result away.",
+    'flags'  =>  HasDocComment | HipHopSpecific,
+    'return' => array(
+      'type'   => Boolean,
+      'desc'   => "TRUE if the query was sent, FALSE on error.",
+    ),
+    'args'   => array(
+      array(
+        'name'   => "query",
+        'type'   => String,
+        'desc'   => "The SQL query to send.",
+      ),
+      array(
+        'name'   => "link_identifier",
+        'type'   => Variant,
+        'value'  => "null",
+        'desc'   => "Which connection to use. If absent, default or current connection will be used.",
+      ),
+    ),
+  ));
+
+DefineFunction(
+  array(
+    'name'   => "mysql_async_query_completed",
+    'desc'   => "Checks, without waiting, whether mysql_async_query_result() can return without blocking.",
+    'flags'  =>  HasDocComment | HipHopSpecific,
+    'return' => array(
+      'type'   => Boolean,
+      'desc'   => "TRUE if the server has answered, or no query is pending.",
+    ),
+    'args'   => array(
+      array(
+        'name'   => "link_identifier",
+        'type'   => Variant,
+        'value'  => "null",
+        'desc'   => "Which connection to use. If absent, default or current connection will be used.",
+      ),
+    ),
+  ));
+
+DefineFunction(
+  array(
+    'name'   => "mysql_async_wait_actionable",
+    'desc'   => "Waits until the server has answered the query sent by mysql_async_query_start() on at least one of the connections.",
+    'flags'  =>  HasDocComment | HipHopSpecific,
+    'return' => array(
+      'type'   => VariantMap,
+      'desc'   => "The connections mysql_async_query_result() can be called on without blocking, with their keys in items. Empty if none is ready before the timeout.",
+    ),
+    'args'   => array(
+      array(
+        'name'   => "items",
+        'type'   => VariantMap,
+        'desc'   => "MySQL connections.",
+      ),
+      array(
+        'name'   => "timeout",
+        'type'   => Double,
+        'value'  => "1.0",
+        'desc'   => "Time, in seconds, to wait.",
+      ),
+    ),
+  ));
+
+DefineFunction(
+  array(
+    'name'   => "mysql_async_query_result",
+    'desc'   => "Returns the result of the query sent by mysql_async_query_start(), waiting for it if the server has not answered yet.",
+    'flags'  =>  HasDocComment | HipHopSpecific,
+    'return' => array(
+      'type'   => Variant,
+      'desc'   => "Same as mysql_query().",
+    ),
+    'args'   => array(
+      array(
+        'name'   => "link_identifier",
+        'type'   => Variant,
+        'value'  => "null",
+        'desc'   => "Which connection to use. If absent, default or current connection will be used.",
+      ),
+    ),
+  ));
+
 DefineFunction(
   array(
     'name'   => "mysql_db_query",
@@ -1027,6 +1113,30 @@ DefineFunction(
     ),
   ));
 
+DefineFunction(
+  array(
+    'name'   => "mysql_fetch_all",
+    'desc'   => "Fetches all the remaining rows of a result at once, which is quicker than calling mysql_fetch_array() for each of them.",
+    'flags'  =>  HasDocComment | HipHopSpecific,
+    'return' => array(
+      'type'   => Variant,
+      'desc'   => "A vector of rows, each like what mysql_fetch_array() returns, or FALSE on error.",
+    ),
+    'args'   => array(
+      array(
+        'name'   => "result",
+        'type'   => Variant,
+        'desc'   => "resource that is being evaluated. This result comes from a call to mysql_query().",
+      ),
+      array(
+        'name'   => "result_type",
+        'type'   => Int32,
+        'value'  => "3",
+        'desc'   => "The type of array each row is fetched into: MYSQL_ASSOC, MYSQL_NUM, or MYSQL_BOTH.",
+      ),
+    ),
+  ));
+
 DefineFunction(
   array(
     'name'   => "mysql_fetch_lengths",
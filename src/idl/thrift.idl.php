@@ -107,6 +107,58 @@ DefineFunction(
     ),
   ));
 
+DefineFunction(
+  array(
+    'name'   => "thrift_protocol_write_compact",
+    'desc'   => "Writes a message with the compact protocol, which is smaller and quicker than the binary one.",
+    'flags'  =>  HasDocComment | HipHopSpecific,
+    'return' => array(
+      'type'   => null,
+    ),
+    'args'   => array(
+      array(
+        'name'   => "transportobj",
+        'type'   => Object,
+      ),
+      array(
+        'name'   => "method_name",
+        'type'   => String,
+      ),
+      array(
+        'name'   => "msgtype",
+        'type'   => Int64,
+      ),
+      array(
+        'name'   => "request_struct",
+        'type'   => Object,
+      ),
+      array(
+        'name'   => "seqid",
+        'type'   => Int32,
+      ),
+    ),
+  ));
+
+DefineFunction(
+  array(
+    'name'   => "thrift_protocol_read_compact",
+    'desc'   => "Reads a message written with the compact protocol.",
+    'flags'  =>  HasDocComment | HipHopSpecific,
+    'return' => array(
+      'type'   => Variant,
+    ),
+    'args'   => array(
+      array(
+        'name'   => "transportobj",
+        'type'   => Object,
+      ),
+      array(
+        'name'   => "obj_typename",
+        'type'   => String,
+      ),
+    ),
+  ));
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Classes
@@ -16,6 +16,7 @@
 #include <runtime/base/array/array_init.h>
 #include <runtime/base/array/zend_array.h>
 #include <runtime/base/array/small_array.h>
+#include <runtime/base/array/hphp_array.h>
 #include <runtime/base/runtime_option.h>
 
 namespace HPHP {
@@ -25,11 +26,15 @@ namespace HPHP {
 ArrayInit::ArrayInit(ssize_t n, bool isVector /* = false */,
                      bool keepRef /* = false */) : m_data(NULL) {
   if (n == 0) {
-    if (RuntimeOption::UseSmallArray && !keepRef) {
+    if (RuntimeOption::UseHphpArray && !keepRef) {
+      m_data = StaticEmptyHphpArray::Get();
+    } else if (RuntimeOption::UseSmallArray && !keepRef) {
       m_data = StaticEmptySmallArray::Get();
     } else {
       m_data = StaticEmptyZendArray::Get();
     }
+  } else if (RuntimeOption::UseHphpArray && !keepRef) {
+    m_data = NEW(HphpArray)(n);
   } else if (n <= SmallArray::SARR_SIZE && !keepRef &&
              RuntimeOption::UseSmallArray) {
     m_data = NEW(SmallArray)();
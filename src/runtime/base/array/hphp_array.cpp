@@ -0,0 +1,1186 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/array/hphp_array.h>
+#include <runtime/base/array/array_init.h>
+#include <runtime/base/array/zend_array.h>
+#include <runtime/base/complex_types.h>
+#include <runtime/base/memory/memory_manager.h>
+#include <runtime/base/runtime_error.h>
+#include <util/hash.h>
+
+namespace HPHP {
+
+IMPLEMENT_SMART_ALLOCATION(HphpArray, SmartAllocatorImpl::NeedRestoreOnce |
+                           SmartAllocatorImpl::NoSweep);
+///////////////////////////////////////////////////////////////////////////////
+// static members
+
+StaticEmptyHphpArray StaticEmptyHphpArray::s_theEmptyArray;
+
+///////////////////////////////////////////////////////////////////////////////
+// construction/destruciton
+
+static uint compute_capacity(uint nSize) {
+  if (nSize >= 0x40000000) return 0x40000000; // positions are int32
+  uint capacity = 4;
+  while (capacity < nSize) capacity <<= 1;
+  return capacity;
+}
+
+HphpArray::HphpArray(uint nSize /* = 0 */) :
+  m_data(NULL), m_hash(NULL), m_nCapacity(0), m_nTableMask(0), m_nUsed(0),
+  m_nNumOfElements(0), m_nNextFreeElement(0), m_linear(false) {
+  m_pos = ArrayData::invalid_index;
+  if (nSize) {
+    allocData(compute_capacity(nSize), false);
+  }
+}
+
+HphpArray::~HphpArray() {
+  for (uint i = 0; i < m_nUsed; i++) {
+    m_data[i].~Element();
+  }
+  if (!m_linear && m_data) {
+    smart_free(m_data);
+  }
+}
+
+void HphpArray::allocData(uint capacity, bool withHash) {
+  ASSERT(capacity >= MinCapacity && (capacity & (capacity - 1)) == 0);
+  uint tableSize = withHash ? capacity * 2 : 0;
+  m_data = (Element *)smart_malloc(capacity * sizeof(Element) +
+                             tableSize * sizeof(int32));
+  m_nCapacity = capacity;
+  m_linear = false;
+  if (withHash) {
+    m_hash = (int32 *)(m_data + capacity);
+    m_nTableMask = tableSize - 1;
+    memset(m_hash, 0xff, tableSize * sizeof(int32)); // EmptySlot
+  } else {
+    m_hash = NULL;
+    m_nTableMask = 0;
+  }
+}
+
+int HphpArray::blockSize() const {
+  int size = m_nCapacity * sizeof(Element);
+  if (m_hash) size += (m_nTableMask + 1) * sizeof(int32);
+  return size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// iterations
+
+ssize_t HphpArray::nextElement(ssize_t pos) const {
+  ASSERT(pos != ArrayData::invalid_index);
+  for (++pos; pos < (ssize_t)m_nUsed; ++pos) {
+    if (!m_data[pos].isHole()) return pos;
+  }
+  return ArrayData::invalid_index;
+}
+
+ssize_t HphpArray::prevElement(ssize_t pos) const {
+  ASSERT(pos != ArrayData::invalid_index);
+  for (--pos; pos >= 0; --pos) {
+    if (!m_data[pos].isHole()) return pos;
+  }
+  return ArrayData::invalid_index;
+}
+
+ssize_t HphpArray::iter_begin() const {
+  if (m_nNumOfElements == 0) return ArrayData::invalid_index;
+  return m_data[0].isHole() ? nextElement(0) : 0;
+}
+
+ssize_t HphpArray::iter_end() const {
+  if (m_nNumOfElements == 0) return ArrayData::invalid_index;
+  return prevElement(m_nUsed);
+}
+
+ssize_t HphpArray::iter_advance(ssize_t prev) const {
+  if (prev == ArrayData::invalid_index) return ArrayData::invalid_index;
+  return nextElement(prev);
+}
+
+ssize_t HphpArray::iter_rewind(ssize_t prev) const {
+  if (prev == ArrayData::invalid_index) return ArrayData::invalid_index;
+  return prevElement(prev);
+}
+
+Variant HphpArray::getKey(ssize_t pos) const {
+  ASSERT(pos >= 0 && pos < (ssize_t)m_nUsed && !m_data[pos].isHole());
+  const Element &e = m_data[pos];
+  if (e.key) {
+    return e.key;
+  }
+  return e.h;
+}
+
+Variant HphpArray::getValue(ssize_t pos) const {
+  ASSERT(pos >= 0 && pos < (ssize_t)m_nUsed && !m_data[pos].isHole());
+  return m_data[pos].data;
+}
+
+void HphpArray::fetchValue(ssize_t pos, Variant & v) const {
+  ASSERT(pos >= 0 && pos < (ssize_t)m_nUsed && !m_data[pos].isHole());
+  v = m_data[pos].data;
+}
+
+CVarRef HphpArray::getValueRef(ssize_t pos) const {
+  ASSERT(pos >= 0 && pos < (ssize_t)m_nUsed && !m_data[pos].isHole());
+  return m_data[pos].data;
+}
+
+bool HphpArray::isVectorData() const {
+  if (!m_hash) return true;
+  int64 index = 0;
+  for (uint i = 0; i < m_nUsed; i++) {
+    const Element &e = m_data[i];
+    if (e.isHole()) continue;
+    if (e.key || e.h != index++) return false;
+  }
+  return true;
+}
+
+Variant HphpArray::reset() {
+  m_pos = iter_begin();
+  if (m_pos != ArrayData::invalid_index) {
+    return m_data[m_pos].data;
+  }
+  return false;
+}
+
+Variant HphpArray::prev() {
+  if (m_pos != ArrayData::invalid_index) {
+    m_pos = prevElement(m_pos);
+    if (m_pos != ArrayData::invalid_index) {
+      return m_data[m_pos].data;
+    }
+  }
+  return false;
+}
+
+Variant HphpArray::next() {
+  if (m_pos != ArrayData::invalid_index) {
+    m_pos = nextElement(m_pos);
+    if (m_pos != ArrayData::invalid_index) {
+      return m_data[m_pos].data;
+    }
+  }
+  return false;
+}
+
+Variant HphpArray::end() {
+  m_pos = iter_end();
+  if (m_pos != ArrayData::invalid_index) {
+    return m_data[m_pos].data;
+  }
+  return false;
+}
+
+Variant HphpArray::key() const {
+  if (m_pos != ArrayData::invalid_index) {
+    return getKey(m_pos);
+  }
+  return null;
+}
+
+Variant HphpArray::value(ssize_t &pos) const {
+  if (pos != ArrayData::invalid_index) {
+    return m_data[pos].data;
+  }
+  return false;
+}
+
+Variant HphpArray::current() const {
+  if (m_pos != ArrayData::invalid_index) {
+    return m_data[m_pos].data;
+  }
+  return false;
+}
+
+static StaticString s_value("value");
+static StaticString s_key("key");
+
+Variant HphpArray::each() {
+  if (m_pos != ArrayData::invalid_index) {
+    ArrayInit init(4, false);
+    Variant key = getKey(m_pos);
+    Variant value = getValue(m_pos);
+    init.set(0, 1, value);
+    init.set(1, s_value, value, -1, true);
+    init.set(2, 0, key);
+    init.set(3, s_key, key, -1, true);
+    m_pos = nextElement(m_pos);
+    return Array(init.create());
+  }
+  return false;
+}
+
+void HphpArray::getFullPos(FullPos &pos) {
+  // it should have been escalated
+  throw FatalErrorException("HphpArray should have been escalated");
+}
+
+bool HphpArray::setFullPos(const FullPos &pos) {
+  // it should have been escalated
+  throw FatalErrorException("HphpArray should have been escalated");
+}
+
+CVarRef HphpArray::currentRef() {
+  ASSERT(m_pos != ArrayData::invalid_index);
+  return m_data[m_pos].data;
+}
+
+CVarRef HphpArray::endRef() {
+  ASSERT(m_pos != ArrayData::invalid_index);
+  return m_data[iter_end()].data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lookups
+
+static bool hit_string_key(const HphpArray::Element &e, const char *k,
+                           int len, int64 hash) {
+  // holes never reach here, as their index table slots are tombstones
+  if (!e.key) return false;
+  const char *data = e.key->data();
+  return data == k || e.h == hash && e.key->size() == len &&
+         memcmp(data, k, len) == 0;
+}
+
+ssize_t HphpArray::find(int64 h) const {
+  if (!m_hash) {
+    if ((uint64)h < (uint64)m_nUsed) return h;
+    return ArrayData::invalid_index;
+  }
+  for (uint i = hash_int64(h) & m_nTableMask; ; i = (i + 1) & m_nTableMask) {
+    int32 pos = m_hash[i];
+    if (pos == EmptySlot) return ArrayData::invalid_index;
+    if (pos >= 0) {
+      const Element &e = m_data[pos];
+      if (e.key == NULL && e.h == h) return pos;
+    }
+  }
+}
+
+ssize_t HphpArray::find(const char *k, int len, int64 prehash) const {
+  if (!m_hash) return ArrayData::invalid_index;
+  if (prehash < 0) prehash = hash_string(k, len);
+  for (uint i = prehash & m_nTableMask; ; i = (i + 1) & m_nTableMask) {
+    int32 pos = m_hash[i];
+    if (pos == EmptySlot) return ArrayData::invalid_index;
+    if (pos >= 0 && hit_string_key(m_data[pos], k, len, prehash)) return pos;
+  }
+}
+
+/**
+ * Returns the index table slot of the key if it exists, or the slot a new
+ * element with this key should take. Index table always has more empty slots
+ * than positions in m_data, so probing always terminates.
+ */
+int32 *HphpArray::findForInsert(int64 h) const {
+  ASSERT(m_hash);
+  int32 *tombstone = NULL;
+  for (uint i = hash_int64(h) & m_nTableMask; ; i = (i + 1) & m_nTableMask) {
+    int32 *slot = m_hash + i;
+    int32 pos = *slot;
+    if (pos == EmptySlot) return tombstone ? tombstone : slot;
+    if (pos == TombstoneSlot) {
+      if (!tombstone) tombstone = slot;
+    } else {
+      const Element &e = m_data[pos];
+      if (e.key == NULL && e.h == h) return slot;
+    }
+  }
+}
+
+int32 *HphpArray::findForInsert(const char *k, int len, int64 prehash) const {
+  ASSERT(m_hash && prehash >= 0);
+  int32 *tombstone = NULL;
+  for (uint i = prehash & m_nTableMask; ; i = (i + 1) & m_nTableMask) {
+    int32 *slot = m_hash + i;
+    int32 pos = *slot;
+    if (pos == EmptySlot) return tombstone ? tombstone : slot;
+    if (pos == TombstoneSlot) {
+      if (!tombstone) tombstone = slot;
+    } else if (hit_string_key(m_data[pos], k, len, prehash)) {
+      return slot;
+    }
+  }
+}
+
+bool HphpArray::exists(int64 k, int64 prehash /* = -1 */) const {
+  return find(k) != ArrayData::invalid_index;
+}
+
+bool HphpArray::exists(litstr k, int64 prehash /* = -1 */) const {
+  return find(k, strlen(k), prehash) != ArrayData::invalid_index;
+}
+
+bool HphpArray::exists(CStrRef k, int64 prehash /* = -1 */) const {
+  return find(k.data(), k.size(), prehash) != ArrayData::invalid_index;
+}
+
+bool HphpArray::exists(CVarRef k, int64 prehash /* = -1 */) const {
+  if (k.isNumeric()) return find(k.toInt64()) != ArrayData::invalid_index;
+  String key = k.toString();
+  return find(key.data(), key.size(), prehash) != ArrayData::invalid_index;
+}
+
+bool HphpArray::idxExists(ssize_t idx) const {
+  return idx != ArrayData::invalid_index;
+}
+
+Variant HphpArray::get(int64 k, int64 prehash /* = -1 */,
+                       bool error /* = false */) const {
+  ssize_t pos = find(k);
+  if (pos != ArrayData::invalid_index) {
+    return m_data[pos].data;
+  }
+  if (error) {
+    raise_notice("Undefined index: %lld", k);
+  }
+  return null;
+}
+
+Variant HphpArray::get(litstr k, int64 prehash /* = -1 */,
+                       bool error /* = false */) const {
+  ssize_t pos = find(k, strlen(k), prehash);
+  if (pos != ArrayData::invalid_index) {
+    return m_data[pos].data;
+  }
+  if (error) {
+    raise_notice("Undefined index: %s", k);
+  }
+  return null;
+}
+
+Variant HphpArray::get(CStrRef k, int64 prehash /* = -1 */,
+                       bool error /* = false */) const {
+  StringData *key = k.get();
+  if (m_hash && prehash < 0) prehash = key->hash();
+  ssize_t pos = find(key->data(), key->size(), prehash);
+  if (pos != ArrayData::invalid_index) {
+    return m_data[pos].data;
+  }
+  if (error) {
+    raise_notice("Undefined index: %s", k.data());
+  }
+  return null;
+}
+
+Variant HphpArray::get(CVarRef k, int64 prehash /* = -1 */,
+                       bool error /* = false */) const {
+  ssize_t pos;
+  if (k.isNumeric()) {
+    pos = find(k.toInt64());
+  } else {
+    String key = k.toString();
+    StringData *strkey = key.get();
+    if (m_hash && prehash < 0) prehash = strkey->hash();
+    pos = find(strkey->data(), strkey->size(), prehash);
+  }
+  if (pos != ArrayData::invalid_index) {
+    return m_data[pos].data;
+  }
+  if (error) {
+    raise_notice("Undefined index: %s", k.toString().data());
+  }
+  return null;
+}
+
+void HphpArray::load(CVarRef k, Variant &v) const {
+  ssize_t pos;
+  if (k.isNumeric()) {
+    pos = find(k.toInt64());
+  } else {
+    String key = k.toString();
+    StringData *strkey = key.get();
+    pos = find(strkey->data(), strkey->size(), m_hash ? strkey->hash() : -1);
+  }
+  if (pos != ArrayData::invalid_index) {
+    CVarRef data = m_data[pos].data;
+    if (data.isReferenced()) v = ref(data);
+    else v = data;
+  }
+}
+
+ssize_t HphpArray::getIndex(int64 k, int64 prehash /* = -1 */) const {
+  return find(k);
+}
+
+ssize_t HphpArray::getIndex(litstr k, int64 prehash /* = -1 */) const {
+  return find(k, strlen(k), prehash);
+}
+
+ssize_t HphpArray::getIndex(CStrRef k, int64 prehash /* = -1 */) const {
+  return find(k.data(), k.size(), prehash);
+}
+
+ssize_t HphpArray::getIndex(CVarRef k, int64 prehash /* = -1 */) const {
+  if (k.isNumeric()) {
+    return find(k.toInt64());
+  }
+  String key = k.toString();
+  return find(key.data(), key.size(), prehash);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// storage management
+
+/**
+ * Elements are relocated with memcpy(). This is safe, because a Variant that
+ * is referenced by other variables only holds a pointer to the shared inner
+ * Variant, and C++ code never keeps pointers into an array across an
+ * operation that may grow it (that's what "keepRef" arrays are for).
+ */
+static inline void move_element(HphpArray::Element *to,
+                                const HphpArray::Element *from) {
+  memcpy((void *)to, (const void *)from, sizeof(HphpArray::Element));
+}
+
+void HphpArray::prepareForWrite() {
+  if (m_linear) {
+    // never write into a LinearAllocator's memory, as it's restored as-is
+    // on every rollback
+    int nbytes = blockSize();
+    Element *data = (Element *)smart_malloc(nbytes);
+    memcpy((void *)data, (const void *)m_data, nbytes);
+    if (m_hash) m_hash = (int32 *)(data + m_nCapacity);
+    m_data = data;
+    m_linear = false;
+  }
+}
+
+void HphpArray::grow() {
+  ASSERT(m_nUsed == m_nCapacity);
+  uint capacity = m_nCapacity;
+  if (capacity == 0) {
+    capacity = MinCapacity;
+  } else if (m_nNumOfElements * 2 > m_nCapacity) {
+    capacity <<= 1; // otherwise squeezing out holes makes enough room
+  }
+
+  Element *old = m_data;
+  uint oldUsed = m_nUsed;
+  bool oldLinear = m_linear;
+  allocData(capacity, m_hash != NULL);
+
+  uint n = 0;
+  ssize_t pos = ArrayData::invalid_index;
+  for (uint i = 0; i < oldUsed; i++) {
+    if (old[i].isHole()) continue;
+    if (m_pos == (ssize_t)i) pos = n;
+    move_element(m_data + n++, old + i);
+  }
+  ASSERT(n == m_nNumOfElements);
+  m_nUsed = n;
+  m_pos = pos;
+  if (!oldLinear && old) {
+    smart_free(old);
+  }
+  if (m_hash) rehash();
+}
+
+void HphpArray::compact() {
+  ASSERT(!m_linear);
+  if (m_nUsed == m_nNumOfElements) return;
+  uint n = 0;
+  ssize_t pos = ArrayData::invalid_index;
+  for (uint i = 0; i < m_nUsed; i++) {
+    if (m_data[i].isHole()) continue;
+    if (m_pos == (ssize_t)i) pos = n;
+    if (n != i) move_element(m_data + n, m_data + i);
+    n++;
+  }
+  m_nUsed = n;
+  m_pos = pos;
+}
+
+void HphpArray::toHash() {
+  ASSERT(!m_hash);
+  if (m_nCapacity == 0) {
+    allocData(MinCapacity, true);
+    return;
+  }
+  Element *old = m_data;
+  bool oldLinear = m_linear;
+  allocData(m_nCapacity, true);
+  memcpy((void *)m_data, (const void *)old, m_nUsed * sizeof(Element));
+  if (!oldLinear) {
+    smart_free(old);
+  }
+  rehash();
+}
+
+void HphpArray::rehash() {
+  ASSERT(m_hash);
+  memset(m_hash, 0xff, (m_nTableMask + 1) * sizeof(int32)); // EmptySlot
+  for (uint pos = 0; pos < m_nUsed; pos++) {
+    const Element &e = m_data[pos];
+    if (e.isHole()) continue;
+    uint i = (e.key ? e.h : hash_int64(e.h)) & m_nTableMask;
+    while (m_hash[i] != EmptySlot) i = (i + 1) & m_nTableMask;
+    m_hash[i] = pos;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// append/insert/update
+
+inline HphpArray::Element *HphpArray::newElement(int32 *slot) {
+  ASSERT(m_nUsed < m_nCapacity);
+  ssize_t pos = m_nUsed++;
+  if (slot) *slot = pos;
+  if (m_pos == ArrayData::invalid_index) m_pos = pos;
+  m_nNumOfElements++;
+  return m_data + pos;
+}
+
+HphpArray::Element *HphpArray::addKey(int64 h, bool &added) {
+  ASSERT(!m_linear);
+  int32 *slot = NULL;
+  if (!m_hash) {
+    if ((uint64)h < (uint64)m_nUsed) {
+      added = false;
+      return m_data + h;
+    }
+    if (h != (int64)m_nUsed) toHash(); // no longer packed
+  }
+  if (m_hash) {
+    slot = findForInsert(h);
+    if (*slot >= 0) {
+      added = false;
+      return m_data + *slot;
+    }
+  }
+  if (m_nUsed == m_nCapacity) {
+    grow();
+    if (m_hash) slot = findForInsert(h);
+  }
+  if (h >= m_nNextFreeElement) {
+    m_nNextFreeElement = h + 1;
+  }
+  added = true;
+  return new (newElement(slot)) Element(h, NULL);
+}
+
+HphpArray::Element *HphpArray::addKey(StringData *key, int64 h,
+                                      bool &added) {
+  ASSERT(!m_linear && key);
+  if (!m_hash) toHash();
+  if (h < 0) h = key->hash();
+  int32 *slot = findForInsert(key->data(), key->size(), h);
+  if (*slot >= 0) {
+    added = false;
+    return m_data + *slot;
+  }
+  if (m_nUsed == m_nCapacity) {
+    grow();
+    slot = findForInsert(key->data(), key->size(), h);
+  }
+  if (key->isShared()) {
+    key = key->copy(false);
+  }
+  key->incRefCount();
+  added = true;
+  return new (newElement(slot)) Element(h, key);
+}
+
+HphpArray::Element *HphpArray::addKey(litstr key, int len, int64 h,
+                                      bool &added) {
+  ASSERT(!m_linear && key);
+  if (!m_hash) toHash();
+  if (h < 0) h = hash_string(key, len);
+  int32 *slot = findForInsert(key, len, h);
+  if (*slot >= 0) {
+    added = false;
+    return m_data + *slot;
+  }
+  if (m_nUsed == m_nCapacity) {
+    grow();
+    slot = findForInsert(key, len, h);
+  }
+  StringData *skey = NEW(StringData)(key, len, AttachLiteral);
+  skey->incRefCount();
+  added = true;
+  return new (newElement(slot)) Element(h, skey);
+}
+
+void HphpArray::nextInsert(CVarRef data) {
+  bool added;
+  Element *e = addKey(m_nNextFreeElement, added);
+  ASSERT(added);
+  e->data = data;
+}
+
+bool HphpArray::add(int64 h, CVarRef data) {
+  bool added;
+  Element *e = addKey(h, added);
+  if (added) e->data = data;
+  return added;
+}
+
+bool HphpArray::add(StringData *key, int64 h, CVarRef data) {
+  bool added;
+  Element *e = addKey(key, h, added);
+  if (added) e->data = data;
+  return added;
+}
+
+void HphpArray::update(int64 h, CVarRef data) {
+  bool added;
+  addKey(h, added)->data = data;
+}
+
+void HphpArray::update(StringData *key, int64 h, CVarRef data) {
+  bool added;
+  addKey(key, h, added)->data = data;
+}
+
+void HphpArray::update(litstr key, int64 h, CVarRef data) {
+  bool added;
+  addKey(key, strlen(key), h, added)->data = data;
+}
+
+ArrayData *HphpArray::lval(Variant *&ret, bool copy) {
+  if (copy) {
+    HphpArray *a = copyImpl();
+    ssize_t pos = a->iter_end();
+    ASSERT(pos != ArrayData::invalid_index);
+    ret = &a->m_data[pos].data;
+    return a;
+  }
+  prepareForWrite();
+  ssize_t pos = iter_end();
+  ASSERT(pos != ArrayData::invalid_index);
+  ret = &m_data[pos].data;
+  return NULL;
+}
+
+ArrayData *HphpArray::lval(int64 k, Variant *&ret, bool copy,
+                           int64 prehash /* = -1 */,
+                           bool checkExist /* = false */) {
+  bool added;
+  if (!copy) {
+    prepareForWrite();
+    ret = &addKey(k, added)->data;
+    return NULL;
+  }
+  if (checkExist) {
+    ssize_t pos = find(k);
+    if (pos != ArrayData::invalid_index) {
+      prepareForWrite();
+      ret = &m_data[pos].data;
+      return NULL;
+    }
+  }
+  HphpArray *a = copyImpl();
+  ret = &a->addKey(k, added)->data;
+  return a;
+}
+
+ArrayData *HphpArray::lval(CStrRef k, Variant *&ret, bool copy,
+                           int64 prehash /* = -1 */,
+                           bool checkExist /* = false */) {
+  StringData *key = k.get();
+  if (prehash < 0) prehash = key->hash();
+  bool added;
+  if (!copy) {
+    prepareForWrite();
+    ret = &addKey(key, prehash, added)->data;
+    return NULL;
+  }
+  if (checkExist) {
+    ssize_t pos = find(key->data(), key->size(), prehash);
+    if (pos != ArrayData::invalid_index) {
+      prepareForWrite();
+      ret = &m_data[pos].data;
+      return NULL;
+    }
+  }
+  HphpArray *a = copyImpl();
+  ret = &a->addKey(key, prehash, added)->data;
+  return a;
+}
+
+ArrayData *HphpArray::lval(litstr k, Variant *&ret, bool copy,
+                           int64 prehash /* = -1 */,
+                           bool checkExist /* = false */) {
+  int len = strlen(k);
+  if (prehash < 0) prehash = hash_string(k, len);
+  bool added;
+  if (!copy) {
+    prepareForWrite();
+    ret = &addKey(k, len, prehash, added)->data;
+    return NULL;
+  }
+  if (checkExist) {
+    ssize_t pos = find(k, len, prehash);
+    if (pos != ArrayData::invalid_index) {
+      prepareForWrite();
+      ret = &m_data[pos].data;
+      return NULL;
+    }
+  }
+  HphpArray *a = copyImpl();
+  ret = &a->addKey(k, len, prehash, added)->data;
+  return a;
+}
+
+ArrayData *HphpArray::lval(CVarRef k, Variant *&ret, bool copy,
+                           int64 prehash /* = -1 */,
+                           bool checkExist /* = false */) {
+  if (k.isNumeric()) {
+    return lval(k.toInt64(), ret, copy, prehash, checkExist);
+  } else if (k.is(LiteralString)) {
+    return lval(k.getLiteralString(), ret, copy, prehash, checkExist);
+  } else {
+    return lval(k.toString(), ret, copy, prehash, checkExist);
+  }
+}
+
+ArrayData *HphpArray::set(int64 k, CVarRef v, bool copy,
+                          int64 prehash /* = -1 */) {
+  if (copy) {
+    HphpArray *a = copyImpl();
+    a->update(k, v);
+    return a;
+  }
+  prepareForWrite();
+  update(k, v);
+  return NULL;
+}
+
+ArrayData *HphpArray::set(CStrRef k, CVarRef v, bool copy,
+                          int64 prehash /* = -1 */) {
+  if (copy) {
+    HphpArray *a = copyImpl();
+    a->update(k.get(), prehash, v);
+    return a;
+  }
+  prepareForWrite();
+  update(k.get(), prehash, v);
+  return NULL;
+}
+
+ArrayData *HphpArray::set(litstr k, CVarRef v, bool copy,
+                          int64 prehash /* = -1 */) {
+  if (copy) {
+    HphpArray *a = copyImpl();
+    a->update(k, prehash, v);
+    return a;
+  }
+  prepareForWrite();
+  update(k, prehash, v);
+  return NULL;
+}
+
+ArrayData *HphpArray::set(CVarRef k, CVarRef v, bool copy,
+                          int64 prehash /* = -1 */) {
+  if (k.isNumeric()) {
+    return set(k.toInt64(), v, copy, prehash);
+  } else if (k.is(LiteralString)) {
+    return set(k.getLiteralString(), v, copy, prehash);
+  } else {
+    return set(k.toString(), v, copy, prehash);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// delete
+
+void HphpArray::erase(ssize_t pos) {
+  ASSERT(!m_linear);
+  if (pos == ArrayData::invalid_index) return;
+  Element *e = m_data + pos;
+  ASSERT(!e->isHole());
+
+  if (m_pos == pos) {
+    m_pos = nextElement(pos);
+  }
+  m_nNumOfElements--;
+
+  // Take the key and the value out of the array before releasing them, as
+  // destructors may come back to this array.
+  StringData *key = e->key;
+  Variant value;
+  memcpy((void *)&value, (const void *)&e->data, sizeof(Variant));
+  new (&e->data) Variant();
+
+  if (!m_hash) {
+    // packed arrays only ever lose their last element
+    ASSERT(pos == (ssize_t)m_nUsed - 1 && key == NULL);
+    m_nUsed--;
+    return;
+  }
+  int32 *slot = key ? findForInsert(key->data(), key->size(), e->h)
+                    : findForInsert(e->h);
+  ASSERT(*slot == pos);
+  *slot = TombstoneSlot;
+  e->key = Element::HoleKey();
+  if (key && key->decRefCount() == 0) {
+    DELETE(StringData)(key);
+  }
+}
+
+ArrayData *HphpArray::remove(int64 k, bool copy, int64 prehash /* = -1 */) {
+  ssize_t pos = find(k);
+  if (pos == ArrayData::invalid_index) {
+    return NULL;
+  }
+  HphpArray *a = copy ? copyImpl() : this;
+  a->prepareForWrite();
+  if (!a->m_hash && (uint64)k != a->m_nUsed - 1) {
+    a->toHash();
+  }
+  a->erase(a->find(k));
+  return copy ? a : NULL;
+}
+
+ArrayData *HphpArray::remove(CStrRef k, bool copy, int64 prehash /* = -1 */) {
+  StringData *key = k.get();
+  if (!m_hash) return NULL; // packed arrays have no string keys
+  if (prehash < 0) prehash = key->hash();
+  if (find(key->data(), key->size(), prehash) == ArrayData::invalid_index) {
+    return NULL;
+  }
+  HphpArray *a = copy ? copyImpl() : this;
+  a->prepareForWrite();
+  a->erase(a->find(key->data(), key->size(), prehash));
+  return copy ? a : NULL;
+}
+
+ArrayData *HphpArray::remove(litstr k, bool copy, int64 prehash /* = -1 */) {
+  if (!m_hash) return NULL;
+  int len = strlen(k);
+  if (prehash < 0) prehash = hash_string(k, len);
+  if (find(k, len, prehash) == ArrayData::invalid_index) {
+    return NULL;
+  }
+  HphpArray *a = copy ? copyImpl() : this;
+  a->prepareForWrite();
+  a->erase(a->find(k, len, prehash));
+  return copy ? a : NULL;
+}
+
+ArrayData *HphpArray::remove(CVarRef k, bool copy, int64 prehash /* = -1 */) {
+  if (k.isNumeric()) {
+    return remove(k.toInt64(), copy, prehash);
+  } else if (k.is(LiteralString)) {
+    return remove(k.getLiteralString(), copy, prehash);
+  } else {
+    return remove(k.toString(), copy, prehash);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// copy, append, stack and queue operations
+
+ArrayData *HphpArray::copy() const {
+  return copyImpl();
+}
+
+HphpArray *HphpArray::copyImpl() const {
+  HphpArray *target = NEW(HphpArray)();
+  target->m_nNextFreeElement = m_nNextFreeElement;
+  if (m_nNumOfElements == 0) {
+    return target;
+  }
+  target->allocData(compute_capacity(m_nNumOfElements), m_hash != NULL);
+
+  uint n = 0;
+  for (uint i = 0; i < m_nUsed; i++) {
+    const Element &e = m_data[i];
+    if (e.isHole()) continue;
+    if (m_pos == (ssize_t)i) target->m_pos = n;
+    if (e.data.isReferenced()) {
+      e.data.setContagious();
+    }
+    if (e.key) e.key->incRefCount();
+    new (target->m_data + n++) Element(e.h, e.key, e.data);
+  }
+  target->m_nUsed = target->m_nNumOfElements = n;
+  if (target->m_hash) target->rehash();
+  return target;
+}
+
+ArrayData *HphpArray::append(CVarRef v, bool copy) {
+  if (copy) {
+    HphpArray *a = copyImpl();
+    a->nextInsert(v);
+    return a;
+  }
+  prepareForWrite();
+  nextInsert(v);
+  return NULL;
+}
+
+ArrayData *HphpArray::append(const ArrayData *elems, ArrayOp op, bool copy) {
+  if (copy) {
+    HphpArray *a = copyImpl();
+    a->append(elems, op, false);
+    return a;
+  }
+  prepareForWrite();
+
+  if (elems->supportValueRef()) {
+    if (op == Plus) {
+      for (ArrayIter it(elems); !it.end(); it.next()) {
+        Variant key = it.first();
+        CVarRef value = it.secondRef();
+        if (value.isReferenced()) value.setContagious();
+        if (key.isNumeric()) {
+          add(key.toInt64(), value);
+        } else {
+          String skey = key.toString();
+          add(skey.get(), -1, value);
+        }
+      }
+    } else {
+      ASSERT(op == Merge);
+      for (ArrayIter it(elems); !it.end(); it.next()) {
+        Variant key = it.first();
+        CVarRef value = it.secondRef();
+        if (value.isReferenced()) value.setContagious();
+        if (key.isNumeric()) {
+          nextInsert(value);
+        } else {
+          String skey = key.toString();
+          update(skey.get(), -1, value);
+        }
+      }
+    }
+  } else {
+    if (op == Plus) {
+      for (ArrayIter it(elems); !it.end(); it.next()) {
+        Variant key = it.first();
+        if (key.isNumeric()) {
+          add(key.toInt64(), it.second());
+        } else {
+          String skey = key.toString();
+          add(skey.get(), -1, it.second());
+        }
+      }
+    } else {
+      ASSERT(op == Merge);
+      for (ArrayIter it(elems); !it.end(); it.next()) {
+        Variant key = it.first();
+        if (key.isNumeric()) {
+          nextInsert(it.second());
+        } else {
+          String skey = key.toString();
+          update(skey.get(), -1, it.second());
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+ArrayData *HphpArray::pop(Variant &value) {
+  if (getCount() > 1) {
+    HphpArray *a = copyImpl();
+    a->pop(value);
+    return a;
+  }
+  ssize_t pos = iter_end();
+  if (pos != ArrayData::invalid_index) {
+    prepareForWrite();
+    Element &e = m_data[pos];
+    value = e.data;
+    if (!e.key && e.h == m_nNextFreeElement - 1) {
+      m_nNextFreeElement--;
+    }
+    erase(pos);
+  } else {
+    value = null;
+  }
+  return NULL;
+}
+
+ArrayData *HphpArray::dequeue(Variant &value) {
+  if (getCount() > 1) {
+    HphpArray *a = copyImpl();
+    a->dequeue(value);
+    return a;
+  }
+  ssize_t pos = iter_begin();
+  if (pos == ArrayData::invalid_index) {
+    value = null;
+    return NULL;
+  }
+  prepareForWrite();
+  value = m_data[pos].data;
+  if (m_hash) {
+    erase(pos);
+    renumber();
+    return NULL;
+  }
+
+  // Packed: shift everything down by one, so keys stay 0..n-1. The old value
+  // is released last, as its destructor may come back to this array.
+  Variant old;
+  memcpy((void *)&old, (const void *)&m_data[0].data, sizeof(Variant));
+  m_nUsed--;
+  m_nNumOfElements--;
+  memmove((void *)m_data, (const void *)(m_data + 1),
+          m_nUsed * sizeof(Element));
+  for (uint i = 0; i < m_nUsed; i++) {
+    m_data[i].h = i;
+  }
+  m_nNextFreeElement = m_nUsed;
+  if (m_pos > 0) {
+    m_pos--;
+  } else if (m_nUsed == 0) {
+    m_pos = ArrayData::invalid_index;
+  }
+  return NULL;
+}
+
+ArrayData *HphpArray::prepend(CVarRef v, bool copy) {
+  if (copy) {
+    HphpArray *a = copyImpl();
+    a->prepend(v, false);
+    return a;
+  }
+  prepareForWrite();
+
+  if (m_nUsed == m_nCapacity) {
+    grow();
+  }
+  // Shift everything up by one, including holes, and put the new element in
+  // front. renumber() below fixes up keys and the index table.
+  memmove((void *)(m_data + 1), (const void *)m_data,
+          m_nUsed * sizeof(Element));
+  new (m_data) Element(0, NULL, v);
+  m_nUsed++;
+  m_nNumOfElements++;
+  if (m_pos == ArrayData::invalid_index) {
+    m_pos = 0;
+  } else {
+    m_pos++;
+  }
+  renumber();
+  return NULL;
+}
+
+void HphpArray::renumber() {
+  if (m_nNumOfElements == 0) {
+    m_nNextFreeElement = 0;
+    return;
+  }
+  prepareForWrite();
+  compact();
+  int64 i = 0;
+  bool allIntKeys = true;
+  for (uint pos = 0; pos < m_nUsed; pos++) {
+    Element &e = m_data[pos];
+    if (e.key == NULL) {
+      e.h = i++;
+    } else {
+      allIntKeys = false;
+    }
+  }
+  m_nNextFreeElement = i;
+  if (allIntKeys) {
+    m_hash = NULL; // keys are 0..n-1 in order again
+  } else if (m_hash) {
+    rehash();
+  }
+}
+
+void HphpArray::onSetStatic() {
+  for (uint i = 0; i < m_nUsed; i++) {
+    Element &e = m_data[i];
+    if (e.isHole()) continue;
+    if (e.key) {
+      e.key->setStatic();
+    }
+    e.data.setStatic();
+  }
+}
+
+ArrayData *HphpArray::escalate(bool mutableIteration /* = false */) const {
+  if (mutableIteration) {
+    // Let ZendArray handle all the quirky cases.
+    return escalateToZendArray();
+  }
+  return const_cast<HphpArray *>(this);
+}
+
+ArrayData *HphpArray::escalateToZendArray() const {
+  ZendArray *ret = NEW(ZendArray)(m_nNumOfElements);
+  for (uint i = 0; i < m_nUsed; i++) {
+    const Element &e = m_data[i];
+    if (e.isHole()) continue;
+    if (e.data.isReferenced()) e.data.setContagious();
+    if (e.key) {
+      ret->set(String(e.key), e.data, false, e.h);
+    } else {
+      ret->set(e.h, e.data, false);
+    }
+  }
+  // Set m_pos in the escalated array
+  if (m_pos != ArrayData::invalid_index) {
+    const Element &e = m_data[m_pos];
+    if (e.key) {
+      ret->setPosition(ret->getIndex(String(e.key), e.h));
+    } else {
+      ret->setPosition(ret->getIndex(e.h));
+    }
+  } else {
+    ret->setPosition(0);
+  }
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// memory allocator methods.
+
+bool HphpArray::calculate(int &size) {
+  size += blockSize();
+  return true;
+}
+
+void HphpArray::backup(LinearAllocator &allocator) {
+  allocator.backup((const char*)m_data, blockSize());
+}
+
+void HphpArray::restore(const char *&data) {
+  int size = blockSize();
+  if (size) {
+    m_data = (Element *)data;
+    if (m_hash) m_hash = (int32 *)(m_data + m_nCapacity);
+    m_linear = true;
+  } else {
+    m_data = NULL;
+    m_linear = false;
+  }
+  data += size;
+}
+
+void HphpArray::sweep() {
+  if (!m_linear && m_data) {
+    smart_free(m_data);
+    m_data = NULL;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
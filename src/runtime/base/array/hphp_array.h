@@ -0,0 +1,220 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_HPHP_ARRAY_H__
+#define __HPHP_HPHP_ARRAY_H__
+
+#include <runtime/base/types.h>
+#include <runtime/base/array/array_data.h>
+#include <runtime/base/memory/smart_allocator.h>
+#include <runtime/base/complex_types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * An array that keeps all its elements in one contiguous, insertion-ordered
+ * vector instead of one Bucket per element.
+ *
+ * While all keys are 0..n-1 in order, the array is "packed": an element's
+ * position is its key and no index table is needed. Anything else (string
+ * keys, holes, out of order integer keys) switches the array to hash mode,
+ * where a separate open-addressing index table (linear probing) maps keys to
+ * positions in the element vector. Removing an element in hash mode leaves
+ * a hole that is squeezed out the next time the vector grows.
+ *
+ * Positions (m_pos, iter_begin(), etc.) are element indices. Mutable
+ * iterations (foreach by reference) escalate to ZendArray, because positions
+ * are not stable across compactions.
+ */
+class HphpArray : public ArrayData {
+public:
+  HphpArray(uint nSize = 0);
+  virtual ~HphpArray();
+
+  virtual ssize_t size() const { return m_nNumOfElements;}
+
+  virtual Variant getKey(ssize_t pos) const;
+  virtual Variant getValue(ssize_t pos) const;
+  virtual void fetchValue(ssize_t pos, Variant & v) const;
+  virtual CVarRef getValueRef(ssize_t pos) const;
+  virtual bool isVectorData() const;
+  virtual bool supportValueRef() const { return true; }
+
+  virtual ssize_t iter_begin() const;
+  virtual ssize_t iter_end() const;
+  virtual ssize_t iter_advance(ssize_t prev) const;
+  virtual ssize_t iter_rewind(ssize_t prev) const;
+
+  virtual Variant reset();
+  virtual Variant prev();
+  virtual Variant current() const;
+  virtual Variant next();
+  virtual Variant end();
+  virtual Variant key() const;
+  virtual Variant value(ssize_t &pos) const;
+  virtual Variant each();
+
+  virtual bool exists(int64   k, int64 prehash = -1) const;
+  virtual bool exists(litstr  k, int64 prehash = -1) const;
+  virtual bool exists(CStrRef k, int64 prehash = -1) const;
+  virtual bool exists(CVarRef k, int64 prehash = -1) const;
+
+  virtual bool idxExists(ssize_t idx) const;
+
+  virtual Variant get(int64   k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(litstr  k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(CStrRef k, int64 prehash = -1, bool error = false) const;
+  virtual Variant get(CVarRef k, int64 prehash = -1, bool error = false) const;
+
+  virtual void load(CVarRef k, Variant &v) const;
+
+  virtual ssize_t getIndex(int64 k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(litstr k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(CStrRef k, int64 prehash = -1) const;
+  virtual ssize_t getIndex(CVarRef k, int64 prehash = -1) const;
+
+  virtual ArrayData *lval(Variant *&ret, bool copy);
+  virtual ArrayData *lval(int64   k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(litstr  k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(CStrRef k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+  virtual ArrayData *lval(CVarRef k, Variant *&ret, bool copy,
+                          int64 prehash = -1, bool checkExist = false);
+
+  virtual ArrayData *set(int64   k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(litstr  k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(CStrRef k, CVarRef v, bool copy, int64 prehash = -1);
+  virtual ArrayData *set(CVarRef k, CVarRef v, bool copy, int64 prehash = -1);
+
+  virtual ArrayData *remove(int64   k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(litstr  k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(CStrRef k, bool copy, int64 prehash = -1);
+  virtual ArrayData *remove(CVarRef k, bool copy, int64 prehash = -1);
+
+  virtual ArrayData *copy() const;
+  virtual ArrayData *append(CVarRef v, bool copy);
+  virtual ArrayData *append(const ArrayData *elems, ArrayOp op, bool copy);
+  virtual ArrayData *pop(Variant &value);
+  virtual ArrayData *dequeue(Variant &value);
+  virtual ArrayData *prepend(CVarRef v, bool copy);
+  virtual void renumber();
+  virtual void onSetStatic();
+
+  virtual void getFullPos(FullPos &pos);
+  virtual bool setFullPos(const FullPos &pos);
+  virtual CVarRef currentRef();
+  virtual CVarRef endRef();
+
+  virtual ArrayData *escalate(bool mutableIteration = false) const;
+
+  bool isPacked() const { return m_hash == NULL;}
+
+  class Element {
+  public:
+    Element(int64 hash, StringData *k) : h(hash), key(k) {}
+    Element(int64 hash, StringData *k, CVarRef d)
+      : h(hash), key(k), data(d) {}
+    ~Element() {
+      if (key && !isHole() && key->decRefCount() == 0) {
+        DELETE(StringData)(key);
+      }
+    }
+
+    int64       h;   // integer key, or hash of the string key
+    StringData *key; // NULL for integer keys
+    Variant     data;
+
+    bool isHole() const { return key == HoleKey();}
+    static StringData *HoleKey() { return (StringData *)1;}
+  };
+
+private:
+  static const uint MinCapacity = 4;
+
+  enum {
+    EmptySlot = -1,     // index table slot never used
+    TombstoneSlot = -2, // index table slot of a removed element
+  };
+
+  Element         *m_data;      // elements in insertion order, maybe holes
+  int32           *m_hash;      // index table, NULL while packed
+  uint             m_nCapacity;
+  uint             m_nTableMask;
+  uint             m_nUsed;     // positions used in m_data, including holes
+  uint             m_nNumOfElements;
+  int64            m_nNextFreeElement;
+  bool             m_linear;    // m_data points into a LinearAllocator
+
+  ssize_t find(int64 h) const;
+  ssize_t find(const char *k, int len, int64 prehash) const;
+  int32 *findForInsert(int64 h) const;
+  int32 *findForInsert(const char *k, int len, int64 prehash) const;
+
+  ssize_t nextElement(ssize_t pos) const;
+  ssize_t prevElement(ssize_t pos) const;
+
+  Element *newElement(int32 *slot);
+  Element *addKey(int64 h, bool &added);
+  Element *addKey(StringData *key, int64 h, bool &added);
+  Element *addKey(litstr key, int len, int64 h, bool &added);
+
+  void nextInsert(CVarRef data);
+  bool add(int64 h, CVarRef data);
+  bool add(StringData *key, int64 h, CVarRef data);
+  void update(int64 h, CVarRef data);
+  void update(StringData *key, int64 h, CVarRef data);
+  void update(litstr key, int64 h, CVarRef data);
+  void erase(ssize_t pos);
+
+  void allocData(uint capacity, bool withHash);
+  int blockSize() const;
+  void grow();
+  void compact();
+  void toHash();
+  void rehash();
+  void prepareForWrite();
+
+  HphpArray *copyImpl() const;
+  ArrayData *escalateToZendArray() const;
+
+  /**
+   * Memory allocator methods.
+   */
+  DECLARE_SMART_ALLOCATION(HphpArray, SmartAllocatorImpl::NeedRestoreOnce |
+                           SmartAllocatorImpl::NoSweep);
+  bool calculate(int &size);
+  void backup(LinearAllocator &allocator);
+  void restore(const char *&data);
+  void sweep();
+};
+
+class StaticEmptyHphpArray : public HphpArray {
+public:
+  StaticEmptyHphpArray() { setStatic();}
+
+  static HphpArray *Get() { return &s_theEmptyArray; }
+
+private:
+  static StaticEmptyHphpArray s_theEmptyArray;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_HPHP_ARRAY_H__
@@ -16,6 +16,7 @@
 */
 
 #include <runtime/base/array/zend_array.h>
+#include <runtime/base/memory/memory_manager.h>
 #include <runtime/base/array/array_init.h>
 #include <runtime/base/complex_types.h>
 #include <runtime/base/runtime_error.h>
@@ -25,7 +26,8 @@
 namespace HPHP {
 
 IMPLEMENT_SMART_ALLOCATION_NOCALLBACKS_CLS(ZendArray, Bucket);
-IMPLEMENT_SMART_ALLOCATION(ZendArray, SmartAllocatorImpl::NeedRestoreOnce);
+IMPLEMENT_SMART_ALLOCATION(ZendArray, SmartAllocatorImpl::NeedRestoreOnce |
+                           SmartAllocatorImpl::NoSweep);
 ///////////////////////////////////////////////////////////////////////////////
 // static members
 
@@ -34,9 +36,10 @@ StaticEmptyZendArray StaticEmptyZendArray::s_theEmptyArray;
 ///////////////////////////////////////////////////////////////////////////////
 // construction/destruciton
 
-ZendArray::ZendArray(uint nSize /* = 0 */) :
+ZendArray::ZendArray(uint nSize /* = 0 */, bool persistent /* = false */) :
   m_nNumOfElements(0), m_nNextFreeElement(0),
-  m_pListHead(NULL), m_pListTail(NULL), m_arBuckets(NULL), m_linear(false) {
+  m_pListHead(NULL), m_pListTail(NULL), m_arBuckets(NULL), m_linear(false),
+  m_persistent(persistent) {
 
   if (nSize >= 0x80000000) {
     m_nTableSize = 0x80000000; // prevent overflow
@@ -48,7 +51,25 @@ ZendArray::ZendArray(uint nSize /* = 0 */) :
     m_nTableSize = 1 << i;
   }
   m_nTableMask = m_nTableSize - 1;
-  m_arBuckets = (Bucket **)calloc(m_nTableSize, sizeof(Bucket *));
+  int nbytes = m_nTableSize * sizeof(Bucket *);
+  m_arBuckets = (Bucket **)bucketsMalloc(nbytes);
+  memset(m_arBuckets, 0, nbytes);
+}
+
+inline void *ZendArray::bucketsMalloc(size_t nbytes) const {
+  return m_persistent ? malloc(nbytes) : smart_malloc(nbytes);
+}
+
+inline void *ZendArray::bucketsRealloc(void *ptr, size_t nbytes) const {
+  return m_persistent ? realloc(ptr, nbytes) : smart_realloc(ptr, nbytes);
+}
+
+inline void ZendArray::bucketsFree(void *ptr) const {
+  if (m_persistent) {
+    free(ptr);
+  } else {
+    smart_free(ptr);
+  }
 }
 
 ZendArray::~ZendArray() {
@@ -59,7 +80,7 @@ ZendArray::~ZendArray() {
     DELETE(Bucket)(q);
   }
   if (!m_linear && m_arBuckets) {
-    free(m_arBuckets);
+    bucketsFree(m_arBuckets);
   }
 }
 
@@ -464,7 +485,7 @@ ssize_t ZendArray::getIndex(CVarRef k, int64 prehash /* = -1 */) const {
 do {                                                                    \
   if (m_linear) {                                                       \
     int nbytes = m_nTableSize * sizeof(Bucket *);                       \
-    Bucket **t = (Bucket **)malloc(nbytes);                             \
+    Bucket **t = (Bucket **)bucketsMalloc(nbytes);                       \
     memcpy(t, m_arBuckets, nbytes);                                     \
     m_arBuckets = t;                                                    \
     m_linear = false;                                                   \
@@ -477,10 +498,10 @@ void ZendArray::resize() {
   // No need to use calloc() or memset(), as rehash() is going to clear
   // m_arBuckets any way.
   if (m_linear) {
-    m_arBuckets = (Bucket **)malloc(curSize << 1);
+    m_arBuckets = (Bucket **)bucketsMalloc(curSize << 1);
     m_linear = false;
   } else {
-    m_arBuckets = (Bucket **)realloc(m_arBuckets, curSize << 1);
+    m_arBuckets = (Bucket **)bucketsRealloc(m_arBuckets, curSize << 1);
   }
   m_nTableSize <<= 1;
   m_nTableMask = m_nTableSize - 1;
@@ -927,7 +948,7 @@ void ZendArray::erase(Bucket ** prev) {
 void ZendArray::prepareBucketHeadsForWrite() {
   if (m_linear) {
     int nbytes = m_nTableSize * sizeof(Bucket *);
-    Bucket **t = (Bucket **)malloc(nbytes);
+    Bucket **t = (Bucket **)bucketsMalloc(nbytes);
     memcpy(t, m_arBuckets, nbytes);
     m_arBuckets = t;
     m_linear = false;
@@ -1278,7 +1299,7 @@ void ZendArray::restore(const char *&data) {
 
 void ZendArray::sweep() {
   if (!m_linear && m_arBuckets) {
-    free(m_arBuckets);
+    bucketsFree(m_arBuckets);
     m_arBuckets = NULL;
   }
 }
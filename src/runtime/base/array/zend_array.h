@@ -31,7 +31,12 @@ class ZendArray : public ArrayData {
 public:
   friend class ArrayInit;
 
-  ZendArray(uint nSize = 0);
+  /**
+   * persistent is for arrays that outlive requests and are not smart
+   * allocated, like static ones: their bucket heads come from malloc(),
+   * as smart_malloc() memory is released at the end of every request.
+   */
+  ZendArray(uint nSize = 0, bool persistent = false);
   virtual ~ZendArray();
 
   virtual ssize_t size() const { return m_nNumOfElements;}
@@ -141,6 +146,11 @@ private:
   Bucket         * m_pListTail;
   Bucket         **m_arBuckets;
   bool             m_linear;
+  bool             m_persistent;
+
+  void *bucketsMalloc(size_t nbytes) const;
+  void *bucketsRealloc(void *ptr, size_t nbytes) const;
+  void bucketsFree(void *ptr) const;
 
   Bucket *find(int64 h) const;
   Bucket *find(const char *k, int len, int64 prehash = -1,
@@ -175,7 +185,8 @@ private:
   /**
    * Memory allocator methods.
    */
-  DECLARE_SMART_ALLOCATION(ZendArray, SmartAllocatorImpl::NeedRestoreOnce);
+  DECLARE_SMART_ALLOCATION(ZendArray, SmartAllocatorImpl::NeedRestoreOnce |
+                           SmartAllocatorImpl::NoSweep);
   bool calculate(int &size);
   void backup(LinearAllocator &allocator);
   void restore(const char *&data);
@@ -184,7 +195,7 @@ private:
 
 class StaticEmptyZendArray : public ZendArray {
 public:
-  StaticEmptyZendArray() { setStatic();}
+  StaticEmptyZendArray() : ZendArray(0, true) { setStatic();}
 
   static ZendArray *Get() { return &s_theEmptyArray; }
 
@@ -549,6 +549,44 @@ void ClassInfo::getAllProperties(PropertyVec &props) const {
   }
 }
 
+/**
+ * The static string generated code already has for s, or a new one that is
+ * never freed, so all threads can share it.
+ */
+static String get_static_string(const char *s) {
+  String str(s, AttachLiteral);
+  if (!str.checkStatic()) {
+    str = *(new StaticString(s));
+  }
+  return str;
+}
+
+static void get_property_slots(const ClassInfo *cls,
+                               ClassInfo::PropertySlotVec &slots,
+                               bool persistent) {
+  ClassInfo::PropertyVec properties;
+  cls->getAllProperties(properties);
+  slots.reserve(properties.size());
+  for (unsigned int i = 0; i < properties.size(); i++) {
+    ClassInfo::PropertyInfo *prop = properties[i];
+    if (prop->attribute & ClassInfo::IsStatic) continue;
+    ClassInfo::PropertySlot slot;
+    slot.info = prop;
+    if (persistent) {
+      slot.name = get_static_string(prop->name);
+      slot.owner = get_static_string(prop->owner->getName());
+    } else {
+      slot.name = prop->name;
+      slot.owner = prop->owner->getName();
+    }
+    slots.push_back(slot);
+  }
+}
+
+void ClassInfo::getPropertySlots(PropertySlotVec &slots) const {
+  get_property_slots(this, slots, false);
+}
+
 ClassInfo::PropertyInfo *ClassInfo::getPropertyInfo(const char *name) const {
   ASSERT(name);
   const PropertyMap &properties = getProperties();
@@ -592,10 +630,24 @@ bool ClassInfo::PropertyInfo::isVisible(const ClassInfo *context) const {
   return false;
 }
 
+void ClassInfoUnique::cachePropertySlots() {
+  // redeclared and evaled parents may change from one request to another
+  for (const ClassInfo *cls = this; cls; ) {
+    if (!dynamic_cast<const ClassInfoUnique *>(cls)) return;
+    const char *parent = cls->getParentClass();
+    if (!parent || !*parent) break;
+    cls = FindClass(parent);
+    if (!cls) return;
+  }
+  PropertySlotVec *slots = new PropertySlotVec();
+  get_property_slots(this, *slots, true);
+  m_propertySlots = slots;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // load functions
 
-ClassInfoUnique::ClassInfoUnique(const char **&p) {
+ClassInfoUnique::ClassInfoUnique(const char **&p) : m_propertySlots(NULL) {
   m_attribute = (Attribute)(int64)(*p++);
   m_name = *p++;
   m_parent = *p++;
@@ -640,9 +692,8 @@ ClassInfoUnique::ClassInfoUnique(const char **&p) {
       staticVariable->name = *p++;
       staticVariable->valueLen = (int64)(*p++);
       staticVariable->valueText = *p++;
-      istringstream in(std::string(staticVariable->valueText,
-                                   staticVariable->valueLen));
-      VariableUnserializer vu(in);
+      VariableUnserializer vu(staticVariable->valueText,
+                              staticVariable->valueLen);
       try {
         staticVariable->value = vu.unserialize();
         staticVariable->value.setStatic();
@@ -677,8 +728,7 @@ ClassInfoUnique::ClassInfoUnique(const char **&p) {
     constant->valueText = *p++;
 
     if (constant->valueText) {
-      istringstream in(std::string(constant->valueText, constant->valueLen));
-      VariableUnserializer vu(in);
+      VariableUnserializer vu(constant->valueText, constant->valueLen);
       try {
         constant->value = vu.unserialize();
         constant->value.setStatic();
@@ -749,6 +799,21 @@ void ClassInfo::Load() {
   ASSERT(s_systemFuncs);
   ASSERT(s_userFuncs);
   s_loaded = true;
+
+  // Slot names have to be static strings, and new ones can only be added
+  // before StaticString::FinishInit(), while there is only one thread.
+  // Compiled classes only have compiled parents, so evaled classes the hook
+  // would find are left out.
+  if (!StaticString::TheStaticStringSet().empty()) {
+    ClassInfoHook *hook = s_hook;
+    s_hook = NULL;
+    for (ClassMap::const_iterator iter = s_classes.begin();
+         iter != s_classes.end(); ++iter) {
+      ClassInfoUnique *cls = dynamic_cast<ClassInfoUnique *>(iter->second);
+      if (cls) cls->cachePropertySlots();
+    }
+    s_hook = hook;
+  }
 }
 
 ClassInfo::MethodInfo::~MethodInfo() {
@@ -268,6 +268,31 @@ public:
   PropertyInfo *getPropertyInfo(const char *name) const;
   bool hasProperty(const char *name) const;
 
+  /**
+   * Non-static properties in getAllProperties() order, with their names and
+   * their declaring classes' names as Strings, so looking them up on an
+   * object does not allocate or hash the names again.
+   */
+  class PropertySlot {
+  public:
+    PropertyInfo *info;
+    String name;
+    String owner;
+  };
+  typedef std::vector<PropertySlot> PropertySlotVec;
+  void getPropertySlots(PropertySlotVec &slots) const;    // recursively
+
+  /**
+   * The same, built once and kept, for classes whose parents are the same
+   * in every request. NULL for others, like redeclared or evaled ones.
+   * Only o_toIterArray(), for get_object_vars() and foreach, uses it;
+   * o_get()/o_set()/o_lval() by name still go through the generated hash
+   * switches, as there is no per-class offset table.
+   */
+  virtual const PropertySlotVec *getCachedPropertySlots() const {
+    return NULL;
+  }
+
   /**
    * Constant functions.
    */
@@ -308,6 +333,16 @@ public:
    */
   ClassInfoUnique(const char **&p);
 
+  const PropertySlotVec *getCachedPropertySlots() const {
+    return m_propertySlots;
+  }
+
+  /**
+   * Builds the slots getCachedPropertySlots() returns, if this class and its
+   * parents are the same in every request. Called once by Load().
+   */
+  void cachePropertySlots();
+
   // implementing ClassInfo
   const char *getParentClass() const { return m_parent;}
   const InterfaceMap &getInterfaces() const { return m_interfaces;}
@@ -329,6 +364,8 @@ private:
   PropertyVec  m_propertiesVec; // all properties in declaration order
   ConstantMap  m_constants;     // all constants
   ConstantVec  m_constantsVec;  // all constants in declaration order
+
+  const PropertySlotVec *m_propertySlots; // built by cachePropertySlots()
 };
 
 /**
@@ -0,0 +1,87 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/dynamic_call_cache.h>
+#include <runtime/base/complex_types.h>
+#include <runtime/base/builtin_functions.h>
+#include <runtime/base/externals.h>
+#include <runtime/base/array/array_init.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+InvokeFewArgsFunc DynamicCallCache::find(const char *s, int len) const {
+  int used = m_used;
+  for (int i = 0; i < used && i < Size; i++) {
+    const Entry &e = m_entries[i];
+    InvokeFewArgsFunc func = e.func;
+    if (func && e.len == len && strcasecmp(e.name, s) == 0) return func;
+  }
+  return NULL;
+}
+
+void DynamicCallCache::add(const DynamicCallTarget *target) {
+  int i = m_used;
+  if (i >= Size) return;
+  // two threads missing at once may both add the same target, that's fine
+  if (!__sync_bool_compare_and_swap(&m_used, i, i + 1)) return;
+  Entry &e = m_entries[i];
+  e.name = target->name;
+  e.len = strlen(target->name);
+  __sync_synchronize(); // readers only look at entries with func set
+  e.func = target->func;
+}
+
+Variant DynamicCallCache::invoke(CStrRef function, int refs, int count,
+                                 INVOKE_FEW_ARGS_IMPL_ARGS) {
+  ASSERT(count <= INVOKE_FEW_ARGS_COUNT);
+  StringData *sd = function.get();
+  if (sd && sd->data()) {
+    InvokeFewArgsFunc func = find(sd->data(), sd->size());
+    if (func) return func(count, INVOKE_FEW_ARGS_PASS_ARGS);
+
+    const DynamicCallTarget *target =
+      get_dynamic_call_target(sd->data(), sd->hash());
+    if (target) {
+      add(target);
+      return target->func(count, INVOKE_FEW_ARGS_PASS_ARGS);
+    }
+  }
+
+  // same array the call site would have built without a cache
+  const Variant *args[] = {
+    &a0, &a1, &a2,
+#if INVOKE_FEW_ARGS_COUNT > 3
+    &a3, &a4, &a5,
+#if INVOKE_FEW_ARGS_COUNT > 6
+    &a6, &a7, &a8, &a9,
+#endif
+#endif
+  };
+  ArrayInit ai(count, true);
+  for (int i = 0; i < count; i++) {
+    if (refs & (1 << i)) {
+      ai.setRef(i, *args[i]);
+    } else {
+      ai.set(i, *args[i]);
+    }
+  }
+  Array params(ai.create());
+  return HPHP::invoke(function, params, -1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
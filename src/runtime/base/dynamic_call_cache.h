@@ -0,0 +1,84 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_DYNAMIC_CALL_CACHE_H__
+#define __HPHP_DYNAMIC_CALL_CACHE_H__
+
+#include <runtime/base/types.h>
+#include <runtime/base/macros.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+typedef Variant (*InvokeFewArgsFunc)(int count, INVOKE_FEW_ARGS_IMPL_ARGS);
+
+/**
+ * What a function name resolves to, for as long as the process runs: only
+ * functions that can't be renamed, redeclared or overridden by eval have one.
+ */
+struct DynamicCallTarget {
+  const char *name;
+  InvokeFewArgsFunc func;
+};
+
+/**
+ * Inline cache of one dynamic function call site, e.g. $f($a, 1). It
+ * remembers the last few functions called from there, so calling one of
+ * them again costs a string compare and a direct call, instead of hashing
+ * the name, searching the jump table and packing arguments into an array.
+ *
+ * Arguments come in the way o_invoke_few_args() takes them: lvalues are not
+ * wrapped with ref(), and refs has bit i set if argument i is one. A miss
+ * that can't be cached, e.g. a builtin, goes through invoke() with the same
+ * array the call site would have built.
+ *
+ * Caches are process wide and never emptied, since their targets don't
+ * change; there is no constructor, so zero-initialized statics are ready to
+ * use without a guard. Call sites get theirs from DynamicCallSite<id>.
+ */
+class DynamicCallCache {
+public:
+  static const int Size = 4; // more targets than that and it stops learning
+
+  Variant invoke(CStrRef function, int refs, int count,
+                 INVOKE_FEW_ARGS_DECL_ARGS);
+
+private:
+  struct Entry {
+    const char *name;
+    int len;
+    InvokeFewArgsFunc volatile func; // set last, entry is valid once set
+  };
+
+  Entry m_entries[Size];
+  int m_used;
+
+  InvokeFewArgsFunc find(const char *s, int len) const;
+  void add(const DynamicCallTarget *target);
+};
+
+template <int Id>
+class DynamicCallSite {
+public:
+  static DynamicCallCache Cache;
+};
+
+template <int Id> DynamicCallCache DynamicCallSite<Id>::Cache;
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_DYNAMIC_CALL_CACHE_H__
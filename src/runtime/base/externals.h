@@ -38,6 +38,15 @@ extern Variant invoke(const char *function, CArrRef params,
                       int64 hash = -1,
                       bool tryInterp = true, bool fatal = true);
 
+/**
+ * Looking up the direct entry point of a user function for call site caches.
+ * NULL if there is none, or if the name may not always resolve to the same
+ * function.
+ */
+struct DynamicCallTarget;
+extern const DynamicCallTarget *get_dynamic_call_target(const char *s,
+                                                        int64 hash);
+
 /**
  * Invoking an arbitrary system function. This is the fallback for invoke.
  */
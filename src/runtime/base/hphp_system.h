@@ -38,6 +38,7 @@
 #include <runtime/base/file/plain_file.h>
 #include <runtime/base/class_info.h>
 #include <runtime/base/externals.h>
+#include <runtime/base/dynamic_call_cache.h>
 #include <runtime/base/class_statics.h>
 #include <runtime/base/dynamic_object_data.h>
 #include <runtime/base/array/array_init.h>
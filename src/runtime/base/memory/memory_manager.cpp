@@ -18,6 +18,10 @@
 #include <runtime/base/memory/leak_detectable.h>
 #include <runtime/base/memory/sweepable.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/server/server_stats.h>
+
+using namespace std;
+using namespace boost;
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -28,19 +32,32 @@ ThreadLocal<MemoryManager> &MemoryManager::TheMemoryManager() {
   return s_singleton;
 }
 
-MemoryManager::MemoryManager() : m_enabled(false), m_checkpoint(false) {
+MemoryManager::MemoryManager()
+  : m_enabled(false), m_checkpoint(false), m_sweeping(false),
+    m_slabsUsed(0), m_front(NULL), m_limit(NULL) {
   if (RuntimeOption::EnableMemoryManager) {
     m_enabled = true;
   }
+  memset(m_smartFree, 0, sizeof(m_smartFree));
+  m_bigHead.next = m_bigHead.prev = &m_bigHead;
+  memset(&m_stats, 0, sizeof(m_stats));
   resetStats();
   m_stats.maxBytes = 0;
 }
 
+MemoryManager::~MemoryManager() {
+  resetSlabs();
+  freeSlabs(0);
+}
+
 void MemoryManager::resetStats() {
   m_stats.usage = 0;
   m_stats.alloc = 0;
   m_stats.peakUsage = 0;
   m_stats.peakAlloc = 0;
+  for (int i = 0; i < SMART_SIZE_CLASS_COUNT; i++) {
+    m_stats.smartTotal[i] = 0;
+  }
 }
 
 void MemoryManager::add(SmartAllocatorImpl *allocator) {
@@ -102,11 +119,19 @@ void MemoryManager::sweepAll() {
 }
 
 void MemoryManager::rollback() {
+  // Objects allocated before the checkpoint have all been restored from
+  // linear memory, and the rest are swept, so nothing refers to
+  // smart_malloc() memory any more. Frees from sweep() are skipped, as the
+  // slabs are reset in one go.
+  m_sweeping = true;
   m_linearAllocator.beginRestore();
   for (unsigned int i = 0; i < m_smartAllocators.size(); i++) {
     m_smartAllocators[i]->rollbackObjects(m_linearAllocator);
   }
   m_linearAllocator.endRestore();
+  resetSlabs();
+  freeSlabs(1);
+  m_sweeping = false;
   protectUnsafePointers();
 }
 
@@ -116,6 +141,16 @@ void MemoryManager::disableDealloc() {
   }
 }
 
+void MemoryManager::enterArena() {
+  if (!RuntimeOption::EnableRequestArena || !afterCheckpoint()) return;
+  for (unsigned int i = 0; i < m_smartAllocators.size(); i++) {
+    SmartAllocatorImpl *allocator = m_smartAllocators[i];
+    if (!allocator->needSweep()) {
+      allocator->disableDealloc();
+    }
+  }
+}
+
 void MemoryManager::cleanup() {
 }
 
@@ -123,6 +158,15 @@ void MemoryManager::logStats() {
   for (unsigned int i = 0; i < m_smartAllocators.size(); i++) {
     m_smartAllocators[i]->logStats();
   }
+  for (int i = 0; i < SMART_SIZE_CLASS_COUNT; i++) {
+    if (m_stats.smartTotal[i]) {
+      string size = i == BigIndex ? string("big") :
+        lexical_cast<string>(s_classSizes[i]);
+      string key = string("mem.smart.") + size;
+      ServerStats::Log(key + ".alloc", m_stats.smartTotal[i]);
+      ServerStats::Log(key + ".inuse", m_stats.smartCount[i]);
+    }
+  }
   LeakDetectable::LogMallocStats();
 }
 
@@ -138,8 +182,179 @@ void MemoryManager::checkMemory(bool detailed) {
     m_smartAllocators[i]->checkMemory(detailed);
   }
   m_linearAllocator.checkMemory(detailed);
+  for (int i = 0; i < SMART_SIZE_CLASS_COUNT; i++) {
+    if (m_stats.smartTotal[i] || m_stats.smartCount[i]) {
+      if (i == BigIndex) {
+        printf("%16s (      big block): ", "smart_malloc");
+      } else {
+        printf("%16s (%6d bytes %5d): ", "smart_malloc", s_classSizes[i],
+               (int)SlabSize / s_classSizes[i]);
+      }
+      printf("%8lld alloc %8lld in use\n", m_stats.smartTotal[i],
+             m_stats.smartCount[i]);
+    }
+  }
+  printf("Smart slabs: %d of %d used\n", m_slabsUsed, (int)m_slabs.size());
   printf("Unsafe pointers: %d\n", (int)m_unsafePointers.size());
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// smart_malloc
+
+// including SmallNode's header, two classes per power of 2
+const int MemoryManager::s_classSizes[MemoryManager::BigIndex] = {
+  16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048,
+  3072, 4096
+};
+
+static inline int smart_size_class(size_t n) {
+  if (n <= 16) return 0;
+  // 2^b < n <= 2^(b+1), picking either 3 * 2^(b-1) or 2^(b+1)
+  int b = 63 - __builtin_clzll(n - 1);
+  return n <= (size_t)(3 << (b - 1)) ? 2 * b - 7 : 2 * b - 6;
+}
+
+void *MemoryManager::smartMalloc(size_t nbytes) {
+  size_t n = nbytes + sizeof(SmallNode);
+  if (n > MaxSmallSize) {
+    return smartMallocBig(nbytes);
+  }
+  int index = smart_size_class(n);
+  ASSERT(index < BigIndex && n <= (size_t)s_classSizes[index]);
+  m_stats.smartCount[index]++;
+  m_stats.smartTotal[index]++;
+
+  SmallNode *p = m_smartFree[index];
+  if (p) {
+    m_smartFree[index] = p->next;
+  } else {
+    int size = s_classSizes[index];
+    if (m_front + size > m_limit) {
+      newSlab();
+    }
+    p = (SmallNode *)m_front;
+    m_front += size;
+  }
+  p->index = index;
+  return p + 1;
+}
+
+void *MemoryManager::smartCalloc(size_t count, size_t bytes) {
+  size_t nbytes = count * bytes;
+  void *p = smartMalloc(nbytes);
+  memset(p, 0, nbytes);
+  return p;
+}
+
+void *MemoryManager::smartRealloc(void *ptr, size_t nbytes) {
+  if (!ptr) return smartMalloc(nbytes);
+
+  SmallNode *p = (SmallNode *)ptr - 1;
+  if (p->index == BigIndex) {
+    return smartReallocBig((BigNode *)ptr - 1, nbytes);
+  }
+  ASSERT(p->index >= 0 && p->index < BigIndex);
+  size_t size = s_classSizes[p->index] - sizeof(SmallNode);
+  if (nbytes <= size) return ptr;
+  void *ret = smartMalloc(nbytes);
+  memcpy(ret, ptr, size);
+  smartFree(ptr);
+  return ret;
+}
+
+void MemoryManager::smartFree(void *ptr) {
+  if (!ptr || m_sweeping) return;
+
+  SmallNode *p = (SmallNode *)ptr - 1;
+  int64 index = p->index;
+  if (index == BigIndex) {
+    smartFreeBig((BigNode *)ptr - 1);
+    return;
+  }
+  ASSERT(index >= 0 && index < BigIndex);
+  m_stats.smartCount[index]--;
+  p->next = m_smartFree[index];
+  m_smartFree[index] = p;
+}
+
+void *MemoryManager::smartMallocBig(size_t nbytes) {
+  BigNode *n = (BigNode *)malloc(nbytes + sizeof(BigNode));
+  n->next = m_bigHead.next;
+  n->prev = &m_bigHead;
+  n->next->prev = n;
+  m_bigHead.next = n;
+  n->size = nbytes;
+  n->index = BigIndex;
+  m_stats.smartCount[BigIndex]++;
+  m_stats.smartTotal[BigIndex]++;
+  m_stats.alloc += nbytes;
+  if (m_stats.alloc > m_stats.peakAlloc) {
+    m_stats.peakAlloc = m_stats.alloc;
+  }
+  return n + 1;
+}
+
+void *MemoryManager::smartReallocBig(BigNode *n, size_t nbytes) {
+  ASSERT(n->index == BigIndex);
+  BigNode *prev = n->prev;
+  BigNode *next = n->next;
+  m_stats.alloc += (int64)nbytes - (int64)n->size;
+  if (m_stats.alloc > m_stats.peakAlloc) {
+    m_stats.peakAlloc = m_stats.alloc;
+  }
+  n = (BigNode *)realloc(n, nbytes + sizeof(BigNode));
+  n->size = nbytes;
+  prev->next = next->prev = n;
+  return n + 1;
+}
+
+void MemoryManager::smartFreeBig(BigNode *n) {
+  ASSERT(n->index == BigIndex);
+  n->prev->next = n->next;
+  n->next->prev = n->prev;
+  m_stats.smartCount[BigIndex]--;
+  m_stats.alloc -= n->size;
+  free(n);
+}
+
+void MemoryManager::newSlab() {
+  // the rest of the current slab, less than MaxSmallSize, is left unused
+  if (m_slabsUsed == m_slabs.size()) {
+    m_slabs.push_back((char *)malloc(SlabSize));
+    m_stats.alloc += SlabSize;
+    if (m_stats.alloc > m_stats.peakAlloc) {
+      m_stats.peakAlloc = m_stats.alloc;
+    }
+  }
+  m_front = m_slabs[m_slabsUsed++];
+  m_limit = m_front + SlabSize;
+}
+
+void MemoryManager::resetSlabs() {
+  for (BigNode *n = m_bigHead.next; n != &m_bigHead; ) {
+    BigNode *next = n->next;
+    m_stats.alloc -= n->size;
+    free(n);
+    n = next;
+  }
+  m_bigHead.next = m_bigHead.prev = &m_bigHead;
+
+  memset(m_smartFree, 0, sizeof(m_smartFree));
+  for (int i = 0; i < SMART_SIZE_CLASS_COUNT; i++) {
+    m_stats.smartCount[i] = 0;
+  }
+  m_slabsUsed = 0;
+  m_front = m_limit = NULL;
+}
+
+void MemoryManager::freeSlabs(unsigned int keep) {
+  ASSERT(m_slabsUsed == 0);
+  while (m_slabs.size() > keep) {
+    free(m_slabs.back());
+    m_slabs.pop_back();
+    m_stats.alloc -= SlabSize;
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
@@ -40,12 +40,17 @@ namespace HPHP {
  *     pointers are backed up to LinearAllocator.
  *  4. Freelance memory, malloced by extensions or STL classes, that are
  *     completely out of MemoryManager's control.
+ *
+ * Variable sized memory of category 2 may also come from smart_malloc(),
+ * which carves it out of per-thread slabs by size class. It is all released
+ * at once by rollback(), after the objects holding it have been swept.
  */
 class MemoryManager {
 public:
   static ThreadLocal<MemoryManager> &TheMemoryManager();
 
   MemoryManager();
+  ~MemoryManager();
 
   /**
    * Without calling this, everything should work as if there is no memory
@@ -89,6 +94,14 @@ public:
    */
   void disableDealloc();
 
+  /**
+   * With EnableRequestArena, turns off deallocation for the rest of the
+   * request on allocators that don't sweep, so their objects are only ever
+   * bump allocated, and reclaimed together by rollback(). Allocators that
+   * sweep keep their free lists, as freed objects must not be swept again.
+   */
+  void enterArena();
+
   /**
    * Mark current allocator's position as ending point of a generation and
    * sweep all memory that has allocated since the previous check point.
@@ -126,19 +139,93 @@ public:
    */
   void resetStats();
 
+  /**
+   * Variable sized allocations, through smart_malloc() and friends.
+   */
+  void *smartMalloc(size_t nbytes);
+  void *smartCalloc(size_t count, size_t bytes);
+  void *smartRealloc(void *ptr, size_t nbytes);
+  void smartFree(void *ptr);
+
 private:
   static DECLARE_THREAD_LOCAL(MemoryManager, s_singleton);
 
   bool m_enabled;
   bool m_checkpoint;
+  bool m_sweeping;
 
   std::vector<SmartAllocatorImpl*> m_smartAllocators;
   LinearAllocator m_linearAllocator;
   std::set<UnsafePointer*> m_unsafePointers;
 
   MemoryUsageStats m_stats;
+
+  /**
+   * Small blocks have a one word header with their size class index, which
+   * is overwritten by the free list link once the block is freed. Big blocks
+   * are malloc-ed one by one and chained, so they can be freed in bulk, too.
+   */
+  union SmallNode {
+    SmallNode *next;
+    int64 index;
+  };
+  struct BigNode {
+    BigNode *next;
+    BigNode *prev;
+    size_t size;
+    int64 index; // always BigIndex, right before the data like SmallNode's
+  };
+  enum {
+    SlabSize = 64 * 1024,
+    MaxSmallSize = 4096,
+    BigIndex = SMART_SIZE_CLASS_COUNT - 1,
+  };
+  static const int s_classSizes[BigIndex];
+
+  SmallNode *m_smartFree[BigIndex];
+  std::vector<char *> m_slabs;
+  unsigned int m_slabsUsed;
+  char *m_front; // free part of the current slab
+  char *m_limit;
+  BigNode m_bigHead;
+
+  void *smartMallocBig(size_t nbytes);
+  void *smartReallocBig(BigNode *n, size_t nbytes);
+  void smartFreeBig(BigNode *n);
+  void newSlab();
+  void resetSlabs();
+  void freeSlabs(unsigned int keep);
 };
 
+/**
+ * malloc() replacements for memory that's only held by smart allocated
+ * objects and never outlives a request. Objects' sweep() doesn't need to
+ * free it, as rollback() releases all of it at once.
+ */
+#ifdef DEBUGGING_SMART_ALLOCATOR
+inline void *smart_malloc(size_t nbytes) { return malloc(nbytes);}
+inline void *smart_calloc(size_t count, size_t bytes) {
+  return calloc(count, bytes);
+}
+inline void *smart_realloc(void *ptr, size_t nbytes) {
+  return realloc(ptr, nbytes);
+}
+inline void smart_free(void *ptr) { free(ptr);}
+#else
+inline void *smart_malloc(size_t nbytes) {
+  return MemoryManager::TheMemoryManager()->smartMalloc(nbytes);
+}
+inline void *smart_calloc(size_t count, size_t bytes) {
+  return MemoryManager::TheMemoryManager()->smartCalloc(count, bytes);
+}
+inline void *smart_realloc(void *ptr, size_t nbytes) {
+  return MemoryManager::TheMemoryManager()->smartRealloc(ptr, nbytes);
+}
+inline void smart_free(void *ptr) {
+  MemoryManager::TheMemoryManager()->smartFree(ptr);
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
@@ -301,7 +301,7 @@ void SmartAllocatorImpl::rollbackObjects(LinearAllocator &allocator) {
   m_dealloc = true;
 
   // sweep dangling objects
-  if (m_flag & (NeedRestore | NeedRestoreOnce | NeedSweep)) {
+  if (needSweep()) {
     m_iter.clear();
     for (m_iter.begin(); m_iter.get(); m_iter.next()) {
       sweep(m_iter.get());
@@ -110,8 +110,11 @@ namespace HPHP {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// size classes of smart_malloc(), the last one being all big blocks
+#define SMART_SIZE_CLASS_COUNT 18
+
 /**
- * Usage stats, all in bytes.
+ * Usage stats, all in bytes, except for the per size class counts.
  */
 struct MemoryUsageStats {
   int64 maxBytes;  // what's request's max bytes allowed
@@ -119,6 +122,9 @@ struct MemoryUsageStats {
   int64 alloc;     // how many bytes are currently malloc-ed
   int64 peakUsage; // how many bytes have been dispensed at maximum
   int64 peakAlloc; // how many bytes malloc-ed at maximum
+
+  int64 smartCount[SMART_SIZE_CLASS_COUNT]; // smart_malloc() blocks in use
+  int64 smartTotal[SMART_SIZE_CLASS_COUNT]; // smart_malloc() calls
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -148,6 +154,7 @@ public:
     RestoreDisabled = 2, // registered after checkpoint
     NeedRestoreOnce = 4, // needs restore out-of-line memory only once
     NeedSweep = 8,       // needs to collect garbage
+    NoSweep = 16,        // sweep() has nothing to free at rollback time
   };
 
 public:
@@ -185,6 +192,15 @@ public:
   void disableDealloc() { m_dealloc = false;}
   void disableRestore() { m_flag |= RestoreDisabled;}
 
+  /**
+   * Whether rollbackObjects() has to find dangling objects and sweep them,
+   * which needs freed objects on the free list to tell them apart.
+   */
+  bool needSweep() const {
+    return (m_flag & (NeedRestore | NeedRestoreOnce | NeedSweep)) &&
+      !(m_flag & NoSweep);
+  }
+
   /**
    * Delegated to type T.
    */
@@ -181,8 +181,13 @@ Variant ObjectData::o_getPublic(CStrRef propName, int64 hash,
   if (propName.size() == 0) {
     return null;
   }
-  if (o_properties && o_properties->exists(propName, hash, true)) {
-    return o_properties->rvalAt(propName, hash, false, true);
+  if (o_properties && o_properties->get()) {
+    // one lookup, not exists() and then rvalAt()
+    ArrayData *properties = o_properties->get();
+    ssize_t pos = properties->getIndex(propName, hash);
+    if (pos != ArrayData::invalid_index) {
+      return properties->getValue(pos);
+    }
   }
   if (getAttribute(InGet)) {
     return ObjectData::doGet(propName, error);
@@ -348,16 +353,21 @@ Array ObjectData::o_toIterArray(CStrRef context,
     }
   }
 
-  ClassInfo::PropertyVec properties;
-  classInfo->getAllProperties(properties);
+  ClassInfo::PropertySlotVec uncached;
+  const ClassInfo::PropertySlotVec *slots =
+    classInfo->getCachedPropertySlots();
+  if (!slots) {
+    classInfo->getPropertySlots(uncached);
+    slots = &uncached;
+  }
   ClassInfo::PropertyMap contextProperties;
   if (category == 2) {
     contextClassInfo->getAllProperties(contextProperties);
   }
   Array dynamics = o_getDynamicProperties();
-  for (unsigned int i = 0; i < properties.size(); i++) {
-    ClassInfo::PropertyInfo *prop = properties[i];
-    if (prop->attribute & ClassInfo::IsStatic) continue;
+  for (unsigned int i = 0; i < slots->size(); i++) {
+    const ClassInfo::PropertySlot &slot = (*slots)[i];
+    ClassInfo::PropertyInfo *prop = slot.info;
 
     bool visible = false;
     switch (category) {
@@ -387,17 +397,17 @@ Array ObjectData::o_toIterArray(CStrRef context,
     default:
       ASSERT(false);
     }
-    if (visible && o_propExists(prop->name, -1, context)) {
+    if (visible && o_propExists(slot.name, -1, context)) {
       if (getRef) {
-        Variant &ov = o_lval(prop->name, -1, context);
-        Variant &av = ret.lvalAt(prop->name, -1, false, true);
+        Variant &ov = o_lval(slot.name, -1, context);
+        Variant &av = ret.lvalAt(slot.name, -1, false, true);
         av = ref(ov);
       } else {
-        ret.set(prop->name, o_getUnchecked(prop->name, -1,
-                                           prop->owner->getName(), -1));
+        ret.set(slot.name, o_getUnchecked(slot.name, -1, slot.owner.data(),
+                                          slot.owner->hash()));
       }
     }
-    dynamics.remove(prop->name);
+    dynamics.remove(slot.name);
   }
   if (!dynamics.empty()) {
     if (getRef) {
@@ -893,8 +903,20 @@ bool ObjectData::o_propExists(CStrRef s, int64 hash /* = -1 */,
   // Exists and the value is not null or it is null but also initialized.
   // Can't just do isInitialized because type inferred properties may not
   // be in the o_lval table.
-  return o_exists(s, hash, context) && (!o_get(s, hash, context).isNull() ||
-      o_lval(s, hash, context).isInitialized());
+  StringData *sd;
+  if (context.isNull()) {
+    sd = FrameInjection::GetClassName(false).get();
+  } else {
+    sd = context.get();
+  }
+  ASSERT(sd && sd->data());
+  // looked up once, rather than by each of the three calls
+  const char *cls = sd->data();
+  int64 chash = sd->hash();
+  if (hash < 0) hash = s->hash();
+  return o_exists(s, hash, cls, chash) &&
+    (!o_get(s, hash, false, cls, chash).isNull() ||
+     o_lval(s, hash, cls, chash).isInitialized());
 }
 
 Variant ObjectData::t___sleep() {
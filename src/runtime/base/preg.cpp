@@ -15,7 +15,10 @@
 */
 #include <runtime/base/string_util.h>
 #include <runtime/base/util/request_local.h>
+#include <runtime/base/server/server_stats.h>
 #include <util/lock.h>
+#include <util/atomic.h>
+#include <util/timer.h>
 #include <pcre.h>
 #include <regex.h>
 #include <runtime/base/runtime_option.h>
@@ -32,8 +35,6 @@
 
 #define PREG_GREP_INVERT            (1<<0)
 
-#define PCRE_CACHE_SIZE 4096
-
 enum {
   PHP_PCRE_NO_ERROR = 0,
   PHP_PCRE_INTERNAL_ERROR,
@@ -47,11 +48,16 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 // regex cache and helpers
 
+DECLARE_BOOST_TYPES(pcre_cache_entry);
 class pcre_cache_entry {
 public:
   ~pcre_cache_entry() {
     free(re);
-    if (extra) free(extra);
+#ifdef PCRE_STUDY_JIT_COMPILE
+    pcre_free_study(extra);
+#else
+    free(extra);
+#endif
 #if HAVE_SETLOCALE
     free(locale);
     if (tables) free(tables);
@@ -59,72 +65,146 @@ public:
   }
 
   pcre *re;
-  pcre_extra *extra; // Holds results of studying
+  pcre_extra *extra; // Holds results of studying, and the match limits
   int preg_options;
 #if HAVE_SETLOCALE
   char *locale;
   unsigned const char *tables;
 #endif
   int compile_options;
+  int64 last_used;
 };
-typedef std::map<std::string, pcre_cache_entry*> PCRECache;
 
-class PCREData : public RequestEventHandler {
+/**
+ * Compiled patterns, shared by all threads and kept across requests. Lookups
+ * only take the read lock and stamp the entry; when the cache is full, the
+ * least recently used quarter of it is dropped. Requests hold on to entries
+ * they are matching with, so dropping one never pulls it from under them.
+ */
+class PCRECache {
 public:
-  ~PCREData() {
-    cleanup();
+  PCRECache() : m_tick(0) {}
+
+  pcre_cache_entryPtr find(const std::string &regex) {
+    ReadLock lock(m_mutex);
+    EntryMap::const_iterator iter = m_entries.find(regex);
+    if (iter == m_entries.end()) return pcre_cache_entryPtr();
+    iter->second->last_used = atomic_add(m_tick, (int64)1);
+    return iter->second;
   }
 
-  void cleanup() {
-    for (PCRECache::iterator iter = cache.begin(); iter != cache.end();
-         ++iter) {
-      delete iter->second;
+  void insert(const std::string &regex, pcre_cache_entryPtr pce) {
+    if (RuntimeOption::PregCacheSize <= 0) return;
+    WriteLock lock(m_mutex);
+    if (m_entries.size() >= (size_t)RuntimeOption::PregCacheSize) {
+      evict();
     }
-    cache.clear();
+    pce->last_used = atomic_add(m_tick, (int64)1);
+    m_entries[regex] = pce;
   }
 
-  virtual void requestInit() {
-    cleanup();
+  void clear() {
+    WriteLock lock(m_mutex);
+    m_entries.clear();
   }
 
-  virtual void requestShutdown() {
-    cleanup();
+private:
+  typedef hphp_string_map<pcre_cache_entryPtr> EntryMap;
+
+  ReadWriteMutex m_mutex;
+  EntryMap m_entries;
+  int64 m_tick;
+
+  void evict() {
+    std::vector<int64> stamps;
+    stamps.reserve(m_entries.size());
+    for (EntryMap::const_iterator iter = m_entries.begin();
+         iter != m_entries.end(); ++iter) {
+      stamps.push_back(iter->second->last_used);
+    }
+    std::vector<int64>::iterator nth = stamps.begin() + stamps.size() / 4;
+    std::nth_element(stamps.begin(), nth, stamps.end());
+    int64 oldest = *nth;
+    for (EntryMap::iterator iter = m_entries.begin();
+         iter != m_entries.end();) {
+      if (iter->second->last_used <= oldest) {
+        m_entries.erase(iter++);
+      } else {
+        ++iter;
+      }
+    }
   }
+};
+static PCRECache s_pcre_cache;
+
+class PCREData : public RequestEventHandler {
+public:
+  virtual void requestInit() {}
+  virtual void requestShutdown() {}
 
-  PCRECache cache;
   int error_code;
-  pcre_extra extra_data;
 };
 IMPLEMENT_STATIC_REQUEST_LOCAL(PCREData, s_pcre_data);
 
-static pcre_cache_entry *pcre_get_compiled_regex_cache(CStrRef regex) {
-  PCRECache &pcre_cache = s_pcre_data->cache;
+bool preg_is_cached(CStrRef pattern) {
+  return s_pcre_cache.find(std::string(pattern.data(), pattern.size())).get();
+}
+
+void preg_clear_cache() {
+  s_pcre_cache.clear();
+}
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+/**
+ * The stack of JIT-compiled patterns. The default is 32K of machine stack,
+ * too small for some patterns, so each thread gets one that can grow up to
+ * 1M, freed when the thread exits.
+ */
+class PCREJitStack {
+public:
+  PCREJitStack() : stack(NULL) {}
+  ~PCREJitStack() {
+    if (stack) pcre_jit_stack_free(stack);
+  }
+
+  pcre_jit_stack *stack;
+};
+static IMPLEMENT_THREAD_LOCAL(PCREJitStack, s_jit_stack);
+
+// called by pcre_exec()
+static pcre_jit_stack *get_jit_stack(void *) {
+  if (!s_jit_stack->stack) {
+    s_jit_stack->stack = pcre_jit_stack_alloc(32 * 1024, 1024 * 1024);
+  }
+  return s_jit_stack->stack;
+}
+#endif
 
+static pcre_cache_entryPtr pcre_get_compiled_regex_cache(CStrRef regex) {
   /* Try to lookup the cached regex entry, and if successful, just pass
      back the compiled pattern, otherwise go on and compile it. */
   std::string sregex(regex.data(), regex.size());
-  PCRECache::const_iterator iter = pcre_cache.find(sregex);
-  if (iter != pcre_cache.end()) {
-    pcre_cache_entry *pce = iter->second;
+  pcre_cache_entryPtr pce = s_pcre_cache.find(sregex);
+  if (pce) {
     /**
      * We use a quick pcre_info() check to see whether cache is corrupted,
      * and if it is, we flush it and compile the pattern from scratch.
      */
     if (pcre_info(pce->re, NULL, NULL) == PCRE_ERROR_BADMAGIC) {
-      for (iter = pcre_cache.begin(); iter != pcre_cache.end(); ++iter) {
-        delete iter->second;
-      }
-      pcre_cache.clear();
+      s_pcre_cache.clear();
     } else {
 #if HAVE_SETLOCALE
       if (!strcmp(pce->locale, locale)) {
 #endif
+        ServerStats::Log("pcre.hit", 1);
         return pce;
 #if HAVE_SETLOCALE
       }
 #endif
     }
   }
+  ServerStats::Log("pcre.miss", 1);
+  Timer timer(Timer::WallTime);
 
   /* Parse through the leading whitespace, and display a warning if we
      get to the end without encountering a delimiter. */
@@ -132,7 +212,7 @@ static pcre_cache_entry *pcre_get_compiled_regex_cache(CStrRef regex) {
   while (isspace((int)*(unsigned char *)p)) p++;
   if (*p == 0) {
     raise_warning("Empty regular expression");
-    return NULL;
+    return pcre_cache_entryPtr();
   }
 
   /* Get the delimiter and display a warning if it is alphanumeric
@@ -140,7 +220,7 @@ static pcre_cache_entry *pcre_get_compiled_regex_cache(CStrRef regex) {
   char delimiter = *p++;
   if (isalnum((int)*(unsigned char *)&delimiter) || delimiter == '\\') {
     raise_warning("Delimiter must not be alphanumeric or backslash");
-    return NULL;
+    return pcre_cache_entryPtr();
   }
 
   char start_delimiter = delimiter;
@@ -164,7 +244,7 @@ static pcre_cache_entry *pcre_get_compiled_regex_cache(CStrRef regex) {
     if (*pp == 0) {
       raise_warning("No ending delimiter '%c' found: [%s]", delimiter,
                       regex.data());
-      return NULL;
+      return pcre_cache_entryPtr();
     }
   } else {
     /* We iterate through the pattern, searching for the matching ending
@@ -185,7 +265,7 @@ static pcre_cache_entry *pcre_get_compiled_regex_cache(CStrRef regex) {
     if (*pp == 0) {
       raise_warning("No ending matching delimiter '%c' found: [%s]",
                       end_delimiter, regex.data());
-      return NULL;
+      return pcre_cache_entryPtr();
     }
   }
 
@@ -226,7 +306,7 @@ static pcre_cache_entry *pcre_get_compiled_regex_cache(CStrRef regex) {
 
     default:
       raise_warning("Unknown modifier '%c': [%s]", pp[-1], regex.data());
-      return NULL;
+      return pcre_cache_entryPtr();
     }
   }
 
@@ -246,26 +326,33 @@ static pcre_cache_entry *pcre_get_compiled_regex_cache(CStrRef regex) {
     if (tables) {
       free((void*)tables);
     }
-    return NULL;
+    return pcre_cache_entryPtr();
   }
 
-  /* If study option was specified, study the pattern and
-     store the result in extra for passing to pcre_exec. */
-  pcre_extra *extra = NULL;
-  if (do_study) {
-    int soptions = 0;
-    extra = pcre_study(re, soptions, &error);
-    if (extra) {
-      extra->flags |= PCRE_EXTRA_MATCH_LIMIT |
-        PCRE_EXTRA_MATCH_LIMIT_RECURSION;
-    }
-    if (error != NULL) {
-      raise_warning("Error while studying pattern");
-    }
+  /* Study the pattern, JIT compiling it where PCRE can, and store the
+     result in extra for passing to pcre_exec. Compiled patterns live on
+     across requests, so this is always worth it, 'S' or not. */
+#ifdef PCRE_STUDY_JIT_COMPILE
+  int soptions = RuntimeOption::PregJit ? PCRE_STUDY_JIT_COMPILE : 0;
+#else
+  int soptions = 0;
+#endif
+  pcre_extra *extra = pcre_study(re, soptions, &error);
+  if (error != NULL && do_study) {
+    raise_warning("Error while studying pattern");
+  }
+  if (extra == NULL) {
+    extra = (pcre_extra *)calloc(1, sizeof(pcre_extra));
   }
+  extra->flags |= PCRE_EXTRA_MATCH_LIMIT | PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+  extra->match_limit = RuntimeOption::PregBacktraceLimit;
+  extra->match_limit_recursion = RuntimeOption::PregRecursionLimit;
+#ifdef PCRE_STUDY_JIT_COMPILE
+  pcre_assign_jit_stack(extra, get_jit_stack, NULL);
+#endif
 
   /* Store the compiled pattern and extra info in the cache. */
-  pcre_cache_entry *new_entry = new pcre_cache_entry();
+  pcre_cache_entryPtr new_entry(new pcre_cache_entry());
   new_entry->re = re;
   new_entry->extra = extra;
   new_entry->preg_options = poptions;
@@ -275,27 +362,14 @@ static pcre_cache_entry *pcre_get_compiled_regex_cache(CStrRef regex) {
   new_entry->locale = strdup(locale);
   new_entry->tables = tables;
 #endif
-  if (iter != pcre_cache.end()) {
-    delete iter->second;
-  }
-  pcre_cache[sregex] = new_entry;
+  s_pcre_cache.insert(sregex, new_entry);
+  ServerStats::Log("pcre.compile.time", timer.getMicroSeconds());
   return new_entry;
 }
 
-static void set_extra_limits(pcre_extra *&extra) {
-  if (extra == NULL) {
-    pcre_extra &extra_data = s_pcre_data->extra_data;
-    extra_data.flags = PCRE_EXTRA_MATCH_LIMIT |
-      PCRE_EXTRA_MATCH_LIMIT_RECURSION;
-    extra = &extra_data;
-  }
-  extra->match_limit = RuntimeOption::PregBacktraceLimit;
-  extra->match_limit_recursion = RuntimeOption::PregRecursionLimit;
-}
-
-static int *create_offset_array(pcre_cache_entry *pce, int &size_offsets) {
+static int *create_offset_array(const pcre_cache_entryPtr &pce,
+                                int &size_offsets) {
   pcre_extra *extra = pce->extra;
-  set_extra_limits(extra);
 
   /* Calculate the size of the offsets array, and allocate memory for it. */
   int num_subpats; // Number of captured subpatterns
@@ -309,18 +383,6 @@ static int *create_offset_array(pcre_cache_entry *pce, int &size_offsets) {
   return (int *)malloc(size_offsets * sizeof(int));
 }
 
-static pcre* pcre_get_compiled_regex(CStrRef regex, pcre_extra **extra,
-                                     int *preg_options) {
-  pcre_cache_entry *pce = pcre_get_compiled_regex_cache(regex);
-  if (extra) {
-    *extra = pce ? pce->extra : NULL;
-  }
-  if (preg_options) {
-    *preg_options = pce ? pce->preg_options : 0;
-  }
-  return pce ? pce->re : NULL;
-}
-
 static inline void add_offset_pair(Variant &result, CStrRef str, int offset,
                                    const char *name) {
   Array match_pair;
@@ -358,8 +420,8 @@ static void pcre_handle_exec_error(int pcre_code) {
 ///////////////////////////////////////////////////////////////////////////////
 
 Variant preg_grep(CStrRef pattern, CArrRef input, int flags /* = 0 */) {
-  pcre_cache_entry *pce = pcre_get_compiled_regex_cache(pattern);
-  if (pce == NULL) {
+  pcre_cache_entryPtr pce = pcre_get_compiled_regex_cache(pattern);
+  if (!pce) {
     return false;
   }
 
@@ -376,7 +438,6 @@ Variant preg_grep(CStrRef pattern, CArrRef input, int flags /* = 0 */) {
   /* Go through the input array */
   bool invert = (flags & PREG_GREP_INVERT);
   pcre_extra *extra = pce->extra;
-  set_extra_limits(extra);
 
   for (ArrayIter iter(input); iter; ++iter) {
     String entry = iter.second().toString();
@@ -413,13 +474,12 @@ Variant preg_grep(CStrRef pattern, CArrRef input, int flags /* = 0 */) {
 Variant preg_match_impl(CStrRef pattern, CStrRef subject,
                                Variant &subpats, int flags, int start_offset,
                                bool global) {
-  pcre_cache_entry *pce = pcre_get_compiled_regex_cache(pattern);
-  if (pce == NULL) {
+  pcre_cache_entryPtr pce = pcre_get_compiled_regex_cache(pattern);
+  if (!pce) {
     return false;
   }
 
   pcre_extra *extra = pce->extra;
-  set_extra_limits(extra);
   subpats = Array::Create();
 
   int subpats_order = global ? PREG_PATTERN_ORDER : 0;
@@ -732,8 +792,8 @@ static bool preg_get_backref(const char **str, int *backref) {
 static String php_pcre_replace(CStrRef pattern, CStrRef subject,
                                CVarRef replace_var, bool callable,
                                int limit, int *replace_count) {
-  pcre_cache_entry *pce = pcre_get_compiled_regex_cache(pattern);
-  if (pce == NULL) {
+  pcre_cache_entryPtr pce = pcre_get_compiled_regex_cache(pattern);
+  if (!pce) {
     return false;
   }
   bool eval = false;
@@ -787,7 +847,6 @@ static String php_pcre_replace(CStrRef pattern, CStrRef subject,
   int start_offset = 0;
   s_pcre_data->error_code = PHP_PCRE_NO_ERROR;
   pcre_extra *extra = pce->extra;
-  set_extra_limits(extra);
 
   int result_len = 0;
   int new_len;        // Length of needed storage
@@ -1064,8 +1123,8 @@ int preg_replace_callback(Variant &result, CVarRef pattern, CVarRef callback,
 
 Variant preg_split(CVarRef pattern, CVarRef subject, int limit /* = -1 */,
                    int flags /* = 0 */) {
-  pcre_cache_entry *pce = pcre_get_compiled_regex_cache(pattern.toString());
-  if (pce == NULL) {
+  pcre_cache_entryPtr pce = pcre_get_compiled_regex_cache(pattern.toString());
+  if (!pce) {
     return false;
   }
 
@@ -1096,8 +1155,7 @@ Variant preg_split(CVarRef pattern, CVarRef subject, int limit /* = -1 */,
   // Get next piece if no limit or limit not yet reached and something matched
   Variant return_value = Array::Create();
   int g_notempty = 0;   /* If the match should not be empty */
-  pcre *re_bump = NULL; /* Regex instance for empty matches */
-  pcre_extra *extra_bump = NULL; /* Almost dummy */
+  pcre_cache_entryPtr bump; /* Regex instance for empty matches */
   while ((limit == -1 || limit > 1)) {
     int count = pcre_exec(pce->re, extra, ssubject.data(), ssubject.size(),
                           start_offset, g_notempty, offsets, size_offsets);
@@ -1159,14 +1217,13 @@ Variant preg_split(CVarRef pattern, CVarRef subject, int limit /* = -1 */,
          to achieve this, unless we're already at the end of the string. */
       if (g_notempty != 0 && start_offset < ssubject.size()) {
         if (pce->compile_options & PCRE_UTF8) {
-          if (re_bump == NULL) {
-            int dummy;
-            if ((re_bump = pcre_get_compiled_regex("/./us", &extra_bump,
-                                                   &dummy)) == NULL) {
+          if (!bump) {
+            bump = pcre_get_compiled_regex_cache("/./us");
+            if (!bump) {
               return false;
             }
           }
-          count = pcre_exec(re_bump, extra_bump, ssubject.data(),
+          count = pcre_exec(bump->re, bump->extra, ssubject.data(),
                             ssubject.size(), start_offset,
                             0, offsets, size_offsets);
           if (count < 1) {
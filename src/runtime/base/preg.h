@@ -53,6 +53,12 @@ Variant php_split(CStrRef spliton, CStrRef str, int count, bool icase);
 
 int preg_last_error();
 
+/**
+ * Compiled patterns are cached across requests and threads.
+ */
+bool preg_is_cached(CStrRef pattern);
+void preg_clear_cache();
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
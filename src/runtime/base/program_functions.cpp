@@ -35,7 +35,9 @@
 #include <util/timer.h>
 #include <util/stack_trace.h>
 #include <util/light_process.h>
+#include <util/async_log.h>
 #include <runtime/base/source_info.h>
+#include <runtime/base/class_info.h>
 #include <runtime/base/rtti_info.h>
 #include <runtime/base/frame_injection.h>
 #include <runtime/ext/extension.h>
@@ -56,6 +58,7 @@
 #include <libgen.h>
 
 #include <runtime/eval/runtime/eval_state.h>
+#include <runtime/eval/runtime/file_watcher.h>
 
 using namespace std;
 using namespace boost::program_options;
@@ -464,6 +467,7 @@ static int start_server(const std::string &username) {
     (RuntimeOption::AccessLogDefaultFormat, RuntimeOption::AccessLogs);
   AdminRequestHandler::GetAccessLog().init
     (RuntimeOption::AdminLogFormat, RuntimeOption::AdminLogFile);
+  AsyncLogWriter::Start();
 
 #if !defined(SKIP_USER_CHANGE)
   if (!username.empty()) {
@@ -474,6 +478,7 @@ static int start_server(const std::string &username) {
 
   HttpServer::Server = HttpServerPtr(new HttpServer());
   HttpServer::Server->run();
+  AsyncLogWriter::Stop();
   return 0;
 }
 
@@ -784,6 +789,7 @@ void hphp_process_init() {
   XboxServer::Restart();
   Extension::InitModules();
   apc_load(RuntimeOption::ApcLoadThread);
+  ClassInfo::Load(); // before FinishInit(): it makes static strings
   StaticString::FinishInit();
   Eval::Debugger::StartServer();
 }
@@ -869,6 +875,7 @@ static bool hphp_warmup(ExecutionContext *context,
   }
 
   s_warmup_state->atCheckpoint = false;
+  MemoryManager::TheMemoryManager()->enterArena();
   return ret;
 }
 
@@ -1003,6 +1010,8 @@ void hphp_session_exit() {
 void hphp_process_exit() {
   Eval::Debugger::Stop();
   Extension::ShutdownModules();
+  Eval::FileWatcher::Stop();
+  AsyncLogWriter::Stop();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
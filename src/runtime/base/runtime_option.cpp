@@ -23,6 +23,7 @@
 #include <util/stack_trace.h>
 #include <util/process.h>
 #include <util/file_cache.h>
+#include <util/async_log.h>
 #include <runtime/base/preg.h>
 #include <runtime/base/server/access_log.h>
 #include <runtime/base/util/extended_logger.h>
@@ -76,6 +77,8 @@ std::string RuntimeOption::ServerIP;
 std::string RuntimeOption::ServerPrimaryIP;
 int RuntimeOption::ServerPort;
 int RuntimeOption::ServerThreadCount = 50;
+bool RuntimeOption::ServerWorkStealing = false;
+int RuntimeOption::ServerEventLoops = 1;
 int RuntimeOption::PageletServerThreadCount = 0;
 int RuntimeOption::FiberCount = 0;
 int RuntimeOption::RequestTimeoutSeconds = 0;
@@ -231,15 +234,19 @@ int64 RuntimeOption::MaxSQLRowCount = 10000;
 int64 RuntimeOption::MaxMemcacheKeyCount = 0;
 int RuntimeOption::SocketDefaultTimeout = 5;
 bool RuntimeOption::EnableMemoryManager = true;
+bool RuntimeOption::EnableRequestArena = false;
 bool RuntimeOption::CheckMemory = false;
 bool RuntimeOption::UseZendArray = true;
 bool RuntimeOption::UseSmallArray = false;
+bool RuntimeOption::UseHphpArray = false;
 bool RuntimeOption::UseDirectCopy = false;
 bool RuntimeOption::EnableApc = true;
 bool RuntimeOption::EnableConstLoad = false;
 bool RuntimeOption::ApcUseSharedMemory = false;
 int RuntimeOption::ApcSharedMemorySize = 1024; // 1GB
 std::string RuntimeOption::ApcPrimeLibrary;
+std::string RuntimeOption::ApcSnapshotFile;
+int RuntimeOption::ApcSnapshotTimeout = 3600;
 int RuntimeOption::ApcLoadThread = 1;
 std::set<std::string> RuntimeOption::ApcCompletionKeys;
 RuntimeOption::ApcTableTypes RuntimeOption::ApcTableType = ApcHashTable;
@@ -249,8 +256,10 @@ time_t RuntimeOption::ApcKeyMaturityThreshold = 20;
 size_t RuntimeOption::ApcMaximumCapacity = 0;
 int RuntimeOption::ApcKeyFrequencyUpdatePeriod = 1000;
 bool RuntimeOption::ApcUseLockedRefs = false;
+bool RuntimeOption::ApcFlatArrays = false;
 bool RuntimeOption::ApcExpireOnSets = false;
 int RuntimeOption::ApcPurgeFrequency = 4096;
+int RuntimeOption::ApcStripeCount = 64;
 
 bool RuntimeOption::EnableDnsCache = false;
 int RuntimeOption::DnsCacheTTL = 10 * 60; // 10 minutes
@@ -265,11 +274,15 @@ std::string RuntimeOption::LightProcessFilePrefix;
 int RuntimeOption::LightProcessCount;
 
 bool RuntimeOption::EnableXHP = true;
+bool RuntimeOption::FileWatch = false;
+int RuntimeOption::FileWatchRevalidate = 60;
 bool RuntimeOption::EnableStrict = false;
 int RuntimeOption::StrictLevel = 1; // StrictBasic, cf strict_mode.h
 bool RuntimeOption::StrictFatal = false;
 bool RuntimeOption::RecordCodeCoverage = false;
 std::string RuntimeOption::CodeCoverageOutputFile;
+bool RuntimeOption::BytecodeInterpreter = false;
+bool RuntimeOption::DumpBytecode = false;
 
 bool RuntimeOption::SandboxMode = false;
 std::string RuntimeOption::SandboxPattern;
@@ -292,6 +305,8 @@ std::string RuntimeOption::MailForceExtraParameters;
 
 int RuntimeOption::PregBacktraceLimit = 100000;
 int RuntimeOption::PregRecursionLimit = 100000;
+int RuntimeOption::PregCacheSize = 4096;
+bool RuntimeOption::PregJit = true;
 
 ///////////////////////////////////////////////////////////////////////////////
 // keep this block after all the above static variables, or we will have
@@ -407,6 +422,12 @@ void RuntimeOption::Load(Hdf &config) {
     LogAggregatorDatabase = aggregator["Database"].getString();
     LogAggregatorSleepSeconds = aggregator["SleepSeconds"].getInt16(10);
 
+    Hdf async = logger["Async"];
+    AsyncLogWriter::Enabled = async.getBool();
+    AsyncLogWriter::BufferSize = async["BufferSize"].getInt32(64 * 1024);
+    AsyncLogWriter::FlushInterval = async["FlushInterval"].getInt32(10);
+    AsyncLogWriter::Block = async["Block"].getBool();
+
     AlwaysLogUnhandledExceptions =
       logger["AlwaysLogUnhandledExceptions"].getBool(true);
     NoSilencer = logger["NoSilencer"].getBool();
@@ -470,6 +491,8 @@ void RuntimeOption::Load(Hdf &config) {
     ServerPrimaryIP = Util::GetPrimaryIP();
     ServerPort = server["Port"].getInt16(80);
     ServerThreadCount = server["ThreadCount"].getInt32(50);
+    ServerWorkStealing = server["WorkStealing"].getBool();
+    ServerEventLoops = server["EventLoops"].getInt32(1);
     RequestTimeoutSeconds = server["RequestTimeoutSeconds"].getInt32(0);
     RequestMemoryMaxBytes = server["RequestMemoryMaxBytes"].getInt32(-1);
     ResponseQueueCount = server["ResponseQueueCount"].getInt32(0);
@@ -582,9 +605,11 @@ void RuntimeOption::Load(Hdf &config) {
     server["ForbiddenFileExtensions"].get(ForbiddenFileExtensions);
 
     EnableMemoryManager = server["EnableMemoryManager"].getBool(true);
+    EnableRequestArena = server["EnableRequestArena"].getBool();
     CheckMemory = server["CheckMemory"].getBool();
     UseZendArray = server["UseZendArray"].getBool(true);
     UseSmallArray = server["UseSmallArray"].getBool(false);
+    UseHphpArray = server["UseHphpArray"].getBool(false);
     UseDirectCopy = server["UseDirectCopy"].getBool(false);
 
     Hdf apc = server["APC"];
@@ -595,12 +620,16 @@ void RuntimeOption::Load(Hdf &config) {
     ApcPrimeLibrary = apc["PrimeLibrary"].getString();
     ApcLoadThread = apc["LoadThread"].getInt16(2);
     apc["CompletionKeys"].get(ApcCompletionKeys);
+    ApcSnapshotFile = apc["SnapshotFile"].getString();
+    ApcSnapshotTimeout = apc["SnapshotTimeout"].getInt32(3600);
 
     string apcTableType = apc["TableType"].getString("hash");
     if (strcasecmp(apcTableType.c_str(), "hash") == 0) {
       ApcTableType = ApcHashTable;
     } else if (strcasecmp(apcTableType.c_str(), "concurrent") == 0) {
       ApcTableType = ApcConcurrentTable;
+    } else if (strcasecmp(apcTableType.c_str(), "striped") == 0) {
+      ApcTableType = ApcStripedTable;
     } else {
       throw InvalidArgumentException("apc table type",
                                      "Invalid table type");
@@ -616,8 +645,10 @@ void RuntimeOption::Load(Hdf &config) {
     }
 
     ApcUseLockedRefs = apc["UseLockedRefs"].getBool();
+    ApcFlatArrays = apc["FlatArrays"].getBool();
     ApcExpireOnSets = apc["ExpireOnSets"].getBool();
     ApcPurgeFrequency = apc["PurgeFrequency"].getInt32(4096);
+    ApcStripeCount = apc["StripeCount"].getInt32(64);
 
     ApcKeyMaturityThreshold = apc["KeyMaturityThreshold"].getInt32(20);
     ApcMaximumCapacity = apc["MaximumCapacity"].getInt64(0);
@@ -828,11 +859,15 @@ void RuntimeOption::Load(Hdf &config) {
   {
     Hdf eval = config["Eval"];
     EnableXHP = eval["EnableXHP"].getBool(true);
+    FileWatch = eval["FileWatch"].getBool();
+    FileWatchRevalidate = eval["FileWatchRevalidate"].getInt32(60);
     EnableStrict = eval["EnableStrict"].getBool();
     StrictLevel = eval["StrictLevel"].getInt32(1); // StrictBasic
     StrictFatal = eval["StrictFatal"].getBool();
     RecordCodeCoverage = eval["RecordCodeCoverage"].getBool();
     CodeCoverageOutputFile = eval["CodeCoverageOutputFile"].getString();
+    BytecodeInterpreter = eval["BytecodeInterpreter"].getBool();
+    DumpBytecode = eval["DumpBytecode"].getBool();
     {
       Hdf debugger = eval["Debugger"];
       EnableDebugger = debugger["EnableDebugger"].getBool();
@@ -864,6 +899,8 @@ void RuntimeOption::Load(Hdf &config) {
     Hdf preg = config["Preg"];
     PregBacktraceLimit = preg["BacktraceLimit"].getInt32(100000);
     PregRecursionLimit = preg["RecursionLimit"].getInt32(100000);
+    PregCacheSize = preg["CacheSize"].getInt32(4096);
+    PregJit = preg["JIT"].getBool(true);
   }
 
   Extension::LoadModules(config);
@@ -73,6 +73,8 @@ public:
   static std::string ServerPrimaryIP;
   static int ServerPort;
   static int ServerThreadCount;
+  static bool ServerWorkStealing;
+  static int ServerEventLoops;
   static int PageletServerThreadCount;
   static int FiberCount;
   static int RequestTimeoutSeconds;
@@ -229,21 +231,26 @@ public:
   static int64 MaxMemcacheKeyCount;
   static int  SocketDefaultTimeout;
   static bool EnableMemoryManager;
+  static bool EnableRequestArena;
   static bool CheckMemory;
   static bool UseZendArray; // ignored: ZendArray is always enabled
   static bool UseSmallArray;
+  static bool UseHphpArray;
   static bool UseDirectCopy;
   static bool EnableApc;
   static bool EnableConstLoad;
   static bool ApcUseSharedMemory;
   static int ApcSharedMemorySize;
   static std::string ApcPrimeLibrary;
+  static std::string ApcSnapshotFile;
+  static int ApcSnapshotTimeout;
   static int ApcLoadThread;
   static std::set<std::string> ApcCompletionKeys;
   enum ApcTableTypes {
     ApcHashTable,
     ApcLfuTable,
-    ApcConcurrentTable
+    ApcConcurrentTable,
+    ApcStripedTable
   };
   static ApcTableTypes ApcTableType;
   enum ApcTableLockTypes {
@@ -255,8 +262,10 @@ public:
   static size_t ApcMaximumCapacity;
   static int ApcKeyFrequencyUpdatePeriod;
   static bool ApcUseLockedRefs;
+  static bool ApcFlatArrays;
   static bool ApcExpireOnSets;
   static int ApcPurgeFrequency;
+  static int ApcStripeCount;
 
   static bool EnableDnsCache;
   static int DnsCacheTTL;
@@ -275,11 +284,15 @@ public:
 
   // Eval options
   static bool EnableXHP;
+  static bool FileWatch;
+  static int FileWatchRevalidate;
   static bool EnableStrict;
   static int StrictLevel;
   static bool StrictFatal;
   static bool RecordCodeCoverage;
   static std::string CodeCoverageOutputFile;
+  static bool BytecodeInterpreter;
+  static bool DumpBytecode;
 
   // Sandbox options
   static bool SandboxMode;
@@ -306,6 +319,8 @@ public:
   // preg stack depth options
   static int PregBacktraceLimit;
   static int PregRecursionLimit;
+  static int PregCacheSize;
+  static bool PregJit;
 
   static bool FastMethodCall;
 };
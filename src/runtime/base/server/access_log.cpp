@@ -21,12 +21,14 @@
 #include <runtime/base/server/server_note.h>
 #include <runtime/base/server/request_uri.h>
 #include <util/process.h>
+#include <util/async_log.h>
 
 namespace HPHP {
 using namespace std;
 ///////////////////////////////////////////////////////////////////////////////
 
 AccessLog::~AccessLog() {
+  AsyncLogWriter::Flush();
   for (uint i = 0; i < m_output.size(); ++i) {
     if (m_output[i]) {
       if (m_files[i].first[0] == '|') {
@@ -89,18 +91,18 @@ void AccessLog::log(Transport *transport) {
   FILE *threadLog = m_fGetThreadData()->log;
   if (threadLog) {
     writeLog(transport, threadLog,
-             m_defaultFormat.c_str());
+             m_defaultFormat.c_str(), false);
   }
   for (uint i = 0; i < m_output.size(); ++i) {
     FILE *outFile = m_output[i];
     if (!outFile) continue;
     const char *format = m_files[i].second.c_str();
-    writeLog(transport, outFile, format);
+    writeLog(transport, outFile, format, true);
   }
 }
 
 void AccessLog::writeLog(Transport *transport, FILE *outFile,
-                         const char *format) {
+                         const char *format, bool async) {
    char c;
    ostringstream out;
    while (c = *format++) {
@@ -121,8 +123,12 @@ void AccessLog::writeLog(Transport *transport, FILE *outFile,
    }
    out << endl;
    string output = out.str();
-   fprintf(outFile, "%s", output.c_str());
-   fflush(outFile);
+   if (async) {
+     AsyncLogWriter::Write(outFile, output.data(), output.size());
+   } else {
+     fprintf(outFile, "%s", output.c_str());
+     fflush(outFile);
+   }
 }
 
 bool AccessLog::parseConditions(const char* &format, int code) {
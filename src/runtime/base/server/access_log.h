@@ -53,7 +53,7 @@ private:
                        Transport *transport, const std::string &arg);
   void skipField(const char* &format);
   void writeLog(Transport *transport, FILE *outFile,
-                       const char *format);
+                       const char *format, bool async);
 
   std::vector<FILE*> m_output;
   bool m_initialized;
@@ -23,6 +23,7 @@
 #include <util/logger.h>
 #include <util/util.h>
 #include <util/mutex.h>
+#include <util/async_log.h>
 #include <runtime/base/time/datetime.h>
 #include <runtime/base/memory/memory_manager.h>
 #include <runtime/base/program_functions.h>
@@ -30,6 +31,7 @@
 #include <runtime/base/memory/leak_detectable.h>
 #include <runtime/ext/mysql_stats.h>
 #include <runtime/base/shared/shared_store_stats.h>
+#include <runtime/eval/runtime/file_watcher.h>
 
 #ifdef GOOGLE_CPU_PROFILER
 #include <google/profiler.h>
@@ -90,6 +92,8 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "/check-mem:       report memory quick statistics in log file\n"
         "/check-apc:       report APC quick statistics\n"
         "/check-sql:       report SQL table statistics\n"
+        "/check-log:       report lines written and dropped by async logging\n"
+        "/check-stat:      report stat() calls made and avoided on includes\n"
 
         "/status.xml:      show server status in XML\n"
         "/status.json:     show server status in JSON\n"
@@ -406,6 +410,32 @@ bool AdminRequestHandler::handleCheckRequest(const std::string &cmd,
     transport->sendString(stats);
     return true;
   }
+  if (cmd == "check-log") {
+    string stats = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    stats += "<Log>\n";
+    stats += "<Written>" +
+      lexical_cast<string>(AsyncLogWriter::GetWrittenCount()) +
+      "</Written>\n";
+    stats += "<Dropped>" +
+      lexical_cast<string>(AsyncLogWriter::GetDroppedCount()) +
+      "</Dropped>\n";
+    stats += "</Log>\n";
+    transport->sendString(stats);
+    return true;
+  }
+  if (cmd == "check-stat") {
+    string stats = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    stats += "<Stat>\n";
+    stats += "<Calls>" +
+      lexical_cast<string>(Eval::FileWatcher::GetStatCount()) +
+      "</Calls>\n";
+    stats += "<Avoided>" +
+      lexical_cast<string>(Eval::FileWatcher::GetAvoidedCount()) +
+      "</Avoided>\n";
+    stats += "</Stat>\n";
+    transport->sendString(stats);
+    return true;
+  }
   return false;
 }
 
@@ -36,6 +36,8 @@
 #include <util/db_conn.h>
 #include <util/log_aggregator.h>
 #include <runtime/ext/ext_apc.h>
+#include <runtime/base/shared/shared_store.h>
+#include <util/timer.h>
 #include <sys/types.h>
 #include <signal.h>
 
@@ -60,11 +62,13 @@ HttpServer::HttpServer()
   LockProfiler::s_pfunc_profile = server_stats_log_mutex;
 
   if (RuntimeOption::TakeoverFilename.empty()) {
-    m_pageServer = ServerPtr
+    LibEventServer *server =
       (new TypedServer<LibEventServer, HttpRequestHandler>
        (RuntimeOption::ServerIP, RuntimeOption::ServerPort,
         RuntimeOption::ServerThreadCount,
         RuntimeOption::RequestTimeoutSeconds));
+    server->setEventLoops(RuntimeOption::ServerEventLoops);
+    m_pageServer = ServerPtr(server);
   } else {
     LibEventServerWithTakeover* server =
       (new TypedServer<LibEventServerWithTakeover, HttpRequestHandler>
@@ -73,6 +77,7 @@ HttpServer::HttpServer()
         RuntimeOption::RequestTimeoutSeconds));
     server->setTransferFilename(RuntimeOption::TakeoverFilename);
     server->addTakeoverListener(this);
+    server->setEventLoops(RuntimeOption::ServerEventLoops);
     m_pageServer = ServerPtr(server);
   }
 
@@ -266,6 +271,14 @@ void HttpServer::run() {
                  m_danglings[i]->getName().c_str());
   }
 
+  if (RuntimeOption::EnableApc && !RuntimeOption::ApcSnapshotFile.empty()) {
+    Timer timer(Timer::WallTime, "saving APC snapshot");
+    if (SharedStores::SaveSnapshot(RuntimeOption::ApcSnapshotFile)) {
+      Logger::Info("APC snapshot saved to %s",
+                   RuntimeOption::ApcSnapshotFile.c_str());
+    }
+  }
+
   hphp_process_exit();
   m_watchDog.waitForEnd();
   m_loggerThread.waitForEnd();
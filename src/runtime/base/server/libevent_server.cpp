@@ -19,6 +19,9 @@
 #include <runtime/base/memory/memory_manager.h>
 #include <runtime/base/server/server_stats.h>
 #include <runtime/base/server/http_protocol.h>
+#include <util/util.h>
+#include <netdb.h>
+#include <fcntl.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 // static handler
@@ -28,6 +31,16 @@ static void on_request(struct evhttp_request *request, void *obj) {
   ((HPHP::LibEventServer*)obj)->onRequest(request);
 }
 
+static void on_loop_request(struct evhttp_request *request, void *obj) {
+  ASSERT(obj);
+  ((HPHP::LibEventLoop*)obj)->onRequest(request);
+}
+
+static void on_loop_control(int fd, short what, void *obj) {
+  ASSERT(obj);
+  ((HPHP::LibEventLoop*)obj)->onControl();
+}
+
 static void on_response(int fd, short what, void *obj) {
   ASSERT(obj);
   ((HPHP::PendingResponseQueue*)obj)->process();
@@ -41,11 +54,76 @@ static void on_thread_stop(int fd, short events, void *context) {
   event_base_loopbreak((struct event_base *)context);
 }
 
+static void dispatch_with_timeout(struct event_base *base,
+                                  int timeoutSeconds) {
+  struct timeval timeout;
+  timeout.tv_sec = timeoutSeconds;
+  timeout.tv_usec = 0;
+
+  event eventTimeout;
+  event_set(&eventTimeout, -1, 0, on_timer, base);
+  event_base_set(base, &eventTimeout);
+  event_add(&eventTimeout, &timeout);
+
+  event_base_loop(base, EVLOOP_ONCE);
+
+  event_del(&eventTimeout);
+}
+
+/**
+ * Binds a non-blocking listening socket, with SO_REUSEPORT if asked to.
+ * Returns -1 with errno set on failure.
+ */
+static int bind_socket(const std::string &address, int port,
+                       bool reusePort) {
+#ifndef SO_REUSEPORT
+  if (reusePort) {
+    errno = ENOPROTOOPT;
+    return -1;
+  }
+#endif
+
+  struct addrinfo hints, *ai;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  char service[12];
+  snprintf(service, sizeof(service), "%d", port);
+  if (getaddrinfo(address.empty() ? NULL : address.c_str(), service, &hints,
+                  &ai) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+  int on = 1;
+  if (fd < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+#ifdef SO_REUSEPORT
+      (reusePort &&
+       setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) ||
+#endif
+      fcntl(fd, F_SETFL, O_NONBLOCK) < 0 ||
+      fcntl(fd, F_SETFD, FD_CLOEXEC) < 0 ||
+      bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 ||
+      listen(fd, 1024) < 0) {
+    int errno_save = errno;
+    if (fd >= 0) close(fd);
+    freeaddrinfo(ai);
+    errno = errno_save;
+    return -1;
+  }
+  freeaddrinfo(ai);
+  return fd;
+}
+
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 // LibEventJob
 
-LibEventJob::LibEventJob(evhttp_request *req) : request(req) {
+LibEventJob::LibEventJob(evhttp_request *req, int loop)
+  : request(req), loop(loop) {
   if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
 #if defined(__APPLE__)
     gettimeofday(&start, NULL);
@@ -85,6 +163,9 @@ LibEventWorker::~LibEventWorker() {
 
 void LibEventWorker::doJob(LibEventJobPtr job) {
   job->stopTimer();
+  if (m_jobStolen) {
+    ServerStats::Log("queue.steal", 1);
+  }
   evhttp_request *request = job->request;
   ASSERT(m_opaque);
   LibEventServer *server = (LibEventServer*)m_opaque;
@@ -94,7 +175,7 @@ void LibEventWorker::doJob(LibEventJobPtr job) {
     ASSERT(m_handler);
   }
 
-  LibEventTransport transport(server, request, m_id);
+  LibEventTransport transport(server, request, m_id, job->loop);
   bool error = true;
   std::string errorMsg;
   try {
@@ -151,7 +232,8 @@ LibEventServer::LibEventServer(const std::string &address, int port,
     m_accept_sock_ssl(-1),
     m_timeoutThreadData(thread, timeoutSeconds),
     m_timeoutThread(&m_timeoutThreadData, &TimeoutThread::run),
-    m_dispatcher(thread, this),
+    m_eventLoops(1),
+    m_dispatcher(thread, this, RuntimeOption::ServerWorkStealing),
     m_dispatcherThread(this, &LibEventServer::dispatch) {
   m_eventBase = event_base_new();
   m_server = evhttp_new(m_eventBase);
@@ -174,12 +256,36 @@ LibEventServer::~LibEventServer() {
   }
 }
 
+void LibEventServer::setEventLoops(int count) {
+  ASSERT(getStatus() == NOT_YET_STARTED);
+  m_eventLoops = count > 1 ? count : 1;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // implementing HttpServer
 
+int LibEventServer::bindAcceptSocket() {
+  if (m_eventLoops <= 1) {
+    return evhttp_bind_socket_with_fd(m_server, m_address.c_str(), m_port);
+  }
+  // Binding once without SO_REUSEPORT first, so we still fail on a port
+  // that another server is listening on, even if it's using SO_REUSEPORT
+  // for its own event loops.
+  int ret = bind_socket(m_address, m_port, false);
+  if (ret < 0) return -1;
+  close(ret);
+  ret = bind_socket(m_address, m_port, true);
+  if (ret >= 0 && evhttp_accept_socket(m_server, ret) < 0) {
+    int errno_save = errno;
+    close(ret);
+    errno = errno_save;
+    ret = -1;
+  }
+  return ret;
+}
+
 int LibEventServer::getAcceptSocket() {
-  int ret;
-  ret = evhttp_bind_socket_with_fd(m_server, m_address.c_str(), m_port);
+  int ret = bindAcceptSocket();
   if (ret < 0) {
     Logger::Error("Fail to bind port %d", m_port);
     return -1;
@@ -206,12 +312,52 @@ void LibEventServer::start() {
     Logger::Info("Listen on ssl port %d",m_port_ssl);
   }
 
+  startLoops();
+
   setStatus(RUNNING);
   m_dispatcher.start();
   m_dispatcherThread.start();
+  for (unsigned int i = 0; i < m_loops.size(); i++) {
+    m_loops[i]->start();
+  }
   m_timeoutThread.start();
 }
 
+void LibEventServer::startLoops() {
+  for (int i = 1; i < m_eventLoops; i++) {
+    LibEventLoopPtr loop(new LibEventLoop(this, i));
+    m_loops.push_back(loop);
+    if (!loop->listen(m_address, m_port, m_accept_sock,
+                      takeOverLoopSocket(i))) {
+      Logger::Error("Fail to listen on port %d for event loop %d", m_port, i);
+      throw FailedToListenException(m_address, m_port);
+    }
+  }
+}
+
+void LibEventServer::stopLoops() {
+  for (unsigned int i = 0; i < m_loops.size(); i++) {
+    m_loops[i]->stop();
+  }
+}
+
+int LibEventServer::getLoopAcceptSocket(int loop) {
+  if (loop < 1 || loop > (int)m_loops.size()) return -1;
+  return m_loops[loop - 1]->getAcceptSocket();
+}
+
+void LibEventServer::stopLoopsAccepting() {
+  for (unsigned int i = 0; i < m_loops.size(); i++) {
+    m_loops[i]->stopAccepting();
+  }
+}
+
+void LibEventServer::closeLoopAcceptSockets() {
+  for (unsigned int i = 0; i < m_loops.size(); i++) {
+    m_loops[i]->closeAcceptSocket();
+  }
+}
+
 void LibEventServer::waitForEnd() {
   m_dispatcherThread.waitForEnd();
 
@@ -220,18 +366,7 @@ void LibEventServer::waitForEnd() {
 }
 
 void LibEventServer::dispatchWithTimeout(int timeoutSeconds) {
-  struct timeval timeout;
-  timeout.tv_sec = timeoutSeconds;
-  timeout.tv_usec = 0;
-
-  event eventTimeout;
-  event_set(&eventTimeout, -1, 0, on_timer, m_eventBase);
-  event_base_set(m_eventBase, &eventTimeout);
-  event_add(&eventTimeout, &timeout);
-
-  event_base_loop(m_eventBase, EVLOOP_ONCE);
-
-  event_del(&eventTimeout);
+  dispatch_with_timeout(m_eventBase, timeoutSeconds);
 }
 
 void LibEventServer::dispatch() {
@@ -275,6 +410,7 @@ void LibEventServer::stop() {
     // an error occured but we're in shutdown already, so ignore
   }
   m_dispatcherThread.waitForEnd();
+  stopLoops();
   evhttp_free(m_server);
   m_server = NULL;
 }
@@ -327,7 +463,7 @@ void LibEventServer::onThreadEnter() {
     (&ThreadInfo::s_threadInfo->m_reqInjectionData);
 }
 
-void LibEventServer::onRequest(struct evhttp_request *request) {
+void LibEventServer::onRequest(struct evhttp_request *request, int loop) {
   if (RuntimeOption::EnableKeepAlive &&
       RuntimeOption::ConnectionTimeoutSeconds > 0) {
     // before processing request, set the connection timeout
@@ -336,14 +472,22 @@ void LibEventServer::onRequest(struct evhttp_request *request) {
                                   RuntimeOption::ConnectionTimeoutSeconds);
   }
   if (getStatus() == RUNNING) {
-    m_dispatcher.enqueue(LibEventJobPtr(new LibEventJob(request)));
+    LibEventJobPtr job(new LibEventJob(request, loop));
+    if (m_eventLoops > 1 && m_threadCount >= m_eventLoops) {
+      // each loop's share of the worker threads
+      int first = loop * m_threadCount / m_eventLoops;
+      int last = (loop + 1) * m_threadCount / m_eventLoops;
+      m_dispatcher.enqueue(job, first, last - first);
+    } else {
+      m_dispatcher.enqueue(job);
+    }
   } else {
     Logger::Error("throwing away one new request while shutting down");
   }
 }
 
 void LibEventServer::onResponse(int worker, evhttp_request *request,
-                                int code) {
+                                int code, int loop) {
   int nwritten = 0;
   bool skip_sync = false;
 #ifdef _EVENT_USE_OPENSSL
@@ -354,18 +498,139 @@ void LibEventServer::onResponse(int worker, evhttp_request *request,
     const char *reason = HttpProtocol::GetReasonString(code);
     nwritten = evhttp_send_reply_sync_begin(request, code, reason, NULL);
   }
-  m_responseQueue.enqueue(worker, request, code, nwritten);
+  getResponseQueue(loop).enqueue(worker, request, code, nwritten);
 }
 
 void LibEventServer::onChunkedResponse(int worker, evhttp_request *request,
                                        int code, evbuffer *chunk,
-                                       bool firstChunk) {
-  m_responseQueue.enqueue(worker, request, code, chunk, firstChunk);
+                                       bool firstChunk, int loop) {
+  getResponseQueue(loop).enqueue(worker, request, code, chunk, firstChunk);
 }
 
 void LibEventServer::onChunkedResponseEnd(int worker,
-                                          evhttp_request *request) {
-  m_responseQueue.enqueue(worker, request);
+                                          evhttp_request *request,
+                                          int loop) {
+  getResponseQueue(loop).enqueue(worker, request);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LibEventLoop
+
+LibEventLoop::LibEventLoop(LibEventServer *server, int index)
+  : m_server(server), m_index(index), m_accept_sock(-1), m_accepting(false),
+    m_thread(this, &LibEventLoop::run) {
+  m_eventBase = event_base_new();
+  m_http = evhttp_new(m_eventBase);
+  evhttp_set_gencb(m_http, on_loop_request, this);
+#ifdef EVHTTP_PORTABLE_READ_LIMITING
+  evhttp_set_read_limit(m_http, RuntimeOption::RequestBodyReadLimit);
+#endif
+  m_responseQueue.create(m_eventBase);
+
+  if (!m_pipeControl.open()) {
+    throw FatalErrorException("unable to create pipe for event loop");
+  }
+  event_set(&m_eventControl, m_pipeControl.getOut(), EV_READ|EV_PERSIST,
+            on_loop_control, this);
+  event_base_set(m_eventBase, &m_eventControl);
+  event_add(&m_eventControl, NULL);
+}
+
+LibEventLoop::~LibEventLoop() {
+  if (m_http) {
+    evhttp_free(m_http);
+  }
+  event_base_free(m_eventBase);
+}
+
+bool LibEventLoop::listen(const std::string &address, int port,
+                          int sharedSock, int takenSock /* = -1 */) {
+  int fd = takenSock;
+  if (fd < 0) {
+    fd = bind_socket(address, port, true);
+  }
+  if (fd < 0) {
+    Logger::Warning("Event loop %d sharing the listening socket: %s",
+                    m_index, Util::safe_strerror(errno).c_str());
+    fd = sharedSock >= 0 ? dup(sharedSock) : -1;
+    if (fd < 0) return false;
+  }
+  if (evhttp_accept_socket(m_http, fd) < 0) {
+    close(fd);
+    return false;
+  }
+  m_accept_sock = fd;
+  m_accepting = true;
+  return true;
+}
+
+void LibEventLoop::start() {
+  m_thread.start();
+}
+
+void LibEventLoop::stop() {
+  // the server is STOPPED by now, so this makes run() return
+  if (write(m_pipeControl.getIn(), "s", 1) < 0) {
+    // an error occured but we're in shutdown already, so ignore
+  }
+  m_thread.waitForEnd();
+  evhttp_free(m_http);
+  m_http = NULL;
+}
+
+void LibEventLoop::stopAccepting() {
+  if (write(m_pipeControl.getIn(), "h", 1) < 0) {
+    Logger::Error("Unable to stop event loop %d from accepting", m_index);
+  }
+}
+
+void LibEventLoop::closeAcceptSocket() {
+  if (write(m_pipeControl.getIn(), "c", 1) < 0) {
+    Logger::Error("Unable to stop event loop %d from accepting", m_index);
+  }
+}
+
+void LibEventLoop::onRequest(evhttp_request *request) {
+  m_server->onRequest(request, m_index);
+}
+
+void LibEventLoop::onControl() {
+  char buf[16];
+  int n = read(m_pipeControl.getOut(), buf, sizeof(buf));
+  for (int i = 0; i < n; i++) {
+    if ((buf[i] == 'h' || buf[i] == 'c') && m_accepting) {
+      if (evhttp_del_accept_socket(m_http, m_accept_sock) < 0) {
+        Logger::Error("Unable to delete accept socket of event loop %d",
+                      m_index);
+      }
+      m_accepting = false;
+    }
+    if (buf[i] == 'c' && m_accept_sock >= 0) {
+      close(m_accept_sock);
+      m_accept_sock = -1;
+    }
+  }
+  event_base_loopbreak(m_eventBase);
+}
+
+void LibEventLoop::run() {
+  while (m_server->getStatus() != Server::STOPPED) {
+    event_base_loop(m_eventBase, EVLOOP_ONCE);
+  }
+
+  event_del(&m_eventControl);
+
+  // flushing all responses
+  if (!m_responseQueue.empty()) {
+    m_responseQueue.process();
+  }
+  m_responseQueue.close();
+
+  // flusing all remaining events
+  if (RuntimeOption::ServerGracefulShutdownWait) {
+    dispatch_with_timeout(m_eventBase,
+                          RuntimeOption::ServerGracefulShutdownWait);
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
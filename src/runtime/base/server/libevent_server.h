@@ -33,10 +33,11 @@ namespace HPHP {
 DECLARE_BOOST_TYPES(LibEventJob);
 class LibEventJob {
 public:
-  LibEventJob(evhttp_request *req);
+  LibEventJob(evhttp_request *req, int loop = 0);
   void stopTimer();
 
   evhttp_request *request;
+  int loop; // which of LibEventServer's event loops to respond on
 
 private:
 #if defined(__APPLE__)
@@ -118,9 +119,74 @@ private:
   void enqueue(int worker, ResponsePtr response);
 };
 
+/**
+ * One of the additional event loops of a LibEventServer with more than one
+ * (see LibEventServer::setEventLoops()). Each has its own event_base, evhttp,
+ * listening socket, response queue and thread.
+ */
+DECLARE_BOOST_TYPES(LibEventLoop);
+class LibEventServer;
+class LibEventLoop {
+public:
+  LibEventLoop(LibEventServer *server, int index);
+  ~LibEventLoop();
+
+  /**
+   * Binds its own listening socket in the same SO_REUSEPORT group as the
+   * server's, so the kernel spreads new connections over all loops. When
+   * that's not possible, e.g. the server's socket was taken over from a
+   * process not using SO_REUSEPORT, it accepts on a dup() of sharedSock.
+   * When takenSock is given, a socket handed over by the server taken over
+   * from, it accepts on that instead.
+   */
+  bool listen(const std::string &address, int port, int sharedSock,
+              int takenSock = -1);
+
+  void start();
+  void stop();
+
+  /**
+   * Stops accepting new connections, but keeps the socket open, so that
+   * connections already queued on it are accepted by the server it's
+   * handed over to. Can be called from any thread.
+   */
+  void stopAccepting();
+
+  /**
+   * Stops accepting and closes the socket. Can be called from any thread.
+   */
+  void closeAcceptSocket();
+
+  int getAcceptSocket() const { return m_accept_sock;}
+
+  PendingResponseQueue &getResponseQueue() { return m_responseQueue;}
+
+  // called by evhttp library and the control pipe
+  void onRequest(evhttp_request *request);
+  void onControl();
+
+private:
+  LibEventServer *m_server;
+  int m_index;
+  int m_accept_sock;
+  bool m_accepting;
+  event_base *m_eventBase;
+  evhttp *m_http;
+
+  // commands from other threads
+  event m_eventControl;
+  CPipe m_pipeControl;
+
+  PendingResponseQueue m_responseQueue;
+  AsyncFunc<LibEventLoop> m_thread;
+
+  void run();
+};
+
 /**
  * Implementing an evhttp based HTTP server with JobQueueDispatcher. This
- * server will have one dispather thread and multiple worker threads.
+ * server will have one dispather thread and multiple worker threads, plus
+ * additional event loop threads when setEventLoops() asks for more than one.
  */
 class LibEventServer : public Server {
 public:
@@ -138,22 +204,37 @@ public:
   virtual int getActiveWorker() {
     return m_dispatcher.getActiveWorker();
   }
+  virtual int getQueuedJobs() {
+    return m_dispatcher.getQueuedJobs();
+  }
 
   void onThreadEnter();
 
+  /**
+   * How many event loops accept connections, parse requests and send
+   * responses. With more than one, each loop has its own SO_REUSEPORT
+   * listening socket and response queue, and prefers its own share of the
+   * worker threads when the dispatcher is work stealing, before idle ones
+   * of the other loops. SSL is only served by the first loop. Has to be
+   * called before start().
+   */
+  void setEventLoops(int count);
+
   /**
    * Request handler called by evhttp library.
    */
-  void onRequest(evhttp_request *request);
+  void onRequest(evhttp_request *request, int loop = 0);
   void onChunkedRead();
 
   /**
    * Called by LibEventTransport when a response is fully prepared.
    */
-  void onResponse(int worker, evhttp_request *request, int code);
+  void onResponse(int worker, evhttp_request *request, int code,
+                  int loop = 0);
   void onChunkedResponse(int worker, evhttp_request *request, int code,
-                         evbuffer *chunk, bool firstChunk);
-  void onChunkedResponseEnd(int worker, evhttp_request *request);
+                         evbuffer *chunk, bool firstChunk, int loop = 0);
+  void onChunkedResponseEnd(int worker, evhttp_request *request,
+                            int loop = 0);
   void onChunkedRequest(evhttp_request *request);
 
   /**
@@ -170,6 +251,36 @@ protected:
   virtual int getAcceptSocket();
   virtual int getAcceptSocketSSL();
 
+  /**
+   * Binds the listening socket, with SO_REUSEPORT when there are more event
+   * loops, and accepts on it. Returns it, or -1 with errno set.
+   */
+  int bindAcceptSocket();
+
+  /**
+   * Creates the additional event loops, each listening on its own socket.
+   */
+  virtual void startLoops();
+
+  /**
+   * A listening socket handed over by the server being taken over from, for
+   * the loop-th event loop, or -1 to bind a new one.
+   */
+  virtual int takeOverLoopSocket(int loop) { return -1;}
+
+  /**
+   * The listening socket of the loop-th event loop (1 for the first one
+   * after ours), or -1 when there is no such loop.
+   */
+  int getLoopAcceptSocket(int loop);
+
+  /**
+   * Stops the additional event loops from accepting new connections, either
+   * keeping their sockets open for handing them over, or closing them.
+   */
+  void stopLoopsAccepting();
+  void closeLoopAcceptSockets();
+
   int m_accept_sock;
   int m_accept_sock_ssl;
   event_base *m_eventBase;
@@ -185,12 +296,21 @@ protected:
   TimeoutThread m_timeoutThreadData;
   AsyncFunc<TimeoutThread> m_timeoutThread;
 
+  int m_eventLoops;
+
 private:
   JobQueueDispatcher<LibEventJobPtr, LibEventWorker> m_dispatcher;
   AsyncFunc<LibEventServer> m_dispatcherThread;
 
   PendingResponseQueue m_responseQueue;
 
+  LibEventLoopPtrVec m_loops; // all but the first one, which is ours
+
+  PendingResponseQueue &getResponseQueue(int loop) {
+    return loop ? m_loops[loop - 1]->getResponseQueue() : m_responseQueue;
+  }
+  void stopLoops();
+
   // dispatcher thread runs this function
   void dispatch();
 
@@ -36,6 +36,13 @@ we send another request to the existing server to make it shut down
 its main port, then we set up our own file descriptor server so
 we can give the socket to the next instance that starts.
 
+With more than one event loop, every loop has its own listening socket
+in the port's SO_REUSEPORT group, with its own queue of connections
+not accepted yet.  Those are handed over one by one in the same way,
+so that no queued connection is dropped: the new server's loops take
+the old ones' sockets by index, and the main event loop accepts on
+any left over when the new server has fewer loops.
+
 It is a little bit of a hack to use libafdt to send the shutdown
 request, but we need to synchronously shut down the admin server,
 so we cannot use the admin server for it.
@@ -50,6 +57,9 @@ so we cannot use the admin server for it.
 #define C_TERM_OK  "\x05"
 #define C_TERM_BAD "\x06"
 #define C_UNKNOWN  "\x07"
+// A third byte holds the index of the event loop.
+#define C_LOOP_FD_REQ "\x08"
+#define C_NO_FD    "\x09"
 
 namespace HPHP {
 
@@ -107,7 +117,27 @@ int LibEventServerWithTakeover::afdtRequest(String request, String* response) {
       // log message is not too harmful.
       Logger::Error("Unable to delete accept socket");
     }
+    // Same for the event loops' sockets, which are handed over next.
+    stopLoopsAccepting();
+    for (unsigned int i = 0; i < m_extra_accept_socks.size(); i++) {
+      if (evhttp_del_accept_socket(m_server, m_extra_accept_socks[i]) < 0) {
+        Logger::Error("Unable to delete extra accept socket");
+      }
+    }
     return m_accept_sock;
+  } else if (request.size() == 3 &&
+             request.substr(0, 2) == P_VERSION C_LOOP_FD_REQ) {
+    int loop = (unsigned char)request.data()[2];
+    Logger::Info("takeover: request is a listen socket request for loop %d",
+                 loop);
+    int fd = -1;
+    if (loop < m_eventLoops) {
+      fd = getLoopAcceptSocket(loop);
+    } else if (loop - m_eventLoops < (int)m_extra_accept_socks.size()) {
+      fd = m_extra_accept_socks[loop - m_eventLoops];
+    }
+    *response = fd < 0 ? P_VERSION C_NO_FD : P_VERSION C_FD_RESP;
+    return fd;
   } else if (request == P_VERSION C_TERM_REQ) {
     Logger::Info("takeover: request is a terminate request");
     // It is a little bit of a hack to use an AFDT request/response
@@ -121,6 +151,11 @@ int LibEventServerWithTakeover::afdtRequest(String request, String* response) {
       return -1;
     }
     m_accept_sock = -1;
+    closeLoopAcceptSockets();
+    for (unsigned int i = 0; i < m_extra_accept_socks.size(); i++) {
+      close(m_extra_accept_socks[i]);
+    }
+    m_extra_accept_socks.clear();
 
     // Close SSL server
     if (m_server_ssl) {
@@ -194,7 +229,7 @@ int LibEventServerWithTakeover::getAcceptSocket() {
     m_accept_sock = -1;
   }
 
-  ret = evhttp_bind_socket_with_fd(m_server, m_address.c_str(), m_port);
+  ret = bindAcceptSocket();
   if (ret >= 0) {
     Logger::Info("takeover: bound directly to port %d", m_port);
     m_accept_sock = ret;
@@ -254,6 +289,56 @@ int LibEventServerWithTakeover::getAcceptSocket() {
   return 0;
 }
 
+int LibEventServerWithTakeover::takeOverLoopSocket(int loop) {
+  if (!m_took_over || loop > 0xff) {
+    return -1;
+  }
+
+  uint8_t fd_request[4] = P_VERSION C_LOOP_FD_REQ;
+  fd_request[2] = loop;
+  uint8_t fd_response[3] = {0,0,0};
+  uint32_t response_len = sizeof(fd_response);
+  int fd = -1;
+  afdt_error_t err = AFDT_ERROR_T_INIT;
+  struct timeval timeout = { 2 , 0 };
+  int ret = afdt_sync_client(
+      m_transfer_fname.c_str(),
+      fd_request,
+      sizeof(fd_request) - 1,
+      fd_response,
+      &response_len,
+      &fd,
+      &timeout,
+      &err);
+  if (ret < 0) {
+    fd_transfer_error_hander(&err, NULL);
+    return -1;
+  }
+  if (fd >= 0) {
+    Logger::Info("takeover: acquired listen socket for event loop %d", loop);
+  }
+  return fd;
+}
+
+void LibEventServerWithTakeover::startLoops() {
+  LibEventServer::startLoops();
+  if (!m_took_over) return;
+
+  // The old server may have had more event loops than we do. Their queued
+  // connections are accepted by our main event loop.
+  for (int loop = m_eventLoops; ; loop++) {
+    int fd = takeOverLoopSocket(loop);
+    if (fd < 0) break;
+    if (evhttp_accept_socket(m_server, fd) < 0) {
+      Logger::Error("evhttp_accept_socket: %s",
+                    Util::safe_strerror(errno).c_str());
+      close(fd);
+      continue;
+    }
+    m_extra_accept_socks.push_back(fd);
+  }
+}
+
 void LibEventServerWithTakeover::start() {
 
   if (m_server_ssl) {
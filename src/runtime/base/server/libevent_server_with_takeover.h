@@ -57,6 +57,8 @@ public:
 protected:
   virtual void start();
   virtual int getAcceptSocket();
+  virtual void startLoops();
+  virtual int takeOverLoopSocket(int loop);
 
   void setupFdServer();
   void notifyTakeoverComplete();
@@ -65,6 +67,9 @@ protected:
   std::string m_transfer_fname;
   std::set<TakeoverListener*> m_takeover_listeners;
   bool m_took_over;
+
+  // sockets taken over for event loops we don't have, accepted on by ours
+  std::vector<int> m_extra_accept_socks;
 };
 
 class TakeoverListener {
@@ -30,9 +30,10 @@ struct m_evkeyvalq {
 
 LibEventTransport::LibEventTransport(LibEventServer *server,
                                      evhttp_request *request,
-                                     int workerId)
+                                     int workerId, int loop)
   : m_server(server), m_request(request), m_eventBasePostData(NULL),
-    m_workerId(workerId), m_sendStarted(false), m_sendEnded(false) {
+    m_workerId(workerId), m_loop(loop),
+    m_sendStarted(false), m_sendEnded(false) {
   // HttpProtocol::PrepareSystemVariables needs this
   evbuffer *buf = m_request->input_buffer;
   ASSERT(buf);
@@ -247,7 +248,7 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
     evbuffer *chunk = evbuffer_new();
     evbuffer_add(chunk, data, size);
     m_server->onChunkedResponse(m_workerId, m_request, code, chunk,
-                               !m_sendStarted);
+                               !m_sendStarted, m_loop);
   } else {
     if (m_method != HEAD) {
       evbuffer_add(m_request->output_buffer, data, size);
@@ -256,7 +257,7 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
       snprintf(buf, sizeof(buf), "%d", size);
       addHeaderImpl("Content-Length", buf);
     }
-    m_server->onResponse(m_workerId, m_request, code);
+    m_server->onResponse(m_workerId, m_request, code, m_loop);
     m_sendEnded = true;
   }
   m_sendStarted = true;
@@ -264,7 +265,7 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
 
 void LibEventTransport::onSendEndImpl() {
   if (m_chunkedEncoding) {
-    m_server->onChunkedResponseEnd(m_workerId, m_request);
+    m_server->onChunkedResponseEnd(m_workerId, m_request, m_loop);
     m_sendEnded = true;
   } else {
     ASSERT(m_sendEnded); // otherwise, we didn't call send for this request
@@ -27,7 +27,7 @@ class LibEventServer;
 class LibEventTransport : public Transport {
 public:
   LibEventTransport(LibEventServer *server, evhttp_request *request,
-                    int workerId);
+                    int workerId, int loop = 0);
 
   /**
    * Implementing Transport...
@@ -56,6 +56,7 @@ private:
   struct event_base *m_eventBasePostData;
   struct event m_moreDataRead;
   int m_workerId;
+  int m_loop;
   std::string m_url;
   std::string m_remote_host;
   std::string m_http_version;
@@ -155,6 +155,11 @@ public:
    */
   virtual int getActiveWorker() = 0;
 
+  /**
+   * How many requests are waiting for a thread.
+   */
+  virtual int getQueuedJobs() { return 0;}
+
   /**
    * This is for TypedServer to specialize a worker class to use.
    */
@@ -241,6 +241,7 @@ void ServerStats::Aggregate(list<TimeSlot*> &slots, const std::string &agg,
   // Hack: These two are not really page specific.
   int load = HttpServer::Server->getPageServer()->getActiveWorker();
   int idle = RuntimeOption::ServerThreadCount - load;
+  int queued = HttpServer::Server->getPageServer()->getQueuedJobs();
 
   for (list<TimeSlot*>::const_iterator iter = slots.begin();
        iter != slots.end(); ++iter) {
@@ -262,6 +263,9 @@ void ServerStats::Aggregate(list<TimeSlot*> &slots, const std::string &agg,
       if (wantedKeys.find("idle") != wantedKeys.end()) {
         values["idle"] = idle;
       }
+      if (wantedKeys.find("queued") != wantedKeys.end()) {
+        values["queued"] = queued;
+      }
 
       for (map<string, int>::const_iterator iter = udfKeys.begin();
            iter != udfKeys.end(); ++iter) {
@@ -807,7 +811,7 @@ void ServerStats::log(const string &name, int64 value) {
 }
 
 int64 ServerStats::get(const std::string &name) {
-  CounterMap::const_iterator iter = m_values.find(name);
+  hphp_string_map<int64>::const_iterator iter = m_values.find(name);
   if (iter != m_values.end()) {
     return iter->second;
   }
@@ -835,11 +839,16 @@ void ServerStats::logPage(const string &url, int code) {
       ts.m_time = now;
       ts.m_pages.clear();
     }
-    PageStats &ps = ts.m_pages[url + lexical_cast<string>(code)];
+    char scode[12];
+    snprintf(scode, sizeof(scode), "%d", code);
+    PageStats &ps = ts.m_pages[url + scode];
     ps.m_url = url;
     ps.m_code = code;
     ps.m_hit++;
-    Merge(ps.m_values, m_values);
+    for (hphp_string_map<int64>::const_iterator iter = m_values.begin();
+         iter != m_values.end(); ++iter) {
+      ps.m_values[intern(iter->first)] += iter->second;
+    }
   }
 
   m_values.clear();
@@ -855,6 +864,19 @@ void ServerStats::logPage(const string &url, int code) {
   m_threadStatus.m_done = time(0);
 }
 
+const SharedString &ServerStats::intern(const string &name) {
+  hphp_string_map<SharedString>::iterator iter = m_names.find(name);
+  if (iter != m_names.end()) {
+    return iter->second;
+  }
+  if (m_names.size() >= MaxInternedNames) {
+    m_names.clear(); // names made up of APC keys, SQL tables and such
+  }
+  SharedString &ss = m_names[name];
+  ss = name;
+  return ss;
+}
+
 void ServerStats::clear() {
   Lock lock(m_lock, false);
   for (unsigned int i = 0; i < m_slots.size(); i++) {
@@ -114,7 +114,18 @@ private:
   int64 m_last; // previous timepoint
   int64 m_min;  // earliest timepoint
   int64 m_max;  // latest timepoint
-  CounterMap m_values;  // current page's name value pairs
+
+  /**
+   * Current page's name value pairs. Only this thread touches them, so
+   * they're keyed by plain strings; names are only interned into
+   * SharedStrings once per page, when merged into m_slots, through a
+   * thread-local cache so the process-wide intern table is rarely hit.
+   */
+  hphp_string_map<int64> m_values;
+  hphp_string_map<SharedString> m_names;
+  static const unsigned int MaxInternedNames = 65536;
+
+  const SharedString &intern(const std::string &name);
 
   void log(const std::string &name, int64 value);
   int64 get(const std::string &name);
@@ -0,0 +1,315 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/shared/flat_array.h>
+#include <runtime/base/shared/shared_map.h>
+#include <runtime/base/shared/shared_store_snapshot.h>
+#include <runtime/base/complex_types.h>
+#include <runtime/base/array/array_init.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+// encoding
+
+static void align(std::string &out) {
+  size_t pad = (8 - (out.size() & 7)) & 7;
+  if (pad) out.append(pad, '\0');
+}
+
+FlatArray *FlatArray::Create(ArrayData *arr) {
+  string out;
+  if (!Encode(out, arr)) return NULL;
+  FlatArray *flat = (FlatArray *)malloc(out.size());
+  memcpy(flat, out.data(), out.size());
+  return flat;
+}
+
+int32 FlatArray::AppendStr(std::string &out, size_t node, CStrRef s) {
+  align(out);
+  int32 offset = out.size() - node;
+  int32 len = s.size();
+  out.append((const char *)&len, sizeof(len));
+  out.append(s.data(), len);
+  out += '\0';
+  return offset;
+}
+
+bool FlatArray::Encode(std::string &out, ArrayData *arr) {
+  align(out);
+  size_t node = out.size();
+
+  FlatArray header;
+  header.m_size = arr->size();
+  header.m_capacity = arr->isVectorData() ? 0 : header.m_size;
+  header.m_unused = 0;
+  out.append(sizeof(FlatArray) + sizeof(Entry) * header.m_size +
+             sizeof(int32) * header.m_capacity, '\0');
+
+  vector<int32> heads(header.m_capacity, -1);
+  int32 i = 0;
+  for (ArrayIter it(arr); !it.end(); it.next(), i++) {
+    Entry e;
+    memset(&e, 0, sizeof(e));
+    e.next = -1;
+
+    if (header.m_capacity) {
+      Variant key = it.first();
+      if (key.isString()) {
+        String s = key.toString();
+        e.keyStr = AppendStr(out, node, s);
+        e.key = hash_string(s.data(), s.size());
+      } else {
+        e.key = key.toInt64();
+      }
+      size_t hash_pos = (size_t)e.key % header.m_capacity;
+      e.next = heads[hash_pos];
+      heads[hash_pos] = i;
+    } else {
+      e.key = i;
+    }
+
+    Variant val = it.second();
+    switch (val.getType()) {
+    case KindOfNull:
+      e.type = TypeNull;
+      break;
+    case KindOfBoolean:
+      e.type = TypeBoolean;
+      e.val = val.toBoolean();
+      break;
+    case KindOfByte:
+    case KindOfInt16:
+    case KindOfInt32:
+    case KindOfInt64:
+      e.type = TypeInt64;
+      e.val = val.toInt64();
+      break;
+    case KindOfDouble:
+      {
+        e.type = TypeDouble;
+        double d = val.toDouble();
+        memcpy(&e.val, &d, sizeof(d));
+        break;
+      }
+    case LiteralString:
+    case KindOfStaticString:
+    case KindOfString:
+      e.type = TypeString;
+      e.val = AppendStr(out, node, val.toString());
+      break;
+    case KindOfArray:
+      e.type = TypeArray;
+      align(out);
+      e.val = out.size() - node;
+      if (!Encode(out, val.getArrayData())) return false;
+      break;
+    default:
+      // objects have to be serialized, and unserialized on every fetch
+      return false;
+    }
+    memcpy(&out[node + sizeof(FlatArray) + sizeof(Entry) * i], &e,
+           sizeof(e));
+  }
+  ASSERT(i == header.m_size);
+
+  header.m_bytes = out.size() - node;
+  memcpy(&out[node], &header, sizeof(header));
+  if (header.m_capacity) {
+    memcpy(&out[node + sizeof(FlatArray) + sizeof(Entry) * header.m_size],
+           &heads[0], sizeof(int32) * header.m_capacity);
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reading
+
+Variant FlatArray::getKey(ssize_t pos, SharedVariant *owner) const {
+  ASSERT(pos >= 0 && pos < m_size);
+  const Entry &e = entries()[pos];
+  if (e.keyStr) {
+    const Str *s = str(e.keyStr);
+    return NEW(StringData)(owner, s->data, s->len);
+  }
+  return e.key;
+}
+
+Variant FlatArray::getValue(ssize_t pos, SharedVariant *owner) const {
+  ASSERT(pos >= 0 && pos < m_size);
+  return DecodeValue(this, entries()[pos], owner);
+}
+
+Variant FlatArray::DecodeValue(const FlatArray *node, const Entry &e,
+                               SharedVariant *owner) {
+  switch (e.type) {
+  case TypeBoolean:
+    return (bool)e.val;
+  case TypeInt64:
+    return e.val;
+  case TypeDouble:
+    {
+      double d;
+      memcpy(&d, &e.val, sizeof(d));
+      return d;
+    }
+  case TypeString:
+    {
+      const Str *s = node->str(e.val);
+      return NEW(StringData)(owner, s->data, s->len);
+    }
+  case TypeArray:
+    return NEW(SharedMap)(owner, node->node(e.val));
+  default:
+    ASSERT(e.type == TypeNull);
+    break;
+  }
+  return null;
+}
+
+int FlatArray::indexOf(int64 key) const {
+  if (isVector()) {
+    if (key < 0 || key >= m_size) return -1;
+    return key;
+  }
+  const Entry *elems = entries();
+  for (int i = hash()[(size_t)key % m_capacity]; i != -1;
+       i = elems[i].next) {
+    if (!elems[i].keyStr && elems[i].key == key) return i;
+  }
+  return -1;
+}
+
+int FlatArray::indexOf(const char *key, int len, int64 hash) const {
+  if (isVector()) return -1;
+  const Entry *elems = entries();
+  for (int i = this->hash()[(size_t)hash % m_capacity]; i != -1;
+       i = elems[i].next) {
+    const Entry &e = elems[i];
+    if (e.keyStr && e.key == hash) {
+      const Str *s = str(e.keyStr);
+      if (s->len == len && memcmp(s->data, key, len) == 0) return i;
+    }
+  }
+  return -1;
+}
+
+int FlatArray::indexOf(CVarRef key) const {
+  switch (key.getType()) {
+  case KindOfByte:
+  case KindOfInt16:
+  case KindOfInt32:
+  case KindOfInt64:
+    return indexOf(key.getNumData());
+  case KindOfStaticString:
+  case KindOfString:
+    {
+      StringData *sd = key.getStringData();
+      return indexOf(sd->data(), sd->size(), sd->hash());
+    }
+  case LiteralString:
+    {
+      const char *s = key.getLiteralString();
+      int len = strlen(s);
+      return indexOf(s, len, hash_string(s, len));
+    }
+  default:
+    // No other types are legitimate keys
+    break;
+  }
+  return -1;
+}
+
+void FlatArray::loadElems(ArrayData *&elems, const SharedMap &sharedMap,
+                          bool keepRef /* = false */) const {
+  ArrayInit ai(m_size, isVector(), keepRef);
+  for (int i = 0; i < m_size; i++) {
+    if (isVector()) {
+      ai.set(i, (int64)i, sharedMap.getValue(i), -1, true);
+    } else {
+      ai.set(i, sharedMap.getKey(i), sharedMap.getValue(i), -1, true);
+    }
+  }
+  elems = ai.create();
+  if (elems->isStatic()) elems = elems->copy();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// snapshots
+
+void FlatArray::toImage(std::string &out) const {
+  const Entry *elems = entries();
+  if (isVector()) {
+    out += (char)SharedStoreSnapshot::TagVector;
+    SharedStoreSnapshot::AppendInt32(out, m_size);
+  } else {
+    out += (char)SharedStoreSnapshot::TagMap;
+    SharedStoreSnapshot::AppendInt32(out, m_size);
+  }
+  for (int i = 0; i < m_size; i++) {
+    const Entry &e = elems[i];
+    if (!isVector()) {
+      if (e.keyStr) {
+        const Str *s = str(e.keyStr);
+        out += (char)SharedStoreSnapshot::TagString;
+        SharedStoreSnapshot::AppendString(out, s->data, s->len);
+      } else {
+        out += (char)SharedStoreSnapshot::TagInt64;
+        SharedStoreSnapshot::AppendInt64(out, e.key);
+      }
+    }
+    ValueImage(this, e, out);
+  }
+}
+
+void FlatArray::ValueImage(const FlatArray *node, const Entry &e,
+                           std::string &out) {
+  switch (e.type) {
+  case TypeBoolean:
+    out += (char)SharedStoreSnapshot::TagBoolean;
+    out += (char)(e.val != 0);
+    break;
+  case TypeInt64:
+    out += (char)SharedStoreSnapshot::TagInt64;
+    SharedStoreSnapshot::AppendInt64(out, e.val);
+    break;
+  case TypeDouble:
+    out += (char)SharedStoreSnapshot::TagDouble;
+    out.append((const char *)&e.val, sizeof(e.val));
+    break;
+  case TypeString:
+    {
+      const Str *s = node->str(e.val);
+      out += (char)SharedStoreSnapshot::TagString;
+      SharedStoreSnapshot::AppendString(out, s->data, s->len);
+      break;
+    }
+  case TypeArray:
+    node->node(e.val)->toImage(out);
+    break;
+  default:
+    // there is no tag for null, so it goes the way ThreadSharedVariant
+    // stores it: serialized
+    ASSERT(e.type == TypeNull);
+    out += (char)SharedStoreSnapshot::TagSerialized;
+    SharedStoreSnapshot::AppendString(out, "N;", 2);
+    break;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,124 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_FLAT_ARRAY_H__
+#define __HPHP_FLAT_ARRAY_H__
+
+#include <runtime/base/types.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+class SharedVariant;
+class SharedMap;
+
+/**
+ * A whole APC array, nested arrays included, encoded in one malloc-ed buffer
+ * instead of one ThreadSharedVariant per element. Each (sub-)array is a node
+ *
+ *   int32 size, int32 hash capacity (0 for vectors), int32 total bytes
+ *   Entry[size]         elements in insertion order
+ *   int32[capacity]     heads of hash chains, maps only
+ *
+ * followed by the strings and nested nodes it refers to. All references are
+ * byte offsets from the node that holds them, so the buffer can be moved or
+ * copied as is. Only null, booleans, numbers, strings and arrays of them can
+ * be encoded; Create() returns NULL for anything else.
+ *
+ * The buffer has no reference count of its own: the ThreadSharedVariant
+ * owning it has one, and SharedMaps of nested nodes hold that.
+ */
+class FlatArray {
+public:
+  static FlatArray *Create(ArrayData *arr);
+  static void Destroy(FlatArray *flat) { free(flat);}
+
+  int size() const { return m_size;}
+  bool isVector() const { return m_capacity == 0;}
+  int bytes() const { return m_bytes;}
+
+  /**
+   * Nothing is copied out of the buffer: strings and nested arrays come
+   * back as StringDatas and SharedMaps holding a reference on owner.
+   */
+  Variant getKey(ssize_t pos, SharedVariant *owner) const;
+  Variant getValue(ssize_t pos, SharedVariant *owner) const;
+
+  int indexOf(CVarRef key) const;
+
+  void loadElems(ArrayData *&elems, const SharedMap &sharedMap,
+                 bool keepRef = false) const;
+
+  /**
+   * Same encoding as SharedVariant::toImage().
+   */
+  void toImage(std::string &out) const;
+
+private:
+  enum ValueType {
+    TypeNull,
+    TypeBoolean,
+    TypeInt64,
+    TypeDouble,
+    TypeString,
+    TypeArray,
+  };
+
+  class Entry {
+  public:
+    int64 key;     // integer key, or hash of the string key
+    int64 val;     // value, or offset of its string or node
+    int32 keyStr;  // offset of the string key, 0 for integer keys
+    int32 next;    // next entry in the same hash chain, or -1
+    int32 type;
+    int32 unused;
+  };
+
+  class Str {
+  public:
+    int32 len;
+    char data[1];
+  };
+
+  int32 m_size;
+  int32 m_capacity;
+  int32 m_bytes;
+  int32 m_unused;
+
+  const Entry *entries() const { return (const Entry *)(this + 1);}
+  const int32 *hash() const { return (const int32 *)(entries() + m_size);}
+  const Str *str(int32 offset) const {
+    return (const Str *)((const char *)this + offset);
+  }
+  const FlatArray *node(int64 offset) const {
+    return (const FlatArray *)((const char *)this + offset);
+  }
+
+  int indexOf(int64 key) const;
+  int indexOf(const char *key, int len, int64 hash) const;
+
+  static bool Encode(std::string &out, ArrayData *arr);
+  static int32 AppendStr(std::string &out, size_t node, CStrRef s);
+  static Variant DecodeValue(const FlatArray *node, const Entry &e,
+                             SharedVariant *owner);
+  static void ValueImage(const FlatArray *node, const Entry &e,
+                         std::string &out);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_FLAT_ARRAY_H__
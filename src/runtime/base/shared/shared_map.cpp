@@ -25,25 +25,46 @@ IMPLEMENT_SMART_ALLOCATION(SharedMap, SmartAllocatorImpl::NeedRestore);
 ///////////////////////////////////////////////////////////////////////////////
 
 SharedMap::SharedMap(SharedVariant* source)
-  : m_arr(source) {
+  : m_arr(source), m_flat(source->getFlatArray()) {
+  source->incRef();
+}
+
+SharedMap::SharedMap(SharedVariant* source, const FlatArray *flat)
+  : m_arr(source), m_flat(flat) {
   source->incRef();
 }
 
 
 bool SharedMap::exists(CVarRef k, int64 prehash /* = -1*/) const {
+  if (m_flat) return m_flat->indexOf(k) != -1;
   return m_arr->exists(k);
 }
 
 Variant SharedMap::get(CVarRef k, int64 prehash /* = -1 */,
                        bool error /* = false */) const {
-  SharedVariant *sv = m_arr->get(k);
-  if (sv) return getLocal(sv);
+  if (m_flat) {
+    int idx = m_flat->indexOf(k);
+    if (idx != -1) return m_flat->getValue(idx, m_arr);
+  } else {
+    SharedVariant *sv = m_arr->get(k);
+    if (sv) return getLocal(sv);
+  }
   if (error) {
     raise_notice("Undefined index: %s", k.toString().data());
   }
   return null;
 }
 
+void SharedMap::load(CVarRef k, Variant &v) const {
+  if (m_flat) {
+    int idx = m_flat->indexOf(k);
+    if (idx != -1) v = m_flat->getValue(idx, m_arr);
+    return;
+  }
+  SharedVariant *sv = m_arr->get(k);
+  if (sv) v = getLocal(sv);
+}
+
 ArrayData *SharedMap::lval(Variant *&ret, bool copy) {
   ArrayData *escalated = escalate();
   ArrayData *ee = escalated->lval(ret, false);
@@ -208,7 +229,11 @@ ArrayData *SharedMap::prepend(CVarRef v, bool copy) {
 
 ArrayData *SharedMap::escalate(bool mutableIteration /* = false */) const {
   ArrayData *ret = NULL;
-  m_arr->loadElems(ret, *this, mutableIteration);
+  if (m_flat) {
+    m_flat->loadElems(ret, *this, mutableIteration);
+  } else {
+    m_arr->loadElems(ret, *this, mutableIteration);
+  }
   ASSERT(!ret->isStatic());
   return ret;
 }
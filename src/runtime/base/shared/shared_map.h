@@ -19,6 +19,7 @@
 
 #include <util/shared_memory_allocator.h>
 #include <runtime/base/shared/shared_variant.h>
+#include <runtime/base/shared/flat_array.h>
 #include <runtime/base/array/array_data.h>
 #include <runtime/base/complex_types.h>
 #include <runtime/base/builtin_functions.h>
@@ -27,31 +28,46 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
- * Wrapper for a shared memory map.
+ * Wrapper for a shared memory map. When the SharedVariant keeps its array as
+ * a FlatArray, elements are read right out of it (m_flat, which may be a
+ * nested array of the one m_arr holds).
  */
 class SharedMap : public ArrayData {
 public:
   SharedMap(SharedVariant* source);
+  SharedMap(SharedVariant* source, const FlatArray *flat);
 
   ~SharedMap() {
     m_arr->decRef();
   }
 
-  virtual SharedVariant *getSharedVariant() const { return m_arr; }
+  virtual SharedVariant *getSharedVariant() const {
+    // a nested flat array is not a SharedVariant of its own
+    if (m_flat && m_flat != m_arr->getFlatArray()) return NULL;
+    return m_arr;
+  }
 
   ssize_t size() const {
+    if (m_flat) return m_flat->size();
     return m_arr->arrSize();
   }
 
   Variant getKey(ssize_t pos) const {
+    if (m_flat) return m_flat->getKey(pos, m_arr);
     return m_arr->getKey(pos);
   }
 
   Variant getValue(ssize_t pos) const {
+    if (m_flat) return m_flat->getValue(pos, m_arr);
     SharedVariant* v = m_arr->getValue(pos);
     return v ? getLocal(v) : null;
   }
 
+  virtual bool isVectorData() const {
+    if (m_flat) return m_flat->isVector();
+    return m_arr->isVectorData();
+  }
+
   bool exists(int64 k, int64 prehash = -1) const {
     return exists(Variant(k), prehash);
   }
@@ -78,6 +94,8 @@ public:
   }
   Variant get(CVarRef k, int64 prehash = -1, bool error = false) const;
 
+  virtual void load(CVarRef k, Variant &v) const;
+
   ssize_t getIndex(int64 k, int64 prehash = -1) const {
     return getIndex(Variant(k), prehash);
   }
@@ -88,6 +106,7 @@ public:
     return getIndex(Variant(k), prehash);
   }
   ssize_t getIndex(CVarRef k, int64 prehash = -1) const {
+    if (m_flat) return m_flat->indexOf(k);
     return m_arr->getIndex(k);
   }
 
@@ -137,6 +156,7 @@ public:
 
 private:
   SharedVariant *m_arr;
+  const FlatArray *m_flat;
   mutable Array m_localCache;
 
   Variant getLocal(SharedVariant *sv) const {
@@ -23,9 +23,13 @@
 #include <runtime/base/memory/leak_detectable.h>
 #include <runtime/base/server/server_stats.h>
 #include <util/lfu_table.h>
+#include <util/atomic.h>
+#include <util/thread_local.h>
 #include <tbb/concurrent_hash_map.h>
 #include <queue>
+#include <sched.h>
 #include <runtime/base/shared/shared_store_stats.h>
+#include <runtime/base/shared/shared_store_snapshot.h>
 
 using namespace std;
 using namespace boost;
@@ -40,12 +44,12 @@ size_t SharedStore::s_lockCount = 10000;
 class LockedSharedStore : public SharedStore {
 public:
   LockedSharedStore(int i) : SharedStore(i) {}
-  virtual void clear();
-  virtual bool get(CStrRef key, Variant &value);
-  virtual bool store(CStrRef key, CVarRef val, int64 ttl,
-                     bool overwrite = true);
-  virtual int64 inc(CStrRef key, int64 step, bool &found);
-  virtual bool cas(CStrRef key, int64 old, int64 val);
+  virtual void clearImpl();
+  virtual bool getImpl(CStrRef key, Variant &value);
+  virtual bool storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                         bool overwrite = true);
+  virtual int64 incImpl(CStrRef key, int64 step, bool &found);
+  virtual bool casImpl(CStrRef key, int64 old, int64 val);
   virtual void prime(const std::vector<KeyValuePair> &vars);
 protected:
   virtual bool find(CStrRef key, StoreValue *&v, bool &expired) = 0;
@@ -56,7 +60,7 @@ protected:
   virtual void readLockMap() = 0;
   virtual void unlockMap() = 0;
   virtual void readUnlockMap() = 0;
-  virtual void clearImpl() = 0;
+  virtual void clearLockedImpl() = 0;
 
 };
 
@@ -141,7 +145,7 @@ public:
     return (SharedVariant*)((size_t)v + (size_t)this);
   }
 
-  virtual void clearImpl() {
+  virtual void clearLockedImpl() {
     for (SharedMap::const_iterator iter = m_vars->begin();
          iter != m_vars->end(); ++iter) {
       ASSERT(getVar(iter->second.var));
@@ -318,7 +322,7 @@ public:
   }
 
 
-  virtual void clearImpl() {
+  virtual void clearLockedImpl() {
     std::vector<StringData*> keys;
     keys.reserve(m_vars.size());
     for (StringMap::iterator iter = m_vars.begin();
@@ -371,6 +375,15 @@ public:
     }
     unlockMap();
   }
+  virtual void walk(Visitor &visitor) {
+    readLockMap();
+    for (StringMap::const_iterator iter = m_vars.begin();
+         iter != m_vars.end(); ++iter) {
+      visitor.visit(iter->first->data(), iter->first->size(),
+                    iter->second.var, iter->second.expiry);
+    }
+    readUnlockMap();
+  }
   virtual void lockMap() {
     m_mlock.acquireWrite();
   }
@@ -486,7 +499,7 @@ public:
     SetUpdater updater(v, ttl);
     m_vars.atomicUpdate(key.get()->copy(true), updater, true, immortal);
   }
-  virtual void clear() {
+  virtual void clearImpl() {
     m_vars.clear();
   }
   virtual bool eraseImpl(CStrRef key, bool expired) {
@@ -540,12 +553,25 @@ public:
     CountBody body(reachable, expired, persistent);
     m_vars.atomicForeach(body);
   }
+  virtual void walk(Visitor &visitor) {
+    class WalkBody : public Map::AtomicReader {
+    public:
+      WalkBody(Visitor &v) : visitor(v) {}
+      void read(StringData* const &k, const StoreValue &val) {
+        visitor.visit(k->data(), k->size(), val.var, val.expiry);
+      }
+    private:
+      Visitor &visitor;
+    };
+    WalkBody body(visitor);
+    m_vars.atomicForeach(body);
+  }
 
-  virtual bool get(CStrRef key, Variant &value);
-  virtual bool store(CStrRef key, CVarRef val, int64 ttl,
-                     bool overwrite = true);
-  virtual int64 inc(CStrRef key, int64 step, bool &found);
-  virtual bool cas(CStrRef key, int64 old, int64 val);
+  virtual bool getImpl(CStrRef key, Variant &value);
+  virtual bool storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                         bool overwrite = true);
+  virtual int64 incImpl(CStrRef key, int64 step, bool &found);
+  virtual bool casImpl(CStrRef key, int64 old, int64 val);
   virtual bool check() {
     return m_vars.check();
   }
@@ -627,11 +653,19 @@ public:
       }
     }
   }
-  virtual bool get(CStrRef key, Variant &value);
-  virtual bool store(CStrRef key, CVarRef val, int64 ttl,
-                     bool overwrite = true);
-  virtual int64 inc(CStrRef key, int64 step, bool &found);
-  virtual bool cas(CStrRef key, int64 old, int64 val);
+  virtual void walk(Visitor &visitor) {
+    WriteLock l(m_lock);
+    for (Map::const_iterator iter = m_vars.begin();
+         iter != m_vars.end(); ++iter) {
+      visitor.visit(iter->first, strlen(iter->first), iter->second.var,
+                    iter->second.expiry);
+    }
+  }
+  virtual bool getImpl(CStrRef key, Variant &value);
+  virtual bool storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                         bool overwrite = true);
+  virtual int64 incImpl(CStrRef key, int64 step, bool &found);
+  virtual bool casImpl(CStrRef key, int64 old, int64 val);
   virtual void prime(const std::vector<SharedStore::KeyValuePair> &vars);
   virtual SharedVariant* construct(litstr str, int len, CStrRef v,
                                    bool serialized) {
@@ -659,7 +693,7 @@ protected:
   typedef tbb::concurrent_hash_map<const char*, StoreValue, charHashCompare>
     Map;
 
-  virtual void clear() {
+  virtual void clearImpl() {
     WriteLock l(m_lock);
     if (RuntimeOption::EnableAPCSizeStats) {
       SharedStoreStats::onClear();
@@ -775,13 +809,669 @@ protected:
 
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// StripedTableSharedStore
+
+/**
+ * Keys are spread over a power-of-two number of stripes, each with its own
+ * chained hash table and mutex. Writers (store/inc/cas/erase) only lock the
+ * stripe the key hashes to. Readers take no lock at all: nodes are published
+ * with a single pointer store, and nothing a reader can reach is freed until
+ * every reader that might have seen it is gone.
+ *
+ * That last part is a small two-counter RCU: a reader bumps one of two
+ * counters, picked by the parity of m_epoch, in a per-thread reader slot.
+ * Replaced values, unlinked nodes and old bucket tables are retired instead
+ * of freed, and once enough of them pile up, the writer that notices flips
+ * the epoch twice, waits for the counters of the previous parity to drain
+ * each time, then releases everything it took off the retired lists.
+ */
+class StripedTableSharedStore : public SharedStore,
+                                private ThreadSharedVariantFactory {
+public:
+  StripedTableSharedStore(int id);
+  ~StripedTableSharedStore();
+
+  virtual void clearImpl();
+  virtual int size();
+  virtual void count(int &reachable, int &expired, int &persistent);
+  virtual void walk(Visitor &visitor);
+
+  virtual bool getImpl(CStrRef key, Variant &value);
+  virtual bool storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                         bool overwrite = true);
+  virtual int64 incImpl(CStrRef key, int64 step, bool &found);
+  virtual bool casImpl(CStrRef key, int64 old, int64 val);
+  virtual void prime(const std::vector<SharedStore::KeyValuePair> &vars);
+
+  virtual SharedVariant* construct(litstr str, int len, CStrRef v,
+                                   bool serialized) {
+    return create(str, len, v, serialized);
+  }
+  virtual SharedVariant* construct(litstr str, int len, CVarRef v) {
+    return create(str, len, v);
+  }
+protected:
+  virtual bool eraseImpl(CStrRef key, bool expired);
+  virtual SharedVariant* construct(CStrRef key, CVarRef v) {
+    return create(key, v);
+  }
+
+private:
+  static const int ReaderSlotCount = 64;
+  static const int InitialBucketCount = 16;
+  static const size_t ReclaimBatchSize = 256;
+
+  class Node {
+  public:
+    Node(StringData *k, int64 h, SharedVariant *v, int64 e)
+      : next(NULL), key(k), hash(h), var(v), expiry(e) {}
+
+    Node * volatile next;
+    StringData *key;
+    int64 hash;
+    SharedVariant * volatile var;
+    volatile int64 expiry;
+
+    bool expired() const { return expiry && time(NULL) >= expiry; }
+    bool match(int64 h, const char *k, int len) const {
+      return hash == h && key->size() == len && !memcmp(key->data(), k, len);
+    }
+  };
+
+  /**
+   * Bucket array and its mask live in one block, so a reader can never pair
+   * a new mask with an old array.
+   */
+  class Table {
+  public:
+    static Table *Create(uint nBuckets);
+    static void Destroy(Table *t) { free(t); }
+
+    uint mask;
+    Node * volatile buckets[1];
+  };
+
+  class Stripe {
+  public:
+    Stripe() : table(Table::Create(InitialBucketCount)), size(0) {}
+
+    Mutex mutex;
+    Table * volatile table;
+    int size;
+  };
+
+  class ReaderSlot {
+  public:
+    ReaderSlot() { active[0] = active[1] = 0; }
+    int active[2];
+    char padding[64 - 2 * sizeof(int)]; // one cache line per slot
+  };
+
+  /**
+   * Marks a lock-free read section for the lifetime of the object.
+   */
+  class ReadSection {
+  public:
+    ReadSection(StripedTableSharedStore *store)
+      : m_slot(store->m_readers[ReaderSlotIndex()]),
+        m_parity(store->m_epoch & 1) {
+      atomic_inc(m_slot.active[m_parity]);
+    }
+    ~ReadSection() {
+      atomic_dec(m_slot.active[m_parity]);
+    }
+  private:
+    ReaderSlot &m_slot;
+    int m_parity;
+  };
+
+  int m_stripeBits;
+  int m_stripeMask;
+  Stripe *m_stripes;
+  ReaderSlot m_readers[ReaderSlotCount];
+  volatile int m_epoch;
+  Mutex m_epochMutex;
+
+  Mutex m_retiredMutex;
+  std::vector<SharedVariant*> m_retiredVars;
+  std::vector<StringData*> m_retiredKeys;
+  std::vector<Node*> m_retiredNodes;
+  std::vector<Table*> m_retiredTables;
+
+  static int ReaderSlotIndex();
+
+  Stripe &getStripe(int64 h) { return m_stripes[h & m_stripeMask]; }
+  uint bucketOf(const Table *t, int64 h) const {
+    return (h >> m_stripeBits) & t->mask;
+  }
+
+  Node *find(const Stripe &s, int64 h, CStrRef key) const;
+  Node *find(const Stripe &s, int64 h, const char *key, int len) const;
+  void insertLocked(Stripe &s, Node *node);
+  void growLocked(Stripe &s);
+  bool eraseLocked(Stripe &s, Node *node);
+  void replaceLocked(Node *node, SharedVariant *var);
+
+  void retire(SharedVariant *var);
+  void retire(Node *node, bool withKey);
+  void retire(Table *t);
+  void reclaim(bool force = false);
+  void synchronize();
+};
+
+static IMPLEMENT_THREAD_LOCAL(int, s_reader_slot);
+static int s_next_reader_slot = 0;
+
+int StripedTableSharedStore::ReaderSlotIndex() {
+  int &slot = *s_reader_slot.get();
+  if (slot == 0) {
+    // 1-based, so that 0 means "not assigned yet"
+    slot = atomic_inc(s_next_reader_slot);
+  }
+  return (slot - 1) % ReaderSlotCount;
+}
+
+StripedTableSharedStore::Table *
+StripedTableSharedStore::Table::Create(uint nBuckets) {
+  ASSERT(nBuckets && (nBuckets & (nBuckets - 1)) == 0);
+  Table *t = (Table *)calloc(1, sizeof(Table) +
+                             (nBuckets - 1) * sizeof(Node*));
+  t->mask = nBuckets - 1;
+  return t;
+}
+
+StripedTableSharedStore::StripedTableSharedStore(int id)
+    : SharedStore(id), m_stripeBits(0), m_epoch(0) {
+  while ((1 << m_stripeBits) < RuntimeOption::ApcStripeCount &&
+         m_stripeBits < 16) {
+    m_stripeBits++;
+  }
+  m_stripeMask = (1 << m_stripeBits) - 1;
+  m_stripes = new Stripe[m_stripeMask + 1];
+}
+
+StripedTableSharedStore::~StripedTableSharedStore() {
+  clear();
+  for (int i = 0; i <= m_stripeMask; i++) {
+    Table::Destroy(m_stripes[i].table);
+  }
+  delete [] m_stripes;
+}
+
+StripedTableSharedStore::Node *
+StripedTableSharedStore::find(const Stripe &s, int64 h,
+                              const char *key, int len) const {
+  Table *t = s.table;
+  for (Node *node = t->buckets[bucketOf(t, h)]; node; node = node->next) {
+    if (node->match(h, key, len)) return node;
+  }
+  return NULL;
+}
+
+StripedTableSharedStore::Node *
+StripedTableSharedStore::find(const Stripe &s, int64 h, CStrRef key) const {
+  return find(s, h, key.data(), key.size());
+}
+
+void StripedTableSharedStore::insertLocked(Stripe &s, Node *node) {
+  if (s.size > (int)s.table->mask) {
+    growLocked(s);
+  }
+  Table *t = s.table;
+  Node * volatile &head = t->buckets[bucketOf(t, node->hash)];
+  node->next = head;
+  __sync_synchronize(); // node fully written before readers can reach it
+  head = node;
+  s.size++;
+}
+
+/**
+ * Readers may still be walking the old table, so its chains are left intact:
+ * every node is copied into the new table, which takes over the keys and
+ * values, and the old nodes and table are retired without them.
+ */
+void StripedTableSharedStore::growLocked(Stripe &s) {
+  Table *old = s.table;
+  Table *t = Table::Create((old->mask + 1) * 2);
+  for (uint i = 0; i <= old->mask; i++) {
+    for (Node *node = old->buckets[i]; node; node = node->next) {
+      Node *copy = new Node(node->key, node->hash, node->var, node->expiry);
+      Node * volatile &head = t->buckets[bucketOf(t, copy->hash)];
+      copy->next = head;
+      head = copy;
+    }
+  }
+  __sync_synchronize();
+  s.table = t;
+
+  for (uint i = 0; i <= old->mask; i++) {
+    for (Node *node = old->buckets[i]; node; node = node->next) {
+      retire(node, false);
+    }
+  }
+  retire(old);
+}
+
+/**
+ * Unlinks the node, leaving its own next pointer alone for readers that are
+ * standing on it.
+ */
+bool StripedTableSharedStore::eraseLocked(Stripe &s, Node *node) {
+  Table *t = s.table;
+  Node * volatile *prev = &t->buckets[bucketOf(t, node->hash)];
+  while (*prev && *prev != node) {
+    prev = &(*prev)->next;
+  }
+  if (*prev == NULL) return false;
+  *prev = node->next;
+  s.size--;
+  retire(node->var);
+  retire(node, true);
+  return true;
+}
+
+void StripedTableSharedStore::replaceLocked(Node *node, SharedVariant *var) {
+  SharedVariant *old = node->var;
+  __sync_synchronize(); // var fully constructed before it is published
+  node->var = var;
+  retire(old);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// deferred reclamation
+
+void StripedTableSharedStore::retire(SharedVariant *var) {
+  Lock lock(m_retiredMutex, false);
+  m_retiredVars.push_back(var);
+}
+
+void StripedTableSharedStore::retire(Node *node, bool withKey) {
+  Lock lock(m_retiredMutex, false);
+  m_retiredNodes.push_back(node);
+  if (withKey) m_retiredKeys.push_back(node->key);
+}
+
+void StripedTableSharedStore::retire(Table *t) {
+  Lock lock(m_retiredMutex, false);
+  m_retiredTables.push_back(t);
+}
+
+/**
+ * Called outside any stripe lock. Only the thread that takes the retired
+ * lists waits for readers; everyone else goes on.
+ */
+void StripedTableSharedStore::reclaim(bool force /* = false */) {
+  std::vector<SharedVariant*> vars;
+  std::vector<StringData*> keys;
+  std::vector<Node*> nodes;
+  std::vector<Table*> tables;
+  {
+    Lock lock(m_retiredMutex, false);
+    if (!force &&
+        m_retiredVars.size() + m_retiredNodes.size() < ReclaimBatchSize) {
+      return;
+    }
+    vars.swap(m_retiredVars);
+    keys.swap(m_retiredKeys);
+    nodes.swap(m_retiredNodes);
+    tables.swap(m_retiredTables);
+  }
+
+  synchronize();
+
+  for (unsigned int i = 0; i < vars.size(); i++) {
+    vars[i]->decRef();
+  }
+  for (unsigned int i = 0; i < keys.size(); i++) {
+    keys[i]->destruct();
+  }
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    delete nodes[i];
+  }
+  for (unsigned int i = 0; i < tables.size(); i++) {
+    Table::Destroy(tables[i]);
+  }
+}
+
+/**
+ * Returns once every read section that started before the call has ended.
+ * A reader can load the old parity and bump its counter only after one
+ * flip's wait is over, so it takes two flips to be sure nobody is left.
+ */
+void StripedTableSharedStore::synchronize() {
+  Lock lock(m_epochMutex);
+  for (int pass = 0; pass < 2; pass++) {
+    int parity = m_epoch & 1;
+    __sync_synchronize();
+    m_epoch++;
+    __sync_synchronize();
+    for (int i = 0; i < ReaderSlotCount; i++) {
+      while (*(volatile int *)&m_readers[i].active[parity]) {
+        sched_yield();
+      }
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SharedStore interface
+
+void StripedTableSharedStore::clearImpl() {
+  if (RuntimeOption::EnableAPCSizeStats) {
+    SharedStoreStats::onClear();
+  }
+  for (int i = 0; i <= m_stripeMask; i++) {
+    Stripe &s = m_stripes[i];
+    Lock lock(s.mutex);
+    Table *t = s.table;
+    for (uint b = 0; b <= t->mask; b++) {
+      Node *node = t->buckets[b];
+      t->buckets[b] = NULL;
+      for (; node; node = node->next) {
+        retire(node->var);
+        retire(node, true);
+      }
+    }
+    s.size = 0;
+  }
+  reclaim(true);
+}
+
+int StripedTableSharedStore::size() {
+  int ret = 0;
+  for (int i = 0; i <= m_stripeMask; i++) {
+    ret += m_stripes[i].size;
+  }
+  return ret;
+}
+
+void StripedTableSharedStore::count(int &reachable, int &expired,
+                                    int &persistent) {
+  reachable = expired = persistent = 0;
+  int now = time(NULL);
+  for (int i = 0; i <= m_stripeMask; i++) {
+    Stripe &s = m_stripes[i];
+    Lock lock(s.mutex);
+    Table *t = s.table;
+    for (uint b = 0; b <= t->mask; b++) {
+      for (Node *node = t->buckets[b]; node; node = node->next) {
+        reachable += node->var->countReachable();
+
+        int64 expiration = node->expiry;
+        if (expiration == 0) {
+          persistent++;
+        } else if (expiration <= now) {
+          expired++;
+        }
+      }
+    }
+  }
+}
+
+void StripedTableSharedStore::walk(Visitor &visitor) {
+  for (int i = 0; i <= m_stripeMask; i++) {
+    Stripe &s = m_stripes[i];
+    Lock lock(s.mutex);
+    Table *t = s.table;
+    for (uint b = 0; b <= t->mask; b++) {
+      for (Node *node = t->buckets[b]; node; node = node->next) {
+        visitor.visit(node->key->data(), node->key->size(), node->var,
+                      node->expiry);
+      }
+    }
+  }
+}
+
+bool StripedTableSharedStore::getImpl(CStrRef key, Variant &value) {
+  bool stats = RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats;
+  if (key.isNull()) return false;
+
+  int64 h = hash_string(key.data(), key.size());
+  bool found = false;
+  bool expired = false;
+  {
+    ReadSection section(this);
+    Node *node = find(getStripe(h), h, key);
+    if (node) {
+      if (node->expired()) {
+        // we cannot erase without the stripe lock, so it's done below
+        expired = true;
+      } else {
+        SharedVariant *var = node->var;
+        value = var->toLocal();
+        found = true;
+        if (RuntimeOption::EnableAPCSizeStats &&
+            RuntimeOption::EnableAPCSizeDetail &&
+            RuntimeOption::EnableAPCFetchStats) {
+          SharedStoreStats::onGet(key.get(), var);
+        }
+      }
+    }
+  }
+  if (expired) {
+    eraseImpl(key, true);
+  }
+  if (stats) {
+    ServerStats::Log(found ? "apc.hit" : "apc.miss", 1);
+  }
+  return found;
+}
+
+bool StripedTableSharedStore::storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                                        bool overwrite /* = true */) {
+  bool stats = RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats;
+  if (key.isNull()) return false;
+
+  SharedVariant* var = construct(key, val);
+  int64 expiry = ttl ? time(NULL) + ttl : 0;
+  int64 h = hash_string(key.data(), key.size());
+  Stripe &s = getStripe(h);
+  bool present;
+  {
+    Lock lock(s.mutex);
+    Node *node = find(s, h, key);
+    present = (node != NULL);
+    if (present) {
+      if (!overwrite && !node->expired()) {
+        var->decRef();
+        return false;
+      }
+      if (RuntimeOption::EnableAPCSizeStats) {
+        SharedStoreStats::onDelete(key.get(), node->var, true);
+      }
+      node->expiry = expiry;
+      replaceLocked(node, var);
+    } else {
+      insertLocked(s, new Node(key.get()->copy(true), h, var, expiry));
+    }
+    if (RuntimeOption::EnableAPCSizeStats) {
+      SharedStoreStats::onStore(key.get(), var, ttl);
+    }
+  }
+  reclaim();
+
+  if (stats) {
+    if (present) {
+      ServerStats::Log("apc.update", 1);
+    } else {
+      ServerStats::Log("apc.new", 1);
+      if (RuntimeOption::EnableStats && RuntimeOption::EnableAPCKeyStats) {
+        string prefix = "apc.new.";
+        prefix += GetSkeleton(key);
+        ServerStats::Log(prefix, 1);
+      }
+    }
+  }
+  return true;
+}
+
+bool StripedTableSharedStore::eraseImpl(CStrRef key, bool expired) {
+  if (key.isNull()) return false;
+
+  int64 h = hash_string(key.data(), key.size());
+  Stripe &s = getStripe(h);
+  bool success = false;
+  {
+    Lock lock(s.mutex);
+    Node *node = find(s, h, key);
+    if (node && (!expired || node->expired())) {
+      if (RuntimeOption::EnableAPCSizeStats) {
+        SharedStoreStats::onDelete(key.get(), node->var, false);
+      }
+      success = eraseLocked(s, node);
+    }
+  }
+  if (success) reclaim();
+  return success;
+}
+
+int64 StripedTableSharedStore::incImpl(CStrRef key, int64 step, bool &found) {
+  found = false;
+  int64 ret = 0;
+  if (!key.isNull()) {
+    int64 h = hash_string(key.data(), key.size());
+    Stripe &s = getStripe(h);
+    {
+      Lock lock(s.mutex);
+      Node *node = find(s, h, key);
+      if (node) {
+        if (node->expired()) {
+          eraseLocked(s, node);
+        } else {
+          Variant v = node->var->toLocal();
+          ret = v.toInt64() + step;
+          v = ret;
+          replaceLocked(node, construct(key, v));
+          found = true;
+        }
+      }
+    }
+    reclaim();
+  }
+
+  if (RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats) {
+    ServerStats::Log("apc.inc", 1);
+  }
+  return ret;
+}
+
+bool StripedTableSharedStore::casImpl(CStrRef key, int64 old, int64 val) {
+  bool success = false;
+  if (!key.isNull()) {
+    int64 h = hash_string(key.data(), key.size());
+    Stripe &s = getStripe(h);
+    {
+      Lock lock(s.mutex);
+      Node *node = find(s, h, key);
+      if (node && !node->expired()) {
+        Variant v = node->var->toLocal();
+        if (v.toInt64() == old) {
+          v = val;
+          replaceLocked(node, construct(key, v));
+          success = true;
+        }
+      }
+    }
+    reclaim();
+  }
+
+  if (RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats) {
+    ServerStats::Log("apc.cas", 1);
+  }
+  return success;
+}
+
+void StripedTableSharedStore::prime
+(const std::vector<SharedStore::KeyValuePair> &vars) {
+  // we are priming, so we are not checking expiration, but priming threads
+  // may still overlap on keys, so existence is checked
+  for (unsigned int i = 0; i < vars.size(); i++) {
+    const SharedStore::KeyValuePair &item = vars[i];
+    int64 h = hash_string(item.key, item.len);
+    Stripe &s = getStripe(h);
+    Lock lock(s.mutex);
+    Node *node = find(s, h, item.key, item.len);
+    if (node) {
+      node->expiry = 0;
+      replaceLocked(node, item.value);
+    } else {
+      node = new Node(new StringData(item.key, item.len, CopyString),
+                      h, item.value, 0);
+      insertLocked(s, node);
+    }
+    if (RuntimeOption::EnableAPCSizeStats &&
+        RuntimeOption::APCSizeCountPrime) {
+      SharedStoreStats::onStore(node->key, item.value, 0);
+    }
+  }
+  reclaim();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // SharedStore
 
-SharedStore::SharedStore(int id) : m_id(id) {
+SharedStore::SharedStore(int id) : m_id(id), m_snapshot(NULL) {
 }
 
 SharedStore::~SharedStore() {
+  delete m_snapshot;
+}
+
+void SharedStore::attachSnapshot(SharedStoreSnapshot *snapshot) {
+  delete m_snapshot;
+  m_snapshot = snapshot;
+}
+
+/**
+ * Moves the key's item, if any, from the snapshot into the store, unless the
+ * store has a value for it already.
+ */
+bool SharedStore::loadFromSnapshot(CStrRef key) {
+  if (!m_snapshot || m_snapshot->empty()) return false;
+
+  Variant value;
+  int64 expiry;
+  if (!m_snapshot->take(key, value, expiry)) return false;
+  int64 ttl = 0;
+  if (expiry) {
+    ttl = expiry - time(NULL);
+    if (ttl <= 0) return false;
+  }
+  storeImpl(key, value, ttl, false);
+  return true;
+}
+
+void SharedStore::clear() {
+  if (m_snapshot) m_snapshot->clear();
+  clearImpl();
+}
+
+bool SharedStore::get(CStrRef key, Variant &value) {
+  if (getImpl(key, value)) return true;
+  return loadFromSnapshot(key) && getImpl(key, value);
+}
+
+bool SharedStore::store(CStrRef key, CVarRef val, int64 ttl,
+                        bool overwrite /* = true */) {
+  if (m_snapshot) {
+    if (overwrite) {
+      m_snapshot->remove(key);
+    } else {
+      loadFromSnapshot(key);
+    }
+  }
+  return storeImpl(key, val, ttl, overwrite);
+}
+
+int64 SharedStore::inc(CStrRef key, int64 step, bool &found) {
+  loadFromSnapshot(key);
+  return incImpl(key, step, found);
+}
+
+bool SharedStore::cas(CStrRef key, int64 old, int64 val) {
+  loadFromSnapshot(key);
+  return casImpl(key, old, val);
 }
 
 std::string SharedStore::GetSkeleton(CStrRef key) {
@@ -804,13 +1494,13 @@ std::string SharedStore::GetSkeleton(CStrRef key) {
   return ret;
 }
 
-void LockedSharedStore::clear() {
+void LockedSharedStore::clearImpl() {
   lockMap();
-  clearImpl();
+  clearLockedImpl();
   unlockMap();
 }
 
-bool LockedSharedStore::get(CStrRef key, Variant &value) {
+bool LockedSharedStore::getImpl(CStrRef key, Variant &value) {
   bool stats = RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats;
 
   readLockMap();
@@ -834,7 +1524,7 @@ bool LockedSharedStore::get(CStrRef key, Variant &value) {
 }
 
 
-bool ConcurrentTableSharedStore::get(CStrRef key, Variant &value) {
+bool ConcurrentTableSharedStore::getImpl(CStrRef key, Variant &value) {
  bool stats = RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats;
  const StoreValue *val;
  ReadLock l(m_lock);
@@ -874,7 +1564,7 @@ bool ConcurrentTableSharedStore::get(CStrRef key, Variant &value) {
 }
 
 
-bool LfuTableSharedStore::get(CStrRef key, Variant &value) {
+bool LfuTableSharedStore::getImpl(CStrRef key, Variant &value) {
   class GetReader : public Map::AtomicReader {
   public:
     GetReader(Variant &v) : expired(false), value(v) {}
@@ -899,8 +1589,8 @@ bool LfuTableSharedStore::get(CStrRef key, Variant &value) {
   return true;
 }
 
-bool LockedSharedStore::store(CStrRef key, CVarRef val, int64 ttl,
-                              bool overwrite /* = true */) {
+bool LockedSharedStore::storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                                  bool overwrite /* = true */) {
   bool stats = RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats;
 
   lockMap();
@@ -936,8 +1626,8 @@ bool LockedSharedStore::store(CStrRef key, CVarRef val, int64 ttl,
 }
 
 
-bool ConcurrentTableSharedStore::store(CStrRef key, CVarRef val, int64 ttl,
-                                       bool overwrite /* = true */) {
+bool ConcurrentTableSharedStore::storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                                           bool overwrite /* = true */) {
   bool stats = RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats;
 
   StoreValue *sval;
@@ -992,8 +1682,8 @@ bool ConcurrentTableSharedStore::store(CStrRef key, CVarRef val, int64 ttl,
 }
 
 
-bool LfuTableSharedStore::store(CStrRef key, CVarRef val, int64 ttl,
-                                bool overwrite /* = true */) {
+bool LfuTableSharedStore::storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                                    bool overwrite /* = true */) {
   class StoreUpdater : public Map::AtomicUpdater {
   public:
     StoreUpdater(int64 t, SharedVariant *v, CStrRef k, bool ovr)
@@ -1083,6 +1773,9 @@ void LfuTableSharedStore::prime
 
 bool SharedStore::erase(CStrRef key, bool expired /* = false */) {
   bool success = eraseImpl(key, expired);
+  if (!expired && m_snapshot && m_snapshot->remove(key)) {
+    success = true;
+  }
 
   if (RuntimeOption::EnableStats && RuntimeOption::EnableAPCStats) {
     ServerStats::Log(success ? "apc.erased" : "apc.erase", 1);
@@ -1097,7 +1790,7 @@ bool LockedSharedStore::eraseImpl(CStrRef key, bool expired /* = false */) {
   return success;
 }
 
-int64 LockedSharedStore::inc(CStrRef key, int64 step, bool &found) {
+int64 LockedSharedStore::incImpl(CStrRef key, int64 step, bool &found) {
   found = false;
   int64 ret = 0;
   lockMap();
@@ -1124,7 +1817,8 @@ int64 LockedSharedStore::inc(CStrRef key, int64 step, bool &found) {
 }
 
 
-int64 ConcurrentTableSharedStore::inc(CStrRef key, int64 step, bool &found) {
+int64 ConcurrentTableSharedStore::incImpl(CStrRef key, int64 step,
+                                          bool &found) {
   found = false;
   int64 ret = 0;
   ReadLock l(m_lock);
@@ -1154,7 +1848,7 @@ int64 ConcurrentTableSharedStore::inc(CStrRef key, int64 step, bool &found) {
 }
 
 
-int64 LfuTableSharedStore::inc(CStrRef key, int64 step, bool &found) {
+int64 LfuTableSharedStore::incImpl(CStrRef key, int64 step, bool &found) {
   class IncUpdater : public Map::AtomicUpdater {
   public:
     IncUpdater(int64 s, bool &f, CStrRef k, LfuTableSharedStore *str)
@@ -1191,7 +1885,7 @@ int64 LfuTableSharedStore::inc(CStrRef key, int64 step, bool &found) {
   return updater.ret;
 }
 
-bool LockedSharedStore::cas(CStrRef key, int64 old, int64 val) {
+bool LockedSharedStore::casImpl(CStrRef key, int64 old, int64 val) {
   bool success = false;
   lockMap();
   StoreValue *sval;
@@ -1218,7 +1912,7 @@ bool LockedSharedStore::cas(CStrRef key, int64 old, int64 val) {
 }
 
 
-bool ConcurrentTableSharedStore::cas(CStrRef key, int64 old, int64 val) {
+bool ConcurrentTableSharedStore::casImpl(CStrRef key, int64 old, int64 val) {
   bool success = false;
   ReadLock l(m_lock);
   StoreValue *sval;
@@ -1244,7 +1938,7 @@ bool ConcurrentTableSharedStore::cas(CStrRef key, int64 old, int64 val) {
 }
 
 
-bool LfuTableSharedStore::cas(CStrRef key, int64 old, int64 val) {
+bool LfuTableSharedStore::casImpl(CStrRef key, int64 old, int64 val) {
   class CasUpdater : public Map::AtomicUpdater {
   public:
     CasUpdater(LfuTableSharedStore *s, CStrRef k, int64 o, int64 v)
@@ -1360,6 +2054,9 @@ void SharedStores::create() {
       case RuntimeOption::ApcConcurrentTable:
         m_stores[i] = new ConcurrentTableSharedStore(i);
         break;
+      case RuntimeOption::ApcStripedTable:
+        m_stores[i] = new StripedTableSharedStore(i);
+        break;
       default:
         ASSERT(false);
       }
@@ -1424,5 +2121,23 @@ std::string SharedStores::ReportStats(int indent) {
   return s_apc_store.reportStats(indent);
 }
 
+bool SharedStores::SaveSnapshot(const std::string &filename) {
+  return SharedStoreSnapshot::Save(filename, s_apc_store.m_stores,
+                                   MAX_SHARED_STORE);
+}
+
+bool SharedStores::LoadSnapshot(const std::string &filename) {
+  std::vector<SharedStoreSnapshot*> snapshots;
+  if (!SharedStoreSnapshot::Load(filename, snapshots, MAX_SHARED_STORE)) {
+    return false;
+  }
+  for (int i = 0; i < MAX_SHARED_STORE; i++) {
+    if (snapshots[i]) {
+      s_apc_store[i].attachSnapshot(snapshots[i]);
+    }
+  }
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
@@ -24,7 +24,8 @@
 
 #define SHARED_STORE_APPLICATION_CACHE 0
 #define SHARED_STORE_DNS_CACHE 1
-#define MAX_SHARED_STORE 2
+#define SHARED_STORE_SESSION 2
+#define MAX_SHARED_STORE 3
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -38,21 +39,26 @@ public:
   int64 expiry;
 };
 
+class SharedStoreSnapshot;
+
 class SharedStore {
 public:
   SharedStore(int id);
   virtual ~SharedStore();
-  virtual void clear() = 0;
+  void clear();
 
   virtual int size() = 0;
   virtual void count(int &reachable, int &expired, int &persistent) = 0;
 
-  virtual bool get(CStrRef key, Variant &value) = 0;
-  virtual bool store(CStrRef key, CVarRef val, int64 ttl,
-                     bool overwrite = true) = 0;
+  /**
+   * These check the attached snapshot, if any, when the key is not in the
+   * store itself.
+   */
+  bool get(CStrRef key, Variant &value);
+  bool store(CStrRef key, CVarRef val, int64 ttl, bool overwrite = true);
   bool erase(CStrRef key, bool expired = false);
-  virtual int64 inc(CStrRef key, int64 step, bool &found) = 0;
-  virtual bool cas(CStrRef key, int64 old, int64 val) = 0;
+  int64 inc(CStrRef key, int64 step, bool &found);
+  bool cas(CStrRef key, int64 old, int64 val);
 
   // for priming only
   virtual SharedVariant* construct(litstr str, int len, CStrRef v,
@@ -66,17 +72,47 @@ public:
   };
   virtual void prime(const std::vector<KeyValuePair> &vars) = 0;
 
+  /**
+   * For writing snapshots: visits every item in the store, including expired
+   * ones. Stores that don't live in process memory don't need snapshots and
+   * visit nothing.
+   */
+  class Visitor {
+  public:
+    virtual ~Visitor() {}
+    virtual void visit(const char *key, int len, SharedVariant *var,
+                       int64 expiry) = 0;
+  };
+  virtual void walk(Visitor &visitor) {}
+
+  /**
+   * Items of a snapshot are only loaded into the store when first accessed.
+   * Takes ownership of the snapshot.
+   */
+  void attachSnapshot(SharedStoreSnapshot *snapshot);
+  SharedStoreSnapshot *getSnapshot() const { return m_snapshot; }
+
   virtual std::string reportStats(int &reachable, int indent);
   virtual bool check() { return true; }
   static size_t s_lockCount;
   static std::string GetSkeleton(CStrRef key);
 protected:
   int m_id;
+  SharedStoreSnapshot *m_snapshot;
 
+  virtual void clearImpl() = 0;
+  virtual bool getImpl(CStrRef key, Variant &value) = 0;
+  virtual bool storeImpl(CStrRef key, CVarRef val, int64 ttl,
+                         bool overwrite) = 0;
   virtual bool eraseImpl(CStrRef key, bool expired) = 0;
+  virtual int64 incImpl(CStrRef key, int64 step, bool &found) = 0;
+  virtual bool casImpl(CStrRef key, int64 old, int64 val) = 0;
   virtual SharedVariant* construct(CStrRef key, CVarRef v) = 0;
   virtual SharedVariant* putVar(SharedVariant* v) const { return v; };
   virtual SharedVariant* getVar(SharedVariant* v) const { return v; };
+
+private:
+  bool loadFromSnapshot(CStrRef key);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -86,6 +122,13 @@ public:
   static void Create();
   static std::string ReportStats(int indent);
 
+  /**
+   * Writes all stores into one image file, or maps one back in, attaching
+   * each store's part as its snapshot.
+   */
+  static bool SaveSnapshot(const std::string &filename);
+  static bool LoadSnapshot(const std::string &filename);
+
 public:
   SharedStores();
   ~SharedStores();
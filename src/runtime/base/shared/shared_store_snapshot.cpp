@@ -0,0 +1,442 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/shared/shared_store_snapshot.h>
+#include <runtime/base/complex_types.h>
+#include <runtime/base/array/array_init.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/ext/ext_apc.h>
+#include <util/logger.h>
+#include <util/exception.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+static const char s_magic[] = "HPHPAPC1";
+static const int s_magicLen = sizeof(s_magic) - 1;
+
+class SharedStoreSnapshot::MappedFile {
+public:
+  MappedFile(void *base, size_t size) : m_base(base), m_size(size) {}
+  ~MappedFile() { munmap(m_base, m_size); }
+
+  const char *begin() const { return (const char *)m_base; }
+  const char *end() const { return begin() + m_size; }
+
+private:
+  void *m_base;
+  size_t m_size;
+};
+
+template<typename T>
+static void read_raw(const char *&p, const char *end, T &v) {
+  if (end - p < (ssize_t)sizeof(T)) {
+    throw Exception("truncated APC snapshot");
+  }
+  memcpy(&v, p, sizeof(T));
+  p += sizeof(T);
+}
+
+static const char *read_bytes(const char *&p, const char *end, int32 len) {
+  if (len < 0 || end - p < len) {
+    throw Exception("truncated APC snapshot");
+  }
+  const char *ret = p;
+  p += len;
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// writing
+
+class SnapshotWriter : public SharedStore::Visitor {
+public:
+  SnapshotWriter(FILE *f)
+    : count(0), skipped(0), failed(false), m_f(f), m_now(time(NULL)) {}
+
+  virtual void visit(const char *key, int len, SharedVariant *var,
+                     int64 expiry) {
+    if (failed || (expiry && expiry <= m_now)) return;
+    m_value.clear();
+    if (!var->toImage(m_value)) {
+      skipped++;
+      return;
+    }
+    if (!SharedStoreSnapshot::WriteItem(m_f, key, len, expiry,
+                                        m_value.data(), m_value.size())) {
+      failed = true;
+      return;
+    }
+    count++;
+  }
+
+  int64 count;
+  int64 skipped;
+  bool failed;
+
+private:
+  FILE *m_f;
+  time_t m_now;
+  string m_value;
+};
+
+bool SharedStoreSnapshot::WriteItem(FILE *f, const char *key, int keyLen,
+                                    int64 expiry, const char *value,
+                                    int valueLen) {
+  int32 len = keyLen;
+  if (fwrite(&len, sizeof(len), 1, f) != 1 ||
+      (keyLen && fwrite(key, keyLen, 1, f) != 1) ||
+      fwrite(&expiry, sizeof(expiry), 1, f) != 1) {
+    return false;
+  }
+  len = valueLen;
+  return fwrite(&len, sizeof(len), 1, f) == 1 &&
+    fwrite(value, valueLen, 1, f) == 1;
+}
+
+bool SharedStoreSnapshot::Save(const std::string &filename,
+                               SharedStore **stores, int count) {
+  string tmp = filename + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (!f) {
+    Logger::Error("Unable to open %s for APC snapshot: %s", tmp.c_str(),
+                  strerror(errno));
+    return false;
+  }
+
+  int32 n = count;
+  bool ok = fwrite(s_magic, s_magicLen, 1, f) == 1 &&
+    fwrite(&n, sizeof(n), 1, f) == 1;
+  for (int i = 0; ok && i < count; i++) {
+    int32 id = i;
+    int64 items = 0;
+    long pos;
+    ok = fwrite(&id, sizeof(id), 1, f) == 1 &&
+      (pos = ftell(f)) >= 0 &&
+      fwrite(&items, sizeof(items), 1, f) == 1;
+    if (!ok) break;
+
+    SnapshotWriter writer(f);
+    stores[i]->walk(writer);
+    items = writer.count;
+    if (writer.skipped) {
+      Logger::Warning("APC snapshot: %lld items of store %d skipped",
+                      writer.skipped, i);
+    }
+    SharedStoreSnapshot *snapshot = stores[i]->getSnapshot();
+    if (snapshot && !writer.failed) {
+      int64 saved = snapshot->save(f);
+      if (saved < 0) {
+        writer.failed = true;
+      } else {
+        items += saved;
+      }
+    }
+
+    ok = !writer.failed &&
+      fseek(f, pos, SEEK_SET) == 0 &&
+      fwrite(&items, sizeof(items), 1, f) == 1 &&
+      fseek(f, 0, SEEK_END) == 0;
+  }
+
+  if (fclose(f) != 0) ok = false;
+  if (!ok || rename(tmp.c_str(), filename.c_str()) != 0) {
+    Logger::Error("Unable to write APC snapshot %s: %s", filename.c_str(),
+                  strerror(errno));
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+int64 SharedStoreSnapshot::save(FILE *f) {
+  time_t now = time(NULL);
+  int64 count = 0;
+  for (int i = 0; i < ShardCount; i++) {
+    Shard &shard = m_shards[i];
+    Lock lock(shard.mutex);
+    for (ItemMap::const_iterator iter = shard.items.begin();
+         iter != shard.items.end(); ++iter) {
+      const Item &item = iter->second;
+      if (item.expiry && item.expiry <= now) continue;
+      if (!WriteItem(f, iter->first.data, iter->first.len, item.expiry,
+                     item.value, item.valueLen)) {
+        return -1;
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loading
+
+bool SharedStoreSnapshot::Load(const std::string &filename,
+                               std::vector<SharedStoreSnapshot*> &snapshots,
+                               int count) {
+  snapshots.assign(count, NULL);
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    if (errno != ENOENT) {
+      Logger::Error("Unable to open APC snapshot %s: %s", filename.c_str(),
+                    strerror(errno));
+    }
+    return false;
+  }
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > s_magicLen) {
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  // A snapshot is only good once: if this process dies without writing a
+  // new one, the next one must not come back with values older than what
+  // it has been serving.
+  unlink(filename.c_str());
+  if (base == MAP_FAILED) {
+    Logger::Error("Unable to map APC snapshot %s", filename.c_str());
+    return false;
+  }
+  MappedFilePtr file(new MappedFile(base, st.st_size));
+
+  try {
+    const char *p = file->begin();
+    const char *end = file->end();
+    if (memcmp(read_bytes(p, end, s_magicLen), s_magic, s_magicLen)) {
+      throw Exception("not an APC snapshot");
+    }
+    int32 stores;
+    read_raw(p, end, stores);
+    for (int i = 0; i < stores; i++) {
+      int32 id;
+      int64 items;
+      read_raw(p, end, id);
+      read_raw(p, end, items);
+      SharedStoreSnapshot *snapshot = new SharedStoreSnapshot(file);
+      if (id >= 0 && id < count && !snapshots[id]) {
+        snapshots[id] = snapshot;
+      } else {
+        Logger::Warning("APC snapshot: store %d ignored", id);
+        delete snapshot;
+        snapshot = NULL;
+      }
+      for (int64 j = 0; j < items; j++) {
+        int32 len;
+        Item item;
+        read_raw(p, end, len);
+        const char *key = read_bytes(p, end, len);
+        read_raw(p, end, item.expiry);
+        read_raw(p, end, item.valueLen);
+        item.value = read_bytes(p, end, item.valueLen);
+        if (snapshot) {
+          snapshot->add(Key(key, len), item);
+        }
+      }
+    }
+  } catch (Exception &e) {
+    Logger::Error("Bad APC snapshot %s: %s", filename.c_str(),
+                  e.getMessage().c_str());
+    for (int i = 0; i < count; i++) {
+      delete snapshots[i];
+      snapshots[i] = NULL;
+    }
+    return false;
+  }
+  return true;
+}
+
+SharedStoreSnapshot::SharedStoreSnapshot(MappedFilePtr file)
+  : m_count(0), m_deadline(0), m_file(file) {
+  if (RuntimeOption::ApcSnapshotTimeout > 0) {
+    m_deadline = time(NULL) + RuntimeOption::ApcSnapshotTimeout;
+  }
+}
+
+void SharedStoreSnapshot::add(const Key &key, const Item &item) {
+  Shard &shard = getShard(key);
+  std::pair<ItemMap::iterator, bool> ret =
+    shard.items.insert(ItemMap::value_type(key, item));
+  if (ret.second) {
+    shard.count++;
+    m_count++;
+  } else {
+    ret.first->second = item;
+  }
+}
+
+SharedStoreSnapshot::~SharedStoreSnapshot() {
+}
+
+Variant SharedStoreSnapshot::Decode(const char *&p, const char *end) {
+  char tag;
+  read_raw(p, end, tag);
+  switch (tag) {
+  case TagBoolean:
+    {
+      char v;
+      read_raw(p, end, v);
+      return (bool)v;
+    }
+  case TagInt64:
+    {
+      int64 v;
+      read_raw(p, end, v);
+      return v;
+    }
+  case TagDouble:
+    {
+      double v;
+      read_raw(p, end, v);
+      return v;
+    }
+  case TagString:
+    {
+      int32 len;
+      read_raw(p, end, len);
+      const char *s = read_bytes(p, end, len);
+      return String(s, len, CopyString);
+    }
+  case TagSerialized:
+    {
+      int32 len;
+      read_raw(p, end, len);
+      const char *s = read_bytes(p, end, len);
+      return apc_unserialize(String(s, len, AttachLiteral));
+    }
+  case TagVector:
+    {
+      int32 size;
+      read_raw(p, end, size);
+      ArrayInit init(size, true);
+      for (int i = 0; i < size; i++) {
+        init.set(i, Decode(p, end));
+      }
+      return init.create();
+    }
+  case TagMap:
+    {
+      int32 size;
+      read_raw(p, end, size);
+      ArrayInit init(size, false);
+      for (int i = 0; i < size; i++) {
+        Variant key = Decode(p, end);
+        init.set(i, key, Decode(p, end), -1, true);
+      }
+      return init.create();
+    }
+  default:
+    break;
+  }
+  throw Exception("bad value tag %d in APC snapshot", (int)tag);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// taking items out
+
+/**
+ * Removes the key's item, if any, handing out a reference to the mapping the
+ * item's value is in, so it can be decoded without holding any lock.
+ */
+bool SharedStoreSnapshot::find(const Key &key, Item &item,
+                               MappedFilePtr &file) {
+  Shard &shard = getShard(key);
+  if (shard.count == 0) return false;
+
+  Lock lock(shard.mutex);
+  ItemMap::iterator iter = shard.items.find(key);
+  if (iter == shard.items.end()) return false;
+  item = iter->second;
+  shard.items.erase(iter);
+  shard.count--;
+  __sync_fetch_and_sub(&m_count, 1);
+  // clear() empties the shard before releasing the mapping, so it is still
+  // there for an item that was found in it.
+  Lock fileLock(m_fileMutex);
+  file = m_file;
+  return true;
+}
+
+bool SharedStoreSnapshot::take(CStrRef key, Variant &value, int64 &expiry) {
+  if (empty()) return false;
+  if (m_deadline) checkDeadline(time(NULL));
+
+  Item item;
+  MappedFilePtr file;
+  if (!find(Key(key.data(), key.size()), item, file)) return false;
+
+  // Unserializing objects may run user code that takes more keys, and that
+  // may also be what empties the snapshot; file keeps the mapping until
+  // decoding is done.
+  bool ok = true;
+  try {
+    const char *p = item.value;
+    value = Decode(p, item.value + item.valueLen);
+  } catch (Exception &e) {
+    Logger::Error("Bad APC snapshot item %s: %s", key.data(),
+                  e.getMessage().c_str());
+    ok = false;
+  }
+  releaseIfEmpty();
+
+  expiry = item.expiry;
+  return ok;
+}
+
+bool SharedStoreSnapshot::remove(CStrRef key) {
+  if (empty()) return false;
+
+  Item item;
+  MappedFilePtr file;
+  if (!find(Key(key.data(), key.size()), item, file)) return false;
+  releaseIfEmpty();
+  return true;
+}
+
+void SharedStoreSnapshot::clear() {
+  for (int i = 0; i < ShardCount; i++) {
+    Shard &shard = m_shards[i];
+    Lock lock(shard.mutex);
+    __sync_fetch_and_sub(&m_count, shard.count);
+    ItemMap().swap(shard.items);
+    shard.count = 0;
+  }
+  releaseIfEmpty();
+}
+
+void SharedStoreSnapshot::checkDeadline(time_t now) {
+  if (m_deadline && now >= m_deadline && !empty()) {
+    Logger::Info("APC snapshot: dropping %d items never fetched",
+                 (int)m_count);
+    clear();
+  }
+}
+
+void SharedStoreSnapshot::releaseIfEmpty() {
+  if (m_count == 0) {
+    Lock lock(m_fileMutex);
+    m_file.reset();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
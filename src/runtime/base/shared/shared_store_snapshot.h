@@ -0,0 +1,164 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_SHARED_STORE_SNAPSHOT_H__
+#define __HPHP_SHARED_STORE_SNAPSHOT_H__
+
+#include <runtime/base/types.h>
+#include <runtime/base/shared/shared_store.h>
+#include <util/mutex.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * An APC image file, written on graceful shutdown and mapped read-only on
+ * startup. The file is
+ *
+ *   "HPHPAPC1" int32(store count)
+ *   for each store:  int32(store id) int64(item count)
+ *   for each item:   int32(key len) key int64(expiry) int32(value len) value
+ *
+ * with values encoded by SharedVariant::toImage(). Expiry is absolute, and 0
+ * for items that never expire. Items are only decoded when a request asks
+ * for them; once they have all been taken, or Apc.SnapshotTimeout seconds
+ * after loading, the mapping is released.
+ *
+ * Items are spread over shards with a lock each, and decoding happens
+ * outside of them, so requests missing in the store at startup don't line
+ * up behind each other.
+ */
+class SharedStoreSnapshot {
+public:
+  static bool Save(const std::string &filename, SharedStore **stores,
+                   int count);
+  /**
+   * Returns one snapshot per store id found in the file, NULL for the rest.
+   */
+  static bool Load(const std::string &filename,
+                   std::vector<SharedStoreSnapshot*> &snapshots, int count);
+
+  /**
+   * Value encoding, used by SharedVariant::toImage() and Decode().
+   */
+  enum Tag {
+    TagBoolean    = 'b',
+    TagInt64      = 'i',
+    TagDouble     = 'd',
+    TagString     = 's',
+    TagSerialized = 'z', // apc_serialize() format, for objects
+    TagVector     = 'v',
+    TagMap        = 'm',
+  };
+  static void AppendInt32(std::string &out, int32 v) {
+    out.append((const char *)&v, sizeof(v));
+  }
+  static void AppendInt64(std::string &out, int64 v) {
+    out.append((const char *)&v, sizeof(v));
+  }
+  static void AppendString(std::string &out, const char *s, int len) {
+    AppendInt32(out, len);
+    out.append(s, len);
+  }
+  static Variant Decode(const char *&p, const char *end);
+  static bool WriteItem(FILE *f, const char *key, int keyLen, int64 expiry,
+                        const char *value, int valueLen);
+
+public:
+  ~SharedStoreSnapshot();
+
+  bool empty() const { return m_count == 0;}
+
+  /**
+   * Removes the item from the snapshot, decoding it into value first, if
+   * it's there.
+   */
+  bool take(CStrRef key, Variant &value, int64 &expiry);
+  bool remove(CStrRef key);
+  void clear();
+
+  /**
+   * Drops everything not taken yet once now is past the deadline set at
+   * loading. take() checks this by itself.
+   */
+  void checkDeadline(time_t now);
+
+  /**
+   * Writes items not taken yet in the file format above, returning how many
+   * were written.
+   */
+  int64 save(FILE *f);
+
+private:
+  DECLARE_BOOST_TYPES(MappedFile);
+
+  class Item {
+  public:
+    int64 expiry;
+    const char *value;
+    int valueLen;
+  };
+
+  class Key {
+  public:
+    Key(const char *d, int l) : data(d), len(l) {}
+    const char *data;
+    int len;
+  };
+  struct KeyHash {
+    size_t operator()(const Key &k) const {
+      return hash_string(k.data, k.len);
+    }
+  };
+  struct KeyEqual {
+    bool operator()(const Key &k1, const Key &k2) const {
+      return k1.len == k2.len && memcmp(k1.data, k2.data, k1.len) == 0;
+    }
+  };
+  typedef hphp_hash_map<Key, Item, KeyHash, KeyEqual> ItemMap;
+
+  static const int ShardCount = 64; // power of 2
+  class Shard {
+  public:
+    Shard() : count(0) {}
+    Mutex mutex;
+    ItemMap items;
+    volatile int count; // so misses on empty shards don't lock
+  };
+
+  SharedStoreSnapshot(MappedFilePtr file);
+
+  Shard m_shards[ShardCount];
+  volatile int m_count;
+  time_t m_deadline; // 0 for none
+
+  // Taken items are decoded holding their own reference to the mapping,
+  // so it is only unmapped once the last of them is done.
+  MappedFilePtr m_file;
+  Mutex m_fileMutex;
+
+  Shard &getShard(const Key &key) {
+    return m_shards[KeyHash()(key) & (ShardCount - 1)];
+  }
+  void add(const Key &key, const Item &item);
+  bool find(const Key &key, Item &item, MappedFilePtr &file);
+  void releaseIfEmpty();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_SHARED_STORE_SNAPSHOT_H__
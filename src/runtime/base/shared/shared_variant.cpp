@@ -27,7 +27,7 @@ int SharedVariant::countReachable() {
   markReachable();
 #endif
   int count = 1;
-  if (m_type == KindOfArray) {
+  if (m_type == KindOfArray && !getFlatArray()) {
     int size = arrSize();
     count += size; // key count
     for (int i = 0; i < size; i++) {
@@ -40,5 +40,14 @@ int SharedVariant::countReachable() {
   return count;
 }
 
+bool SharedVariant::isVectorData() {
+  ASSERT(m_type == KindOfArray);
+  int size = arrSize();
+  for (int i = 0; i < size; i++) {
+    if (getIndex((int64)i) != i) return false;
+  }
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
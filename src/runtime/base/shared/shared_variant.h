@@ -28,6 +28,7 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 class SharedMap;
+class FlatArray;
 
 class SharedVariantStats;
 
@@ -62,6 +63,10 @@ public:
   }
 
   virtual size_t arrSize() const = 0;
+  /**
+   * Same as ArrayData::isVectorData() of the array stored.
+   */
+  virtual bool isVectorData();
 
   virtual int getIndex(CVarRef key) = 0;
   virtual SharedVariant* get(CVarRef key) = 0;
@@ -73,11 +78,23 @@ public:
   virtual Variant getKey(ssize_t pos) const = 0;
   virtual SharedVariant* getValue(ssize_t pos) const = 0;
 
+  /**
+   * An array kept in one buffer has no SharedVariant per element: getValue()
+   * and get() return NULL, and SharedMap reads this instead.
+   */
+  virtual const FlatArray *getFlatArray() const { return NULL; }
+
   int countReachable();
 
   // recursively get stats from the SharedVariant
   virtual void getStats(SharedVariantStats *stat) = 0;
 
+  /**
+   * Appends a self-contained binary image of the value, for APC snapshots.
+   * Returns false if this kind of SharedVariant cannot be written out.
+   */
+  virtual bool toImage(std::string &out) { return false; }
+
   // whether it is an object, or an array that recursively contains an object
   // or an array with circular reference
   bool shouldCache() { return getShouldCache(); }
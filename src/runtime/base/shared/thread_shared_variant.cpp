@@ -18,6 +18,7 @@
 #include <runtime/ext/ext_variable.h>
 #include <runtime/ext/ext_apc.h>
 #include <runtime/base/shared/shared_map.h>
+#include <runtime/base/shared/shared_store_snapshot.h>
 #include <runtime/base/runtime_option.h>
 
 using namespace std;
@@ -86,6 +87,14 @@ ThreadSharedVariant::ThreadSharedVariant(CVarRef source, bool serialized,
         }
       }
 
+      if (RuntimeOption::ApcFlatArrays) {
+        m_data.flat = FlatArray::Create(arr);
+        if (m_data.flat) {
+          setIsFlat();
+          break;
+        }
+      }
+
       size_t size = arr->size();
       if (arr->isVectorData()) {
         setIsVector();
@@ -213,7 +222,8 @@ ThreadSharedVariant::~ThreadSharedVariant() {
       }
 
       ASSERT(getOwner());
-      if (getIsVector()) delete m_data.vec;
+      if (getIsFlat()) FlatArray::Destroy(m_data.flat);
+      else if (getIsVector()) delete m_data.vec;
       else delete m_data.map;
     }
     break;
@@ -236,12 +246,14 @@ size_t ThreadSharedVariant::stringLength() const {
 
 size_t ThreadSharedVariant::arrSize() const {
   ASSERT(is(KindOfArray));
+  if (getIsFlat()) return m_data.flat->size();
   if (getIsVector()) return m_data.vec->size;
   return m_data.map->size();
 }
 
 int ThreadSharedVariant::getIndex(CVarRef key) {
   ASSERT(is(KindOfArray));
+  if (getIsFlat()) return m_data.flat->indexOf(key);
   switch (key.getType()) {
   case KindOfByte:
   case KindOfInt16:
@@ -273,6 +285,7 @@ int ThreadSharedVariant::getIndex(CVarRef key) {
 }
 
 SharedVariant* ThreadSharedVariant::get(CVarRef key) {
+  if (getIsFlat()) return NULL;
   int idx = getIndex(key);
   if (idx != -1) {
     if (getIsVector()) return m_data.vec->vals[idx];
@@ -291,6 +304,10 @@ void ThreadSharedVariant::loadElems(ArrayData *&elems,
                                     const SharedMap &sharedMap,
                                     bool keepRef /* = false */) {
   ASSERT(is(KindOfArray));
+  if (getIsFlat()) {
+    m_data.flat->loadElems(elems, sharedMap, keepRef);
+    return;
+  }
   uint count = arrSize();
   ArrayInit ai(count, getIsVector(), keepRef);
   for (uint i = 0; i < count; i++) {
@@ -353,6 +370,11 @@ void ThreadSharedVariant::getStats(SharedVariantStats *stats) {
                              stats->dataSize;
       break;
     }
+    if (getIsFlat()) {
+      stats->dataSize = m_data.flat->bytes();
+      stats->dataTotalSize = sizeof(ThreadSharedVariant) + stats->dataSize;
+      break;
+    }
     if (getIsVector()) {
       stats->dataTotalSize = sizeof(ThreadSharedVariant) + sizeof(VectorData);
       stats->dataTotalSize += sizeof(ThreadSharedVariant*) * m_data.vec->size;
@@ -377,5 +399,58 @@ void ThreadSharedVariant::getStats(SharedVariantStats *stats) {
   }
 }
 
+bool ThreadSharedVariant::toImage(std::string &out) {
+  switch (m_type) {
+  case KindOfBoolean:
+    out += (char)SharedStoreSnapshot::TagBoolean;
+    out += (char)(m_data.num != 0);
+    break;
+  case KindOfInt64:
+    out += (char)SharedStoreSnapshot::TagInt64;
+    SharedStoreSnapshot::AppendInt64(out, m_data.num);
+    break;
+  case KindOfDouble:
+    out += (char)SharedStoreSnapshot::TagDouble;
+    out.append((const char *)&m_data.dbl, sizeof(m_data.dbl));
+    break;
+  case KindOfString:
+    out += (char)SharedStoreSnapshot::TagString;
+    SharedStoreSnapshot::AppendString(out, m_data.str->data(),
+                                      m_data.str->size());
+    break;
+  case KindOfObject:
+    // already serialized, and kept that way so no class is needed here
+    out += (char)SharedStoreSnapshot::TagSerialized;
+    SharedStoreSnapshot::AppendString(out, m_data.str->data(),
+                                      m_data.str->size());
+    break;
+  default:
+    ASSERT(is(KindOfArray));
+    if (getSerializedArray()) {
+      out += (char)SharedStoreSnapshot::TagSerialized;
+      SharedStoreSnapshot::AppendString(out, m_data.str->data(),
+                                        m_data.str->size());
+    } else if (getIsFlat()) {
+      m_data.flat->toImage(out);
+    } else if (getIsVector()) {
+      out += (char)SharedStoreSnapshot::TagVector;
+      SharedStoreSnapshot::AppendInt32(out, m_data.vec->size);
+      for (size_t i = 0; i < m_data.vec->size; i++) {
+        m_data.vec->vals[i]->toImage(out);
+      }
+    } else {
+      ImmutableMap *map = m_data.map;
+      out += (char)SharedStoreSnapshot::TagMap;
+      SharedStoreSnapshot::AppendInt32(out, map->size());
+      for (int i = 0; i < map->size(); i++) {
+        map->getKeyIndex(i)->toImage(out);
+        map->getValIndex(i)->toImage(out);
+      }
+    }
+    break;
+  }
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
@@ -24,6 +24,7 @@
 #include <runtime/base/shared/shared_variant.h>
 #include <runtime/base/complex_types.h>
 #include <runtime/base/shared/immutable_map.h>
+#include <runtime/base/shared/flat_array.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -63,6 +64,11 @@ public:
   }
 
   size_t arrSize() const;
+  virtual bool isVectorData() {
+    ASSERT(is(KindOfArray));
+    // the source array was asked when this was made
+    return getIsFlat() ? m_data.flat->isVector() : getIsVector();
+  }
   int getIndex(CVarRef key);
   SharedVariant* get(CVarRef key);
   bool exists(CVarRef key);
@@ -72,6 +78,9 @@ public:
 
   virtual Variant getKey(ssize_t pos) const {
     ASSERT(is(KindOfArray));
+    if (getIsFlat()) {
+      return m_data.flat->getKey(pos, const_cast<ThreadSharedVariant*>(this));
+    }
     if (getIsVector()) {
       ASSERT(pos < (ssize_t) m_data.vec->size);
       return pos;
@@ -80,17 +89,22 @@ public:
   }
   virtual SharedVariant* getValue(ssize_t pos) const {
     ASSERT(is(KindOfArray));
+    if (getIsFlat()) return NULL;
     if (getIsVector()) {
       ASSERT(pos < (ssize_t) m_data.vec->size);
       return m_data.vec->vals[pos];
     }
     return m_data.map->getValIndex(pos);
   }
+  virtual const FlatArray *getFlatArray() const {
+    return getIsFlat() ? m_data.flat : NULL;
+  }
 
   // implementing LeakDetectable
   virtual void dump(std::string &out);
 
   virtual void getStats(SharedVariantStats *stats);
+  virtual bool toImage(std::string &out);
 
   StringData *getStringData() const {
     ASSERT(is(KindOfString));
@@ -103,13 +117,14 @@ protected:
 
   virtual SharedVariant* getKeySV(ssize_t pos) const {
     ASSERT(is(KindOfArray));
-    if (getIsVector()) return NULL;
+    if (getIsVector() || getIsFlat()) return NULL;
     else return m_data.map->getKeyIndex(pos);
   }
 
 private:
   const static uint16 IsVector = (1<<13);
   const static uint16 Owner = (1<<12);
+  const static uint16 IsFlat = (1<<11);
 
   class VectorData {
   public:
@@ -134,12 +149,17 @@ private:
     StringData *str;
     ImmutableMap* map;
     VectorData* vec;
+    FlatArray* flat;
   } m_data;
 
   bool getIsVector() const { return (bool)(m_flags & IsVector);}
   void setIsVector() { m_flags |= IsVector;}
   void clearIsVector() { m_flags &= ~IsVector;}
 
+  bool getIsFlat() const { return (bool)(m_flags & IsFlat);}
+  void setIsFlat() { m_flags |= IsFlat;}
+  void clearIsFlat() { m_flags &= ~IsFlat;}
+
   bool getOwner() const { return (bool)(m_flags & Owner);}
   void setOwner() { m_flags |= Owner;}
   void clearOwner() { m_flags &= ~Owner;}
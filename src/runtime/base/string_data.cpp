@@ -57,6 +57,19 @@ StringData::StringData(SharedVariant *shared)
   ASSERT(m_data);
 }
 
+StringData::StringData(SharedVariant *owner, const char *data, int len)
+  : m_data(NULL), _count(0), m_len(0), m_shared(NULL) {
+  #ifdef TAINTED
+  m_tainting = default_tainting;
+  m_tainted_metadata = NULL;
+  #endif
+  ASSERT(owner && data && data[len] == '\0');
+  owner->incRef();
+  m_shared = owner;
+  m_data = data;
+  m_len = len | IsShared;
+}
+
 StringData::StringData(const char *data, int len, StringDataMode mode)
   : m_data(NULL), _count(0), m_len(0), m_shared(NULL) {
   #ifdef TAINTED
@@ -144,12 +157,14 @@ void StringData::append(const char *s, int len) {
       m_shared->decRef();
     }
     m_len = newlen;
+    m_hash = 0; // was m_shared, or a hash of what was there before
   } else if (m_data == s) {
     int newlen;
     char *newdata = string_concat(data(), size(), s, len, newlen);
     releaseData();
     m_data = newdata;
     m_len = newlen;
+    m_hash = 0;
   } else {
     int dataLen = size();
     ASSERT((m_data > s && m_data - s > len) ||
@@ -158,6 +173,7 @@ void StringData::append(const char *s, int len) {
     m_data = (const char*)realloc((void*)m_data, m_len + 1);
     memcpy((void*)(m_data + dataLen), s, len);
     ((char*)m_data)[m_len] = '\0';
+    m_hash = 0;
   }
 }
 
@@ -188,8 +204,12 @@ void StringData::escalate() {
   char *buf = (char*)malloc(len+1);
   memcpy(buf, data(), len);
   buf[len] = '\0';
+  if (isShared()) {
+    m_shared->decRef();
+  }
   m_len = len;
   m_data = buf;
+  m_hash = 0; // still m_shared's bits otherwise
 }
 
 void StringData::dump() {
@@ -259,6 +279,7 @@ void StringData::setChar(int offset, char ch) {
     escalate();
   }
   ((char*)m_data)[offset] = ch;
+  m_hash = 0;
 }
 
 void StringData::removeChar(int offset) {
@@ -272,14 +293,15 @@ void StringData::removeChar(int offset) {
     if (offset < len - 1) {
       memcpy(data + offset, this->data() + offset + 1, len - offset - 1);
     }
-    data[len] = 0;
-    m_len = len;
-    releaseData();
+    data[len - 1] = 0;
+    releaseData(); // before m_len, which tells it what to release
+    m_len = len - 1;
     m_data = data;
   } else {
     m_len = ((m_len & IsMask) | (len - 1));
     memmove((void*)(m_data + offset), m_data + offset + 1, len - offset);
   }
+  m_hash = 0;
 }
 
 void StringData::inc() {
@@ -295,6 +317,7 @@ void StringData::inc() {
   if (overflowed) {
     assign(overflowed, AttachString);
   }
+  m_hash = 0;
 }
 
 void StringData::negate() {
@@ -305,6 +328,7 @@ void StringData::negate() {
   for (int i = 0; i < len; i++) {
     buf[i] = ~(buf[i]);
   }
+  m_hash = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -457,9 +481,16 @@ int StringData::compare(const StringData *v2) const {
   return ret;
 }
 
+SharedVariant *StringData::getSharedVariant() const {
+  // strings in a flat APC array refer to the array
+  if (isShared() && m_shared->is(KindOfString)) return m_shared;
+  return NULL;
+}
+
 int64 StringData::getSharedStringHash() const {
   ASSERT(isShared());
-  return m_shared->stringHash();
+  if (m_shared->is(KindOfString)) return m_shared->stringHash();
+  return hash_string(data(), size());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -78,10 +78,7 @@ class StringData {
   /**
    * Get the wrapped SharedVariant.
    */
-  SharedVariant *getSharedVariant() const {
-    if (isShared()) return m_shared;
-    return NULL;
-  }
+  SharedVariant *getSharedVariant() const;
 
   /**
    * When we have static StringData in SharedStore, we should avoid directly
@@ -103,6 +100,11 @@ class StringData {
   StringData(const char *data, StringDataMode mode = AttachLiteral);
   StringData(const char *data, int len, StringDataMode mode);
   StringData(SharedVariant *shared);
+  /**
+   * A string kept inside an APC array (a FlatArray): shared like the one
+   * above, but the reference is on the array that owns data.
+   */
+  StringData(SharedVariant *owner, const char *data, int len);
 
   void assign(const char *data, StringDataMode mode);
   void assign(const char *data, int len, StringDataMode mode);
@@ -747,14 +747,12 @@ void Array::serialize(VariableSerializer *serializer) const {
 }
 
 void Array::unserialize(VariableUnserializer *unserializer) {
-  std::istream &in = unserializer->in();
-  int64 size;
-  char sep;
-  in >> size >> sep;
+  int64 size = unserializer->readInt();
+  char sep = unserializer->readChar();
   if (sep != ':') {
     throw Exception("Expected ':' but got '%c'", sep);
   }
-  in >> sep;
+  sep = unserializer->readChar();
   if (sep != '{') {
     throw Exception("Expected '{' but got '%c'", sep);
   }
@@ -774,7 +772,7 @@ void Array::unserialize(VariableUnserializer *unserializer) {
     }
   }
 
-  in >> sep;
+  sep = unserializer->readChar();
   if (sep != '}') {
     throw Exception("Expected '}' but got '%c'", sep);
   }
@@ -45,9 +45,10 @@ CVarRef ref(CVarRef v);
  * escalation. This describes all possible escalation paths:
  *
  *   SmallArray --> ZendArray
+ *   HphpArray  --> ZendArray
  *
  * SmallArray escalates to ZendArray when the capacity of the SmallArray is
- * exceeded.
+ * exceeded. HphpArray only escalates to ZendArray for mutable iterations.
  */
 class Array : public SmartPtr<ArrayData> {
  public:
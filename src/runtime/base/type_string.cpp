@@ -19,6 +19,7 @@
 #include <runtime/base/builtin_functions.h>
 #include <runtime/base/comparisons.h>
 #include <runtime/base/variable_serializer.h>
+#include <runtime/base/variable_unserializer.h>
 #include <runtime/base/zend/zend_functions.h>
 #include <runtime/base/zend/zend_string.h>
 #include <runtime/base/zend/zend_printf.h>
@@ -26,8 +27,6 @@
 
 namespace HPHP {
 
-#define SERIALIZE_MAX_SIZE (64*1024*1024)
-
 const String null_string = String();
 const StaticString empty_string("");
 
@@ -596,35 +595,13 @@ void String::serialize(VariableSerializer *serializer) const {
   }
 }
 
-void String::unserialize(std::istream &in,
+void String::unserialize(VariableUnserializer *unserializer,
                          char delimiter0 /* = '"' */,
                          char delimiter1 /* = '"' */) {
   int size;
-  in >> size;
-  if (size >= SERIALIZE_MAX_SIZE) {
-    throw Exception("Size of serialized string (%d) exceeds max", size);
-  }
-
-  char ch;
-  in >> ch;
-  if (ch != ':') {
-    throw Exception("Expected ':' but got '%c'", ch);
-  }
-  in >> ch;
-  if (ch != delimiter0) {
-    throw Exception("Expected '%c' but got '%c'", delimiter0, ch);
-  }
-
-  char *buf = (char*)malloc(size + 1);
-  in.read(buf, size);
-  buf[size] = '\0';
-  SmartPtr<StringData>::operator=(NEW(StringData)(buf, size, AttachString));
-
-  in >> ch;
-  if (ch != delimiter1) {
-    throw Exception("Expected '%c' but got '%c'", delimiter1, ch);
-  }
-
+  const char *data =
+    unserializer->readStringData(size, delimiter0, delimiter1);
+  operator=(unserializer->makeString(data, size));
   checkStatic();
 }
 
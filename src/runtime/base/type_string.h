@@ -262,8 +262,8 @@ public:
    * Input/Output
    */
   void serialize(VariableSerializer *serializer) const;
-  void unserialize(std::istream &in, char delimiter0 = '"',
-                   char delimiter1 = '"');
+  void unserialize(VariableUnserializer *unserializer,
+                   char delimiter0 = '"', char delimiter1 = '"');
 
   /**
    * Check TheStaticStringSet, and upgrade itself to an existing StaticString.
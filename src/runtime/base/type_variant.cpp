@@ -2998,9 +2998,8 @@ void Variant::serialize(VariableSerializer *serializer,
 }
 
 void Variant::unserialize(VariableUnserializer *unserializer) {
-  std::istream &in = unserializer->in();
-  char type, sep;
-  in >> type >> sep;
+  char type = unserializer->readChar();
+  char sep = unserializer->readChar();
 
   if (type != 'R') {
     unserializer->add(this);
@@ -3018,8 +3017,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
   switch (type) {
   case 'r':
     {
-      int64 id;
-      in >> id;
+      int64 id = unserializer->readInt();
       Variant *v = unserializer->get(id);
       if (v == NULL) {
         throw Exception("Id %ld out of range", id);
@@ -3029,8 +3027,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
     break;
   case 'R':
     {
-      int64 id;
-      in >> id;
+      int64 id = unserializer->readInt();
       Variant *v = unserializer->get(id);
       if (v == NULL) {
         throw Exception("Id %ld out of range", id);
@@ -3038,33 +3035,33 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
       operator=(ref(*v));
     }
     break;
-  case 'b': { int64 v;  in >> v; operator=((bool)v); } break;
-  case 'i': { int64 v;  in >> v; operator=(v);       } break;
+  case 'b': operator=((bool)unserializer->readInt()); break;
+  case 'i': operator=(unserializer->readInt());       break;
   case 'd':
     {
       double v;
-      char ch = in.peek();
+      char ch = unserializer->peek();
       bool negative = false;
       char buf[4];
       if (ch == '-') {
         negative = true;
-        in >> ch;
-        ch = in.peek();
+        unserializer->readChar();
+        ch = unserializer->peek();
       }
       if (ch == 'I') {
-        in.read(buf, 3); buf[3] = '\0';
+        memcpy(buf, unserializer->readRaw(3), 3); buf[3] = '\0';
         if (strcmp(buf, "INF")) {
           throw Exception("Expected 'INF' but got '%s'", buf);
         }
         v = atof("inf");
       } else if (ch == 'N') {
-        in.read(buf, 3); buf[3] = '\0';
+        memcpy(buf, unserializer->readRaw(3), 3); buf[3] = '\0';
         if (strcmp(buf, "NAN")) {
           throw Exception("Expected 'NAN' but got '%s'", buf);
         }
         v = atof("nan");
       } else {
-        in >> v;
+        v = unserializer->readDouble();
       }
       operator=(negative ? -v : v);
     }
@@ -3072,7 +3069,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
   case 's':
     {
       String v;
-      v.unserialize(in);
+      v.unserialize(unserializer);
       operator=(v);
     }
     break;
@@ -3082,7 +3079,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
         char buf[8];
         StringData *sd;
       } u;
-      in.read(u.buf, 8);
+      memcpy(u.buf, unserializer->readRaw(8), 8);
       operator=(u.sd);
     }
     break;
@@ -3100,16 +3097,16 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
         char buf[8];
         ArrayData *ad;
       } u;
-      in.read(u.buf, 8);
+      memcpy(u.buf, unserializer->readRaw(8), 8);
       operator=(u.ad);
     }
     break;
   case 'o':
     {
       String clsName;
-      clsName.unserialize(in);
+      clsName.unserialize(unserializer);
 
-      in >> sep;
+      sep = unserializer->readChar();
       if (sep != ':') {
         throw Exception("Expected ':' but got '%c'", sep);
       }
@@ -3133,9 +3130,9 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
   case 'O':
     {
       String clsName;
-      clsName.unserialize(in);
+      clsName.unserialize(unserializer);
 
-      in >> sep;
+      sep = unserializer->readChar();
       if (sep != ':') {
         throw Exception("Expected ':' but got '%c'", sep);
       }
@@ -3148,13 +3145,12 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
         obj->o_set("__PHP_Incomplete_Class_Name", -1, clsName);
       }
       operator=(obj);
-      int64 size;
-      char sep;
-      in >> size >> sep;
+      int64 size = unserializer->readInt();
+      sep = unserializer->readChar();
       if (sep != ':') {
         throw Exception("Expected ':' but got '%c'", sep);
       }
-      in >> sep;
+      sep = unserializer->readChar();
       if (sep != '{') {
         throw Exception("Expected '{' but got '%c'", sep);
       }
@@ -3181,7 +3177,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
           value.unserialize(unserializer);
         }
       }
-      in >> sep;
+      sep = unserializer->readChar();
       if (sep != '}') {
         throw Exception("Expected '}' but got '%c'", sep);
       }
@@ -3193,9 +3189,9 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
   case 'C':
     {
       String clsName;
-      clsName.unserialize(in);
+      clsName.unserialize(unserializer);
 
-      in >> sep;
+      sep = unserializer->readChar();
       if (sep != ':') {
         throw Exception("Expected ':' but got '%c'", sep);
       }
@@ -3207,7 +3203,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
       operator=(obj);
 
       String serialized;
-      serialized.unserialize(in, '{', '}');
+      serialized.unserialize(unserializer, '{', '}');
       obj->o_invoke_mil("unserialize",
                     CREATE_VECTOR1(serialized), -1);
 
@@ -3217,7 +3213,7 @@ void Variant::unserialize(VariableUnserializer *unserializer) {
   default:
     throw Exception("Unknown type '%c'", type);
   }
-  in >> sep;
+  sep = unserializer->readChar();
   if (sep != ';') {
     throw Exception("Expected ';' but got '%c'", sep);
   }
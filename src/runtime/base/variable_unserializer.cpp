@@ -0,0 +1,132 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/complex_types.h>
+#include <runtime/base/variable_unserializer.h>
+#include <util/exception.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+#define SERIALIZE_MAX_SIZE (64*1024*1024)
+
+VariableUnserializer::~VariableUnserializer() {
+  delete [] m_keys;
+}
+
+void VariableUnserializer::throwEnd() {
+  throw Exception("Unexpected end of serialized data");
+}
+
+int64 VariableUnserializer::readInt() {
+  char ch = readChar();
+  bool negative = ch == '-';
+  if (negative || ch == '+') {
+    if (m_buf == m_end) throwEnd();
+    ch = *m_buf++;
+  }
+  if (ch < '0' || ch > '9') {
+    throw Exception("Expected a digit but got '%c'", ch);
+  }
+  // largest magnitude allowed: 2^63 - 1, or 2^63 when negative
+  uint64 limit = 0x7FFFFFFFFFFFFFFFULL + (negative ? 1 : 0);
+  uint64 v = ch - '0';
+  while (m_buf < m_end && *m_buf >= '0' && *m_buf <= '9') {
+    unsigned digit = *m_buf++ - '0';
+    if (v > (limit - digit) / 10) {
+      throw Exception("Integer in serialized data is out of range");
+    }
+    v = v * 10 + digit;
+  }
+  return negative ? (int64)(0 - v) : (int64)v;
+}
+
+double VariableUnserializer::readDouble() {
+  while (m_buf < m_end && isSpace(*m_buf)) m_buf++;
+  int len = 0;
+  while (m_buf + len < m_end) {
+    char ch = m_buf[len];
+    if ((ch < '0' || ch > '9') && ch != '.' && ch != 'e' && ch != 'E' &&
+        ch != '-' && ch != '+') {
+      break;
+    }
+    len++;
+  }
+  // copied out, as strtod() needs the number terminated; the whole number
+  // is copied, on the heap when it does not fit the stack buffer
+  char sbuf[64];
+  std::string hbuf;
+  const char *buf;
+  if (len < (int)sizeof(sbuf)) {
+    memcpy(sbuf, m_buf, len);
+    sbuf[len] = '\0';
+    buf = sbuf;
+  } else {
+    hbuf.assign(m_buf, len);
+    buf = hbuf.c_str();
+  }
+  char *end;
+  double v = strtod(buf, &end);
+  if (end == buf) {
+    if (m_buf == m_end) throwEnd();
+    throw Exception("Expected a number but got '%c'", *m_buf);
+  }
+  m_buf += end - buf;
+  return v;
+}
+
+const char *VariableUnserializer::readStringData(int &size,
+                                                 char delimiter0 /* = '"' */,
+                                                 char delimiter1 /* = '"' */) {
+  int64 len = readInt();
+  if (len < 0 || len >= SERIALIZE_MAX_SIZE) {
+    throw Exception("Size of serialized string (%lld) exceeds max", len);
+  }
+
+  char ch = readChar();
+  if (ch != ':') {
+    throw Exception("Expected ':' but got '%c'", ch);
+  }
+  ch = readChar();
+  if (ch != delimiter0) {
+    throw Exception("Expected '%c' but got '%c'", delimiter0, ch);
+  }
+  size = len;
+  const char *data = readRaw(size);
+  ch = readChar();
+  if (ch != delimiter1) {
+    throw Exception("Expected '%c' but got '%c'", delimiter1, ch);
+  }
+  return data;
+}
+
+String VariableUnserializer::makeString(const char *data, int len) {
+  if (!m_key || len == 0) {
+    return String(data, len, CopyString);
+  }
+  if (!m_keys) m_keys = new String[KeyCacheSize];
+  // cheaper than hashing, and keys of one shape rarely collide
+  unsigned char first = data[0];
+  unsigned char last = data[len - 1];
+  String &key = m_keys[(len + first * 7 + last * 31) & (KeyCacheSize - 1)];
+  if (key.size() != len || memcmp(key.data(), data, len)) {
+    key = String(data, len, CopyString);
+  }
+  return key;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
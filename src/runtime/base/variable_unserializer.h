@@ -22,9 +22,21 @@
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Reads what VariableSerializer writes, scanning the input in place in one
+ * pass. Nothing is copied out of it but the bytes of strings that end up in
+ * values.
+ */
 class VariableUnserializer {
 public:
-  VariableUnserializer(std::istream &in) : m_in(in), m_key(false) {}
+  /**
+   * Reads from the len bytes at buf, which have to stay around while
+   * unserializing.
+   */
+  VariableUnserializer(const char *buf, int len)
+    : m_start(buf), m_buf(buf), m_end(buf + len), m_keys(NULL),
+      m_key(false) {}
+  ~VariableUnserializer();
 
   Variant unserialize() {
     Variant v;
@@ -40,9 +52,46 @@ public:
     return v;
   }
 
-  std::istream &in() const {
-    return m_in;
+  /**
+   * Number of bytes read so far.
+   */
+  int consumed() const { return m_buf - m_start;}
+
+  /**
+   * Scanning, the way operator>>() on an istream used to: readChar() and
+   * readInt() skip whitespace first, peek() and readRaw() do not. All throw
+   * at the end of the input, except for peek(), which gives '\0' there.
+   */
+  char peek() const { return m_buf < m_end ? *m_buf : '\0';}
+  char readChar() {
+    while (m_buf < m_end && isSpace(*m_buf)) m_buf++;
+    if (m_buf == m_end) throwEnd();
+    return *m_buf++;
+  }
+  int64 readInt();
+  double readDouble();
+  const char *readRaw(int len) {
+    if (len < 0 || len > m_end - m_buf) throwEnd();
+    const char *p = m_buf;
+    m_buf += len;
+    return p;
   }
+
+  /**
+   * Reads a string's size:"data" and gives back where its data is, without
+   * copying it. Other delimiters than '"' are for Serializable objects'
+   * size:{data}.
+   */
+  const char *readStringData(int &size, char delimiter0 = '"',
+                             char delimiter1 = '"');
+
+  /**
+   * A string of the len bytes at data. For array keys and property names,
+   * the same bytes give back the same string, so arrays and objects of the
+   * same shape share their keys, and the keys' hashes.
+   */
+  String makeString(const char *data, int len);
+
   void add(Variant* v) {
     if (!m_key) {
       m_refs.push_back(v);
@@ -54,9 +103,19 @@ public:
   }
 
  private:
-  std::istream &m_in;
+  static const int KeyCacheSize = 64; // power of 2
+
+  const char *m_start;
+  const char *m_buf;
+  const char *m_end;
   std::vector<Variant*> m_refs;
+  String *m_keys; // KeyCacheSize of them, once there are keys
   bool m_key;
+
+  static bool isSpace(char ch) {
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+  }
+  static void throwEnd();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -17,6 +17,9 @@
 #include <runtime/eval/ast/assignment_op_expression.h>
 #include <runtime/eval/ast/lval_expression.h>
 #include <runtime/eval/parser/hphp.tab.hpp>
+#include <runtime/eval/bytecode/byte_code_program.h>
+#include <runtime/eval/ast/variable_expression.h>
+#include <runtime/base/runtime_option.h>
 
 namespace HPHP {
 namespace Eval {
@@ -61,6 +64,21 @@ Variant AssignmentOpExpression::refval(VariableEnvironment &env,
   return ref(eval(env));
 }
 
+void AssignmentOpExpression::byteCode(ByteCodeProgram &code) const {
+  const VariableExpression *var =
+    dynamic_cast<const VariableExpression *>(m_lhs.get());
+  if (!var || var->idx() == -1 || RuntimeOption::EnableStrict) {
+    code.addExpr(this);
+    return;
+  }
+  m_rhs->byteCode(code);
+  if (m_op == '=') {
+    code.add(ByteCode::SetLocal, NULL, var->idx());
+  } else {
+    code.add(ByteCode::SetOpLocal, var, var->idx(), m_op);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -16,6 +16,7 @@
 
 #include <runtime/eval/ast/binary_op_expression.h>
 #include <runtime/eval/parser/hphp.tab.hpp>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -102,6 +103,58 @@ void BinaryOpExpression::dump() const {
   m_exp2->dump();
 }
 
+void BinaryOpExpression::byteCode(ByteCodeProgram &code) const {
+  int op;
+  switch (m_op) {
+  case T_LOGICAL_OR:
+  case T_BOOLEAN_OR:
+  case T_LOGICAL_AND:
+  case T_BOOLEAN_AND:
+    {
+      bool isAnd = m_op == T_LOGICAL_AND || m_op == T_BOOLEAN_AND;
+      int jump = isAnd ? ByteCode::JmpZ : ByteCode::JmpNZ;
+      m_exp1->byteCode(code);
+      int j1 = code.add(jump);
+      m_exp2->byteCode(code);
+      int j2 = code.add(jump);
+      code.add(isAnd ? ByteCode::True : ByteCode::False);
+      int end = code.add(ByteCode::Jmp);
+      code.setTarget(j1, code.size());
+      code.setTarget(j2, code.size());
+      code.add(isAnd ? ByteCode::False : ByteCode::True);
+      code.setTarget(end, code.size());
+      return;
+    }
+  case T_LOGICAL_XOR:         op = ByteCode::LogXor;    break;
+  case '|':                   op = ByteCode::BitOr;     break;
+  case '&':                   op = ByteCode::BitAnd;    break;
+  case '^':                   op = ByteCode::BitXor;    break;
+  case '.':                   op = ByteCode::Concat;    break;
+  case '+':                   op = ByteCode::Add;       break;
+  case '-':                   op = ByteCode::Sub;       break;
+  case '*':                   op = ByteCode::Mul;       break;
+  case '/':                   op = ByteCode::Div;       break;
+  case '%':                   op = ByteCode::Mod;       break;
+  case T_SL:                  op = ByteCode::Shl;       break;
+  case T_SR:                  op = ByteCode::Shr;       break;
+  case T_IS_IDENTICAL:        op = ByteCode::Same;      break;
+  case T_IS_NOT_IDENTICAL:    op = ByteCode::NotSame;   break;
+  case T_IS_EQUAL:            op = ByteCode::Equal;     break;
+  case T_IS_NOT_EQUAL:        op = ByteCode::NotEqual;  break;
+  case '<':                   op = ByteCode::Less;      break;
+  case T_IS_SMALLER_OR_EQUAL: op = ByteCode::LessEqual; break;
+  case '>':                   op = ByteCode::More;      break;
+  case T_IS_GREATER_OR_EQUAL: op = ByteCode::MoreEqual; break;
+  default:
+    ASSERT(false);
+    code.addExpr(this);
+    return;
+  }
+  m_exp1->byteCode(code);
+  m_exp2->byteCode(code);
+  code.add(op);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -30,6 +30,7 @@ public:
   BinaryOpExpression(EXPRESSION_ARGS, ExpressionPtr exp1, int op,
                      ExpressionPtr exp2);
   virtual Variant eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   ExpressionPtr m_exp1;
@@ -17,6 +17,8 @@
 #include <runtime/eval/ast/break_statement.h>
 #include <runtime/eval/ast/expression.h>
 #include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
+#include <runtime/eval/ast/scalar_expression.h>
 
 namespace HPHP {
 namespace Eval {
@@ -51,6 +53,18 @@ void BreakStatement::dump() const {
   printf(";");
 }
 
+void BreakStatement::byteCode(ByteCodeProgram &code) const {
+  int64 level = 1;
+  if (m_level) {
+    ScalarExpressionPtr scalar = m_level->cast<ScalarExpression>();
+    level = scalar ? scalar->getValue().toInt64() : 0;
+  }
+  // dynamic levels, and levels out of the function, are left to the AST
+  if (level <= 0 || !code.addBreak(level, m_isBreak)) {
+    code.addStmt(this);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
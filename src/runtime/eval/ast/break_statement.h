@@ -30,6 +30,7 @@ class BreakStatement : public Statement {
 public:
   BreakStatement(STATEMENT_ARGS, ExpressionPtr level, bool isBreak);
   virtual void eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   ExpressionPtr m_level;
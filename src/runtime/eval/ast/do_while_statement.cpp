@@ -17,6 +17,7 @@
 #include <runtime/eval/ast/do_while_statement.h>
 #include <runtime/eval/ast/expression.h>
 #include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -42,6 +43,17 @@ void DoWhileStatement::dump() const {
   printf(");");
 }
 
+void DoWhileStatement::byteCode(ByteCodeProgram &code) const {
+  code.addLine(this);
+  int loop = code.beginLoop();
+  int top = code.size();
+  if (m_body) m_body->byteCode(code);
+  code.setContinueTarget(loop, code.size());
+  m_cond->byteCode(code);
+  code.add(ByteCode::JmpNZ, NULL, top);
+  code.endLoop(loop);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
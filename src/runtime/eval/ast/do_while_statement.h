@@ -30,6 +30,7 @@ class DoWhileStatement : public Statement {
 public:
   DoWhileStatement(STATEMENT_ARGS, StatementPtr body, ExpressionPtr cond);
   virtual void eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   ExpressionPtr m_cond;
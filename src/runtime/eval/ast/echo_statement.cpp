@@ -16,6 +16,7 @@
 
 #include <runtime/eval/ast/echo_statement.h>
 #include <runtime/eval/ast/expression.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 using namespace std;
 
@@ -41,6 +42,15 @@ void EchoStatement::dump() const {
   printf(");");
 }
 
+void EchoStatement::byteCode(ByteCodeProgram &code) const {
+  code.addLine(this);
+  for (vector<ExpressionPtr>::const_iterator it = m_args.begin();
+       it != m_args.end(); ++it) {
+    (*it)->byteCode(code);
+    code.add(ByteCode::Echo);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -30,6 +30,7 @@ class EchoStatement : public Statement {
 public:
   EchoStatement(STATEMENT_ARGS, const std::vector<ExpressionPtr> &args);
   virtual void eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   std::vector<ExpressionPtr> m_args;
@@ -16,6 +16,7 @@
 
 #include <runtime/eval/ast/expr_statement.h>
 #include <runtime/eval/ast/expression.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -39,6 +40,12 @@ void ExprStatement::dump() const {
   printf(";");
 }
 
+void ExprStatement::byteCode(ByteCodeProgram &code) const {
+  code.addLine(this);
+  m_exp->byteCode(code);
+  code.add(ByteCode::Pop);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -30,6 +30,7 @@ class ExprStatement : public Statement {
 public:
   ExprStatement(STATEMENT_ARGS, ExpressionPtr exp);
   virtual void eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   ExpressionPtr m_exp;
@@ -18,6 +18,7 @@
 #include <runtime/eval/ast/lval_expression.h>
 #include <runtime/eval/ast/name.h>
 #include <runtime/eval/parser/hphp.tab.hpp>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -65,6 +66,10 @@ bool Expression::isRefParam() const {
   return false;
 }
 
+void Expression::byteCode(ByteCodeProgram &code) const {
+  code.addExpr(this);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -41,6 +41,11 @@ public:
   virtual Variant evalExist(VariableEnvironment &env) const;
   virtual const LvalExpression *toLval() const;
   virtual bool isRefParam() const;
+  /**
+   * Appends code that pushes the value of this expression. By default the
+   * program walks it as AST.
+   */
+  virtual void byteCode(ByteCodeProgram &code) const;
 
   static Variant evalVector(const std::vector<ExpressionPtr> &v,
                             VariableEnvironment &env);
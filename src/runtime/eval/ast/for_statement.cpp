@@ -17,6 +17,7 @@
 #include <runtime/eval/ast/for_statement.h>
 #include <runtime/eval/ast/expression.h>
 #include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -54,6 +55,33 @@ void ForStatement::dump() const {
 
 }
 
+static void byte_code_vector(ByteCodeProgram &code,
+                             const std::vector<ExpressionPtr> &v,
+                             bool keepLast) {
+  for (unsigned int i = 0; i < v.size(); i++) {
+    v[i]->byteCode(code);
+    if (!keepLast || i + 1 < v.size()) code.add(ByteCode::Pop);
+  }
+}
+
+void ForStatement::byteCode(ByteCodeProgram &code) const {
+  code.addLine(this);
+  byte_code_vector(code, m_init, false);
+  int loop = code.beginLoop();
+  int top = code.size();
+  int exit = -1;
+  if (!m_cond.empty()) {
+    byte_code_vector(code, m_cond, true);
+    exit = code.add(ByteCode::JmpZ);
+  }
+  if (m_body) m_body->byteCode(code);
+  code.setContinueTarget(loop, code.size());
+  byte_code_vector(code, m_next, false);
+  code.add(ByteCode::Jmp, NULL, top);
+  if (exit >= 0) code.setTarget(exit, code.size());
+  code.endLoop(loop);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -34,6 +34,7 @@ public:
                const std::vector<ExpressionPtr> &next,
                StatementPtr body);
   virtual void eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   std::vector<ExpressionPtr> m_init;
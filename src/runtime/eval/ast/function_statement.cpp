@@ -30,6 +30,7 @@
 #include <runtime/eval/strict_mode.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/intercept.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -156,10 +157,12 @@ void Parameter::dropDefault() {
 FunctionStatement::FunctionStatement(STATEMENT_ARGS, const string &name,
                                      const string &doc)
   : Statement(STATEMENT_PASS), m_name(name),
-    m_lname(Util::toLower(m_name)), m_maybeIntercepted(-1), m_docComment(doc) {
+    m_lname(Util::toLower(m_name)), m_byteCode(NULL), m_maybeIntercepted(-1),
+    m_docComment(doc) {
 }
 FunctionStatement::~FunctionStatement() {
   unregister_intercept_flag(&m_maybeIntercepted);
+  delete m_byteCode;
 }
 
 void FunctionStatement::init(bool ref, const vector<ParameterPtr> params,
@@ -180,6 +183,16 @@ void FunctionStatement::init(bool ref, const vector<ParameterPtr> params,
       m_params[i]->dropDefault();
     }
   }
+
+  // the debugger and code coverage need every construct to set its line
+  if (m_body && RuntimeOption::BytecodeInterpreter &&
+      !RuntimeOption::EnableDebugger && !RuntimeOption::RecordCodeCoverage) {
+    m_byteCode = ByteCodeProgram::Compile(m_body.get(), m_ref);
+    if (m_byteCode && RuntimeOption::DumpBytecode) {
+      printf("%s:\n", fullName().c_str());
+      m_byteCode->dump();
+    }
+  }
 }
 
 const string &FunctionStatement::fullName() const {
@@ -265,7 +278,11 @@ Variant FunctionStatement::evalBody(VariableEnvironment &env) const {
   }
 
   if (m_body) {
-    m_body->eval(env);
+    if (m_byteCode) {
+      m_byteCode->execute(env);
+    } else {
+      m_body->eval(env);
+    }
     if (env.isReturning()) {
       if (m_ref) {
         ret.setContagious();
@@ -36,6 +36,7 @@ DECLARE_AST_PTR(Name);
 DECLARE_AST_PTR(StaticStatement);
 class FunctionCallExpression;
 class FuncScopeVariableEnvironment;
+class ByteCodeProgram;
 
 class Parameter : public Construct {
 public:
@@ -92,6 +93,7 @@ protected:
   std::vector<ParameterPtr> m_params;
 
   StatementListStatementPtr m_body;
+  ByteCodeProgram *m_byteCode;
   bool m_hasCallToGetArgs;
   mutable char m_maybeIntercepted;
 
@@ -17,6 +17,7 @@
 #include <runtime/eval/ast/if_statement.h>
 #include <runtime/eval/ast/expression.h>
 #include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -75,6 +76,23 @@ void IfStatement::dump() const {
   }
 }
 
+void IfStatement::byteCode(ByteCodeProgram &code) const {
+  code.addLine(this);
+  vector<int> ends;
+  for (vector<IfBranchPtr>::const_iterator it = m_branches.begin();
+       it != m_branches.end(); ++it) {
+    (*it)->cond()->byteCode(code);
+    int next = code.add(ByteCode::JmpZ);
+    if ((*it)->body()) (*it)->body()->byteCode(code);
+    ends.push_back(code.add(ByteCode::Jmp));
+    code.setTarget(next, code.size());
+  }
+  if (m_else) m_else->byteCode(code);
+  for (unsigned int i = 0; i < ends.size(); i++) {
+    code.setTarget(ends[i], code.size());
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -16,6 +16,8 @@
 
 #include <runtime/eval/ast/inc_op_expression.h>
 #include <runtime/eval/ast/lval_expression.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
+#include <runtime/eval/ast/variable_expression.h>
 
 namespace HPHP {
 namespace Eval {
@@ -68,6 +70,22 @@ void IncOpExpression::dump() const {
   }
 }
 
+void IncOpExpression::byteCode(ByteCodeProgram &code) const {
+  const VariableExpression *var =
+    dynamic_cast<const VariableExpression *>(m_exp.get());
+  if (!var || var->idx() == -1) {
+    code.addExpr(this);
+    return;
+  }
+  int op;
+  if (m_inc) {
+    op = m_front ? ByteCode::PreIncLocal : ByteCode::PostIncLocal;
+  } else {
+    op = m_front ? ByteCode::PreDecLocal : ByteCode::PostDecLocal;
+  }
+  code.add(op, NULL, var->idx());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
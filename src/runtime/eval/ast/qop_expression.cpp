@@ -15,6 +15,7 @@
 */
 
 #include <runtime/eval/ast/qop_expression.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -41,6 +42,16 @@ void QOpExpression::dump() const {
   m_false->dump();
 }
 
+void QOpExpression::byteCode(ByteCodeProgram &code) const {
+  m_cond->byteCode(code);
+  int jumpFalse = code.add(ByteCode::JmpZ);
+  m_true->byteCode(code);
+  int end = code.add(ByteCode::Jmp);
+  code.setTarget(jumpFalse, code.size());
+  m_false->byteCode(code);
+  code.setTarget(end, code.size());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
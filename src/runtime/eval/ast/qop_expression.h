@@ -30,6 +30,7 @@ public:
   QOpExpression(EXPRESSION_ARGS, ExpressionPtr cond, ExpressionPtr t,
                 ExpressionPtr f);
   virtual Variant eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   ExpressionPtr m_cond;
@@ -18,6 +18,7 @@
 #include <runtime/eval/ast/expression.h>
 #include <runtime/eval/ast/lval_expression.h>
 #include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -48,6 +49,20 @@ void ReturnStatement::dump() const {
   printf(";");
 }
 
+void ReturnStatement::byteCode(ByteCodeProgram &code) const {
+  if (m_value && code.refReturn()) {
+    code.addStmt(this);
+    return;
+  }
+  code.addLine(this);
+  if (m_value) {
+    m_value->byteCode(code);
+    code.add(ByteCode::Ret);
+  } else {
+    code.add(ByteCode::RetNull);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
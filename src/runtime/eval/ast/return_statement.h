@@ -30,6 +30,7 @@ class ReturnStatement : public Statement {
 public:
   ReturnStatement(STATEMENT_ARGS, ExpressionPtr value);
   virtual void eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   ExpressionPtr m_value;
@@ -16,6 +16,7 @@
 
 #include <runtime/eval/ast/scalar_expression.h>
 #include <runtime/eval/parser/hphp.tab.hpp>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -112,6 +113,32 @@ void ScalarExpression::dump() const {
   }
 }
 
+void ScalarExpression::byteCode(ByteCodeProgram &code) const {
+  switch (m_kind) {
+  case SNull:
+    code.add(ByteCode::Null);
+    break;
+  case SBool:
+    code.add(m_num.num ? ByteCode::True : ByteCode::False);
+    break;
+  case SString:
+    if (!m_binary) {
+      code.addString(m_value.c_str());
+    } else {
+      code.addExpr(this);
+    }
+    break;
+  case SInt:
+    code.addInt(m_num.num);
+    break;
+  case SDouble:
+    code.addDouble(m_num.dbl);
+    break;
+  default:
+    ASSERT(false);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -32,6 +32,7 @@ public:
   ScalarExpression(EXPRESSION_ARGS, const std::string &s);
   ScalarExpression(EXPRESSION_ARGS, int type, const std::string &val);
   virtual Variant eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   Variant getValue() const;
   virtual void dump() const;
 private:
@@ -14,13 +14,14 @@
    +----------------------------------------------------------------------+
 */
 #include <runtime/eval/ast/statement.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
 ///////////////////////////////////////////////////////////////////////////////
 
 void Statement::byteCode(ByteCodeProgram &code) const {
-  throw FatalErrorException("Cannot compile %s:%d", m_loc.file, m_loc.line1);
+  code.addStmt(this);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -34,6 +34,10 @@ class Statement : public Construct {
 public:
   Statement(STATEMENT_ARGS) : Construct(CONSTRUCT_PASS) {};
   virtual void eval(VariableEnvironment &env) const = 0;
+  /**
+   * Appends this statement to a bytecode program. By default the program
+   * walks it as AST.
+   */
   virtual void byteCode(ByteCodeProgram &code) const;
 };
 
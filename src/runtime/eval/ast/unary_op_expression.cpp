@@ -19,6 +19,7 @@
 #include <runtime/ext/ext_misc.h>
 #include <runtime/eval/eval.h>
 #include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -112,6 +113,25 @@ void UnaryOpExpression::dumpOp() const {
   printf("%s", op);
 }
 
+void UnaryOpExpression::byteCode(ByteCodeProgram &code) const {
+  switch (m_op) {
+  case '(':
+    m_exp->byteCode(code);
+    break;
+  case '!':
+    m_exp->byteCode(code);
+    code.add(ByteCode::Not);
+    break;
+  case '-':
+    m_exp->byteCode(code);
+    code.add(ByteCode::Negate);
+    break;
+  default:
+    code.addExpr(this);
+    break;
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
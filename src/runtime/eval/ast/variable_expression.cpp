@@ -19,6 +19,7 @@
 #include <runtime/eval/ast/name.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/eval/strict_mode.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -126,6 +127,14 @@ void VariableExpression::dump() const {
   m_name->dump();
 }
 
+void VariableExpression::byteCode(ByteCodeProgram &code) const {
+  if (m_idx != -1) {
+    code.add(ByteCode::GetLocal, this, m_idx);
+  } else {
+    code.addExpr(this);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -30,6 +30,7 @@ class VariableExpression : public LvalExpression {
 public:
   VariableExpression(EXPRESSION_ARGS, NamePtr name, int idx = -1);
   virtual Variant eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual Variant evalExist(VariableEnvironment &env) const;
   virtual Variant &lval(VariableEnvironment &env) const;
   virtual bool weakLval(VariableEnvironment &env, Variant* &v) const;
@@ -37,6 +38,7 @@ public:
   virtual Variant set(VariableEnvironment &env, CVarRef val) const;
   virtual Variant setOp(VariableEnvironment &env, int op, CVarRef rhs) const;
   NamePtr getName() const;
+  int idx() const { return m_idx; }
   virtual void dump() const;
 private:
   NamePtr m_name;
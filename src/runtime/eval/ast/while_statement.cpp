@@ -17,6 +17,7 @@
 #include <runtime/eval/ast/while_statement.h>
 #include <runtime/eval/ast/expression.h>
 #include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/bytecode/byte_code_program.h>
 
 namespace HPHP {
 namespace Eval {
@@ -42,6 +43,19 @@ void WhileStatement::dump() const {
   printf("}");
 }
 
+void WhileStatement::byteCode(ByteCodeProgram &code) const {
+  code.addLine(this);
+  int loop = code.beginLoop();
+  int top = code.size();
+  code.setContinueTarget(loop, top);
+  m_cond->byteCode(code);
+  int exit = code.add(ByteCode::JmpZ);
+  if (m_body) m_body->byteCode(code);
+  code.add(ByteCode::Jmp, NULL, top);
+  code.setTarget(exit, code.size());
+  code.endLoop(loop);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -30,6 +30,7 @@ class WhileStatement : public Statement {
 public:
   WhileStatement(STATEMENT_ARGS, ExpressionPtr cond, StatementPtr body);
   virtual void eval(VariableEnvironment &env) const;
+  virtual void byteCode(ByteCodeProgram &code) const;
   virtual void dump() const;
 private:
   ExpressionPtr m_cond;
@@ -0,0 +1,398 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/eval/bytecode/byte_code_program.h>
+#include <runtime/eval/ast/statement.h>
+#include <runtime/eval/ast/expression.h>
+#include <runtime/eval/ast/lval_expression.h>
+#include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/runtime/eval_state.h>
+
+namespace HPHP {
+namespace Eval {
+using namespace std;
+///////////////////////////////////////////////////////////////////////////////
+
+const char *ByteCode::Name(int op) {
+#define BYTE_CODE_NAME(name) #name,
+  static const char *names[] = {
+    BYTE_CODE_OPS(BYTE_CODE_NAME)
+  };
+#undef BYTE_CODE_NAME
+  ASSERT(op >= 0 && op < OpCount);
+  return names[op];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// compiling
+
+ByteCodeProgram::ByteCodeProgram(bool refReturn)
+  : m_currentLoop(-1), m_native(0), m_refReturn(refReturn) {
+}
+
+ByteCodeProgram *ByteCodeProgram::Compile(const Statement *body,
+                                          bool refReturn) {
+  ByteCodeProgram *prog = new ByteCodeProgram(refReturn);
+  body->byteCode(*prog);
+  if (prog->m_native == 0) {
+    // every statement walks the AST anyway
+    delete prog;
+    return NULL;
+  }
+  prog->add(ByteCode::Exit);
+  prog->finish();
+  return prog;
+}
+
+int ByteCodeProgram::add(int op, const Construct *ast /* = NULL */,
+                         int arg /* = 0 */, int sub /* = 0 */) {
+  ByteCode bc;
+  bc.op = op;
+  bc.sub = sub;
+  bc.arg = arg;
+  bc.ast = ast;
+  m_code.push_back(bc);
+  switch (op) {
+  case ByteCode::Line:
+  case ByteCode::EvalStmt:
+  case ByteCode::EvalExpr:
+  case ByteCode::Pop:
+  case ByteCode::Ret:
+  case ByteCode::RetNull:
+    break;
+  default:
+    m_native++;
+    break;
+  }
+  return m_code.size() - 1;
+}
+
+void ByteCodeProgram::addInt(int64 num) {
+  m_code[add(ByteCode::Int)].num = num;
+}
+
+void ByteCodeProgram::addDouble(double dbl) {
+  m_code[add(ByteCode::Double)].dbl = dbl;
+}
+
+void ByteCodeProgram::addString(const char *str) {
+  m_code[add(ByteCode::String)].str = str;
+}
+
+void ByteCodeProgram::addLine(const Construct *c) {
+  add(ByteCode::Line, NULL, c->loc()->line1);
+}
+
+void ByteCodeProgram::addStmt(const Statement *stmt) {
+  add(ByteCode::EvalStmt, stmt, m_currentLoop);
+}
+
+void ByteCodeProgram::addExpr(const Expression *exp) {
+  add(ByteCode::EvalExpr, exp);
+}
+
+int ByteCodeProgram::beginLoop() {
+  Loop loop;
+  loop.parent = m_currentLoop;
+  loop.breakTarget = -1;
+  loop.continueTarget = -1;
+  m_loops.push_back(loop);
+  m_currentLoop = m_loops.size() - 1;
+  return m_currentLoop;
+}
+
+void ByteCodeProgram::setContinueTarget(int loop, int target) {
+  m_loops[loop].continueTarget = target;
+}
+
+void ByteCodeProgram::endLoop(int loop) {
+  ASSERT(loop == m_currentLoop);
+  m_loops[loop].breakTarget = size();
+  m_currentLoop = m_loops[loop].parent;
+}
+
+bool ByteCodeProgram::addBreak(int level, bool isBreak) {
+  int loop = m_currentLoop;
+  for (; loop >= 0 && level > 1; level--) {
+    loop = m_loops[loop].parent;
+  }
+  if (loop < 0) return false;
+  add(isBreak ? ByteCode::Break : ByteCode::Continue, NULL, loop);
+  return true;
+}
+
+void ByteCodeProgram::finish() {
+  ASSERT(m_currentLoop == -1);
+  for (unsigned int i = 0; i < m_code.size(); i++) {
+    ByteCode &bc = m_code[i];
+    if (bc.op == ByteCode::Break) {
+      bc.op = ByteCode::Jmp;
+      bc.arg = m_loops[bc.arg].breakTarget;
+    } else if (bc.op == ByteCode::Continue) {
+      bc.op = ByteCode::Jmp;
+      bc.arg = m_loops[bc.arg].continueTarget;
+    }
+  }
+}
+
+void ByteCodeProgram::dump() const {
+  for (unsigned int i = 0; i < m_code.size(); i++) {
+    const ByteCode &bc = m_code[i];
+    printf("%5d  %-14s", i, ByteCode::Name(bc.op));
+    switch (bc.op) {
+    case ByteCode::Int:    printf("%lld", bc.num);                   break;
+    case ByteCode::Double: printf("%g", bc.dbl);                     break;
+    case ByteCode::String: printf("\"%s\"", bc.str);                 break;
+    case ByteCode::EvalStmt:
+    case ByteCode::EvalExpr:
+      printf("line %d", bc.ast->loc()->line1);
+      break;
+    case ByteCode::SetOpLocal:
+      printf("%d, %d", bc.arg, bc.sub);
+      break;
+    case ByteCode::Line:
+    case ByteCode::GetLocal:
+    case ByteCode::SetLocal:
+    case ByteCode::PreIncLocal:
+    case ByteCode::PostIncLocal:
+    case ByteCode::PreDecLocal:
+    case ByteCode::PostDecLocal:
+    case ByteCode::Jmp:
+    case ByteCode::JmpZ:
+    case ByteCode::JmpNZ:
+      printf("%d", bc.arg);
+      break;
+    default:
+      break;
+    }
+    printf("\n");
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// running
+
+/**
+ * Operands live on the request's argument stack, above the arguments of the
+ * frame being run. An exception can leave some there, so they are popped on
+ * the way out whichever way it is.
+ */
+class OperandStackGuard {
+public:
+  OperandStackGuard(VariantStack &stack)
+    : m_stack(stack), m_base(stack.pos()) {}
+  ~OperandStackGuard() {
+    ASSERT(m_stack.pos() >= m_base);
+    m_stack.pop(m_stack.pos() - m_base);
+  }
+private:
+  VariantStack &m_stack;
+  uint m_base;
+};
+
+/**
+ * After a statement walked as AST set a break level, gives it to the loops
+ * enclosing the statement the way the AST loops would, innermost first.
+ * Returns where to go on, or -1 to leave the body with the level still set.
+ */
+int ByteCodeProgram::unwind(VariableEnvironment &env, int loop) const {
+  for (; loop >= 0; loop = m_loops[loop].parent) {
+    int hb = env.handleBreak();
+    if (hb == 2) return m_loops[loop].breakTarget;
+    if (hb == 3) return m_loops[loop].continueTarget;
+  }
+  return -1;
+}
+
+void ByteCodeProgram::execute(VariableEnvironment &env) const {
+#define BYTE_CODE_LABEL(name) &&op_##name,
+  static const void *const labels[] = {
+    BYTE_CODE_OPS(BYTE_CODE_LABEL)
+  };
+#undef BYTE_CODE_LABEL
+
+  VariantStack &stack = RequestEvalState::argStack();
+  OperandStackGuard guard(stack);
+  FrameInjection *frame = ThreadInfo::s_threadInfo.get()->m_top;
+  const ByteCode *code = &m_code[0];
+  const ByteCode *pc = code;
+
+#define DISPATCH() goto *labels[pc->op]
+#define NEXT() do { ++pc; DISPATCH(); } while (0)
+#define JUMP(target) do { pc = code + (target); DISPATCH(); } while (0)
+#define PUSH(v) stack.push<CVarRef>(v)
+#define LOCAL() env.getIdx(pc->arg)
+// Operands are popped into locals before anything that can run user code
+// (__toString, conversions): that code pushes onto the same stack, and a
+// grow() there would move references into it.
+#define BINARY_OP(name, expr)                                                 \
+  op_##name: {                                                                \
+    Variant v2(stack.topPop());                                               \
+    Variant v1(stack.topPop());                                               \
+    Variant r(expr);                                                          \
+    PUSH(r);                                                                  \
+    NEXT();                                                                   \
+  }
+
+  DISPATCH();
+
+op_Line:
+  if (frame) frame->setLine(pc->arg);
+  NEXT();
+
+op_EvalStmt:
+  static_cast<const Statement *>(pc->ast)->eval(env);
+  if (env.isEscaping()) {
+    if (env.isReturning()) return;
+    int target = unwind(env, pc->arg);
+    if (target < 0) return;
+    JUMP(target);
+  }
+  NEXT();
+
+op_EvalExpr:
+  PUSH(static_cast<const Expression *>(pc->ast)->eval(env));
+  NEXT();
+
+op_Null:   PUSH(null_variant);           NEXT();
+op_True:   stack.push<bool>(true);       NEXT();
+op_False:  stack.push<bool>(false);      NEXT();
+op_Int:    stack.push<int64>(pc->num);   NEXT();
+op_Double: stack.push<double>(pc->dbl);  NEXT();
+op_String: stack.push<litstr>(pc->str);  NEXT();
+
+op_GetLocal: {
+    CVarRef v = LOCAL();
+    if (v.isInitialized()) {
+      PUSH(v);
+    } else {
+      // let the AST raise the notice
+      PUSH(static_cast<const Expression *>(pc->ast)->eval(env));
+    }
+    NEXT();
+  }
+
+op_SetLocal: {
+    // copied: the old value's destructor may run user code
+    Variant v(stack.top());
+    LOCAL() = v;
+    NEXT();
+  }
+
+op_SetOpLocal: {
+    Variant v(stack.topPop());
+    Variant r(static_cast<const LvalExpression *>(pc->ast)->
+              setOpVariant(LOCAL(), pc->sub, v));
+    PUSH(r);
+    NEXT();
+  }
+
+op_PreIncLocal:  { Variant r(++LOCAL()); PUSH(r); NEXT(); }
+op_PostIncLocal: { Variant r(LOCAL()++); PUSH(r); NEXT(); }
+op_PreDecLocal:  { Variant r(--LOCAL()); PUSH(r); NEXT(); }
+op_PostDecLocal: { Variant r(LOCAL()--); PUSH(r); NEXT(); }
+
+op_Pop:
+  stack.pop();
+  NEXT();
+
+op_Echo: {
+    Variant v(stack.topPop());
+    echo(v.toString());
+    NEXT();
+  }
+
+op_Not: {
+    bool b = !stack.top().toBoolean();
+    stack.pop();
+    stack.push<bool>(b);
+    NEXT();
+  }
+
+op_Negate: {
+    Variant v(stack.topPop());
+    Variant r(negate(v));
+    PUSH(r);
+    NEXT();
+  }
+
+BINARY_OP(Add,       v1 + v2)
+BINARY_OP(Sub,       v1 - v2)
+BINARY_OP(Mul,       multiply(v1, v2))
+BINARY_OP(Div,       divide(v1, v2))
+BINARY_OP(Mod,       modulo(v1, v2))
+BINARY_OP(Concat,    concat(v1, v2))
+BINARY_OP(BitAnd,    bitwise_and(v1, v2))
+BINARY_OP(BitOr,     bitwise_or(v1, v2))
+BINARY_OP(BitXor,    bitwise_xor(v1, v2))
+BINARY_OP(Shl,       v1.toInt64() << v2.toInt64())
+BINARY_OP(Shr,       v1.toInt64() >> v2.toInt64())
+BINARY_OP(LogXor,    logical_xor(v1, v2))
+BINARY_OP(Same,      same(v1, v2))
+BINARY_OP(NotSame,   !same(v1, v2))
+BINARY_OP(Equal,     equal(v1, v2))
+BINARY_OP(NotEqual,  !equal(v1, v2))
+BINARY_OP(Less,      less(v1, v2))
+BINARY_OP(LessEqual, not_more(v1, v2))
+BINARY_OP(More,      more(v1, v2))
+BINARY_OP(MoreEqual, not_less(v1, v2))
+
+op_Jmp:
+  JUMP(pc->arg);
+
+op_JmpZ: {
+    bool b = stack.top().toBoolean();
+    stack.pop();
+    if (!b) JUMP(pc->arg);
+    NEXT();
+  }
+
+op_JmpNZ: {
+    bool b = stack.top().toBoolean();
+    stack.pop();
+    if (b) JUMP(pc->arg);
+    NEXT();
+  }
+
+op_Break:
+op_Continue:
+  // patched into Jmp by finish()
+  ASSERT(false);
+  NEXT();
+
+op_Ret:
+  env.setRet(stack.top());
+  stack.pop();
+  return;
+
+op_RetNull:
+  env.setRet();
+  return;
+
+op_Exit:
+  return;
+
+#undef BINARY_OP
+#undef LOCAL
+#undef PUSH
+#undef JUMP
+#undef NEXT
+#undef DISPATCH
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
@@ -0,0 +1,183 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __EVAL_BYTECODE_BYTE_CODE_PROGRAM_H__
+#define __EVAL_BYTECODE_BYTE_CODE_PROGRAM_H__
+
+#include <runtime/eval/base/eval_base.h>
+
+namespace HPHP {
+namespace Eval {
+///////////////////////////////////////////////////////////////////////////////
+
+class Construct;
+class Statement;
+class Expression;
+
+/**
+ * Operand stack effects are given as (popped -> pushed).
+ */
+#define BYTE_CODE_OPS(OP)                                                      \
+  OP(Exit)         /* end of the body                                    */    \
+  OP(Line)         /* arg: line number                                   */    \
+  OP(EvalStmt)     /* ast: statement, arg: innermost loop or -1          */    \
+  OP(EvalExpr)     /* ast: expression to walk                   (0 -> 1) */    \
+  OP(Null)         /*                                           (0 -> 1) */    \
+  OP(True)         /*                                           (0 -> 1) */    \
+  OP(False)        /*                                           (0 -> 1) */    \
+  OP(Int)          /* num                                       (0 -> 1) */    \
+  OP(Double)       /* dbl                                       (0 -> 1) */    \
+  OP(String)       /* str, a literal owned by the AST           (0 -> 1) */    \
+  OP(GetLocal)     /* arg: slot, ast: the variable              (0 -> 1) */    \
+  OP(SetLocal)     /* arg: slot                                 (1 -> 1) */    \
+  OP(SetOpLocal)   /* arg: slot, sub: operator, ast: the lval   (1 -> 1) */    \
+  OP(PreIncLocal)  /* arg: slot                                 (0 -> 1) */    \
+  OP(PostIncLocal) /* arg: slot                                 (0 -> 1) */    \
+  OP(PreDecLocal)  /* arg: slot                                 (0 -> 1) */    \
+  OP(PostDecLocal) /* arg: slot                                 (0 -> 1) */    \
+  OP(Pop)          /*                                           (1 -> 0) */    \
+  OP(Echo)         /*                                           (1 -> 0) */    \
+  OP(Not)          /*                                           (1 -> 1) */    \
+  OP(Negate)       /*                                           (1 -> 1) */    \
+  OP(Add)          /*                                           (2 -> 1) */    \
+  OP(Sub)          /*                                           (2 -> 1) */    \
+  OP(Mul)          /*                                           (2 -> 1) */    \
+  OP(Div)          /*                                           (2 -> 1) */    \
+  OP(Mod)          /*                                           (2 -> 1) */    \
+  OP(Concat)       /*                                           (2 -> 1) */    \
+  OP(BitAnd)       /*                                           (2 -> 1) */    \
+  OP(BitOr)        /*                                           (2 -> 1) */    \
+  OP(BitXor)       /*                                           (2 -> 1) */    \
+  OP(Shl)          /*                                           (2 -> 1) */    \
+  OP(Shr)          /*                                           (2 -> 1) */    \
+  OP(LogXor)       /*                                           (2 -> 1) */    \
+  OP(Same)         /*                                           (2 -> 1) */    \
+  OP(NotSame)      /*                                           (2 -> 1) */    \
+  OP(Equal)        /*                                           (2 -> 1) */    \
+  OP(NotEqual)     /*                                           (2 -> 1) */    \
+  OP(Less)         /*                                           (2 -> 1) */    \
+  OP(LessEqual)    /*                                           (2 -> 1) */    \
+  OP(More)         /*                                           (2 -> 1) */    \
+  OP(MoreEqual)    /*                                           (2 -> 1) */    \
+  OP(Jmp)          /* arg: target                                        */    \
+  OP(JmpZ)         /* arg: target                               (1 -> 0) */    \
+  OP(JmpNZ)        /* arg: target                               (1 -> 0) */    \
+  OP(Break)        /* arg: loop, turned into Jmp by finish()             */    \
+  OP(Continue)     /* arg: loop, turned into Jmp by finish()             */    \
+  OP(Ret)          /*                                           (1 -> 0) */    \
+  OP(RetNull)      /*                                                    */    \
+
+/**
+ * One instruction. Which of the fields are used depends on the opcode, see
+ * BYTE_CODE_OPS.
+ */
+class ByteCode {
+public:
+#define BYTE_CODE_ENUM(name) name,
+  enum Op {
+    BYTE_CODE_OPS(BYTE_CODE_ENUM)
+    OpCount
+  };
+#undef BYTE_CODE_ENUM
+
+  int16 op;
+  int16 sub;
+  int32 arg;
+  union {
+    int64 num;
+    double dbl;
+    const char *str;
+    const Construct *ast;
+  };
+
+  static const char *Name(int op);
+};
+
+/**
+ * A function or method body compiled from its AST into a flat array of
+ * ByteCodes, run by a threaded dispatch loop over a shared operand stack.
+ *
+ * Only simple constructs have instructions of their own: scalars, locals
+ * (by their Block slot), arithmetic, comparisons, assignments to locals,
+ * echo, if/while/do/for, break/continue and return. Everything else is kept
+ * as an EvalStmt or EvalExpr instruction that walks the AST node in the same
+ * VariableEnvironment, so both see the same locals.
+ *
+ * Construct::byteCode() implementations append to a program through the
+ * emitting methods below; execute() only reads it, so one program is shared
+ * by all threads.
+ */
+class ByteCodeProgram {
+public:
+  /**
+   * Returns NULL if nothing in the body would run faster as bytecode.
+   */
+  static ByteCodeProgram *Compile(const Statement *body, bool refReturn);
+
+  void execute(VariableEnvironment &env) const;
+  void dump() const;
+
+  /**
+   * Emitting, used by Construct::byteCode().
+   */
+  bool refReturn() const { return m_refReturn; }
+  int size() const { return m_code.size(); }
+  int add(int op, const Construct *ast = NULL, int arg = 0, int sub = 0);
+  void addInt(int64 num);
+  void addDouble(double dbl);
+  void addString(const char *str);
+  void addLine(const Construct *c);
+  void addStmt(const Statement *stmt);
+  void addExpr(const Expression *exp);
+  void setTarget(int jump, int target) { m_code[jump].arg = target; }
+
+  /**
+   * Loops: continue and break targets are only known once the loop is
+   * compiled, so break/continue are emitted as Break/Continue instructions
+   * and patched by finish().
+   */
+  int beginLoop();
+  void setContinueTarget(int loop, int target);
+  void endLoop(int loop);
+  /**
+   * Returns false if there are fewer than level enclosing loops.
+   */
+  bool addBreak(int level, bool isBreak);
+
+private:
+  class Loop {
+  public:
+    int parent;
+    int breakTarget;
+    int continueTarget;
+  };
+
+  std::vector<ByteCode> m_code;
+  std::vector<Loop> m_loops;
+  int m_currentLoop;
+  int m_native;   // instructions that do not walk the AST
+  bool m_refReturn;
+
+  ByteCodeProgram(bool refReturn);
+  void finish();
+  int unwind(VariableEnvironment &env, int loop) const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+
+#endif /* __EVAL_BYTECODE_BYTE_CODE_PROGRAM_H__ */
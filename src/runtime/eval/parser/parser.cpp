@@ -69,6 +69,9 @@
 #include <util/preprocess.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/util/string_buffer.h>
+#include <runtime/base/zend/zend_string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 using namespace HPHP;
 using namespace HPHP::Eval;
@@ -110,25 +113,53 @@ StatementPtr Parser::parseString(const char *input,
 
 StatementPtr Parser::parseFile(const char *input,
                                vector<StaticStatementPtr> &statics) {
-  Lock lock(s_lock);
   ASSERT(input);
-  ifstream iss(input);
-  StatementPtr s;
-  if (!iss.good()) return s;
+  string code, md5;
+  if (!readFile(input, code, md5)) return StatementPtr();
+  return parseFile(input, code, statics);
+}
 
+StatementPtr Parser::parseFile(const char *fileName, const string &code,
+                               vector<StaticStatementPtr> &statics) {
+  Lock lock(s_lock);
+  istringstream iss(code);
   stringstream ss;
-  istream *is = RuntimeOption::EnableXHP ? preprocessXHP(iss, ss, input) : &iss;
+  istream *is =
+    RuntimeOption::EnableXHP ? preprocessXHP(iss, ss, fileName) : &iss;
   Scanner scanner(new ylmm::basic_buffer(*is, false, true),
                   true, false);
-  Parser parser(scanner, input, statics);
+  Parser parser(scanner, fileName, statics);
   if (parser.parse()) {
     scanner.flushFlex();
-    raise_error("Error parsing %s: %s", input,
+    raise_error("Error parsing %s: %s", fileName,
                 parser.getMessage().c_str());
     return StatementPtr();
   }
-  s = parser.getTree();
-  return s;
+  return parser.getTree();
+}
+
+bool Parser::readFile(const char *fileName, string &code, string &md5) {
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0;
+  if (ok) {
+    code.resize(st.st_size);
+    size_t done = 0;
+    while (done < code.size()) {
+      ssize_t n = read(fd, &code[done], code.size() - done);
+      if (n <= 0) break;
+      done += n;
+    }
+    // the file may have been truncated since fstat()
+    code.resize(done);
+    int len;
+    char *hex = string_md5(code.data(), code.size(), false, len);
+    md5.assign(hex, len);
+    free(hex);
+  }
+  close(fd);
+  return ok;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -43,6 +43,18 @@ public:
   static StatementPtr
   parseFile(const char *input,
             std::vector<StaticStatementPtr> &statics);
+  /**
+   * Parses code already read from fileName, by readFile().
+   */
+  static StatementPtr
+  parseFile(const char *fileName, const std::string &code,
+            std::vector<StaticStatementPtr> &statics);
+  /**
+   * Reads fileName into code, with the md5 of it in hex. Returns false if
+   * the file cannot be read.
+   */
+  static bool readFile(const char *fileName, std::string &code,
+                       std::string &md5);
 public:
   enum NameKind {
     StringName,
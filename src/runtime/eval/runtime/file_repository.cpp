@@ -17,6 +17,7 @@
 #include <sys/stat.h>
 #include <runtime/eval/runtime/file_repository.h>
 #include <runtime/eval/runtime/variable_environment.h>
+#include <runtime/eval/runtime/file_watcher.h>
 #include <runtime/eval/ast/statement.h>
 #include <runtime/eval/parser/parser.h>
 #include <runtime/eval/ast/static_statement.h>
@@ -33,12 +34,18 @@ namespace Eval {
 set<string> FileRepository::s_names;
 
 PhpFile::PhpFile(StatementPtr tree, const vector<StaticStatementPtr> &statics,
-                 Mutex &lock, const struct stat &s)
+                 Mutex &lock, const struct stat &s, const string &md5)
   : Block(statics), m_lock(lock), m_refCount(1), m_timestamp(s.st_mtime),
-    m_ino(s.st_ino), m_devId(s.st_dev), m_tree(tree),
+    m_ino(s.st_ino), m_devId(s.st_dev), m_md5(md5), m_tree(tree),
     m_profName(string("run_init::") + string(m_tree->loc()->file)) {
 }
 
+PhpFile::PhpFile(const PhpFile &file, const struct stat &s)
+  : Block(file), m_lock(file.m_lock), m_refCount(1), m_timestamp(s.st_mtime),
+    m_ino(s.st_ino), m_devId(s.st_dev), m_md5(file.m_md5),
+    m_tree(file.m_tree), m_profName(file.m_profName) {
+}
+
 PhpFile::~PhpFile() {
   ASSERT(m_refCount == 0);
 }
@@ -110,7 +117,7 @@ PhpFile *FileRepository::checkoutFile(const std::string &rname, const struct sta
     }
   } else {
     if (it->second->isChanged(s)) {
-      ret = readFile(name, s);
+      ret = readFile(name, s, it->second);
       if (ret) {
         it->second->decRef();
         it->second = ret;
@@ -128,23 +135,29 @@ bool FileRepository::findFile(std::string &path, struct stat &s,
   return fileStat(path, s);
 }
 
-PhpFile *FileRepository::readFile(const std::string &name, const struct stat &s) {
-  vector<StaticStatementPtr> sts;
+PhpFile *FileRepository::readFile(const std::string &name,
+                                  const struct stat &s,
+                                  PhpFile *old /* = NULL */) {
   const char *canoname = canonicalize(name);
-  StatementPtr stmt = Parser::parseFile(canoname, sts);
+  string code, md5;
+  if (!Parser::readFile(canoname, code, md5)) return NULL;
+  if (old && old->md5() == md5) {
+    // requests may still be running old, so it's left as it is
+    return new PhpFile(*old, s);
+  }
+
+  vector<StaticStatementPtr> sts;
+  StatementPtr stmt = Parser::parseFile(canoname, code, sts);
   if (stmt) {
     uint lock = hash_string(canoname) & 127;
-    PhpFile *p = new PhpFile(stmt, sts, s_locks[lock], s);
+    PhpFile *p = new PhpFile(stmt, sts, s_locks[lock], s, md5);
     return p;
   }
   return NULL;
 }
 
 bool FileRepository::fileStat(const std::string &name, struct stat &s) {
-  if (stat(name.c_str(), &s) == 0) {
-    return true;
-  }
-  return false;
+  return FileWatcher::Stat(name, s);
 }
 
 const char* FileRepository::canonicalize(const std::string &name) {
@@ -33,25 +33,35 @@ DECLARE_AST_PTR(StaticStatement);
 class PhpFile : public Block {
 public:
   PhpFile(StatementPtr tree, const std::vector<StaticStatementPtr> &statics,
-          Mutex &lock, const struct stat &s);
+          Mutex &lock, const struct stat &s, const std::string &md5);
+  /**
+   * For a file touched, or written again, with the same content: shares the
+   * parsed tree of file.
+   */
+  PhpFile(const PhpFile &file, const struct stat &s);
   ~PhpFile();
   Variant eval(LVariableTable *env);
   void decRef();
   void incRef();
   time_t readTime() const { return m_timestamp; }
   bool isChanged(const struct stat &s);
+  const std::string &md5() const { return m_md5; }
+  const StatementPtr &tree() const { return m_tree; }
 private:
   Mutex &m_lock;
   int m_refCount;
   time_t m_timestamp;
   ino_t m_ino;
   dev_t m_devId;
+  std::string m_md5;
   StatementPtr m_tree;
   std::string m_profName;
 };
 
 /**
- * FileRepository is global.
+ * FileRepository is global. Parsed trees only live in this process: every
+ * process parses each file it runs once, and again after its content
+ * changes. Nothing is kept on disk or shared between processes.
  */
 class FileRepository {
 public:
@@ -66,7 +76,11 @@ private:
   static hphp_hash_map<std::string, PhpFile*, string_hash> m_files;
   static Mutex s_locks[128];
 
-  static PhpFile *readFile(const std::string &name, const struct stat &s);
+  /**
+   * Doesn't parse the file again if its content is the same as old's.
+   */
+  static PhpFile *readFile(const std::string &name, const struct stat &s,
+                           PhpFile *old = NULL);
   static bool fileStat(const std::string &name, struct stat &s);
   static std::set<std::string> s_names;
 
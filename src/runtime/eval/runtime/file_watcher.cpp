@@ -0,0 +1,346 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/eval/runtime/file_watcher.h>
+#include <runtime/base/runtime_option.h>
+#include <util/async_func.h>
+#include <util/atomic.h>
+#include <util/lock.h>
+#include <util/logger.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <limits.h>
+
+using namespace std;
+
+namespace HPHP {
+namespace Eval {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Watching a file's directory rather than the file itself also catches
+ * editors and deploy tools that write a new file and rename it over the old.
+ */
+static const uint32 DirEvents =
+  IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+  IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+class FileWatcherImpl {
+public:
+  FileWatcherImpl()
+    : m_func(this, &FileWatcherImpl::run), m_fd(-1), m_started(false),
+      m_failed(false), m_events(0), m_stats(0), m_avoided(0) {
+    m_stopPipe[0] = m_stopPipe[1] = -1;
+  }
+
+  bool stat(const string &path, struct stat &s) {
+    if (!RuntimeOption::FileWatch || path.empty() || path[0] != '/' ||
+        !start()) {
+      atomic_add(m_stats, (int64)1);
+      return ::stat(path.c_str(), &s) == 0;
+    }
+
+    time_t now = time(NULL);
+    {
+      ReadLock lock(m_mutex);
+      EntryMap::const_iterator it = m_entries.find(path);
+      if (it != m_entries.end() && !expired(it->second, now)) {
+        s = it->second.st;
+        atomic_add(m_avoided, (int64)1);
+        return true;
+      }
+    }
+
+    atomic_add(m_stats, (int64)1);
+    if (::stat(path.c_str(), &s) != 0) {
+      WriteLock lock(m_mutex);
+      drop(path);
+      return false;
+    }
+
+    int64 events = m_events;
+    __sync_synchronize();
+    NameVec names;
+    if (!resolve(path, names)) return true;
+    WatchVec watches;
+    for (unsigned int i = 0; i < names.size(); i++) {
+      int wd = inotify_add_watch(m_fd, names[i].first.c_str(),
+                                 DirEvents | IN_ONLYDIR);
+      if (wd < 0) return true;
+      watches.push_back(Watch(wd, names[i].second));
+    }
+    // again, now that no change after it goes unseen
+    if (::stat(path.c_str(), &s) != 0) {
+      WriteLock lock(m_mutex);
+      drop(path);
+      return false;
+    }
+
+    WriteLock lock(m_mutex);
+    drop(path);
+    if (m_events == events && !m_failed) {
+      Entry &e = m_entries[path];
+      e.st = s;
+      e.checked = now;
+      e.watches = watches;
+      for (unsigned int i = 0; i < watches.size(); i++) {
+        m_watched[watches[i].first][watches[i].second].insert(path);
+      }
+    }
+    return true;
+  }
+
+  void stop() {
+    {
+      Lock lock(m_startMutex);
+      if (!m_started || m_failed) return;
+    }
+    if (write(m_stopPipe[1], "", 1) < 0) return;
+    m_func.waitForEnd();
+  }
+
+  int64 stats() const { return m_stats;}
+  int64 avoided() const { return m_avoided;}
+
+private:
+  typedef std::vector<std::pair<string, string> > NameVec; // dir, name
+  typedef std::pair<int, string> Watch; // watched dir, name
+  typedef std::vector<Watch> WatchVec;
+
+  class Entry {
+  public:
+    struct stat st;
+    time_t checked;
+    WatchVec watches;
+  };
+  typedef hphp_hash_map<string, Entry, string_hash> EntryMap;
+  typedef map<string, set<string> > NameMap; // paths kept, by name
+
+  AsyncFunc<FileWatcherImpl> m_func;
+  Mutex m_startMutex;
+  int m_fd;
+  int m_stopPipe[2];
+  volatile bool m_started;
+  volatile bool m_failed;
+
+  ReadWriteMutex m_mutex; // for everything below
+  EntryMap m_entries;
+  map<int, NameMap> m_watched; // by directory watched
+  volatile int64 m_events;     // batches of events dropped entries
+
+  int64 m_stats;
+  int64 m_avoided;
+
+  static bool expired(const Entry &e, time_t now) {
+    return RuntimeOption::FileWatchRevalidate > 0 &&
+      now - e.checked >= RuntimeOption::FileWatchRevalidate;
+  }
+
+  /**
+   * Resolves path like realpath() does, collecting every directory entry
+   * that names a different file when changed: the file's own, in the
+   * directory it really is in, and each symlink's on the way, so that
+   * flipping a "current" link to a new release is noticed too.
+   */
+  static bool resolve(const string &path, NameVec &names) {
+    std::deque<string> rest;
+    split(path, rest, false);
+    string dir; // resolved so far, without symlinks, "" for "/"
+    int links = 0;
+    while (!rest.empty()) {
+      string name = rest.front();
+      rest.pop_front();
+      if (name.empty() || name == ".") continue;
+      if (name == "..") {
+        size_t slash = dir.rfind('/');
+        dir.resize(slash == string::npos ? 0 : slash);
+        continue;
+      }
+      string next = dir + "/" + name;
+      struct stat ls;
+      if (lstat(next.c_str(), &ls) != 0) return false;
+      if (!S_ISLNK(ls.st_mode)) {
+        dir = next;
+        continue;
+      }
+      char target[PATH_MAX];
+      ssize_t len = readlink(next.c_str(), target, sizeof(target) - 1);
+      if (len <= 0 || ++links > 40) return false;
+      names.push_back(make_pair(dir.empty() ? "/" : dir, name));
+      string t(target, len);
+      if (t[0] == '/') dir.clear();
+      split(t, rest, true);
+    }
+    if (dir.empty()) return false;
+    size_t slash = dir.rfind('/');
+    names.push_back(make_pair(slash ? dir.substr(0, slash) : string("/"),
+                              dir.substr(slash + 1)));
+    return true;
+  }
+
+  static void split(const string &path, std::deque<string> &names,
+                    bool front) {
+    std::vector<string> parts;
+    size_t pos = 0;
+    while (pos <= path.size()) {
+      size_t slash = path.find('/', pos);
+      if (slash == string::npos) slash = path.size();
+      parts.push_back(path.substr(pos, slash - pos));
+      pos = slash + 1;
+    }
+    if (front) {
+      names.insert(names.begin(), parts.begin(), parts.end());
+    } else {
+      names.insert(names.end(), parts.begin(), parts.end());
+    }
+  }
+
+  bool start() {
+    if (m_started) return !m_failed;
+    Lock lock(m_startMutex);
+    if (!m_started) {
+      m_fd = inotify_init();
+      if (m_fd < 0 || pipe(m_stopPipe) != 0) {
+        Logger::Warning("unable to watch files, stat()ing on every include");
+        m_failed = true;
+      } else {
+        m_func.start();
+      }
+      m_started = true;
+    }
+    return !m_failed;
+  }
+
+  /**
+   * All the drop*() calls need the write lock.
+   */
+  void drop(const string &path) {
+    EntryMap::iterator it = m_entries.find(path);
+    if (it == m_entries.end()) return;
+    const WatchVec &watches = it->second.watches;
+    for (unsigned int i = 0; i < watches.size(); i++) {
+      map<int, NameMap>::iterator iter = m_watched.find(watches[i].first);
+      if (iter == m_watched.end()) continue;
+      NameMap::iterator names = iter->second.find(watches[i].second);
+      if (names == iter->second.end()) continue;
+      names->second.erase(path);
+      if (names->second.empty()) iter->second.erase(names);
+    }
+    m_entries.erase(it);
+  }
+
+  void dropPaths(const set<string> &paths) {
+    // copied, as dropping them changes the set
+    std::vector<string> copy(paths.begin(), paths.end());
+    for (unsigned int i = 0; i < copy.size(); i++) {
+      drop(copy[i]);
+    }
+  }
+
+  void dropName(int wd, const char *name) {
+    map<int, NameMap>::iterator iter = m_watched.find(wd);
+    if (iter == m_watched.end()) return;
+    NameMap::iterator names = iter->second.find(name);
+    if (names == iter->second.end()) return;
+    dropPaths(names->second);
+  }
+
+  void dropDir(int wd) {
+    map<int, NameMap>::iterator iter = m_watched.find(wd);
+    if (iter == m_watched.end()) return;
+    std::vector<string> names;
+    for (NameMap::const_iterator it = iter->second.begin();
+         it != iter->second.end(); ++it) {
+      names.push_back(it->first);
+    }
+    for (unsigned int i = 0; i < names.size(); i++) {
+      dropName(wd, names[i].c_str());
+    }
+    m_watched.erase(wd);
+  }
+
+  void dropAll() {
+    m_entries.clear();
+    m_watched.clear();
+  }
+
+  void run() {
+    char buf[64 * 1024]
+      __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+      struct pollfd fds[2];
+      fds[0].fd = m_fd;
+      fds[0].events = POLLIN;
+      fds[1].fd = m_stopPipe[0];
+      fds[1].events = POLLIN;
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) continue;
+        break;
+      }
+      if (fds[1].revents) break;
+      if (!fds[0].revents) continue;
+
+      ssize_t len = read(m_fd, buf, sizeof(buf));
+      if (len <= 0) {
+        if (len < 0 && errno == EINTR) continue;
+        break;
+      }
+
+      WriteLock lock(m_mutex);
+      for (char *p = buf; p < buf + len; ) {
+        struct inotify_event *event = (struct inotify_event *)p;
+        if (event->mask & IN_Q_OVERFLOW) {
+          dropAll();
+        } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+          dropDir(event->wd);
+        } else if (event->len) {
+          dropName(event->wd, event->name);
+        }
+        p += sizeof(struct inotify_event) + event->len;
+      }
+      ++m_events;
+    }
+
+    // nothing tells us about changes any more
+    WriteLock lock(m_mutex);
+    dropAll();
+    m_failed = true;
+  }
+};
+
+static FileWatcherImpl s_watcher;
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool FileWatcher::Stat(const std::string &path, struct stat &s) {
+  return s_watcher.stat(path, s);
+}
+
+void FileWatcher::Stop() {
+  s_watcher.stop();
+}
+
+int64 FileWatcher::GetStatCount() {
+  return s_watcher.stats();
+}
+
+int64 FileWatcher::GetAvoidedCount() {
+  return s_watcher.avoided();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
@@ -0,0 +1,58 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __EVAL_FILE_WATCHER_H__
+#define __EVAL_FILE_WATCHER_H__
+
+#include <runtime/eval/base/eval_base.h>
+#include <sys/stat.h>
+
+namespace HPHP {
+namespace Eval {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * stat() for included files, without a syscall per include. With
+ * Eval.FileWatch on, the result of stat()ing an absolute path is kept, and
+ * the directory the file really is in is watched with inotify by a thread of
+ * its own, which drops kept results as soon as their file changes. So are
+ * the directories of symlinks on the way, like a "current" link to the live
+ * release, so results are dropped when a link is pointed elsewhere, too.
+ * Results are also dropped once Eval.FileWatchRevalidate seconds old, for
+ * changes inotify does not see, like ones made on another host to a network
+ * mounted source tree.
+ *
+ * Only files that exist are kept, so a file showing up is noticed on the
+ * next include. Looking up one that doesn't costs a single stat().
+ */
+class FileWatcher {
+public:
+  static bool Stat(const std::string &path, struct stat &s);
+
+  /**
+   * Stops the watching thread, if it was started.
+   */
+  static void Stop();
+
+  static int64 GetStatCount();
+  static int64 GetAvoidedCount();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+
+#endif /* __EVAL_FILE_WATCHER_H__ */
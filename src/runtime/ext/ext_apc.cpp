@@ -19,12 +19,14 @@
 #include <runtime/ext/ext_variable.h>
 #include <runtime/ext/ext_fb.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/shared/shared_store.h>
 #include <util/async_job.h>
 #include <util/timer.h>
 #include <dlfcn.h>
 #include <runtime/base/program_functions.h>
 #include <runtime/base/builtin_functions.h>
 #include <runtime/base/variable_serializer.h>
+#include <runtime/base/variable_unserializer.h>
 
 using namespace std;
 
@@ -215,10 +217,19 @@ public:
 };
 
 void apc_load(int thread) {
+  if (!RuntimeOption::EnableApc) return;
+
+  // primed items take precedence over snapshot ones, as they are looked up
+  // in the stores first
+  static bool snapshotLoaded = false;
+  if (!snapshotLoaded && !RuntimeOption::ApcSnapshotFile.empty()) {
+    snapshotLoaded = true;
+    Timer timer(Timer::WallTime, "loading APC snapshot");
+    SharedStores::LoadSnapshot(RuntimeOption::ApcSnapshotFile);
+  }
+
   static void *handle = NULL;
-  if (handle ||
-      RuntimeOption::ApcPrimeLibrary.empty() ||
-      !RuntimeOption::EnableApc) {
+  if (handle || RuntimeOption::ApcPrimeLibrary.empty()) {
     return;
   }
 
@@ -654,9 +665,9 @@ Variant apc_unserialize(CStrRef str) {
   return f_unserialize(str);
 }
 
-void reserialize(istream &in, StringBuffer &buf) {
-  char type, sep;
-  in >> type >> sep;
+void reserialize(VariableUnserializer *uns, StringBuffer &buf) {
+  char type = uns->readChar();
+  char sep = uns->readChar();
 
   if (type == 'N') {
     buf.append(type);
@@ -673,10 +684,8 @@ void reserialize(istream &in, StringBuffer &buf) {
     {
       buf.append(type);
       buf.append(sep);
-      while (in.peek() != ';') {
-        char ch;
-        in >> ch;
-        buf.append(ch);
+      while (uns->peek() != ';') {
+        buf.append(uns->readChar());
       }
     }
     break;
@@ -686,17 +695,20 @@ void reserialize(istream &in, StringBuffer &buf) {
       // shouldn't happen, but keep the code here anyway.
       buf.append(type);
       buf.append(sep);
-      char pointer[8];
-      in.read(pointer, 8);
-      buf.append(pointer, 8);
+      buf.append(uns->readRaw(8), 8);
     }
     break;
   case 's':
     {
+      int size;
+      const char *data = uns->readStringData(size);
+      // copied, as data is not NUL-terminated; the set is empty once
+      // static strings are all made, so there is nothing to look up then
       String v;
-      v.unserialize(in);
-      ASSERT(!v.isNull());
-      if (v->isStatic()) {
+      if (!StaticString::TheStaticStringSet().empty()) {
+        v = String(data, size, CopyString);
+      }
+      if (!v.isNull() && v.checkStatic()) {
         union {
           char pointer[8];
           StringData *sd;
@@ -707,30 +719,29 @@ void reserialize(istream &in, StringBuffer &buf) {
         buf.append(';');
       } else {
         buf.append("s:");
-        buf.append(v.size());
+        buf.append(size);
         buf.append(":\"");
-        buf.append(v.data(), v.size());
+        buf.append(data, size);
         buf.append("\";");
       }
-      in >> sep; // ';'
+      uns->readChar(); // ';'
       return;
     }
     break;
   case 'a':
     {
       buf.append("a:");
-      int64 size;
-      char sep2;
-      in >> size >> sep2;
+      int64 size = uns->readInt();
+      char sep2 = uns->readChar();
       buf.append(size);
       buf.append(sep2);
-      in >> sep2; // '{'
+      sep2 = uns->readChar(); // '{'
       buf.append(sep2);
       for (int64 i = 0; i < size; i++) {
-        reserialize(in, buf); // key
-        reserialize(in, buf); // value
+        reserialize(uns, buf); // key
+        reserialize(uns, buf); // value
       }
-      in >> sep2; // '}'
+      sep2 = uns->readChar(); // '}'
       buf.append(sep2);
       return;
     }
@@ -741,25 +752,25 @@ void reserialize(istream &in, StringBuffer &buf) {
       buf.append(type);
       buf.append(sep);
 
-      String clsName;
-      clsName.unserialize(in);
-      buf.append(clsName.size());
+      int clsLen;
+      const char *clsName = uns->readStringData(clsLen);
+      buf.append(clsLen);
       buf.append(":\"");
-      buf.append(clsName.data(), clsName.size());
+      buf.append(clsName, clsLen);
       buf.append("\":");
 
-      int64 size;
-      char sep2;
-      in >> sep2 >> size >> sep2;
+      uns->readChar(); // ':'
+      int64 size = uns->readInt();
+      char sep2 = uns->readChar();
       buf.append(size);
       buf.append(sep2);
-      in >> sep2; // '{'
+      sep2 = uns->readChar(); // '{'
       buf.append(sep2);
       for (int64 i = 0; i < size; i++) {
-        reserialize(in, buf); // property name
-        reserialize(in, buf); // property value
+        reserialize(uns, buf); // property name
+        reserialize(uns, buf); // property value
       }
-      in >> sep2; // '}'
+      sep2 = uns->readChar(); // '}'
       buf.append(sep2);
       return;
     }
@@ -769,19 +780,19 @@ void reserialize(istream &in, StringBuffer &buf) {
       buf.append(type);
       buf.append(sep);
 
-      String clsName;
-      clsName.unserialize(in);
-      buf.append(clsName.size());
+      int clsLen;
+      const char *clsName = uns->readStringData(clsLen);
+      buf.append(clsLen);
       buf.append(":\"");
-      buf.append(clsName.data(), clsName.size());
+      buf.append(clsName, clsLen);
       buf.append("\":");
 
-      in >> sep; // ':'
-      String serialized;
-      serialized.unserialize(in, '{', '}');
-      buf.append(serialized.size());
+      uns->readChar(); // ':'
+      int size;
+      const char *serialized = uns->readStringData(size, '{', '}');
+      buf.append(size);
       buf.append(":{");
-      buf.append(serialized.data(), serialized.size());
+      buf.append(serialized, size);
       buf.append('}');
       return;
     }
@@ -790,16 +801,16 @@ void reserialize(istream &in, StringBuffer &buf) {
     throw Exception("Unknown type '%c'", type);
   }
 
-  in >> sep; // the last ';'
+  sep = uns->readChar(); // the last ';'
   buf.append(sep);
 }
 
 String apc_reserialize(CStrRef str) {
   if (str.empty()) return str;
 
-  istringstream in(std::string(str.data(), str.size()));
+  VariableUnserializer uns(str.data(), str.size());
   StringBuffer buf;
-  reserialize(in, buf);
+  reserialize(&uns, buf);
 
   return buf.detach();
 }
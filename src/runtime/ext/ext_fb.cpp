@@ -875,7 +875,7 @@ int f_fb_get_taint(CStrRef str){
 ///////////////////////////////////////////////////////////////////////////////
 // const index functions
 
-static ZendArray const_data;
+static ZendArray const_data(0, true); // persistent
 
 Variant f_fb_const_fetch(CVarRef key) {
   String k = key.toString();
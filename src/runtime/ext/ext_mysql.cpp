@@ -20,6 +20,7 @@
 #include <runtime/ext/ext_network.h>
 #include <runtime/ext/mysql_stats.h>
 #include <runtime/base/runtime_option.h>
+#include <runtime/base/zend/zend_strtod.h>
 #include <runtime/base/server/server_stats.h>
 #include <runtime/base/util/request_local.h>
 #include <runtime/base/util/extended_logger.h>
@@ -27,6 +28,7 @@
 #include <util/db_mysql.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <poll.h>
 
 using namespace std;
 
@@ -65,6 +67,7 @@ MySQLResult::~MySQLResult() {
         DELETE(Variant)(info.name);
         DELETE(Variant)(info.table);
         DELETE(Variant)(info.def);
+        DELETE(Variant)(info.key);
       }
     }
     delete[] m_fields;
@@ -139,6 +142,10 @@ MYSQL *MySQL::GetConn(CVarRef link_identifier, MySQL **rconn /* = NULL */) {
   MYSQL *ret = NULL;
   if (mySQL) {
     ret = mySQL->get();
+    if (ret && mySQL->m_async_state != AsyncNone) {
+      // anything else on the link needs the protocol back in sync first
+      mySQL->discardAsyncQuery();
+    }
   }
   if (ret == NULL) {
     raise_warning("supplied argument is not a valid MySQL-Link resource");
@@ -228,7 +235,7 @@ static MYSQL *create_new_conn() {
 MySQL::MySQL(const char *host, int port, const char *username,
              const char *password, const char *database)
     : m_port(port), m_last_error_set(false), m_last_errno(0),
-      m_xaction_count(0) {
+      m_xaction_count(0), m_async_state(AsyncNone), m_async_tid(0) {
   if (host) m_host = host;
   if (username) m_username = username;
   if (password) m_password = password;
@@ -256,6 +263,7 @@ void MySQL::close() {
     m_last_errno = 0;
     m_xaction_count = 0;
     m_last_error.clear();
+    m_async_state = AsyncNone;
     mysql_close(m_conn);
     m_conn = NULL;
   }
@@ -312,6 +320,8 @@ bool MySQL::reconnect(CStrRef host, int port, CStrRef socket, CStrRef username,
                               port, socket.data(), client_flags);
   }
 
+  // a persistent connection may still have an earlier request's query pending
+  discardAsyncQuery();
   if (!mysql_ping(m_conn)) {
     if (RuntimeOption::EnableStats && RuntimeOption::EnableSQLStats) {
       ServerStats::Log("sql.reconn_ok", 1);
@@ -337,6 +347,18 @@ bool MySQL::reconnect(CStrRef host, int port, CStrRef socket, CStrRef username,
                             port, socket.data(), client_flags);
 }
 
+void MySQL::discardAsyncQuery() {
+  if (m_async_state == AsyncPending) {
+    IOStatusHelper io("mysql::async_discard", m_host.c_str(), m_port);
+    if (!mysql_read_query_result(m_conn)) {
+      MYSQL_RES *res = mysql_use_result(m_conn);
+      if (res) mysql_free_result(res); // reads the rows left
+    }
+  }
+  m_async_state = AsyncNone;
+  m_async_query.clear();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // helpers
 
@@ -689,7 +711,9 @@ Variant f_mysql_error(CVarRef link_identifier /* = null */) {
 ///////////////////////////////////////////////////////////////////////////////
 // query functions
 
-static Variant mysql_makevalue(CStrRef data, MYSQL_FIELD *mysql_field) {
+static Variant mysql_makevalue(const char *data, int len,
+                               MYSQL_FIELD *mysql_field) {
+  bool integer = false;
   switch (mysql_field->type) {
   case MYSQL_TYPE_DECIMAL:
   case MYSQL_TYPE_TINY:
@@ -698,17 +722,29 @@ static Variant mysql_makevalue(CStrRef data, MYSQL_FIELD *mysql_field) {
   case MYSQL_TYPE_LONGLONG:
   case MYSQL_TYPE_INT24:
   case MYSQL_TYPE_YEAR:
-    return data.toInt64();
+    integer = true;
+    break;
   case MYSQL_TYPE_FLOAT:
   case MYSQL_TYPE_DOUBLE:
     //case MYSQL_TYPE_NEWDECIMAL:
-    return data.toDouble();
+    break;
   case MYSQL_TYPE_NULL:
     return null;
   default:
-    break;
+    return String(data, len, CopyString);
+  }
+
+  // numbers are short, so they are parsed off the stack without a String
+  char buf[64];
+  if (len < (int)sizeof(buf)) {
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+    if (integer) return (int64)strtoll(buf, NULL, 10);
+    return len ? zend_strtod(buf, NULL) : 0.0;
   }
-  return data;
+  String s(data, len, CopyString);
+  if (integer) return s.toInt64();
+  return s.toDouble();
 }
 
 extern "C" {
@@ -738,8 +774,7 @@ static bool php_mysql_read_rows(MYSQL *mysql, CVarRef result) {
       unsigned long len = net_field_length(&cp);
       Variant *data = NEW(Variant)();
       if (len != NULL_LENGTH) {
-        *data = mysql_makevalue(String((char *)cp, len, CopyString),
-                                mysql->fields + i);
+        *data = mysql_makevalue((const char *)cp, len, mysql->fields + i);
         cp += len;
         if (mysql->fields) {
           if (mysql->fields[i].max_length < len)
@@ -783,117 +818,110 @@ static Variant php_mysql_localize_result(MYSQL *mysql) {
   return result;
 }
 
-static Variant php_mysql_do_query_general(CStrRef query, CVarRef link_id,
-                                          bool use_store) {
+static bool php_mysql_skip_write(CStrRef query) {
   if (RuntimeOption::MySQLReadOnly &&
       same(f_preg_match("/^((\\/\\*.*?\\*\\/)|\\(|\\s)*select/i", query), 0)) {
     raise_notice("runtime/ext_mysql: write query not executed [%s]",
                     query.data());
-    return true; // pretend it worked
+    return true;
   }
+  return false;
+}
 
-  MySQL *rconn = NULL;
-  MYSQL *conn = MySQL::GetConn(link_id, &rconn);
-  if (!conn || !rconn) return false;
-
-  if (RuntimeOption::EnableStats && RuntimeOption::EnableSQLStats) {
-    ServerStats::Log("sql.query", 1);
-
-    // removing comments, which can be wrong actually if some string field's
-    // value has /* or */ in it.
-    String q = f_preg_replace("/\\/\\*.*?\\*\\//", " ", query).toString();
-
-    Variant matches;
-    f_preg_match("/^(?:\\(|\\s)*(?:"
-                 "(insert).*?\\s+(?:into\\s+)?([^\\s\\(,]+)|"
-                 "(update|set|show)\\s+([^\\s\\(,]+)|"
-                 "(replace).*?\\s+into\\s+([^\\s\\(,]+)|"
-                 "(delete).*?\\s+from\\s+([^\\s\\(,]+)|"
-                 "(select).*?[\\s`]+from\\s+([^\\s\\(,]+))/is",
-                 q, ref(matches));
-    int size = matches.toArray().size();
-    if (size > 2) {
-      string verb = Util::toLower(matches[size - 2].toString().data());
-      string table = Util::toLower(matches[size - 1].toString().data());
-      if (!table.empty() && table[0] == '`') {
-        table = table.substr(1, table.length() - 2);
+static void php_mysql_log_query(CStrRef query, MySQL *rconn) {
+  if (!RuntimeOption::EnableStats || !RuntimeOption::EnableSQLStats) return;
+  ServerStats::Log("sql.query", 1);
+
+  // removing comments, which can be wrong actually if some string field's
+  // value has /* or */ in it.
+  String q = f_preg_replace("/\\/\\*.*?\\*\\//", " ", query).toString();
+
+  Variant matches;
+  f_preg_match("/^(?:\\(|\\s)*(?:"
+               "(insert).*?\\s+(?:into\\s+)?([^\\s\\(,]+)|"
+               "(update|set|show)\\s+([^\\s\\(,]+)|"
+               "(replace).*?\\s+into\\s+([^\\s\\(,]+)|"
+               "(delete).*?\\s+from\\s+([^\\s\\(,]+)|"
+               "(select).*?[\\s`]+from\\s+([^\\s\\(,]+))/is",
+               q, ref(matches));
+  int size = matches.toArray().size();
+  if (size > 2) {
+    string verb = Util::toLower(matches[size - 2].toString().data());
+    string table = Util::toLower(matches[size - 1].toString().data());
+    if (!table.empty() && table[0] == '`') {
+      table = table.substr(1, table.length() - 2);
+    }
+    ServerStats::Log(string("sql.query.") + table + "." + verb, 1);
+    if (RuntimeOption::EnableStats && RuntimeOption::EnableSQLTableStats) {
+      MySqlStats::Record(verb, rconn->m_xaction_count, table);
+      if (verb == "update") {
+        f_preg_match("([^\\s,]+)\\s*=\\s*([^\\s,]+)[\\+\\-]",
+                     q, ref(matches));
+        size = matches.toArray().size();
+        if (size > 2 && same(matches[1], matches[2])) {
+          MySqlStats::Record("incdec", rconn->m_xaction_count, table);
+        }
       }
-      ServerStats::Log(string("sql.query.") + table + "." + verb, 1);
+      // we only bump it up when we're in the middle of a transaction
+      if (rconn->m_xaction_count) {
+        ++rconn->m_xaction_count;
+      }
+    }
+  } else {
+    f_preg_match("/^(?:(?:\\/\\*.*?\\*\\/)|\\(|\\s)*"
+                 "(begin|commit|rollback)/is",
+                 query, ref(matches));
+    size = matches.toArray().size();
+    if (size == 2) {
+      string verb = Util::toLower(matches[1].toString().data());
+      rconn->m_xaction_count = ((verb == "begin") ? 1 : 0);
+      ServerStats::Log(string("sql.query.") + verb, 1);
       if (RuntimeOption::EnableStats && RuntimeOption::EnableSQLTableStats) {
-        MySqlStats::Record(verb, rconn->m_xaction_count, table);
-        if (verb == "update") {
-          f_preg_match("([^\\s,]+)\\s*=\\s*([^\\s,]+)[\\+\\-]",
-                       q, ref(matches));
-          size = matches.toArray().size();
-          if (size > 2 && same(matches[1], matches[2])) {
-            MySqlStats::Record("incdec", rconn->m_xaction_count, table);
-          }
-        }
-        // we only bump it up when we're in the middle of a transaction
-        if (rconn->m_xaction_count) {
-          ++rconn->m_xaction_count;
-        }
+        MySqlStats::Record(verb);
       }
     } else {
-      f_preg_match("/^(?:(?:\\/\\*.*?\\*\\/)|\\(|\\s)*"
-                   "(begin|commit|rollback)/is",
-                   query, ref(matches));
-      size = matches.toArray().size();
-      if (size == 2) {
-        string verb = Util::toLower(matches[1].toString().data());
-        rconn->m_xaction_count = ((verb == "begin") ? 1 : 0);
-        ServerStats::Log(string("sql.query.") + verb, 1);
-        if (RuntimeOption::EnableStats && RuntimeOption::EnableSQLTableStats) {
-          MySqlStats::Record(verb);
-        }
-      } else {
-        raise_warning("Unable to record MySQL stats with: %s", query.data());
-        ServerStats::Log("sql.query.unknown", 1);
-      }
+      raise_warning("Unable to record MySQL stats with: %s", query.data());
+      ServerStats::Log("sql.query.unknown", 1);
     }
   }
+}
 
-  SlowTimer timer(RuntimeOption::MySQLSlowQueryThreshold,
-                  "runtime/ext_mysql: slow query", query.data());
-  IOStatusHelper io("mysql::query", rconn->m_host.c_str(), rconn->m_port);
-  unsigned long tid = mysql_thread_id(conn);
-  if (mysql_real_query(conn, query.data(), query.size())) {
-    raise_notice("runtime/ext_mysql: failed executing [%s] [%s]", query.data(),
-                 mysql_error(conn));
-
-    // When we are timed out, and we're SELECT-ing, we're potentially
-    // running a long query on the server without waiting for any results
-    // back, wasting server resource. So we're sending a KILL command
-    // to see if we can stop the query execution.
-    if (tid && RuntimeOption::MySQLKillOnTimeout) {
-      unsigned int errcode = mysql_errno(conn);
-      if (errcode == 2058 /* CR_NET_READ_INTERRUPTED */ ||
-          errcode == 2059 /* CR_NET_WRITE_INTERRUPTED */) {
-        Variant ret = f_preg_match("/^((\\/\\*.*?\\*\\/)|\\(|\\s)*select/is",
-                                   query);
-        if (!same(ret, false)) {
-          MYSQL *new_conn = create_new_conn();
-          IOStatusHelper io("mysql::kill", rconn->m_host.c_str(),
-                            rconn->m_port);
-          MYSQL *connected = mysql_real_connect
-            (new_conn, rconn->m_host.c_str(), rconn->m_username.c_str(),
-             rconn->m_password.c_str(), NULL, rconn->m_port, NULL, 0);
-          if (connected) {
-            string killsql = "KILL " + boost::lexical_cast<string>(tid);
-            if (mysql_real_query(connected, killsql.c_str(), killsql.size())) {
-              raise_warning("Unable to kill thread %llu", tid);
-            }
+static void php_mysql_query_failed(CStrRef query, MYSQL *conn, MySQL *rconn,
+                                   unsigned long tid) {
+  raise_notice("runtime/ext_mysql: failed executing [%s] [%s]", query.data(),
+               mysql_error(conn));
+
+  // When we are timed out, and we're SELECT-ing, we're potentially
+  // running a long query on the server without waiting for any results
+  // back, wasting server resource. So we're sending a KILL command
+  // to see if we can stop the query execution.
+  if (tid && RuntimeOption::MySQLKillOnTimeout) {
+    unsigned int errcode = mysql_errno(conn);
+    if (errcode == 2058 /* CR_NET_READ_INTERRUPTED */ ||
+        errcode == 2059 /* CR_NET_WRITE_INTERRUPTED */) {
+      Variant ret = f_preg_match("/^((\\/\\*.*?\\*\\/)|\\(|\\s)*select/is",
+                                 query);
+      if (!same(ret, false)) {
+        MYSQL *new_conn = create_new_conn();
+        IOStatusHelper io("mysql::kill", rconn->m_host.c_str(),
+                          rconn->m_port);
+        MYSQL *connected = mysql_real_connect
+          (new_conn, rconn->m_host.c_str(), rconn->m_username.c_str(),
+           rconn->m_password.c_str(), NULL, rconn->m_port, NULL, 0);
+        if (connected) {
+          string killsql = "KILL " + boost::lexical_cast<string>(tid);
+          if (mysql_real_query(connected, killsql.c_str(), killsql.size())) {
+            raise_warning("Unable to kill thread %llu", tid);
           }
-          mysql_close(new_conn);
         }
+        mysql_close(new_conn);
       }
     }
-
-    return false;
   }
-  Logger::Verbose("runtime/ext_mysql: successfully executed [%dms] [%s]",
-                  (int)timer.getTime(), query.data());
+}
 
+static Variant php_mysql_get_result(CStrRef query, MYSQL *conn,
+                                    bool use_store) {
   MYSQL_RES *mysql_result;
   if (use_store) {
     if (RuntimeOption::MySQLLocalize) {
@@ -922,6 +950,32 @@ static Variant php_mysql_do_query_general(CStrRef query, CVarRef link_id,
   return ret;
 }
 
+static Variant php_mysql_do_query_general(CStrRef query, CVarRef link_id,
+                                          bool use_store) {
+  if (php_mysql_skip_write(query)) {
+    return true; // pretend it worked
+  }
+
+  MySQL *rconn = NULL;
+  MYSQL *conn = MySQL::GetConn(link_id, &rconn);
+  if (!conn || !rconn) return false;
+
+  php_mysql_log_query(query, rconn);
+
+  SlowTimer timer(RuntimeOption::MySQLSlowQueryThreshold,
+                  "runtime/ext_mysql: slow query", query.data());
+  IOStatusHelper io("mysql::query", rconn->m_host.c_str(), rconn->m_port);
+  unsigned long tid = mysql_thread_id(conn);
+  if (mysql_real_query(conn, query.data(), query.size())) {
+    php_mysql_query_failed(query, conn, rconn, tid);
+    return false;
+  }
+  Logger::Verbose("runtime/ext_mysql: successfully executed [%dms] [%s]",
+                  (int)timer.getTime(), query.data());
+
+  return php_mysql_get_result(query, conn, use_store);
+}
+
 Variant f_mysql_query(CStrRef query, CVarRef link_identifier /* = null */) {
   return php_mysql_do_query_general(query, link_identifier, true);
 }
@@ -931,6 +985,123 @@ Variant f_mysql_unbuffered_query(CStrRef query,
   return php_mysql_do_query_general(query, link_identifier, false);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// async queries: sent right away, with the result read only once the server
+// has answered, so one request can have queries running on many links
+
+static MySQL *php_mysql_get_async_conn(CVarRef link_identifier) {
+  MySQL *mySQL = MySQL::Get(link_identifier);
+  if (mySQL == NULL || mySQL->get() == NULL) {
+    raise_warning("supplied argument is not a valid MySQL-Link resource");
+    return NULL;
+  }
+  return mySQL;
+}
+
+static bool php_mysql_async_ready(MySQL *mySQL, int timeout_ms) {
+  if (mySQL->m_async_state != MySQL::AsyncPending) return true;
+  struct pollfd fd;
+  fd.fd = mySQL->get()->net.fd;
+  fd.events = POLLIN;
+  fd.revents = 0;
+  return poll(&fd, 1, timeout_ms) != 0; // errors make reading fail right away
+}
+
+bool f_mysql_async_query_start(CStrRef query,
+                               CVarRef link_identifier /* = null */) {
+  MySQL *rconn = NULL;
+  MYSQL *conn = MySQL::GetConn(link_identifier, &rconn);
+  if (!conn || !rconn) return false;
+
+  if (php_mysql_skip_write(query)) {
+    rconn->m_async_state = MySQL::AsyncSkipped;
+    return true; // pretend it worked
+  }
+
+  php_mysql_log_query(query, rconn);
+
+  IOStatusHelper io("mysql::async_start", rconn->m_host.c_str(),
+                    rconn->m_port);
+  unsigned long tid = mysql_thread_id(conn);
+  if (mysql_send_query(conn, query.data(), query.size())) {
+    php_mysql_query_failed(query, conn, rconn, tid);
+    return false;
+  }
+  rconn->m_async_state = MySQL::AsyncPending;
+  rconn->m_async_query = string(query.data(), query.size());
+  rconn->m_async_tid = tid;
+  return true;
+}
+
+bool f_mysql_async_query_completed(CVarRef link_identifier /* = null */) {
+  MySQL *mySQL = php_mysql_get_async_conn(link_identifier);
+  return mySQL && php_mysql_async_ready(mySQL, 0);
+}
+
+Array f_mysql_async_wait_actionable(CArrRef items,
+                                    double timeout /* = 1.0 */) {
+  Array ret = Array::Create();
+  vector<struct pollfd> fds;
+  vector<Variant> keys;
+  for (ArrayIter iter(items); iter; ++iter) {
+    CVarRef item = iter.secondRef();
+    if (!item.isObject()) continue;
+    MySQL *mySQL = item.toObject().getTyped<MySQL>(true, true);
+    if (mySQL == NULL || mySQL->get() == NULL) continue;
+    if (mySQL->m_async_state != MySQL::AsyncPending) {
+      ret.set(iter.first(), item);
+      continue;
+    }
+    struct pollfd fd;
+    fd.fd = mySQL->get()->net.fd;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    fds.push_back(fd);
+    keys.push_back(iter.first());
+  }
+  if (fds.empty()) return ret;
+
+  // no waiting when some are actionable already
+  int timeout_ms = ret.empty() ? (int)(timeout * 1000) : 0;
+  IOStatusHelper io("mysql::async_wait", "", 0);
+  int n;
+  while ((n = poll(&fds[0], fds.size(), timeout_ms)) < 0 && errno == EINTR) {}
+  for (unsigned int i = 0; n > 0 && i < fds.size(); i++) {
+    if (fds[i].revents) {
+      ret.set(keys[i], items.rvalAt(keys[i]));
+    }
+  }
+  return ret;
+}
+
+Variant f_mysql_async_query_result(CVarRef link_identifier /* = null */) {
+  MySQL *rconn = php_mysql_get_async_conn(link_identifier);
+  if (!rconn) return false;
+  if (rconn->m_async_state == MySQL::AsyncSkipped) {
+    rconn->m_async_state = MySQL::AsyncNone;
+    return true;
+  }
+  if (rconn->m_async_state != MySQL::AsyncPending) {
+    raise_warning("no query started by mysql_async_query_start()");
+    return false;
+  }
+
+  MYSQL *conn = rconn->get();
+  String query(rconn->m_async_query);
+  rconn->m_async_state = MySQL::AsyncNone;
+  rconn->m_async_query.clear();
+
+  IOStatusHelper io("mysql::async_result", rconn->m_host.c_str(),
+                    rconn->m_port);
+  if (mysql_read_query_result(conn)) {
+    php_mysql_query_failed(query, conn, rconn, rconn->m_async_tid);
+    return false;
+  }
+  Logger::Verbose("runtime/ext_mysql: successfully executed [%s]",
+                  query.data());
+  return php_mysql_get_result(query, conn, true);
+}
+
 Variant f_mysql_list_dbs(CVarRef link_identifier /* = null */) {
   MYSQL *conn = MySQL::GetConn(link_identifier);
   if (!conn) return false;
@@ -982,59 +1153,64 @@ bool f_mysql_data_seek(CVarRef result, int row) {
 #define MYSQL_NUM    1 << 1
 #define MYSQL_BOTH   (MYSQL_ASSOC|MYSQL_NUM)
 
-static Variant php_mysql_fetch_hash(CVarRef result, int result_type) {
-  if ((result_type & MYSQL_BOTH) == 0) {
-    throw_invalid_argument("result_type: %d", result_type);
-    return false;
-  }
-
-  MySQLResult *res = get_result(result);
-  if (res == NULL) return false;
-
-  Array ret;
+/**
+ * Builds the next row of res into ret, with keys made once per result and
+ * the array sized up front. Returns false when there are no more rows.
+ */
+static bool php_mysql_fetch_next(MySQLResult *res, int result_type,
+                                 Variant &ret) {
+  int fields = res->getFieldCount();
+  MYSQL_RES *mysql_result = NULL;
+  MYSQL_ROW mysql_row = NULL;
+  unsigned long *mysql_row_lengths = NULL;
   if (res->isLocalized()) {
     if (!res->fetchRow()) return false;
-
-    for (int i = 0; i < res->getFieldCount(); i++) {
-      if (result_type & MYSQL_NUM) {
-        ret.set(i, res->getField(i));
-      }
-      if (result_type & MYSQL_ASSOC) {
-        MySQLFieldInfo *info = res->getFieldInfo(i);
-        ret.set(info->name->toString(), res->getField(i));
-      }
+  } else {
+    mysql_result = res->get();
+    mysql_row = mysql_fetch_row(mysql_result);
+    if (!mysql_row) {
+      return false;
+    }
+    mysql_row_lengths = mysql_fetch_lengths(mysql_result);
+    if (!mysql_row_lengths) {
+      return false;
     }
-    return ret;
-  }
-
-  MYSQL_RES *mysql_result = res->get();
-  MYSQL_ROW mysql_row = mysql_fetch_row(mysql_result);
-  if (!mysql_row) {
-    return false;
-  }
-  unsigned long *mysql_row_lengths = mysql_fetch_lengths(mysql_result);
-  if (!mysql_row_lengths) {
-    return false;
   }
 
-  mysql_field_seek(mysql_result, 0);
-
-  MYSQL_FIELD *mysql_field;
-  int i;
-  for (mysql_field = mysql_fetch_field(mysql_result), i = 0; mysql_field;
-       mysql_field = mysql_fetch_field(mysql_result), i++) {
+  int size = (result_type & MYSQL_NUM) && (result_type & MYSQL_ASSOC) ?
+    fields * 2 : fields;
+  ArrayInit row(size, !(result_type & MYSQL_ASSOC));
+  for (int i = 0; i < fields; i++) {
     Variant data;
-    if (mysql_row[i]) {
-      data = mysql_makevalue(String(mysql_row[i], mysql_row_lengths[i],
-                                    CopyString), mysql_field);
+    if (res->isLocalized()) {
+      data = res->getField(i);
+    } else if (mysql_row[i]) {
+      data = mysql_makevalue(mysql_row[i], mysql_row_lengths[i],
+                             mysql_result->fields + i);
     }
     if (result_type & MYSQL_NUM) {
-      ret.set(i, data);
+      row.set(i, (int64)i, data);
     }
     if (result_type & MYSQL_ASSOC) {
-      ret.set(String(mysql_field->name, CopyString), data);
+      MySQLFieldInfo *info = res->getFieldInfo(i);
+      row.set(i, *info->key, data, -1, true);
     }
   }
+  ret = row.create();
+  return true;
+}
+
+static Variant php_mysql_fetch_hash(CVarRef result, int result_type) {
+  if ((result_type & MYSQL_BOTH) == 0) {
+    throw_invalid_argument("result_type: %d", result_type);
+    return false;
+  }
+
+  MySQLResult *res = get_result(result);
+  if (res == NULL) return false;
+
+  Variant ret;
+  if (!php_mysql_fetch_next(res, result_type, ret)) return false;
   return ret;
 }
 
@@ -1050,6 +1226,23 @@ Variant f_mysql_fetch_array(CVarRef result, int result_type /* = 3 */) {
   return php_mysql_fetch_hash(result, result_type);
 }
 
+Variant f_mysql_fetch_all(CVarRef result, int result_type /* = 3 */) {
+  if ((result_type & MYSQL_BOTH) == 0) {
+    throw_invalid_argument("result_type: %d", result_type);
+    return false;
+  }
+
+  MySQLResult *res = get_result(result);
+  if (res == NULL) return false;
+
+  Array ret = Array::Create();
+  Variant row;
+  while (php_mysql_fetch_next(res, result_type, row)) {
+    ret.append(row);
+  }
+  return ret;
+}
+
 Variant f_mysql_fetch_object(CVarRef result,
                              CStrRef class_name /* = "stdClass" */,
                              CArrRef params /* = null */) {
@@ -1289,6 +1482,7 @@ void MySQLResult::setFieldInfo(int64 f, MYSQL_FIELD *field) {
   info.name = NEW(Variant)(String(field->name, CopyString));
   info.table = NEW(Variant)(String(field->table, CopyString));
   info.def = NEW(Variant)(String(field->def, CopyString));
+  info.key = NEW(Variant)(info.name->toKey());
   info.max_length = (int64)field->max_length;
   info.length = (int64)field->length;
   info.type = (int)field->type;
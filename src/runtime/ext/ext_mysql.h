@@ -108,6 +108,12 @@ public:
 
   MYSQL *get() { return m_conn;}
 
+  /**
+   * Reads and throws away the result of a query mysql_async_query_start()
+   * sent, so the connection can take other queries.
+   */
+  void discardAsyncQuery();
+
 private:
   MYSQL *m_conn;
 
@@ -121,6 +127,15 @@ public:
   int m_last_errno;
   std::string m_last_error;
   int m_xaction_count;
+
+  enum AsyncState {
+    AsyncNone,
+    AsyncPending,   // sent, result not read yet
+    AsyncSkipped    // write query not sent in read-only mode
+  };
+  AsyncState m_async_state;
+  std::string m_async_query;
+  unsigned long m_async_tid;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -128,12 +143,13 @@ public:
 class MySQLFieldInfo {
 public:
   MySQLFieldInfo()
-    : name(NULL), table(NULL), def(NULL),
+    : name(NULL), table(NULL), def(NULL), key(NULL),
       max_length(0), length(0), type(0), flags(0) {}
 
   Variant *name;
   Variant *table;
   Variant *def;
+  Variant *key; // name as an array key, so rows do not convert it each time
   int64 max_length;
   int64 length;
   int type;
@@ -339,6 +355,15 @@ Variant f_mysql_query(CStrRef query, CVarRef link_identifier = null);
 
 Variant f_mysql_unbuffered_query(CStrRef query,
                                  CVarRef link_identifier = null);
+
+bool f_mysql_async_query_start(CStrRef query,
+                               CVarRef link_identifier = null);
+
+bool f_mysql_async_query_completed(CVarRef link_identifier = null);
+
+Array f_mysql_async_wait_actionable(CArrRef items, double timeout = 1.0);
+
+Variant f_mysql_async_query_result(CVarRef link_identifier = null);
 inline Variant f_mysql_db_query(CStrRef database, CStrRef query,
                                 CVarRef link_identifier = null) {
   throw NotSupportedException
@@ -367,6 +392,8 @@ Variant f_mysql_fetch_assoc(CVarRef result);
 
 Variant f_mysql_fetch_array(CVarRef result, int result_type = 3);
 
+Variant f_mysql_fetch_all(CVarRef result, int result_type = 3);
+
 Variant f_mysql_fetch_lengths(CVarRef result);
 
 Variant f_mysql_fetch_object(CVarRef result, CStrRef class_name = "stdClass",
@@ -26,7 +26,10 @@
 #include <runtime/base/ini_setting.h>
 #include <runtime/base/time/datetime.h>
 #include <runtime/base/variable_unserializer.h>
+#include <runtime/base/shared/shared_store.h>
 #include <util/lock.h>
+#include <util/synchronizable.h>
+#include <util/thread_local.h>
 #include <util/compatibility.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -77,6 +80,7 @@ public:
   int64  m_gc_maxlifetime;
   int    m_module_number;
   int64  m_cache_expire;
+  int64  m_lock_timeout;
 
   std::string m_ps_open;
   std::string m_ps_close;
@@ -86,6 +90,7 @@ public:
   std::string m_ps_gc;
 
   SessionSerializer *m_serializer;
+  bool m_default_serializer; // session.serialize_handler left at "php"
 
   bool m_auto_start;
   bool m_use_cookies;
@@ -100,16 +105,19 @@ public:
   int  m_define_sid;
   bool m_invalid_session_id;  /* allows the driver to report about an invalid
                                  session id and request id regeneration */
+  bool m_unlocked_write;      /* allows the driver to report that it refused to
+                                 write a session the request does not lock */
 
   Session()
     : m_entropy_length(0), m_cookie_lifetime(0), m_cookie_secure(false),
       m_cookie_httponly(false), m_mod(NULL), m_session_status(None),
       m_gc_probability(0), m_gc_divisor(0), m_gc_maxlifetime(0),
-      m_module_number(0), m_cache_expire(0), m_serializer(NULL),
+      m_module_number(0), m_cache_expire(0), m_lock_timeout(0),
+      m_serializer(NULL), m_default_serializer(true),
       m_auto_start(false), m_use_cookies(false), m_use_only_cookies(false),
       m_use_trans_sid(false), m_apply_trans_sid(false),
       m_hash_bits_per_character(0), m_send_cookie(0), m_define_sid(0),
-      m_invalid_session_id(false) {
+      m_invalid_session_id(false), m_unlocked_write(false) {
   }
 };
 
@@ -153,6 +161,7 @@ public:
                      ini_on_update_long,           &m_gc_maxlifetime);
     IniSetting::Bind("session.serialize_handler",  "php",
                      ini_on_update_serializer);
+    m_default_serializer = true;
     IniSetting::Bind("session.cookie_lifetime",    "0",
                      ini_on_update_long,           &m_cookie_lifetime);
     IniSetting::Bind("session.cookie_path",        "/",
@@ -177,6 +186,8 @@ public:
                      ini_on_update_string,         &m_cache_limiter);
     IniSetting::Bind("session.cache_expire",       "180",
                      ini_on_update_long,           &m_cache_expire);
+    IniSetting::Bind("session.lock_timeout",       "30",
+                     ini_on_update_long,           &m_lock_timeout);
     IniSetting::Bind("session.use_trans_sid",      "0",
                      ini_on_update_trans_sid);
     IniSetting::Bind("session.hash_function",      "0",
@@ -214,6 +225,12 @@ public:
   virtual bool gc(int maxlifetime, int *nrdels) = 0;
   virtual String create_sid();
 
+  /**
+   * Serializer to use instead of "php" while session.serialize_handler is
+   * left at its default, or NULL to use "php".
+   */
+  virtual const char *getDefaultSerializer() const { return NULL;}
+
 public:
   static SessionModule *Find(const char *name) {
     for (unsigned int i = 0; i < RegisteredModules.size(); i++) {
@@ -343,6 +360,26 @@ String SessionModule::create_sid() {
 ///////////////////////////////////////////////////////////////////////////////
 // FileSessionModule
 
+/* If you change the logic here, please also update the error messages in
+ * FileSessionModule and MemorySessionModule appropriately */
+static bool is_valid_session_id(const char *key) {
+  const char *p; char c;
+  bool ret = true;
+  for (p = key; (c = *p); p++) {
+    /* valid characters are a..z,A..Z,0..9 */
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+          || (c >= '0' && c <= '9') || c == ',' || c == '-')) {
+      ret = false;
+      break;
+    }
+  }
+  size_t len = p - key;
+  if (len == 0) {
+    ret = false;
+  }
+  return ret;
+}
+
 class FileSessionModule : public SessionModule {
 public:
   FileSessionModule()
@@ -532,26 +569,6 @@ private:
   size_t m_st_size;
   int m_filemode;
 
-  /* If you change the logic here, please also update the error message in
-   * ps_files_open() appropriately */
-  static bool IsValid(const char *key) {
-    const char *p; char c;
-    bool ret = true;
-    for (p = key; (c = *p); p++) {
-      /* valid characters are a..z,A..Z,0..9 */
-      if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
-            || (c >= '0' && c <= '9') || c == ',' || c == '-')) {
-        ret = false;
-        break;
-      }
-    }
-    size_t len = p - key;
-    if (len == 0) {
-      ret = false;
-    }
-    return ret;
-  }
-
 #define FILE_PREFIX "sess_"
 
   bool createPath(char *buf, size_t buflen, const char *key) {
@@ -601,7 +618,7 @@ private:
       m_lastkey.clear();
       closeImpl();
 
-      if (!IsValid(key)) {
+      if (!is_valid_session_id(key)) {
         raise_warning("The session id contains illegal characters, "
                       "valid characters are a-z, A-Z, 0-9 and '-,'");
         PS(invalid_session_id) = true;
@@ -687,6 +704,166 @@ private:
 };
 static FileSessionModule s_file_session_module;
 
+///////////////////////////////////////////////////////////////////////////////
+// MemorySessionModule
+
+/**
+ * Ids of the sessions some request is between read() and close() on.
+ */
+class SessionLocks : public Synchronizable {
+public:
+  bool acquire(const std::string &id, int64 timeout) {
+    Lock lock(this);
+    time_t deadline = time(NULL) + timeout;
+    while (m_ids.find(id) != m_ids.end()) {
+      time_t now = time(NULL);
+      if (now >= deadline) {
+        return false;
+      }
+      wait(deadline - now);
+    }
+    m_ids.insert(id);
+    return true;
+  }
+
+  void release(const std::string &id) {
+    Lock lock(this);
+    m_ids.erase(id);
+    notifyAll();
+  }
+
+private:
+  hphp_string_set m_ids;
+};
+static SessionLocks s_session_locks;
+
+// id of the session this thread's request holds, if any
+static IMPLEMENT_THREAD_LOCAL(std::string, s_locked_session);
+// id of the session this thread's request could not lock in read(), if any
+static IMPLEMENT_THREAD_LOCAL(std::string, s_refused_session);
+
+/**
+ * Keeps sessions in their own APC store instead of files, so reading and
+ * writing one is a hash lookup, and lets the store expire them
+ * session.gc_maxlifetime seconds after they were last written. Requests on
+ * the same session are serialized the way flock() does for files: read()
+ * waits up to session.lock_timeout seconds for any other request on it to
+ * close(), and fails after that. write() under an id read() did not lock,
+ * as after session_regenerate_id(), takes that id's lock the same way.
+ * Sessions only live as long as the server process, or its APC snapshot.
+ */
+class MemorySessionModule : public SessionModule {
+public:
+  MemorySessionModule() : SessionModule("memory") {}
+
+  virtual const char *getDefaultSerializer() const { return "php_binary";}
+
+  virtual bool open(const char *save_path, const char *session_name) {
+    return true;
+  }
+
+  virtual bool close() {
+    unlock();
+    s_refused_session->clear();
+    return true;
+  }
+
+  virtual bool read(const char *key, String &value) {
+    if (!is_valid_session_id(key)) {
+      raise_warning("The session id contains illegal characters, "
+                    "valid characters are a-z, A-Z, 0-9 and '-,'");
+      PS(invalid_session_id) = true;
+      return false;
+    }
+    if (*s_locked_session != key) {
+      unlock();
+      if (!s_session_locks.acquire(key, PS(lock_timeout))) {
+        raise_warning("Unable to lock session %s within %lld seconds",
+                      key, PS(lock_timeout));
+        *s_refused_session = key;
+        return false;
+      }
+      *s_locked_session = key;
+    }
+
+    Variant v;
+    if (s_apc_store[SHARED_STORE_SESSION].get(key, v)) {
+      value = v.toString();
+    } else {
+      value = "";
+    }
+    return true;
+  }
+
+  virtual bool write(const char *key, CStrRef value) {
+    if (*s_locked_session != key) {
+      // Not read under this id, as after session_regenerate_id(): the lock
+      // moves to it. Refused when read() could not lock it, as what we have
+      // is not what is stored, or when another request holds it.
+      unlock();
+      if (*s_refused_session == key ||
+          !s_session_locks.acquire(key, PS(lock_timeout))) {
+        PS(unlocked_write) = true;
+        return false;
+      }
+      *s_locked_session = key;
+    }
+    return s_apc_store[SHARED_STORE_SESSION].store
+      (key, value, PS(gc_maxlifetime));
+  }
+
+  virtual bool destroy(const char *key) {
+    s_apc_store[SHARED_STORE_SESSION].erase(key);
+    if (*s_locked_session == key) {
+      unlock();
+    }
+    return true;
+  }
+
+  virtual bool gc(int maxlifetime, int *nrdels) {
+    ExpiredVisitor visitor;
+    SharedStore &store = s_apc_store[SHARED_STORE_SESSION];
+    store.walk(visitor);
+    *nrdels = 0;
+    for (unsigned int i = 0; i < visitor.keys.size(); i++) {
+      if (store.erase(visitor.keys[i], true)) {
+        ++*nrdels;
+      }
+    }
+    return true;
+  }
+
+private:
+  class ExpiredVisitor : public SharedStore::Visitor {
+  public:
+    ExpiredVisitor() : now(time(NULL)) {}
+    virtual void visit(const char *key, int len, SharedVariant *var,
+                       int64 expiry) {
+      if (expiry && expiry <= now) {
+        keys.push_back(String(key, len, CopyString));
+      }
+    }
+    time_t now;
+    std::vector<String> keys;
+  };
+
+  void unlock() {
+    if (!s_locked_session->empty()) {
+      s_session_locks.release(*s_locked_session);
+      s_locked_session->clear();
+    }
+  }
+};
+static MemorySessionModule s_memory_session_module;
+
+bool session_memory_lock(CStrRef id, int64 timeout) {
+  return s_session_locks.acquire(id.data(), timeout);
+}
+
+void session_memory_unlock(CStrRef id) {
+  s_session_locks.release(id.data());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // UserSessionModule
 
@@ -808,13 +985,10 @@ public:
       String key(p + 1, namelen, CopyString);
       p += namelen + 1;
       if (has_value) {
-        istringstream in(std::string(p, endptr - p));
-        VariableUnserializer vu(in);
+        VariableUnserializer vu(p, endptr - p);
         try {
           g->gv__SESSION.set(key, vu.unserialize());
-          if (in.tellg() > 0 && in.tellg() < endptr - p) {
-            p += in.tellg();
-          }
+          p += vu.consumed();
         } catch (Exception &e) {
         }
       }
@@ -871,13 +1045,10 @@ public:
       String key(p, q - p, CopyString);
       q++;
       if (has_value) {
-        istringstream in(std::string(q, endptr - q));
-        VariableUnserializer vu(in);
+        VariableUnserializer vu(q, endptr - q);
         try {
           g->gv__SESSION.set(key, vu.unserialize());
-          if (in.tellg() > 0 && in.tellg() < endptr - q) {
-            q += in.tellg();
-          }
+          q += vu.consumed();
         } catch (Exception &e) {
         }
       }
@@ -906,6 +1077,7 @@ bool ini_on_update_save_handler(CStrRef value, void *p) {
 bool ini_on_update_serializer(CStrRef value, void *p) {
   SESSION_CHECK_ACTIVE_STATE;
   PS(serializer) = SessionSerializer::Find(value.data());
+  PS(default_serializer) = false;
   return true;
 }
 
@@ -951,22 +1123,34 @@ static int php_session_destroy() {
   return retval;
 }
 
+static SessionSerializer *php_session_serializer() {
+  if (PS(default_serializer) && PS(mod)) {
+    const char *name = PS(mod)->getDefaultSerializer();
+    if (name) {
+      return SessionSerializer::Find(name);
+    }
+  }
+  return PS(serializer);
+}
+
 static String php_session_encode() {
-  if (!PS(serializer)) {
+  SessionSerializer *serializer = php_session_serializer();
+  if (!serializer) {
     raise_warning("Unknown session.serialize_handler. "
                   "Failed to encode session object");
     return String();
   }
-  return PS(serializer)->encode();
+  return serializer->encode();
 }
 
 static void php_session_decode(CStrRef value) {
-  if (!PS(serializer)) {
+  SessionSerializer *serializer = php_session_serializer();
+  if (!serializer) {
     raise_warning("Unknown session.serialize_handler. "
                   "Failed to decode session object");
     return;
   }
-  if (!PS(serializer)->decode(value)) {
+  if (!serializer->decode(value)) {
     php_session_destroy();
     raise_warning("Failed to decode session object. "
                   "Session has been destroyed");
@@ -1032,13 +1216,19 @@ new_session:
 
 static void php_session_save_current_state() {
   bool ret = false;
+  PS(unlocked_write) = false;
   if (PS(mod)) {
     String value = php_session_encode();
     if (!value.isNull()) {
       ret = PS(mod)->write(PS(id).data(), value);
     }
   }
-  if (!ret) {
+  if (!ret && PS(unlocked_write)) {
+    raise_warning("Failed to write session data (%s). The session is not "
+                  "locked by this request, most likely because it timed out "
+                  "waiting for the lock (session.lock_timeout)",
+                  PS(mod)->getName());
+  } else if (!ret) {
     raise_warning("Failed to write session data (%s). Please verify that the "
                   "current setting of session.save_path is correct (%s)",
                   PS(mod)->getName(), PS(save_path).c_str());
@@ -46,6 +46,16 @@ bool f_session_register(int _argc, CVarRef var_names, CArrRef _argv = null_array
 bool f_session_unregister(CStrRef varname);
 bool f_session_is_registered(CStrRef varname);
 
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Locks a session kept by the "memory" save handler the way a request does
+ * from session_start() to session_write_close(), waiting up to timeout
+ * seconds for its current holder. Returns false if it timed out.
+ */
+bool session_memory_lock(CStrRef id, int64 timeout);
+void session_memory_unlock(CStrRef id);
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
@@ -17,6 +17,7 @@
 
 #include <runtime/ext/ext_thrift.h>
 #include <runtime/ext/ext_class.h>
+#include <runtime/base/util/request_local.h>
 
 #include <sys/types.h>
 #include <netinet/in.h>
@@ -82,6 +83,29 @@ const int8_t T_EXCEPTION = 3;
 const int INVALID_DATA = 1;
 const int BAD_VERSION = 4;
 
+// compact protocol
+enum CType {
+  C_STOP          = 0,
+  C_BOOLEAN_TRUE  = 1,
+  C_BOOLEAN_FALSE = 2,
+  C_BYTE          = 3,
+  C_I16           = 4,
+  C_I32           = 5,
+  C_I64           = 6,
+  C_DOUBLE        = 7,
+  C_BINARY        = 8,
+  C_LIST          = 9,
+  C_SET           = 10,
+  C_MAP           = 11,
+  C_STRUCT        = 12
+};
+
+const uint8_t COMPACT_PROTOCOL_ID = 0x82;
+const uint8_t COMPACT_VERSION = 1;
+const uint8_t COMPACT_VERSION_MASK = 0x1f;
+const int COMPACT_TYPE_SHIFT = 5;
+const uint8_t COMPACT_TYPE_BITS = 0x07;
+
 static StaticString s_getTransport("getTransport");
 static StaticString s_flush("flush");
 static StaticString s_write("write");
@@ -281,9 +305,176 @@ protected:
 
 };
 
-void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport, CArrRef spec);
-void binary_serialize_spec(CObjRef zthis, PHPOutputTransport& transport, CArrRef spec);
-void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport, CVarRef value, CArrRef fieldspec);
+///////////////////////////////////////////////////////////////////////////////
+// compiled _TSPEC
+
+class ThriftStructSpec;
+
+/**
+ * What a _TSPEC entry, or the key, val or elem spec nested in one, says
+ * about a value, read out of the spec array once.
+ */
+class ThriftTypeSpec {
+public:
+  ThriftTypeSpec()
+    : type(T_STOP), ktype(T_STOP), vtype(T_STOP), etype(T_STOP),
+      key(NULL), val(NULL), elem(NULL), structSpec(NULL) {}
+  ~ThriftTypeSpec() {
+    delete key;
+    delete val;
+    delete elem;
+  }
+
+  void compile(CArrRef spec);
+
+  int8_t type;
+  int8_t ktype;
+  int8_t vtype;
+  int8_t etype;
+  String className;             // T_STRUCT only
+  ThriftTypeSpec *key;
+  ThriftTypeSpec *val;
+  ThriftTypeSpec *elem;
+  ThriftStructSpec *structSpec; // of className, found on first read
+
+private:
+  static ThriftTypeSpec *CompileNested(CArrRef spec, CStrRef name);
+};
+
+class ThriftFieldSpec : public ThriftTypeSpec {
+public:
+  ThriftFieldSpec() : fieldno(0), hash(-1) {}
+
+  int64 fieldno;
+  String name;
+  int64 hash; // of name, for property lookups
+};
+
+class ThriftStructSpec {
+public:
+  ~ThriftStructSpec() {
+    for (unsigned int i = 0; i < fields.size(); i++) {
+      delete fields[i];
+    }
+  }
+
+  void compile(CArrRef spec);
+
+  ThriftFieldSpec *find(int64 fieldno) const {
+    hphp_hash_map<int64, ThriftFieldSpec *, int64_hash>::const_iterator it =
+      ids.find(fieldno);
+    return it == ids.end() ? NULL : it->second;
+  }
+
+  std::vector<ThriftFieldSpec *> fields; // in _TSPEC order
+  hphp_hash_map<int64, ThriftFieldSpec *, int64_hash> ids;
+};
+
+/**
+ * For values read or written with no spec, like map keys, or where the
+ * spec array had nothing.
+ */
+static ThriftTypeSpec s_no_spec;
+
+inline ThriftTypeSpec &nested_spec(ThriftTypeSpec *spec) {
+  return spec ? *spec : s_no_spec;
+}
+
+void throw_tprotocolexception(CStrRef what, long errorcode);
+
+ThriftTypeSpec *ThriftTypeSpec::CompileNested(CArrRef spec, CStrRef name) {
+  Variant v = spec.rvalAt(name, -1);
+  if (v.isNull()) return NULL;
+  ThriftTypeSpec *ret = new ThriftTypeSpec();
+  ret->compile(v.toArray());
+  return ret;
+}
+
+void ThriftTypeSpec::compile(CArrRef spec) {
+  type = spec.rvalAt(s_type, -1).toByte();
+  ktype = spec.rvalAt(s_ktype, -1).toByte();
+  vtype = spec.rvalAt(s_vtype, -1).toByte();
+  etype = spec.rvalAt(s_etype, -1).toByte();
+  Variant cls = spec.rvalAt(s_class, -1);
+  if (!cls.isNull()) className = cls.toString();
+  key = CompileNested(spec, s_key);
+  val = CompileNested(spec, s_val);
+  elem = CompileNested(spec, s_elem);
+}
+
+void ThriftStructSpec::compile(CArrRef spec) {
+  for (ArrayIter key_ptr = spec.begin(); !key_ptr.end(); ++key_ptr) {
+    Variant key = key_ptr.first();
+    if (!key.isInteger()) {
+      throw_tprotocolexception("Bad keytype in TSPEC (expected 'long')",
+                               INVALID_DATA);
+    }
+    ThriftFieldSpec *field = new ThriftFieldSpec();
+    fields.push_back(field);
+    Array fieldspec = key_ptr.second().toArray();
+    field->compile(fieldspec);
+    field->fieldno = key.toInt64();
+    field->name = fieldspec.rvalAt(s_var, -1).toString();
+    field->hash = field->name->hash();
+    ids[field->fieldno] = field;
+  }
+}
+
+/**
+ * Compiled _TSPECs by class name. Generated classes set _TSPEC in their
+ * constructors, so a spec is only kept once it is an array, and it is kept
+ * for the rest of the request, as a class may be declared differently by
+ * the next one.
+ */
+class ThriftRequestData : public RequestEventHandler {
+public:
+  virtual void requestInit() {
+    clear();
+  }
+
+  virtual void requestShutdown() {
+    clear();
+  }
+
+  ThriftStructSpec *getSpec(CStrRef className) {
+    StringIMap<ThriftStructSpec *>::const_iterator it =
+      m_specs.find(className);
+    if (it != m_specs.end()) return it->second;
+
+    Variant spec = get_static_property(className.data(), "_TSPEC");
+    if (!spec.is(KindOfArray)) return NULL;
+    ThriftStructSpec *ret = new ThriftStructSpec();
+    try {
+      ret->compile(spec.toArray());
+    } catch (...) {
+      delete ret;
+      throw;
+    }
+    m_specs[className] = ret;
+    return ret;
+  }
+
+private:
+  StringIMap<ThriftStructSpec *> m_specs;
+
+  void clear() {
+    for (StringIMap<ThriftStructSpec *>::const_iterator it = m_specs.begin();
+         it != m_specs.end(); ++it) {
+      delete it->second;
+    }
+    m_specs.clear();
+  }
+};
+IMPLEMENT_STATIC_REQUEST_LOCAL(ThriftRequestData, s_thrift_data);
+
+///////////////////////////////////////////////////////////////////////////////
+
+void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport,
+                             const ThriftStructSpec *spec);
+void binary_serialize_spec(CObjRef zthis, PHPOutputTransport& transport,
+                           const ThriftStructSpec *spec);
+void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
+                      CVarRef value, ThriftTypeSpec &fieldspec);
 void skip_element(long thrift_typeID, PHPInputTransport& transport);
 
 // Create a PHP object given a typename and call the ctor, optionally passing up to 2 arguments
@@ -308,37 +499,48 @@ void throw_tprotocolexception(CStrRef what, long errorcode) {
   throw ex;
 }
 
+/**
+ * Creates the object a T_STRUCT value of fieldspec is read into, and finds
+ * its spec. Returns a null Object if the class cannot be created, for the
+ * caller to skip the value.
+ */
+Object create_struct(ThriftTypeSpec &fieldspec, ThriftStructSpec *&spec) {
+  if (fieldspec.className.isNull()) {
+    throw_tprotocolexception("no class type in spec", INVALID_DATA);
+  }
+  Object ret = createObject(fieldspec.className);
+  if (ret.isNull()) return ret;
+  if (!fieldspec.structSpec) {
+    // after createObject(), which sets _TSPEC
+    fieldspec.structSpec = s_thrift_data->getSpec(fieldspec.className);
+  }
+  spec = fieldspec.structSpec;
+  if (!spec) {
+    char errbuf[128];
+    snprintf(errbuf, 128, "spec for %s is wrong type: %d\n",
+             fieldspec.className.data(), (int)KindOfObject);
+    throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+  }
+  return ret;
+}
+
 Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
-                           CArrRef fieldspec) {
+                           ThriftTypeSpec &fieldspec) {
   Variant ret;
   switch (thrift_typeID) {
     case T_STOP:
     case T_VOID:
       return null;
     case T_STRUCT: {
-      Variant val;
-      if ((val = fieldspec.rvalAt(s_class)).isNull()) {
-        throw_tprotocolexception("no class type in spec", INVALID_DATA);
-        skip_element(T_STRUCT, transport);
-        return null;
-      }
-      String structType = val.toString();
-      ret = createObject(structType);
-      if (ret.isNull()) {
+      ThriftStructSpec *spec;
+      Object obj = create_struct(fieldspec, spec);
+      if (obj.isNull()) {
         // unable to create class entry
         skip_element(T_STRUCT, transport);
         return null;
       }
-      Variant spec = get_static_property(structType, "_TSPEC");
-      if (!spec.is(KindOfArray)) {
-        char errbuf[128];
-        snprintf(errbuf, 128, "spec for %s is wrong type: %d\n",
-                 structType.data(), ret.getType());
-        throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
-        return null;
-      }
-      binary_deserialize_spec(ret, transport, spec.toArray());
-      return ret;
+      binary_deserialize_spec(obj, transport, spec);
+      return obj;
     } break;
     case T_BOOL: {
       uint8_t c;
@@ -395,8 +597,8 @@ Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
       transport.readBytes(types, 2);
       uint32_t size = transport.readU32();
 
-      Array keyspec = fieldspec.rvalAt(s_key, -1).toArray();
-      Array valspec = fieldspec.rvalAt(s_val, -1).toArray();
+      ThriftTypeSpec &keyspec = nested_spec(fieldspec.key);
+      ThriftTypeSpec &valspec = nested_spec(fieldspec.val);
       ret = Array::Create();
 
       for (uint32_t s = 0; s < size; ++s) {
@@ -409,8 +611,7 @@ Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
     case T_LIST: { // array with autogenerated numeric keys
       int8_t type = transport.readI8();
       uint32_t size = transport.readU32();
-      Variant elemvar = fieldspec.rvalAt(s_elem, -1);
-      Array elemspec = elemvar.toArray();
+      ThriftTypeSpec &elemspec = nested_spec(fieldspec.elem);
       ret = Array::Create();
 
       for (uint32_t s = 0; s < size; ++s) {
@@ -425,8 +626,7 @@ Variant binary_deserialize(int8_t thrift_typeID, PHPInputTransport& transport,
       transport.readBytes(&type, 1);
       transport.readBytes(&size, 4);
       size = ntohl(size);
-      Variant elemvar = fieldspec.rvalAt(s_elem, -1);
-      Array elemspec = elemvar.toArray();
+      ThriftTypeSpec &elemspec = nested_spec(fieldspec.elem);
       ret = Array::Create();
 
       for (uint32_t s = 0; s < size; ++s) {
@@ -517,7 +717,7 @@ void binary_serialize_hashtable_key(int8_t keytype, PHPOutputTransport& transpor
   } else {
     key = key.toString();
   }
-  binary_serialize(keytype, transport, key, Array());
+  binary_serialize(keytype, transport, key, s_no_spec);
 }
 
 inline bool ttype_is_int(int8_t t) {
@@ -531,30 +731,17 @@ inline bool ttypes_are_compatible(int8_t t1, int8_t t2) {
 }
 
 void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport,
-                             CArrRef spec) {
+                             const ThriftStructSpec *spec) {
   // SET and LIST have 'elem' => array('type', [optional] 'class')
   // MAP has 'val' => array('type', [optiona] 'class')
   while (true) {
-    Variant val;
-
     int8_t ttype = transport.readI8();
     if (ttype == T_STOP) return;
     int16_t fieldno = transport.readI16();
-    if (!(val = spec.rvalAt(fieldno)).isNull()) {
-      Array fieldspec = val.toArray();
-      // pull the field name
-      // zend hash tables use the null at the end in the length... so strlen(hash key) + 1.
-      String varname = fieldspec.rvalAt(s_var).toString();
-
-      // and the type
-      int8_t expected_ttype = fieldspec.rvalAt(s_type).toInt64();
-
-      if (ttypes_are_compatible(ttype, expected_ttype)) {
-        Variant rv = binary_deserialize(ttype, transport, fieldspec);
-        zthis->set(varname, rv);
-      } else {
-        skip_element(ttype, transport);
-      }
+    ThriftFieldSpec *field = spec ? spec->find(fieldno) : NULL;
+    if (field && ttypes_are_compatible(ttype, field->type)) {
+      Variant rv = binary_deserialize(ttype, transport, *field);
+      zthis->o_set(field->name, field->hash, rv);
     } else {
       skip_element(ttype, transport);
     }
@@ -562,7 +749,7 @@ void binary_deserialize_spec(CObjRef zthis, PHPInputTransport& transport,
 }
 
 void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
-                      CVarRef value, CArrRef fieldspec) {
+                      CVarRef value, ThriftTypeSpec &fieldspec) {
   // At this point the typeID (and field num, if applicable) should've already
   // been written to the output so all we need to do is write the payload.
   switch (thrift_typeID) {
@@ -575,9 +762,8 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
                                  "type as a T_STRUCT", INVALID_DATA);
       }
       binary_serialize_spec(value, transport,
-                            get_static_property(toObject(value)->
-                                                o_getClassName(),
-                                                "_TSPEC").toArray());
+                            s_thrift_data->getSpec(toObject(value)->
+                                                   o_getClassName()));
     } return;
     case T_BOOL:
       transport.writeI8(value.toBoolean() ? 1 : 0);
@@ -612,12 +798,12 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
     } return;
     case T_MAP: {
       Array ht = value.toArray();
-      uint8_t keytype = fieldspec.rvalAt(s_ktype, -1).toByte();
+      uint8_t keytype = fieldspec.ktype;
       transport.writeI8(keytype);
-      uint8_t valtype = fieldspec.rvalAt(s_vtype, -1).toByte();
+      uint8_t valtype = fieldspec.vtype;
       transport.writeI8(valtype);
 
-      Array valspec = fieldspec.rvalAt(s_val, -1).toArray();
+      ThriftTypeSpec &valspec = nested_spec(fieldspec.val);
 
       transport.writeI32(ht.size());
       for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
@@ -629,9 +815,9 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
       Array ht = value.toArray();
       Variant val;
 
-      uint8_t valtype = fieldspec.rvalAt(s_etype, -1).toInt64();
+      uint8_t valtype = fieldspec.etype;
       transport.writeI8(valtype);
-      Array valspec = fieldspec.rvalAt(s_elem, -1).toArray();
+      ThriftTypeSpec &valspec = nested_spec(fieldspec.elem);
       transport.writeI32(ht.size());
       for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
         binary_serialize(valtype, transport, key_ptr.second(), valspec);
@@ -640,7 +826,7 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
     case T_SET: {
       Array ht = value.toArray();
 
-      uint8_t keytype = fieldspec.rvalAt(s_etype, -1).toByte();
+      uint8_t keytype = fieldspec.etype;
       transport.writeI8(keytype);
 
       transport.writeI32(ht.size());
@@ -656,27 +842,16 @@ void binary_serialize(int8_t thrift_typeID, PHPOutputTransport& transport,
 
 
 void binary_serialize_spec(CObjRef zthis, PHPOutputTransport& transport,
-                           CArrRef spec) {
-  for (ArrayIter key_ptr = spec.begin(); !key_ptr.end(); ++key_ptr) {
-    Variant key = key_ptr.first();
-    if (!key.isInteger()) {
-      throw_tprotocolexception("Bad keytype in TSPEC (expected 'long')", INVALID_DATA);
-      return;
-    }
-    unsigned long fieldno = key.toInt64();
-    Array fieldspec = key_ptr.second().toArray();
-
-    // field name
-    String varname = fieldspec.rvalAt(s_var, -1).toString();
-
-    // thrift type
-    int8_t ttype = fieldspec.rvalAt(s_type, -1).toByte();
-
-    Variant prop = zthis->o_get(varname, -1);
-    if (!prop.isNull()) {
-      transport.writeI8(ttype);
-      transport.writeI16(fieldno);
-      binary_serialize(ttype, transport, prop, fieldspec);
+                           const ThriftStructSpec *spec) {
+  if (spec) {
+    for (unsigned int i = 0; i < spec->fields.size(); i++) {
+      ThriftFieldSpec *field = spec->fields[i];
+      Variant prop = zthis->o_get(field->name, field->hash);
+      if (!prop.isNull()) {
+        transport.writeI8(field->type);
+        transport.writeI16(field->fieldno);
+        binary_serialize(field->type, transport, prop, *field);
+      }
     }
   }
   transport.writeI8(T_STOP); // struct end
@@ -699,9 +874,9 @@ void f_thrift_protocol_write_binary(CObjRef transportobj, CStrRef method_name,
     transport.writeI32(seqid);
   }
 
-  Variant spec = get_static_property(request_struct->o_getClassName(),
-                                     "_TSPEC");
-  binary_serialize_spec(request_struct, transport, spec.toArray());
+  binary_serialize_spec(request_struct, transport,
+                        s_thrift_data->getSpec(request_struct->
+                                               o_getClassName()));
 }
 
 Variant f_thrift_protocol_read_binary(CObjRef transportobj,
@@ -734,14 +909,551 @@ Variant f_thrift_protocol_read_binary(CObjRef transportobj,
 
   if (messageType == T_EXCEPTION) {
     Object ex = createObject("TApplicationException");
-    Variant spec = get_static_property("TApplicationException", "_TSPEC");
-    binary_deserialize_spec(ex, transport, spec.toArray());
+    binary_deserialize_spec(ex, transport,
+                            s_thrift_data->getSpec("TApplicationException"));
+    throw ex;
+  }
+
+  Object ret_val = createObject(obj_typename);
+  binary_deserialize_spec(ret_val, transport,
+                          s_thrift_data->getSpec(obj_typename));
+  return ret_val;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// compact protocol
+
+int8_t ttype_to_ctype(int8_t ttype) {
+  switch (ttype) {
+    case T_STOP:   return C_STOP;
+    case T_BOOL:   return C_BOOLEAN_TRUE;
+    case T_BYTE:   return C_BYTE;
+    case T_I16:    return C_I16;
+    case T_I32:    return C_I32;
+    case T_U64:
+    case T_I64:    return C_I64;
+    case T_DOUBLE: return C_DOUBLE;
+    //case T_UTF7: // aliases T_STRING
+    case T_UTF8:
+    case T_UTF16:
+    case T_STRING: return C_BINARY;
+    case T_LIST:   return C_LIST;
+    case T_SET:    return C_SET;
+    case T_MAP:    return C_MAP;
+    case T_STRUCT: return C_STRUCT;
+  }
+  char errbuf[128];
+  sprintf(errbuf, "Unknown thrift typeID %d", ttype);
+  throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+  return C_STOP;
+}
+
+int8_t ctype_to_ttype(int8_t ctype) {
+  switch (ctype) {
+    case C_STOP:          return T_STOP;
+    case C_BOOLEAN_TRUE:
+    case C_BOOLEAN_FALSE: return T_BOOL;
+    case C_BYTE:          return T_BYTE;
+    case C_I16:           return T_I16;
+    case C_I32:           return T_I32;
+    case C_I64:           return T_I64;
+    case C_DOUBLE:        return T_DOUBLE;
+    case C_BINARY:        return T_STRING;
+    case C_LIST:          return T_LIST;
+    case C_SET:           return T_SET;
+    case C_MAP:           return T_MAP;
+    case C_STRUCT:        return T_STRUCT;
+  }
+  char errbuf[128];
+  sprintf(errbuf, "Unknown compact type %d", ctype);
+  throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+  return T_STOP;
+}
+
+inline bool ttype_is_string(int8_t t) {
+  return t == T_STRING || t == T_UTF8 || t == T_UTF16;
+}
+
+/**
+ * Integers are zigzag varints, doubles are little endian, and field ids
+ * are written as deltas from the previous field's, with bool fields
+ * carrying their value in the field header.
+ */
+class CompactWriter {
+public:
+  CompactWriter(PHPOutputTransport &transport)
+    : m_transport(transport), m_lastFieldId(0) {}
+
+  void writeMessageBegin(CStrRef name, int64 msgtype, int32_t seqid) {
+    m_transport.writeI8(COMPACT_PROTOCOL_ID);
+    m_transport.writeI8(COMPACT_VERSION |
+                        ((msgtype & COMPACT_TYPE_BITS) << COMPACT_TYPE_SHIFT));
+    writeVarint((uint32_t)seqid);
+    writeString(name);
+  }
+
+  void writeStruct(CObjRef obj, const ThriftStructSpec *spec) {
+    int16_t lastFieldId = m_lastFieldId;
+    m_lastFieldId = 0;
+    if (spec) {
+      for (unsigned int i = 0; i < spec->fields.size(); i++) {
+        ThriftFieldSpec *field = spec->fields[i];
+        Variant prop = obj->o_get(field->name, field->hash);
+        if (prop.isNull()) continue;
+        if (field->type == T_BOOL) {
+          writeFieldHeader(prop.toBoolean() ? C_BOOLEAN_TRUE : C_BOOLEAN_FALSE,
+                           field->fieldno);
+        } else {
+          writeFieldHeader(ttype_to_ctype(field->type), field->fieldno);
+          writeValue(field->type, prop, *field);
+        }
+      }
+    }
+    m_transport.writeI8(C_STOP);
+    m_lastFieldId = lastFieldId;
+  }
+
+private:
+  PHPOutputTransport &m_transport;
+  int16_t m_lastFieldId;
+
+  void writeVarint(uint64_t n) {
+    char buf[10];
+    int len = 0;
+    while (n & ~(uint64_t)0x7f) {
+      buf[len++] = (char)((n & 0x7f) | 0x80);
+      n >>= 7;
+    }
+    buf[len++] = (char)n;
+    m_transport.write(buf, len);
+  }
+
+  void writeI32(int32_t n) {
+    writeVarint(((uint32_t)n << 1) ^ (uint32_t)(n >> 31));
+  }
+
+  void writeI64(int64_t n) {
+    writeVarint(((uint64_t)n << 1) ^ (uint64_t)(n >> 63));
+  }
+
+  void writeString(CStrRef s) {
+    writeVarint((uint32_t)s.size());
+    m_transport.write(s.data(), s.size());
+  }
+
+  void writeFieldHeader(int8_t ctype, int16_t fieldno) {
+    if (fieldno > m_lastFieldId && fieldno - m_lastFieldId <= 15) {
+      m_transport.writeI8(((fieldno - m_lastFieldId) << 4) | ctype);
+    } else {
+      m_transport.writeI8(ctype);
+      writeI32(fieldno);
+    }
+    m_lastFieldId = fieldno;
+  }
+
+  void writeCollectionBegin(int8_t etype, int size) {
+    if (size < 15) {
+      m_transport.writeI8((size << 4) | ttype_to_ctype(etype));
+    } else {
+      m_transport.writeI8(0xf0 | ttype_to_ctype(etype));
+      writeVarint((uint32_t)size);
+    }
+  }
+
+  void writeKey(int8_t keytype, CVarRef key) {
+    if (ttype_is_string(keytype)) {
+      writeValue(keytype, key.toString(), s_no_spec);
+    } else {
+      writeValue(keytype, key.toInt64(), s_no_spec);
+    }
+  }
+
+  void writeValue(int8_t ttype, CVarRef value, ThriftTypeSpec &fieldspec) {
+    switch (ttype) {
+      case T_STOP:
+      case T_VOID:
+        return;
+      case T_STRUCT:
+        if (!value.is(KindOfObject)) {
+          throw_tprotocolexception("Attempt to send non-object "
+                                   "type as a T_STRUCT", INVALID_DATA);
+        }
+        writeStruct(value, s_thrift_data->getSpec(toObject(value)->
+                                                  o_getClassName()));
+        return;
+      case T_BOOL:
+        m_transport.writeI8(value.toBoolean() ?
+                            C_BOOLEAN_TRUE : C_BOOLEAN_FALSE);
+        return;
+      case T_BYTE:
+        m_transport.writeI8(value.toByte());
+        return;
+      case T_I16:
+        writeI32(value.toInt16());
+        return;
+      case T_I32:
+        writeI32(value.toInt32());
+        return;
+      case T_I64:
+      case T_U64:
+        writeI64(value.toInt64());
+        return;
+      case T_DOUBLE: {
+        union {
+          uint64_t c;
+          double d;
+        } a;
+        a.d = value.toDouble();
+        char buf[8];
+        for (int i = 0; i < 8; i++) {
+          buf[i] = (char)(a.c >> (8 * i));
+        }
+        m_transport.write(buf, 8);
+      } return;
+      //case T_UTF7:
+      case T_UTF8:
+      case T_UTF16:
+      case T_STRING:
+        writeString(value.toString());
+        return;
+      case T_MAP: {
+        Array ht = value.toArray();
+        int8_t keytype = fieldspec.ktype;
+        int8_t valtype = fieldspec.vtype;
+        if (ht.size() == 0) {
+          m_transport.writeI8(0);
+          return;
+        }
+        writeVarint((uint32_t)ht.size());
+        m_transport.writeI8((ttype_to_ctype(keytype) << 4) |
+                            ttype_to_ctype(valtype));
+        ThriftTypeSpec &valspec = nested_spec(fieldspec.val);
+        for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
+          writeKey(keytype, key_ptr.first());
+          writeValue(valtype, key_ptr.second(), valspec);
+        }
+      } return;
+      case T_LIST: {
+        Array ht = value.toArray();
+        int8_t valtype = fieldspec.etype;
+        writeCollectionBegin(valtype, ht.size());
+        ThriftTypeSpec &valspec = nested_spec(fieldspec.elem);
+        for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
+          writeValue(valtype, key_ptr.second(), valspec);
+        }
+      } return;
+      case T_SET: {
+        Array ht = value.toArray();
+        int8_t keytype = fieldspec.etype;
+        writeCollectionBegin(keytype, ht.size());
+        for (ArrayIter key_ptr = ht.begin(); !key_ptr.end(); ++key_ptr) {
+          writeKey(keytype, key_ptr.first());
+        }
+      } return;
+    };
+    char errbuf[128];
+    sprintf(errbuf, "Unknown thrift typeID %d", ttype);
+    throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+  }
+};
+
+class CompactReader {
+public:
+  CompactReader(PHPInputTransport &transport)
+    : m_transport(transport), m_lastFieldId(0), m_hasBoolValue(false),
+      m_boolValue(false) {}
+
+  int8_t readMessageBegin() {
+    uint8_t protocolId = m_transport.readI8();
+    if (protocolId != COMPACT_PROTOCOL_ID) {
+      throw_tprotocolexception("Bad protocol identifier", BAD_VERSION);
+    }
+    uint8_t versionAndType = m_transport.readI8();
+    if ((versionAndType & COMPACT_VERSION_MASK) != COMPACT_VERSION) {
+      throw_tprotocolexception("Bad version identifier", BAD_VERSION);
+    }
+    readVarint(); // sequence ID, we don't care about it
+    uint32_t namelen = readVarint();
+    m_transport.skip(namelen);
+    return (versionAndType >> COMPACT_TYPE_SHIFT) & COMPACT_TYPE_BITS;
+  }
+
+  void readStruct(CObjRef obj, const ThriftStructSpec *spec) {
+    int16_t lastFieldId = m_lastFieldId;
+    m_lastFieldId = 0;
+    while (true) {
+      int8_t ttype;
+      int16_t fieldno;
+      if (!readFieldHeader(ttype, fieldno)) break;
+      ThriftFieldSpec *field = spec ? spec->find(fieldno) : NULL;
+      if (field && (ttypes_are_compatible(ttype, field->type) ||
+                    (ttype_is_string(ttype) && ttype_is_string(field->type)))) {
+        Variant rv = readValue(ttype, *field);
+        obj->o_set(field->name, field->hash, rv);
+      } else {
+        skip(ttype);
+      }
+    }
+    m_lastFieldId = lastFieldId;
+  }
+
+private:
+  PHPInputTransport &m_transport;
+  int16_t m_lastFieldId;
+  bool m_hasBoolValue; // a bool field's value, from its header
+  bool m_boolValue;
+
+  uint64_t readVarint() {
+    uint64_t n = 0;
+    for (int shift = 0; shift < 70; shift += 7) {
+      uint8_t b = m_transport.readI8();
+      n |= (uint64_t)(b & 0x7f) << shift;
+      if (!(b & 0x80)) return n;
+    }
+    throw_tprotocolexception("Variable-length int over 10 bytes",
+                             INVALID_DATA);
+    return 0;
+  }
+
+  int32_t readI32() {
+    uint32_t n = readVarint();
+    return (int32_t)(n >> 1) ^ -(int32_t)(n & 1);
+  }
+
+  int64_t readI64() {
+    uint64_t n = readVarint();
+    return (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+  }
+
+  bool readFieldHeader(int8_t &ttype, int16_t &fieldno) {
+    uint8_t header = m_transport.readI8();
+    int8_t ctype = header & 0x0f;
+    if (ctype == C_STOP) return false;
+    int16_t delta = header >> 4;
+    fieldno = delta ? m_lastFieldId + delta : readI32();
+    m_lastFieldId = fieldno;
+    ttype = ctype_to_ttype(ctype);
+    if (ttype == T_BOOL) {
+      m_hasBoolValue = true;
+      m_boolValue = ctype == C_BOOLEAN_TRUE;
+    }
+    return true;
+  }
+
+  void readCollectionBegin(int8_t &etype, uint32_t &size) {
+    uint8_t header = m_transport.readI8();
+    size = header >> 4;
+    if (size == 15) size = readVarint();
+    etype = ctype_to_ttype(header & 0x0f);
+  }
+
+  void readMapBegin(int8_t &keytype, int8_t &valtype, uint32_t &size) {
+    size = readVarint();
+    keytype = valtype = T_STOP;
+    if (size) {
+      uint8_t types = m_transport.readI8();
+      keytype = ctype_to_ttype(types >> 4);
+      valtype = ctype_to_ttype(types & 0x0f);
+    }
+  }
+
+  bool readBool() {
+    if (m_hasBoolValue) {
+      m_hasBoolValue = false;
+      return m_boolValue;
+    }
+    return m_transport.readI8() == C_BOOLEAN_TRUE;
+  }
+
+  Variant readValue(int8_t ttype, ThriftTypeSpec &fieldspec) {
+    switch (ttype) {
+      case T_STOP:
+      case T_VOID:
+        return null;
+      case T_STRUCT: {
+        ThriftStructSpec *spec;
+        Object obj = create_struct(fieldspec, spec);
+        if (obj.isNull()) {
+          // unable to create class entry
+          skip(T_STRUCT);
+          return null;
+        }
+        readStruct(obj, spec);
+        return obj;
+      }
+      case T_BOOL:
+        return readBool();
+      case T_BYTE:
+        return (int)m_transport.readI8();
+      case T_I16:
+      case T_I32:
+        return readI32();
+      case T_U64:
+      case T_I64:
+        return (int64)readI64();
+      case T_DOUBLE: {
+        uint8_t buf[8];
+        m_transport.readBytes(buf, 8);
+        union {
+          uint64_t c;
+          double d;
+        } a;
+        a.c = 0;
+        for (int i = 0; i < 8; i++) {
+          a.c |= (uint64_t)buf[i] << (8 * i);
+        }
+        return a.d;
+      }
+      //case T_UTF7: // aliases T_STRING
+      case T_UTF8:
+      case T_UTF16:
+      case T_STRING: {
+        uint32_t size = readVarint();
+        if (size && (size + 1)) {
+          char* strbuf = (char*) malloc(size + 1);
+          m_transport.readBytes(strbuf, size);
+          strbuf[size] = '\0';
+          return String(strbuf, size, AttachString);
+        } else {
+          return "";
+        }
+      }
+      case T_MAP: {
+        int8_t keytype, valtype;
+        uint32_t size;
+        readMapBegin(keytype, valtype, size);
+        ThriftTypeSpec &keyspec = nested_spec(fieldspec.key);
+        ThriftTypeSpec &valspec = nested_spec(fieldspec.val);
+        Array ret = Array::Create();
+        for (uint32_t s = 0; s < size; ++s) {
+          Variant key = readValue(keytype, keyspec);
+          Variant value = readValue(valtype, valspec);
+          ret.set(key, value);
+        }
+        return ret;
+      }
+      case T_LIST: {
+        int8_t type;
+        uint32_t size;
+        readCollectionBegin(type, size);
+        ThriftTypeSpec &elemspec = nested_spec(fieldspec.elem);
+        Array ret = Array::Create();
+        for (uint32_t s = 0; s < size; ++s) {
+          ret.append(readValue(type, elemspec));
+        }
+        return ret;
+      }
+      case T_SET: {
+        int8_t type;
+        uint32_t size;
+        readCollectionBegin(type, size);
+        ThriftTypeSpec &elemspec = nested_spec(fieldspec.elem);
+        Array ret = Array::Create();
+        for (uint32_t s = 0; s < size; ++s) {
+          Variant key = readValue(type, elemspec);
+          if (key.isInteger()) {
+            ret.set(key, true);
+          } else {
+            ret.set(key.toString(), true);
+          }
+        }
+        return ret;
+      }
+    };
+
+    char errbuf[128];
+    sprintf(errbuf, "Unknown thrift typeID %d", ttype);
+    throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+    return null;
+  }
+
+  void skip(int8_t ttype) {
+    switch (ttype) {
+      case T_STOP:
+      case T_VOID:
+        return;
+      case T_STRUCT: {
+        int16_t lastFieldId = m_lastFieldId;
+        m_lastFieldId = 0;
+        int8_t type;
+        int16_t fieldno;
+        while (readFieldHeader(type, fieldno)) {
+          skip(type);
+        }
+        m_lastFieldId = lastFieldId;
+      } return;
+      case T_BOOL:
+        readBool();
+        return;
+      case T_BYTE:
+        m_transport.skip(1);
+        return;
+      case T_I16:
+      case T_I32:
+      case T_U64:
+      case T_I64:
+        readVarint();
+        return;
+      case T_DOUBLE:
+        m_transport.skip(8);
+        return;
+      //case T_UTF7: // aliases T_STRING
+      case T_UTF8:
+      case T_UTF16:
+      case T_STRING:
+        m_transport.skip(readVarint());
+        return;
+      case T_MAP: {
+        int8_t keytype, valtype;
+        uint32_t size;
+        readMapBegin(keytype, valtype, size);
+        for (uint32_t i = 0; i < size; ++i) {
+          skip(keytype);
+          skip(valtype);
+        }
+      } return;
+      case T_LIST:
+      case T_SET: {
+        int8_t type;
+        uint32_t size;
+        readCollectionBegin(type, size);
+        for (uint32_t i = 0; i < size; ++i) {
+          skip(type);
+        }
+      } return;
+    };
+
+    char errbuf[128];
+    sprintf(errbuf, "Unknown thrift typeID %d", ttype);
+    throw_tprotocolexception(String(errbuf, CopyString), INVALID_DATA);
+  }
+};
+
+void f_thrift_protocol_write_compact(CObjRef transportobj,
+                                     CStrRef method_name, int64 msgtype,
+                                     CObjRef request_struct, int seqid) {
+  PHPOutputTransport transport(transportobj);
+  CompactWriter writer(transport);
+  writer.writeMessageBegin(method_name, msgtype, seqid);
+  writer.writeStruct(request_struct,
+                     s_thrift_data->getSpec(request_struct->
+                                            o_getClassName()));
+}
+
+Variant f_thrift_protocol_read_compact(CObjRef transportobj,
+                                       CStrRef obj_typename) {
+  PHPInputTransport transport(transportobj);
+  CompactReader reader(transport);
+  int8_t messageType = reader.readMessageBegin();
+
+  if (messageType == T_EXCEPTION) {
+    Object ex = createObject("TApplicationException");
+    reader.readStruct(ex, s_thrift_data->getSpec("TApplicationException"));
     throw ex;
   }
 
   Object ret_val = createObject(obj_typename);
-  Variant spec = get_static_property(obj_typename, "_TSPEC");
-  binary_deserialize_spec(ret_val, transport, spec.toArray());
+  reader.readStruct(ret_val, s_thrift_data->getSpec(obj_typename));
   return ret_val;
 }
 
@@ -160,6 +160,26 @@ inline Variant x_mysql_unbuffered_query(CStrRef query, CVarRef link_identifier =
   return f_mysql_unbuffered_query(query, link_identifier);
 }
 
+inline bool x_mysql_async_query_start(CStrRef query, CVarRef link_identifier = null) {
+  FUNCTION_INJECTION_BUILTIN(mysql_async_query_start);
+  return f_mysql_async_query_start(query, link_identifier);
+}
+
+inline bool x_mysql_async_query_completed(CVarRef link_identifier = null) {
+  FUNCTION_INJECTION_BUILTIN(mysql_async_query_completed);
+  return f_mysql_async_query_completed(link_identifier);
+}
+
+inline Array x_mysql_async_wait_actionable(CArrRef items, double timeout = 1.0) {
+  FUNCTION_INJECTION_BUILTIN(mysql_async_wait_actionable);
+  return f_mysql_async_wait_actionable(items, timeout);
+}
+
+inline Variant x_mysql_async_query_result(CVarRef link_identifier = null) {
+  FUNCTION_INJECTION_BUILTIN(mysql_async_query_result);
+  return f_mysql_async_query_result(link_identifier);
+}
+
 inline Variant x_mysql_db_query(CStrRef database, CStrRef query, CVarRef link_identifier = null) {
   FUNCTION_INJECTION_BUILTIN(mysql_db_query);
   return f_mysql_db_query(database, query, link_identifier);
@@ -230,6 +250,11 @@ inline Variant x_mysql_fetch_array(CVarRef result, int result_type = 3) {
   return f_mysql_fetch_array(result, result_type);
 }
 
+inline Variant x_mysql_fetch_all(CVarRef result, int result_type = 3) {
+  FUNCTION_INJECTION_BUILTIN(mysql_fetch_all);
+  return f_mysql_fetch_all(result, result_type);
+}
+
 inline Variant x_mysql_fetch_lengths(CVarRef result) {
   FUNCTION_INJECTION_BUILTIN(mysql_fetch_lengths);
   return f_mysql_fetch_lengths(result);
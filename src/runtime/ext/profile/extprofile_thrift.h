@@ -35,6 +35,16 @@ inline Variant x_thrift_protocol_read_binary(CObjRef transportobj, CStrRef obj_t
   return f_thrift_protocol_read_binary(transportobj, obj_typename, strict_read);
 }
 
+inline void x_thrift_protocol_write_compact(CObjRef transportobj, CStrRef method_name, int64 msgtype, CObjRef request_struct, int seqid) {
+  FUNCTION_INJECTION_BUILTIN(thrift_protocol_write_compact);
+  f_thrift_protocol_write_compact(transportobj, method_name, msgtype, request_struct, seqid);
+}
+
+inline Variant x_thrift_protocol_read_compact(CObjRef transportobj, CStrRef obj_typename) {
+  FUNCTION_INJECTION_BUILTIN(thrift_protocol_read_compact);
+  return f_thrift_protocol_read_compact(transportobj, obj_typename);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 }
@@ -2367,6 +2367,21 @@ Variant i_thrift_protocol_write_binary(CArrRef params) {
     return (f_thrift_protocol_write_binary(arg0, arg1, arg2, arg3, arg4, arg5), null);
   }
 }
+Variant i_thrift_protocol_write_compact(CArrRef params) {
+  FUNCTION_INJECTION(thrift_protocol_write_compact);
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 5) return throw_wrong_arguments("thrift_protocol_write_compact", count, 5, 5, 1);
+  {
+    ArrayData *ad(params.get());
+    ssize_t pos = ad ? ad->iter_begin() : ArrayData::invalid_index;
+    CVarRef arg0((ad->getValue(pos)));
+    CVarRef arg1((pos = ad->iter_advance(pos),ad->getValue(pos)));
+    CVarRef arg2((pos = ad->iter_advance(pos),ad->getValue(pos)));
+    CVarRef arg3((pos = ad->iter_advance(pos),ad->getValue(pos)));
+    CVarRef arg4((pos = ad->iter_advance(pos),ad->getValue(pos)));
+    return (f_thrift_protocol_write_compact(arg0, arg1, arg2, arg3, arg4), null);
+  }
+}
 Variant i_wandgetexceptiontype(CArrRef params) {
   FUNCTION_INJECTION(wandgetexceptiontype);
   int count __attribute__((__unused__)) = params.size();
@@ -13147,6 +13162,18 @@ Variant i_thrift_protocol_read_binary(CArrRef params) {
     return (f_thrift_protocol_read_binary(arg0, arg1, arg2));
   }
 }
+Variant i_thrift_protocol_read_compact(CArrRef params) {
+  FUNCTION_INJECTION(thrift_protocol_read_compact);
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 2) return throw_wrong_arguments("thrift_protocol_read_compact", count, 2, 2, 1);
+  {
+    ArrayData *ad(params.get());
+    ssize_t pos = ad ? ad->iter_begin() : ArrayData::invalid_index;
+    CVarRef arg0((ad->getValue(pos)));
+    CVarRef arg1((pos = ad->iter_advance(pos),ad->getValue(pos)));
+    return (f_thrift_protocol_read_compact(arg0, arg1));
+  }
+}
 Variant i_get_included_files(CArrRef params) {
   FUNCTION_INJECTION(get_included_files);
   int count __attribute__((__unused__)) = params.size();
@@ -21085,6 +21112,19 @@ Variant i_mysql_fetch_array(CArrRef params) {
     return (f_mysql_fetch_array(arg0, arg1));
   }
 }
+Variant i_mysql_fetch_all(CArrRef params) {
+  FUNCTION_INJECTION(mysql_fetch_all);
+  int count __attribute__((__unused__)) = params.size();
+  if (count < 1 || count > 2) return throw_wrong_arguments("mysql_fetch_all", count, 1, 2, 1);
+  {
+    ArrayData *ad(params.get());
+    ssize_t pos = ad ? ad->iter_begin() : ArrayData::invalid_index;
+    CVarRef arg0((ad->getValue(pos)));
+    if (count <= 1) return (f_mysql_fetch_all(arg0));
+    CVarRef arg1((pos = ad->iter_advance(pos),ad->getValue(pos)));
+    return (f_mysql_fetch_all(arg0, arg1));
+  }
+}
 Variant i_magickpreviousimage(CArrRef params) {
   FUNCTION_INJECTION(magickpreviousimage);
   int count __attribute__((__unused__)) = params.size();
@@ -22727,6 +22767,56 @@ Variant i_mysql_query(CArrRef params) {
     return (f_mysql_query(arg0, arg1));
   }
 }
+Variant i_mysql_async_query_start(CArrRef params) {
+  FUNCTION_INJECTION(mysql_async_query_start);
+  int count __attribute__((__unused__)) = params.size();
+  if (count < 1 || count > 2) return throw_wrong_arguments("mysql_async_query_start", count, 1, 2, 1);
+  {
+    ArrayData *ad(params.get());
+    ssize_t pos = ad ? ad->iter_begin() : ArrayData::invalid_index;
+    CVarRef arg0((ad->getValue(pos)));
+    if (count <= 1) return (f_mysql_async_query_start(arg0));
+    CVarRef arg1((pos = ad->iter_advance(pos),ad->getValue(pos)));
+    return (f_mysql_async_query_start(arg0, arg1));
+  }
+}
+Variant i_mysql_async_query_completed(CArrRef params) {
+  FUNCTION_INJECTION(mysql_async_query_completed);
+  int count __attribute__((__unused__)) = params.size();
+  if (count > 1) return throw_toomany_arguments("mysql_async_query_completed", 1, 1);
+  {
+    ArrayData *ad(params.get());
+    ssize_t pos = ad ? ad->iter_begin() : ArrayData::invalid_index;
+    if (count <= 0) return (f_mysql_async_query_completed());
+    CVarRef arg0((ad->getValue(pos)));
+    return (f_mysql_async_query_completed(arg0));
+  }
+}
+Variant i_mysql_async_wait_actionable(CArrRef params) {
+  FUNCTION_INJECTION(mysql_async_wait_actionable);
+  int count __attribute__((__unused__)) = params.size();
+  if (count < 1 || count > 2) return throw_wrong_arguments("mysql_async_wait_actionable", count, 1, 2, 1);
+  {
+    ArrayData *ad(params.get());
+    ssize_t pos = ad ? ad->iter_begin() : ArrayData::invalid_index;
+    CVarRef arg0((ad->getValue(pos)));
+    if (count <= 1) return (f_mysql_async_wait_actionable(arg0));
+    CVarRef arg1((pos = ad->iter_advance(pos),ad->getValue(pos)));
+    return (f_mysql_async_wait_actionable(arg0, arg1));
+  }
+}
+Variant i_mysql_async_query_result(CArrRef params) {
+  FUNCTION_INJECTION(mysql_async_query_result);
+  int count __attribute__((__unused__)) = params.size();
+  if (count > 1) return throw_toomany_arguments("mysql_async_query_result", 1, 1);
+  {
+    ArrayData *ad(params.get());
+    ssize_t pos = ad ? ad->iter_begin() : ArrayData::invalid_index;
+    if (count <= 0) return (f_mysql_async_query_result());
+    CVarRef arg0((ad->getValue(pos)));
+    return (f_mysql_async_query_result(arg0));
+  }
+}
 Variant i_crypt(CArrRef params) {
   FUNCTION_INJECTION(crypt);
   int count __attribute__((__unused__)) = params.size();
@@ -25693,6 +25783,7 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
       break;
     case 937:
       HASH_INVOKE(0x7F9E810BC93023A9LL, memcache_close);
+      HASH_INVOKE(0x2662DE17A56DC3A9LL, mysql_async_query_start);
       break;
     case 938:
       HASH_INVOKE(0x3238A5BD362443AALL, escapeshellcmd);
@@ -26226,6 +26317,7 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
       break;
     case 1379:
       HASH_INVOKE(0x1B1B2D70792D9563LL, mysql_get_client_info);
+      HASH_INVOKE(0x36202A74FFE5A563LL, mysql_async_wait_actionable);
       break;
     case 1382:
       HASH_INVOKE(0x6E2FDBD28F895566LL, timezone_abbreviations_list);
@@ -26631,6 +26723,7 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
       HASH_INVOKE(0x798B4197212456B5LL, bcpowmod);
       HASH_INVOKE(0x623CE67C41A9E6B5LL, ldap_next_attribute);
       HASH_INVOKE(0x7E773A36449576B5LL, imagecharup);
+      HASH_INVOKE(0x3B81B5A6BE3ED6B5LL, thrift_protocol_write_compact);
       break;
     case 1719:
       HASH_INVOKE(0x0C44E5EEB9C646B7LL, memcache_connect);
@@ -27449,6 +27542,9 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
     case 2379:
       HASH_INVOKE(0x37F356F578FA394BLL, substr);
       break;
+    case 2380:
+      HASH_INVOKE(0x6A0AC90368DF994CLL, mysql_async_query_result);
+      break;
     case 2381:
       HASH_INVOKE(0x3D3AD12E52FF294DLL, imagecreatefromwbmp);
       break;
@@ -27716,6 +27812,7 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
       break;
     case 2601:
       HASH_INVOKE(0x618D2A98986B1A29LL, ldap_unbind);
+      HASH_INVOKE(0x31773B24F6E98A29LL, mysql_async_query_completed);
       break;
     case 2602:
       HASH_INVOKE(0x3CAEA6B8D1C92A2ALL, stream_bucket_prepend);
@@ -28199,6 +28296,9 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
     case 2958:
       HASH_INVOKE(0x62A4D7A03F7C3B8ELL, ceil);
       break;
+    case 2961:
+      HASH_INVOKE(0x0538D73928468B91LL, mysql_fetch_all);
+      break;
     case 2967:
       HASH_INVOKE(0x09837A82A928AB97LL, is_null);
       break;
@@ -29658,6 +29758,9 @@ Variant invoke_builtin(const char *s, CArrRef params, int64 hash, bool fatal) {
       HASH_INVOKE(0x7F5FC3CAF8CE9FDELL, gzcompress);
       HASH_INVOKE(0x72925D2DF7E61FDELL, drawpathcurvetoquadraticbeziersmoothrelative);
       break;
+    case 4069:
+      HASH_INVOKE(0x43BA2CB702E68FE5LL, thrift_protocol_read_compact);
+      break;
     case 4071:
       HASH_INVOKE(0x217067889854CFE7LL, xmlwriter_start_dtd);
       break;
@@ -33594,6 +33697,38 @@ Variant ei_thrift_protocol_write_binary(Eval::VariableEnvironment &env, const Ev
   }
   return (x_thrift_protocol_write_binary(a0, a1, a2, a3, a4, a5), null);
 }
+Variant ei_thrift_protocol_write_compact(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  Variant a1;
+  Variant a2;
+  Variant a3;
+  Variant a4;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 5) return throw_wrong_arguments("thrift_protocol_write_compact", count, 5, 5, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a1 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a2 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a3 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a4 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  return (x_thrift_protocol_write_compact(a0, a1, a2, a3, a4), null);
+}
 Variant ei_wandgetexceptiontype(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
   Variant a0;
   const std::vector<Eval::ExpressionPtr> &params = caller->params();
@@ -51716,6 +51851,26 @@ Variant ei_thrift_protocol_read_binary(Eval::VariableEnvironment &env, const Eva
   }
   return (x_thrift_protocol_read_binary(a0, a1, a2));
 }
+Variant ei_thrift_protocol_read_compact(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  Variant a1;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count != 2) return throw_wrong_arguments("thrift_protocol_read_compact", count, 2, 2, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a1 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  return (x_thrift_protocol_read_compact(a0, a1));
+}
 Variant ei_get_included_files(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
   const std::vector<Eval::ExpressionPtr> &params = caller->params();
   int count __attribute__((__unused__)) = params.size();
@@ -65162,6 +65317,27 @@ Variant ei_mysql_fetch_array(Eval::VariableEnvironment &env, const Eval::Functio
   if (count <= 1) return (x_mysql_fetch_array(a0));
   else return (x_mysql_fetch_array(a0, a1));
 }
+Variant ei_mysql_fetch_all(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  Variant a1;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count < 1 || count > 2) return throw_wrong_arguments("mysql_fetch_all", count, 1, 2, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a1 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  if (count <= 1) return (x_mysql_fetch_all(a0));
+  else return (x_mysql_fetch_all(a0, a1));
+}
 Variant ei_magickpreviousimage(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
   Variant a0;
   const std::vector<Eval::ExpressionPtr> &params = caller->params();
@@ -67941,6 +68117,82 @@ Variant ei_mysql_query(Eval::VariableEnvironment &env, const Eval::FunctionCallE
   if (count <= 1) return (x_mysql_query(a0));
   else return (x_mysql_query(a0, a1));
 }
+Variant ei_mysql_async_query_start(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  Variant a1;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count < 1 || count > 2) return throw_wrong_arguments("mysql_async_query_start", count, 1, 2, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a1 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  if (count <= 1) return (x_mysql_async_query_start(a0));
+  else return (x_mysql_async_query_start(a0, a1));
+}
+Variant ei_mysql_async_query_completed(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count > 1) return throw_toomany_arguments("mysql_async_query_completed", 1, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  if (count <= 0) return (x_mysql_async_query_completed());
+  else return (x_mysql_async_query_completed(a0));
+}
+Variant ei_mysql_async_wait_actionable(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  Variant a1;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count < 1 || count > 2) return throw_wrong_arguments("mysql_async_wait_actionable", count, 1, 2, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+    if (it == params.end()) break;
+    a1 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  if (count <= 1) return (x_mysql_async_wait_actionable(a0));
+  else return (x_mysql_async_wait_actionable(a0, a1));
+}
+Variant ei_mysql_async_query_result(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
+  Variant a0;
+  const std::vector<Eval::ExpressionPtr> &params = caller->params();
+  int count __attribute__((__unused__)) = params.size();
+  if (count > 1) return throw_toomany_arguments("mysql_async_query_result", 1, 1);
+  std::vector<Eval::ExpressionPtr>::const_iterator it = params.begin();
+  do {
+    if (it == params.end()) break;
+    a0 = (*it)->eval(env);
+    it++;
+  } while(false);
+  for (; it != params.end(); ++it) {
+    (*it)->eval(env);
+  }
+  if (count <= 0) return (x_mysql_async_query_result());
+  else return (x_mysql_async_query_result(a0));
+}
 Variant ei_crypt(Eval::VariableEnvironment &env, const Eval::FunctionCallExpression *caller) {
   Variant a0;
   Variant a1;
@@ -72130,6 +72382,7 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
       break;
     case 937:
       HASH_INVOKE_FROM_EVAL(0x7F9E810BC93023A9LL, memcache_close);
+      HASH_INVOKE_FROM_EVAL(0x2662DE17A56DC3A9LL, mysql_async_query_start);
       break;
     case 938:
       HASH_INVOKE_FROM_EVAL(0x3238A5BD362443AALL, escapeshellcmd);
@@ -72663,6 +72916,7 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
       break;
     case 1379:
       HASH_INVOKE_FROM_EVAL(0x1B1B2D70792D9563LL, mysql_get_client_info);
+      HASH_INVOKE_FROM_EVAL(0x36202A74FFE5A563LL, mysql_async_wait_actionable);
       break;
     case 1382:
       HASH_INVOKE_FROM_EVAL(0x6E2FDBD28F895566LL, timezone_abbreviations_list);
@@ -73068,6 +73322,7 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
       HASH_INVOKE_FROM_EVAL(0x798B4197212456B5LL, bcpowmod);
       HASH_INVOKE_FROM_EVAL(0x623CE67C41A9E6B5LL, ldap_next_attribute);
       HASH_INVOKE_FROM_EVAL(0x7E773A36449576B5LL, imagecharup);
+      HASH_INVOKE_FROM_EVAL(0x3B81B5A6BE3ED6B5LL, thrift_protocol_write_compact);
       break;
     case 1719:
       HASH_INVOKE_FROM_EVAL(0x0C44E5EEB9C646B7LL, memcache_connect);
@@ -73886,6 +74141,9 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
     case 2379:
       HASH_INVOKE_FROM_EVAL(0x37F356F578FA394BLL, substr);
       break;
+    case 2380:
+      HASH_INVOKE_FROM_EVAL(0x6A0AC90368DF994CLL, mysql_async_query_result);
+      break;
     case 2381:
       HASH_INVOKE_FROM_EVAL(0x3D3AD12E52FF294DLL, imagecreatefromwbmp);
       break;
@@ -74153,6 +74411,7 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
       break;
     case 2601:
       HASH_INVOKE_FROM_EVAL(0x618D2A98986B1A29LL, ldap_unbind);
+      HASH_INVOKE_FROM_EVAL(0x31773B24F6E98A29LL, mysql_async_query_completed);
       break;
     case 2602:
       HASH_INVOKE_FROM_EVAL(0x3CAEA6B8D1C92A2ALL, stream_bucket_prepend);
@@ -74636,6 +74895,9 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
     case 2958:
       HASH_INVOKE_FROM_EVAL(0x62A4D7A03F7C3B8ELL, ceil);
       break;
+    case 2961:
+      HASH_INVOKE_FROM_EVAL(0x0538D73928468B91LL, mysql_fetch_all);
+      break;
     case 2967:
       HASH_INVOKE_FROM_EVAL(0x09837A82A928AB97LL, is_null);
       break;
@@ -76095,6 +76357,9 @@ Variant Eval::invoke_from_eval_builtin(const char *s, Eval::VariableEnvironment
       HASH_INVOKE_FROM_EVAL(0x7F5FC3CAF8CE9FDELL, gzcompress);
       HASH_INVOKE_FROM_EVAL(0x72925D2DF7E61FDELL, drawpathcurvetoquadraticbeziersmoothrelative);
       break;
+    case 4069:
+      HASH_INVOKE_FROM_EVAL(0x43BA2CB702E68FE5LL, thrift_protocol_read_compact);
+      break;
     case 4071:
       HASH_INVOKE_FROM_EVAL(0x217067889854CFE7LL, xmlwriter_start_dtd);
       break;
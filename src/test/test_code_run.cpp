@@ -31,6 +31,7 @@ using namespace std;
 
 // By default, use shared linking for faster testing.
 bool TestCodeRun::FastMode = true;
+bool TestCodeRun::BytecodeMode = false;
 
 TestCodeRun::TestCodeRun() : m_perfMode(false) {
   Option::GenerateCPPMain = true;
@@ -246,6 +247,8 @@ static bool verify_result(const char *input, const char *output, bool perfMode,
       const char *argv[] = {"", filearg.c_str(),
                             "--config=test/config.hdf",
                             "-v Fiber.ThreadCount = 0",
+                            TestCodeRun::BytecodeMode ?
+                            "-v Eval.BytecodeInterpreter = true" : NULL,
                             NULL};
       Process::Exec("hphpi/hphpi", argv, NULL, actual, &err);
     }
@@ -3679,6 +3682,29 @@ bool TestCodeRun::TestObjectMagicMethod() {
        "}\n"
        "test();\n");
 
+  // magic methods that call deep enough to grow the eval argument stack
+  // while an operator, echo or assignment is using its operands
+  MVCR("<?php\n"
+       "function deep($n, $a, $b) {\n"
+       "  return $n ? deep($n - 1, $b, $a) + 1 : $a . $b;\n"
+       "}\n"
+       "class S {\n"
+       "  function __toString() { return 's' . deep(300, 'x', 'y'); }\n"
+       "  function __destruct() { echo 'd' . deep(300, 1, 2) . \"\\n\"; }\n"
+       "}\n"
+       "function test() {\n"
+       "  $o = new S;\n"
+       "  $s = 'a' . $o;\n"
+       "  $s .= $o;\n"
+       "  echo $o;\n"
+       "  echo \"\\n\";\n"
+       "  var_dump($s);\n"
+       "  $t = new S;\n"
+       "  $t = 5;\n"
+       "  var_dump($t);\n"
+       "}\n"
+       "test();\n");
+
   return true;
 }
 
@@ -4836,6 +4862,29 @@ bool TestCodeRun::TestDynamicFunctions() {
       "$goo(foo());"
       "bar(foo());");
 
+  // one call site calling many functions, some of them more than once
+  MVCR("<?php "
+      "function f1($a) { return 'f1'.$a; }"
+      "function f2($a) { return 'f2'.$a; }"
+      "function f3($a, $b = 'b') { return 'f3'.$a.$b; }"
+      "function f4(&$a) { $a .= 'f4'; return 'f4'; }"
+      "function f5($a) { return 'f5'.$a; }"
+      "$x = 'x';"
+      "foreach (array('f1', 'F2', 'f3', 'f4', 'f5', 'strtoupper', 'f1',"
+      "               'f4', 'F3', 'f5') as $f) {"
+      "  var_dump($f($x));"
+      "}"
+      "var_dump($x);");
+  MVCR("<?php "
+      "function inc(&$a) { $a++; }"
+      "$a = array(1, 3, 2);"
+      "foreach (array('sort', 'rsort', 'sort') as $f) {"
+      "  $f($a); var_dump($a);"
+      "}"
+      "$i = 0;"
+      "for ($n = 0; $n < 3; $n++) { $f = 'inc'; $f($i); }"
+      "var_dump($i);");
+
   return true;
 }
 
@@ -6978,6 +7027,37 @@ bool TestCodeRun::TestBreakStatement() {
       "    }"
       "}");
 
+  MVCR("<?php "
+      "function f($n) {"
+      "  $i = 0;"
+      "  while (++$i < $n) {"
+      "    switch ($i % 4) {"
+      "    case 1:"
+      "      continue 2;"
+      "    case 3:"
+      "      if ($i > 8) break 2;"
+      "      break;"
+      "    }"
+      "    foreach (array(1, 2, 3) as $j) {"
+      "      if ($i * $j == 12) break 2;"
+      "      if ($j == 2) continue 2;"
+      "      echo $i . ':' . $j . \"\\n\";"
+      "    }"
+      "  }"
+      "  $k = 0;"
+      "  do {"
+      "    if ($k++ % 2) continue;"
+      "    for ($m = 0; ; $m++) {"
+      "      if ($m == $k) break;"
+      "      if ($m + $k > 6) return $i . ' ' . $k . ' ' . $m;"
+      "    }"
+      "    echo $k . ' ' . $m . \"\\n\";"
+      "  } while ($k < $n);"
+      "  return -$k;"
+      "}"
+      "var_dump(f(5));"
+      "var_dump(f(20));");
+
   return true;
 }
 
@@ -9095,6 +9175,75 @@ bool TestCodeRun::TestGetObjectVars() {
       "$base_obj = new Base();"
       "$child_obj->foo($base_obj);"
       );
+  MVCR("<?php "
+      "class Base {"
+      "  public    $aaa = 1;"
+      "  protected $bbb = 2;"
+      "  private   $ccc = 3;"
+      "  function base_vars() {"
+      "    var_dump(get_object_vars($this));"
+      "    foreach ($this as $k => $v) echo \"$k=$v\\n\";"
+      "    var_dump($this->ccc);"
+      "  }"
+      "}"
+      "class Child extends Base {"
+      "  private   $ccc = 30;"
+      "  protected $ddd = 4;"
+      "  function child_vars() {"
+      "    var_dump(get_object_vars($this));"
+      "    foreach ($this as $k => $v) echo \"$k=$v\\n\";"
+      "    var_dump($this->bbb, $this->ccc);"
+      "    foreach (array('aaa', 'bbb', 'ccc', 'ddd', 'eee') as $name) {"
+      "      $this->$name = $name;"
+      "      var_dump($this->$name);"
+      "    }"
+      "  }"
+      "}"
+      "$obj = new Child();"
+      "$obj->eee = 5;"
+      "$obj->base_vars();"
+      "$obj->child_vars();"
+      "$obj->base_vars();"
+      "var_dump(get_object_vars($obj));"
+      "var_dump(get_object_vars($obj));"
+      "foreach (array('aaa', 'eee', 'fff') as $name) {"
+      "  var_dump(isset($obj->$name));"
+      "  $obj->$name = $name . '!';"
+      "  var_dump($obj->$name);"
+      "}"
+      "var_dump($obj);"
+      );
+  MVCR("<?php "
+      "if (isset($g)) {"
+      "  class Base {"
+      "    public $aaa = 'a';"
+      "  }"
+      "} else {"
+      "  class Base {"
+      "    public    $aaa = 1;"
+      "    protected $bbb = 2;"
+      "    private   $ccc = 3;"
+      "    function base_vars() {"
+      "      var_dump(get_object_vars($this));"
+      "      foreach ($this as $k => $v) echo \"$k=$v\\n\";"
+      "    }"
+      "  }"
+      "}"
+      "class Child extends Base {"
+      "  private   $ccc = 30;"
+      "  protected $ddd = 4;"
+      "  function child_vars() {"
+      "    var_dump(get_object_vars($this));"
+      "    foreach ($this as $k => $v) echo \"$k=$v\\n\";"
+      "  }"
+      "}"
+      "$obj = new Child();"
+      "$obj->base_vars();"
+      "$obj->child_vars();"
+      "var_dump(get_object_vars($obj));"
+      "foreach ($obj as $k => $v) echo \"$k=$v\\n\";"
+      "var_dump(get_object_vars(new Base()));"
+      );
 
   MVCR("<?php "
        "var_dump(get_object_vars(false));"
@@ -9609,6 +9758,89 @@ bool TestCodeRun::TestThrift() {
       "  var_dump(thrift_protocol_read_binary($p, 'TestStruct', true));"
       "}"
       "test();");
+
+  MVCRO(
+      "<?php "
+      "class TType {"
+      "  const BOOL   = 2;"
+      "  const I16    = 6;"
+      "  const I32    = 8;"
+      "  const STRING = 11;"
+      "  const LST    = 15;"
+      "}"
+      "class DummyProtocol {"
+      "  public $t;"
+      "  function __construct() {"
+      "    $this->t = new DummyTransport();"
+      "  }"
+      "  function getTransport() {"
+      "    return $this->t;"
+      "  }"
+      "}"
+      "class DummyTransport {"
+      "  public $buff = '';"
+      "  public $pos = 0;"
+      "  function flush() { }"
+      "  function write($buff) {"
+      "    $this->buff .= $buff;"
+      "  }"
+      "  function read($n) {"
+      "    $r = substr($this->buff, $this->pos, $n);"
+      "    $this->pos += $n;"
+      "    return $r;"
+      "  }"
+      "}"
+      "class CompactStruct {"
+      "  static $_TSPEC;"
+      ""
+      "  public $anInt = null;"
+      "  public $aBool = null;"
+      "  public $aString = null;"
+      "  public $aList = null;"
+      ""
+      "  public function __construct($vals=null) {"
+      "    if (!isset(self::$_TSPEC)) {"
+      "      self::$_TSPEC = array("
+      "        1 => array('var' => 'anInt', 'type' => TType::I32),"
+      "        2 => array('var' => 'aBool', 'type' => TType::BOOL),"
+      "        3 => array('var' => 'aString', 'type' => TType::STRING),"
+      "        20 => array("
+      "          'var' => 'aList',"
+      "          'type' => TType::LST,"
+      "          'etype' => TType::I16,"
+      "          'elem' => array('type' => TType::I16),"
+      "        ),"
+      "      );"
+      "    }"
+      "  }"
+      "}"
+      ""
+      "function test() {"
+      "  $p = new DummyProtocol();"
+      "  $v1 = new CompactStruct();"
+      "  $v1->anInt = -2;"
+      "  $v1->aBool = true;"
+      "  $v1->aString = 'hi';"
+      "  $v1->aList = array(1, -1, 300);"
+      "  thrift_protocol_write_compact($p, 'm', 1, $v1, 7);"
+      "  var_dump(bin2hex($p->getTransport()->buff));"
+      "  print_r(thrift_protocol_read_compact($p, 'CompactStruct'));"
+      "}"
+      "test();",
+      "string(40) \"822107016d150311180268690928340201d80400\"\n"
+      "CompactStruct Object\n"
+      "(\n"
+      "    [anInt] => -2\n"
+      "    [aBool] => 1\n"
+      "    [aString] => hi\n"
+      "    [aList] => Array\n"
+      "        (\n"
+      "            [0] => 1\n"
+      "            [1] => -1\n"
+      "            [2] => 300\n"
+      "        )\n"
+      "\n"
+      ")\n");
   return true;
 }
 
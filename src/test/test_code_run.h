@@ -180,6 +180,7 @@ class TestCodeRun : public TestBase {
   bool TestAdHoc();
 
   static bool FastMode;
+  static bool BytecodeMode; // hphpi runs with Eval.BytecodeInterpreter on
 
  protected:
   bool CleanUp();
@@ -18,6 +18,7 @@
 #include <runtime/base/base_includes.h>
 #include <util/logger.h>
 #include <runtime/base/memory/memory_manager.h>
+#include <runtime/base/array/zend_array.h>
 #include <runtime/base/builtin_functions.h>
 #include <runtime/ext/ext_variable.h>
 #include <runtime/ext/ext_apc.h>
@@ -26,6 +27,11 @@
 #include <runtime/base/shared/shared_store.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/server/ip_block_map.h>
+#include <runtime/base/array/hphp_array.h>
+#include <runtime/base/shared/thread_shared_variant.h>
+#include <runtime/eval/runtime/file_repository.h>
+#include <runtime/eval/runtime/file_watcher.h>
+#include <utime.h>
 #include <test/test_mysql_info.inc>
 
 using namespace std;
@@ -40,14 +46,18 @@ TestCppBase::TestCppBase() {
 bool TestCppBase::RunTests(const std::string &which) {
   bool ret = true;
   RUN_TEST(TestSmartAllocator);
+  RUN_TEST(TestSmartMalloc);
   RUN_TEST(TestString);
   RUN_TEST(TestArray);
+  RUN_TEST(TestHphpArray);
   RUN_TEST(TestObject);
   RUN_TEST(TestVariant);
 #ifndef DEBUGGING_SMART_ALLOCATOR
   RUN_TEST(TestMemoryManager);
 #endif
   RUN_TEST(TestIpBlockMap);
+  RUN_TEST(TestFileRepository);
+  RUN_TEST(TestFileWatcher);
   return ret;
 }
 
@@ -125,6 +135,60 @@ bool TestCppBase::TestSmartAllocator() {
   return Count(true);
 }
 
+bool TestCppBase::TestSmartMalloc() {
+#ifndef DEBUGGING_SMART_ALLOCATOR
+  MemoryUsageStats &stats = MemoryManager::TheMemoryManager()->getStats();
+  int64 small = stats.smartCount[2];
+  int64 big = stats.smartCount[SMART_SIZE_CLASS_COUNT - 1];
+
+  char *p1 = (char *)smart_malloc(20); // 32 byte class with its header
+  char *p2 = (char *)smart_malloc(24);
+  VERIFY(p1 != p2);
+  VERIFY(stats.smartCount[2] == small + 2);
+  strcpy(p1, "0123456789");
+  smart_free(p2);
+  VERIFY(stats.smartCount[2] == small + 1);
+  VERIFY(smart_malloc(17) == p2); // reused from free list
+
+  VERIFY(smart_realloc(p1, 24) == p1); // still fits
+  p1 = (char *)smart_realloc(p1, 1000);
+  VERIFY(strcmp(p1, "0123456789") == 0);
+  p1 = (char *)smart_realloc(p1, 100000);
+  VERIFY(strcmp(p1, "0123456789") == 0);
+  VERIFY(stats.smartCount[SMART_SIZE_CLASS_COUNT - 1] == big + 1);
+  smart_free(p1);
+  smart_free(p2);
+  VERIFY(stats.smartCount[2] == small);
+  VERIFY(stats.smartCount[SMART_SIZE_CLASS_COUNT - 1] == big);
+
+  int *p3 = (int *)smart_calloc(300, sizeof(int));
+  for (int i = 0; i < 300; i++) {
+    VERIFY(p3[i] == 0);
+  }
+  smart_free(p3);
+
+  // arrays outliving requests keep their bucket heads out of the slabs
+  int64 before = 0;
+  for (int i = 0; i < SMART_SIZE_CLASS_COUNT; i++) {
+    before += stats.smartCount[i];
+  }
+  {
+    ZendArray arr(0, true);
+    for (int64 i = 0; i < 100; i++) {
+      arr.set(i, i, false); // resized a few times
+    }
+    int64 after = 0;
+    for (int i = 0; i < SMART_SIZE_CLASS_COUNT; i++) {
+      after += stats.smartCount[i];
+    }
+    VERIFY(after == before);
+    VS(arr.get(99), 99);
+  }
+  VERIFY(StaticEmptyZendArray::Get()->size() == 0);
+#endif
+  return Count(true);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // data types
 
@@ -208,12 +272,28 @@ bool TestCppBase::TestString() {
     String s = "test";
     s.lvalAt(2) = "";
     VS((const char *)s, "tet");
+    VS(s.size(), 3);
     s.lvalAt(2) = "zz";
     VS((const char *)s, "tez");
     s.lvalAt(4) = "q";
     VS((const char *)s, "tez q");
   }
 
+  // a string in an APC array, changed after its hash was taken
+  {
+    ThreadSharedVariant *owner = new ThreadSharedVariant("abc", false);
+    StringData *sd = NEW(StringData)(owner, owner->stringData(),
+                                     owner->stringLength());
+    String s(sd);
+    VS(s->hash(), hash_string("abc", 3));
+    sd->setChar(0, "x"); // no longer shared
+    VS((const char *)s, "xbc");
+    VS(s->hash(), hash_string("xbc", 3));
+    sd->append("d", 1);
+    VS(s->hash(), hash_string("xbcd", 4));
+    owner->decRef();
+  }
+
   return Count(true);
 }
 
@@ -626,6 +706,95 @@ bool TestCppBase::TestArray() {
   return Count(true);
 }
 
+bool TestCppBase::TestHphpArray() {
+  bool saved = RuntimeOption::UseHphpArray;
+  RuntimeOption::UseHphpArray = true;
+
+  // packed
+  {
+    Array arr = Array::Create();
+    VERIFY(dynamic_cast<HphpArray*>(arr.get()));
+    for (int i = 0; i < 100; i++) arr.append(i * 2);
+    VERIFY(arr.size() == 100);
+    VERIFY(arr->isVectorData());
+    VERIFY(((HphpArray*)arr.get())->isPacked());
+    VS(arr[57], 114);
+    VERIFY(!arr.exists(100));
+
+    Variant v = arr.pop();
+    VS(v, 198);
+    v = arr.dequeue();
+    VS(v, 0);
+    VERIFY(arr.size() == 98);
+    VS(arr[0], 2);
+    VERIFY(((HphpArray*)arr.get())->isPacked());
+
+    arr.prepend("first");
+    VS(arr[0], "first");
+    VS(arr[1], 2);
+    VERIFY(arr.size() == 99);
+    VERIFY(((HphpArray*)arr.get())->isPacked());
+  }
+
+  // string keys, holes and iteration order
+  {
+    Array arr = Array::Create();
+    arr.set("b", 1);
+    arr.set(5, 2);
+    arr.set("a", 3);
+    arr.append(4);
+    VERIFY(!((HphpArray*)arr.get())->isPacked());
+    VS(arr[6], 4);
+    VS(arr["a"], 3);
+    VERIFY(!arr->isVectorData());
+
+    arr.remove(5);
+    VERIFY(!arr.exists(5));
+    VERIFY(arr.size() == 3);
+    for (int i = 0; i < 50; i++) {
+      arr.set(String("k") + String((int64)i), i);
+    }
+    VERIFY(arr.size() == 53);
+    VS(arr["k49"], 49);
+
+    ArrayIter iter = arr.begin();
+    VS(iter.first(), "b");  ++iter;
+    VS(iter.first(), "a");  ++iter;
+    VS(iter.first(), 6);    ++iter;
+    VS(iter.first(), "k0");
+
+    Variant v = arr.dequeue();
+    VS(v, 1);
+    VS(arr.begin().first(), "a");
+    VS(arr[0], 4);
+  }
+
+  // copy on write
+  {
+    Array arr = CREATE_MAP2("n1", "v1", "n2", "v2");
+    Array arr2 = arr;
+    arr2.set("n3", "v3");
+    VERIFY(arr.size() == 2);
+    VERIFY(arr2.size() == 3);
+    VS(arr2["n1"], "v1");
+  }
+
+  // mutable iteration
+  {
+    Variant arr = CREATE_MAP2("n1", "v1", "n2", "v2");
+    arr.escalate(true);
+    VERIFY(!dynamic_cast<HphpArray*>(arr.getArrayData()));
+    Variant k, v;
+    for (MutableArrayIterPtr iter = arr.begin(&k, v); iter->advance();) {
+      arr.weakRemove(k);
+    }
+    VS(arr, Array::Create());
+  }
+
+  RuntimeOption::UseHphpArray = saved;
+  return Count(true);
+}
+
 bool TestCppBase::TestObject() {
   {
     String s = "O:1:\"B\":1:{s:3:\"obj\";O:1:\"A\":1:{s:1:\"a\";i:10;}}";
@@ -879,7 +1048,10 @@ bool TestCppBase::TestMemoryManager() {
   // we do it twice, so to verify MemoryManager's rollback() is valid
   // we do it 3rd time, so to verify LinearAllocator works under rollback.
   // we do it 4th time, so to verify MySQL connection works under rollback.
+  // and every other time, objects are freed without free lists in between.
   for (int i = 0; i < 4; i++) {
+    RuntimeOption::EnableRequestArena = (i % 2 == 1);
+    MemoryManager::TheMemoryManager()->enterArena();
 
     // Circular reference between two arrays. Without sweeping, these memory
     // will still be reachable after exit.
@@ -946,6 +1118,7 @@ bool TestCppBase::TestMemoryManager() {
     VERIFY(!globals->m_array.exists("c"));
 
   }
+  RuntimeOption::EnableRequestArena = false;
   DELETE(TestGlobals)(globals);
   return Count(true);
 }
@@ -983,3 +1156,136 @@ bool TestCppBase::TestIpBlockMap() {
 
   return Count(true);
 }
+
+static bool write_php_file(const char *path, const char *code, time_t mtime,
+                           struct stat &s) {
+  FILE *f = fopen(path, "w");
+  if (!f) return false;
+  fputs(code, f);
+  fclose(f);
+  struct utimbuf t;
+  t.actime = t.modtime = mtime;
+  return utime(path, &t) == 0 && stat(path, &s) == 0;
+}
+
+bool TestCppBase::TestFileRepository() {
+  using Eval::FileRepository;
+  using Eval::PhpFile;
+
+  char path[] = "/tmp/test_file_repository.XXXXXX";
+  close(mkstemp(path));
+  time_t now = time(NULL);
+  struct stat s;
+
+  VERIFY(write_php_file(path, "<?php $a = 1;", now, s));
+  PhpFile *f1 = FileRepository::checkoutFile(path, s);
+  VERIFY(f1);
+  PhpFile *f2 = FileRepository::checkoutFile(path, s);
+  VERIFY(f2 == f1);
+
+  // touched: not parsed again, and the file checked out before is intact
+  VERIFY(write_php_file(path, "<?php $a = 1;", now + 10, s));
+  PhpFile *f3 = FileRepository::checkoutFile(path, s);
+  VERIFY(f3 && f3 != f1);
+  VERIFY(f3->tree().get() == f1->tree().get());
+  VERIFY(f3->md5() == f1->md5());
+  VERIFY(f1->readTime() == now);
+  VERIFY(f3->readTime() == now + 10);
+
+  // changed: parsed again
+  VERIFY(write_php_file(path, "<?php $a = 2;", now + 20, s));
+  PhpFile *f4 = FileRepository::checkoutFile(path, s);
+  VERIFY(f4 && f4 != f3);
+  VERIFY(f4->tree().get() != f3->tree().get());
+  VERIFY(f4->md5() != f3->md5());
+
+  f1->decRef();
+  f2->decRef();
+  f3->decRef();
+  f4->decRef();
+  unlink(path);
+  return Count(true);
+}
+
+static void write_file(const std::string &path, const char *content) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (f) {
+    fputs(content, f);
+    fclose(f);
+  }
+}
+
+// inotify events arrive asynchronously: poll until the watcher sees the
+// new size, or the file gone when size is negative
+static bool watched_size(const std::string &path, int size) {
+  using Eval::FileWatcher;
+  struct stat s;
+  for (int i = 0; i < 1000; i++) {
+    bool found = FileWatcher::Stat(path, s);
+    if (size < 0 ? !found : found && s.st_size == size) return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+bool TestCppBase::TestFileWatcher() {
+  using Eval::FileWatcher;
+
+  bool fileWatch = RuntimeOption::FileWatch;
+  int revalidate = RuntimeOption::FileWatchRevalidate;
+  RuntimeOption::FileWatch = true;
+  RuntimeOption::FileWatchRevalidate = 0;
+
+  char tmp[] = "/tmp/test_file_watcher.XXXXXX";
+  VERIFY(mkdtemp(tmp));
+  std::string dir = tmp;
+  std::string path = dir + "/a.php";
+  struct stat s;
+
+  // cached after the first lookup
+  write_file(path, "12345");
+  VERIFY(FileWatcher::Stat(path, s) && s.st_size == 5);
+  int64 avoided = FileWatcher::GetAvoidedCount();
+  VERIFY(FileWatcher::Stat(path, s) && s.st_size == 5);
+  VERIFY(FileWatcher::GetAvoidedCount() == avoided + 1);
+
+  // modified, renamed over, deleted
+  write_file(path, "1234567");
+  VERIFY(watched_size(path, 7));
+  write_file(dir + "/b.php", "123");
+  VERIFY(rename((dir + "/b.php").c_str(), path.c_str()) == 0);
+  VERIFY(watched_size(path, 3));
+  VERIFY(unlink(path.c_str()) == 0);
+  VERIFY(watched_size(path, -1));
+
+  // a missing file is never cached and costs a single stat
+  int64 stats = FileWatcher::GetStatCount();
+  VERIFY(!FileWatcher::Stat(path, s));
+  VERIFY(FileWatcher::GetStatCount() == stats + 1);
+
+  // current -> r1 flipped to current -> r2, as a deploy would
+  VERIFY(mkdir((dir + "/r1").c_str(), 0777) == 0);
+  VERIFY(mkdir((dir + "/r2").c_str(), 0777) == 0);
+  write_file(dir + "/r1/a.php", "1");
+  write_file(dir + "/r2/a.php", "22");
+  VERIFY(symlink("r1", (dir + "/current").c_str()) == 0);
+  std::string linked = dir + "/current/a.php";
+  VERIFY(FileWatcher::Stat(linked, s) && s.st_size == 1);
+  avoided = FileWatcher::GetAvoidedCount();
+  VERIFY(FileWatcher::Stat(linked, s) && s.st_size == 1);
+  VERIFY(FileWatcher::GetAvoidedCount() == avoided + 1);
+  VERIFY(symlink("r2", (dir + "/current.new").c_str()) == 0);
+  VERIFY(rename((dir + "/current.new").c_str(),
+                (dir + "/current").c_str()) == 0);
+  VERIFY(watched_size(linked, 2));
+
+  // modified through the link
+  write_file(dir + "/r2/a.php", "4444");
+  VERIFY(watched_size(linked, 4));
+
+  RuntimeOption::FileWatch = fileWatch;
+  RuntimeOption::FileWatchRevalidate = revalidate;
+  std::string cmd = "rm -rf " + dir;
+  system(cmd.c_str());
+  return Count(true);
+}
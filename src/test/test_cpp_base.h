@@ -39,8 +39,11 @@ class TestCppBase : public TestBase {
 
   // building blocks
   bool TestSmartAllocator();
+  bool TestSmartMalloc();
   bool TestMemoryManager();
   bool TestIpBlockMap();
+  bool TestFileRepository();
+  bool TestFileWatcher();
 
   /**
    * Date types. This in turn tests StringData, ArrayData, StringOffset,
@@ -56,6 +59,7 @@ class TestCppBase : public TestBase {
    */
   bool TestString();
   bool TestArray();
+  bool TestHphpArray();
   bool TestObject();
   bool TestVariant();
   bool TestListAssignment();
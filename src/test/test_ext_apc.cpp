@@ -17,6 +17,8 @@
 #include <test/test_ext_apc.h>
 #include <runtime/ext/ext_apc.h>
 #include <runtime/base/shared/shared_store.h>
+#include <runtime/base/shared/shared_store_snapshot.h>
+#include <runtime/base/shared/thread_shared_variant.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/program_functions.h>
 
@@ -75,6 +77,7 @@ bool TestExtApc::RunTests(const std::string &which) {
   RUN_TEST(test_apc_bin_load);
   RUN_TEST(test_apc_bin_dumpfile);
   RUN_TEST(test_apc_bin_loadfile);
+  RUN_TEST(test_apc_snapshot);
 
   RuntimeOption::ApcTableType = RuntimeOption::ApcConcurrentTable;
   s_apc_store.reset();
@@ -98,6 +101,32 @@ bool TestExtApc::RunTests(const std::string &which) {
   RUN_TEST(test_apc_bin_load);
   RUN_TEST(test_apc_bin_dumpfile);
   RUN_TEST(test_apc_bin_loadfile);
+  RUN_TEST(test_apc_snapshot);
+
+  RuntimeOption::ApcTableType = RuntimeOption::ApcStripedTable;
+  s_apc_store.reset();
+  printf("\nNon shared-memory striped version:\n");
+  RUN_TEST(test_apc_add);
+  RUN_TEST(test_apc_store);
+  RUN_TEST(test_apc_fetch);
+  RUN_TEST(test_apc_delete);
+  RUN_TEST(test_apc_compile_file);
+  RUN_TEST(test_apc_cache_info);
+  RUN_TEST(test_apc_clear_cache);
+  RUN_TEST(test_apc_define_constants);
+  RUN_TEST(test_apc_load_constants);
+  RUN_TEST(test_apc_sma_info);
+  RUN_TEST(test_apc_filehits);
+  RUN_TEST(test_apc_delete_file);
+  RUN_TEST(test_apc_inc);
+  RUN_TEST(test_apc_dec);
+  RUN_TEST(test_apc_cas);
+  RUN_TEST(test_apc_bin_dump);
+  RUN_TEST(test_apc_bin_load);
+  RUN_TEST(test_apc_bin_dumpfile);
+  RUN_TEST(test_apc_bin_loadfile);
+  RUN_TEST(test_apc_snapshot);
+  RUN_TEST(test_apc_reserialize);
 
   s_apc_store.clear();
   RuntimeOption::ApcTableType = RuntimeOption::ApcHashTable;
@@ -123,6 +152,33 @@ bool TestExtApc::RunTests(const std::string &which) {
   RUN_TEST(test_apc_bin_load);
   RUN_TEST(test_apc_bin_dumpfile);
   RUN_TEST(test_apc_bin_loadfile);
+  RUN_TEST(test_apc_snapshot);
+
+  RuntimeOption::ApcUseLockedRefs = false;
+  RuntimeOption::ApcFlatArrays = true;
+  s_apc_store.reset();
+  printf("\nNon shared-memory version with flat arrays:\n");
+  RUN_TEST(test_apc_add);
+  RUN_TEST(test_apc_store);
+  RUN_TEST(test_apc_fetch);
+  RUN_TEST(test_apc_delete);
+  RUN_TEST(test_apc_compile_file);
+  RUN_TEST(test_apc_cache_info);
+  RUN_TEST(test_apc_clear_cache);
+  RUN_TEST(test_apc_define_constants);
+  RUN_TEST(test_apc_load_constants);
+  RUN_TEST(test_apc_sma_info);
+  RUN_TEST(test_apc_filehits);
+  RUN_TEST(test_apc_delete_file);
+  RUN_TEST(test_apc_inc);
+  RUN_TEST(test_apc_dec);
+  RUN_TEST(test_apc_cas);
+  RUN_TEST(test_apc_bin_dump);
+  RUN_TEST(test_apc_bin_load);
+  RUN_TEST(test_apc_bin_dumpfile);
+  RUN_TEST(test_apc_bin_loadfile);
+  RUN_TEST(test_apc_snapshot);
+  RuntimeOption::ApcFlatArrays = false;
 
   return ret;
 }
@@ -225,6 +281,25 @@ bool TestExtApc::test_apc_fetch() {
     Variant apcdata = f_apc_fetch(CREATE_VECTOR2("apcdata", "nah"));
     VS(apcdata, CREATE_MAP1("apcdata", CREATE_MAP2("a", "test", "b", 1)));
   }
+  {
+    Array nested = CREATE_MAP3("v", CREATE_VECTOR3(1, 2.5, "x"),
+                               "m", CREATE_MAP2("k", true, 5, null),
+                               "s", "str");
+    f_apc_store("nested", nested);
+    Variant apcdata = f_apc_fetch("nested");
+    VS(apcdata, nested);
+    VS(apcdata["m"][5], null);
+    VS(apcdata["m"]["k"], true);
+    VS(apcdata["v"][2], "x");
+    apcdata.lvalAt("m").set("k", false);
+    VS(apcdata["m"]["k"], false);
+    VS(apcdata["v"][2], "x");
+    VS(f_apc_fetch("nested")["m"]["k"], true);
+    f_apc_store("inner", apcdata["v"]);
+    VS(f_apc_fetch("inner"), CREATE_VECTOR3(1, 2.5, "x"));
+    f_apc_delete("nested");
+    VS(f_apc_fetch("inner"), CREATE_VECTOR3(1, 2.5, "x"));
+  }
   return Count(true);
 }
 
@@ -377,3 +452,80 @@ bool TestExtApc::test_apc_bin_loadfile() {
   }
   return Count(false);
 }
+
+bool TestExtApc::test_apc_snapshot() {
+  std::string file = "/tmp/test_apc_snapshot";
+  f_apc_store("ts", "TestString");
+  f_apc_store("ti", 123);
+  f_apc_store("td", 1.5);
+  f_apc_store("tb", false);
+  f_apc_store("tv", CREATE_VECTOR2("a", CREATE_VECTOR1(1)));
+  f_apc_store("tm", CREATE_MAP2("a", 1, 2, "b"));
+  VERIFY(SharedStores::SaveSnapshot(file));
+
+  s_apc_store.reset();
+  VS(f_apc_fetch("ts"), false);
+  VERIFY(SharedStores::LoadSnapshot(file));
+  VERIFY(access(file.c_str(), F_OK) != 0);
+  f_apc_store("ti", 456);
+  VS(f_apc_fetch("ts"), "TestString");
+  VS(f_apc_fetch("ti"), 456);
+  VS(f_apc_fetch("td"), 1.5);
+  VS(f_apc_fetch("tb"), false);
+  VS(f_apc_fetch("tv"), CREATE_VECTOR2("a", CREATE_VECTOR1(1)));
+  VS(f_apc_fetch("tm"), CREATE_MAP2("a", 1, 2, "b"));
+  VERIFY(s_apc_store[0].getSnapshot()->empty());
+  f_apc_clear_cache();
+
+  // items expired since they were written, and the deadline for the rest
+  std::string value(1, (char)SharedStoreSnapshot::TagString);
+  SharedStoreSnapshot::AppendString(value, "TestString", 10);
+  time_t now = time(NULL);
+  FILE *f = fopen(file.c_str(), "w");
+  VERIFY(f);
+  std::string header = "HPHPAPC1";
+  SharedStoreSnapshot::AppendInt32(header, 1); // stores
+  SharedStoreSnapshot::AppendInt32(header, 0); // store id
+  SharedStoreSnapshot::AppendInt64(header, 3); // items
+  VERIFY(fwrite(header.data(), header.size(), 1, f) == 1);
+  VERIFY(SharedStoreSnapshot::WriteItem(f, "texp", 4, now - 1,
+                                        value.data(), value.size()));
+  VERIFY(SharedStoreSnapshot::WriteItem(f, "tlive", 5, now + 3600,
+                                        value.data(), value.size()));
+  VERIFY(SharedStoreSnapshot::WriteItem(f, "tlate", 5, 0,
+                                        value.data(), value.size()));
+  VERIFY(fclose(f) == 0);
+
+  s_apc_store.reset();
+  VERIFY(SharedStores::LoadSnapshot(file));
+  VS(f_apc_fetch("texp"), false);
+  VS(f_apc_fetch("tlive"), "TestString");
+  SharedStoreSnapshot *snapshot = s_apc_store[0].getSnapshot();
+  VERIFY(!snapshot->empty());
+  snapshot->checkDeadline(now + RuntimeOption::ApcSnapshotTimeout - 1);
+  VERIFY(!snapshot->empty());
+  snapshot->checkDeadline(now + RuntimeOption::ApcSnapshotTimeout + 60);
+  VERIFY(snapshot->empty());
+  VS(f_apc_fetch("tlate"), false);
+  f_apc_clear_cache();
+  return Count(true);
+}
+
+bool TestExtApc::test_apc_reserialize() {
+  // nothing here is a static string, so it all comes back as it was
+  const char *values[] = {
+    "s:5:\"hello\";",
+    "a:3:{i:0;s:3:\"abc\";s:1:\"k\";d:1.5;s:1:\"n\";a:1:{i:1;N;}}",
+    "O:8:\"stdClass\":2:{s:1:\"a\";s:2:\"xy\";s:1:\"b\";b:1;}",
+    "i:-12;",
+  };
+  for (unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    VS(apc_reserialize(values[i]), values[i]);
+  }
+
+  // as serialized values being primed do
+  ThreadSharedVariant *primed = new ThreadSharedVariant(values[2], true);
+  VS(primed->toLocal(), f_unserialize(values[2]));
+  primed->decRef();
+  return Count(true);
+}
@@ -50,6 +50,7 @@ bool TestExtMysql::RunTests(const std::string &which) {
   RUN_TEST(test_mysql_set_timeout);
   RUN_TEST(test_mysql_query);
   RUN_TEST(test_mysql_unbuffered_query);
+  RUN_TEST(test_mysql_async_query);
   RUN_TEST(test_mysql_db_query);
   RUN_TEST(test_mysql_list_dbs);
   RUN_TEST(test_mysql_list_tables);
@@ -64,6 +65,7 @@ bool TestExtMysql::RunTests(const std::string &which) {
   RUN_TEST(test_mysql_fetch_row);
   RUN_TEST(test_mysql_fetch_assoc);
   RUN_TEST(test_mysql_fetch_array);
+  RUN_TEST(test_mysql_fetch_all);
   RUN_TEST(test_mysql_fetch_lengths);
   RUN_TEST(test_mysql_fetch_object);
   RUN_TEST(test_mysql_result);
@@ -303,6 +305,41 @@ bool TestExtMysql::test_mysql_unbuffered_query() {
   return Count(true);
 }
 
+bool TestExtMysql::test_mysql_async_query() {
+  Variant conn1 = f_mysql_connect(TEST_HOSTNAME, TEST_USERNAME, TEST_PASSWORD,
+                                  true);
+  VERIFY(CreateTestTable());
+  VS(f_mysql_query("insert into test (name) values ('test'),('test2')"), true);
+  Variant conn2 = f_mysql_connect(TEST_HOSTNAME, TEST_USERNAME, TEST_PASSWORD,
+                                  true);
+  f_mysql_select_db(TEST_DATABASE, conn2);
+
+  VERIFY(f_mysql_async_query_start("select name from test where id = 1",
+                                   conn1));
+  VERIFY(f_mysql_async_query_start("select name from test where id = 2",
+                                   conn2));
+  Array links = CREATE_MAP2("a", conn1, "b", conn2);
+  Array ready;
+  while (ready.size() < 2) {
+    Array actionable = f_mysql_async_wait_actionable(links, 1.0);
+    for (ArrayIter iter(actionable); iter; ++iter) {
+      ready.set(iter.first(), iter.second());
+    }
+  }
+  VERIFY(f_mysql_async_query_completed(conn1));
+
+  Variant res = f_mysql_async_query_result(conn1);
+  VS(f_mysql_result(res, 0), "test");
+  res = f_mysql_async_query_result(conn2);
+  VS(f_mysql_result(res, 0), "test2");
+
+  // other calls on a link with a query pending throw its result away
+  VERIFY(f_mysql_async_query_start("select name from test", conn1));
+  res = f_mysql_query("select name from test where id = 2", conn1);
+  VS(f_mysql_result(res, 0), "test2");
+  return Count(true);
+}
+
 bool TestExtMysql::test_mysql_db_query() {
   try {
     f_mysql_db_query("", "");
@@ -460,6 +497,34 @@ bool TestExtMysql::test_mysql_fetch_array() {
   return Count(true);
 }
 
+bool TestExtMysql::test_mysql_fetch_all() {
+  Variant conn = f_mysql_connect(TEST_HOSTNAME, TEST_USERNAME, TEST_PASSWORD);
+  VERIFY(CreateTestTable());
+  VS(f_mysql_query("insert into test (name) values ('test'),('test2')"), true);
+
+  Variant res = f_mysql_query("select id, name as `5` from test order by id");
+  VERIFY(!same(f_mysql_fetch_row(res), false));
+  Variant rows = f_mysql_fetch_all(res, 1); // MYSQL_ASSOC
+  VS(f_print_r(rows, true),
+     "Array\n"
+     "(\n"
+     "    [0] => Array\n"
+     "        (\n"
+     "            [id] => 2\n"
+     "            [5] => test2\n"
+     "        )\n"
+     "\n"
+     ")\n");
+  VS(f_mysql_fetch_all(res), Array::Create());
+  VERIFY(f_mysql_data_seek(res, 0));
+  rows = f_mysql_fetch_all(res);
+  VS(rows[1][0], 2);
+  VS(rows[1]["id"], 2);
+  VS(rows[1][5], "test2");
+  VS(rows[1][1], "test2");
+  return Count(true);
+}
+
 bool TestExtMysql::test_mysql_fetch_lengths() {
   Variant conn = f_mysql_connect(TEST_HOSTNAME, TEST_USERNAME, TEST_PASSWORD);
   VERIFY(CreateTestTable());
@@ -52,6 +52,7 @@ class TestExtMysql : public TestCppExt {
   bool test_mysql_set_timeout();
   bool test_mysql_query();
   bool test_mysql_unbuffered_query();
+  bool test_mysql_async_query();
   bool test_mysql_db_query();
   bool test_mysql_list_dbs();
   bool test_mysql_list_tables();
@@ -66,6 +67,7 @@ class TestExtMysql : public TestCppExt {
   bool test_mysql_fetch_row();
   bool test_mysql_fetch_assoc();
   bool test_mysql_fetch_array();
+  bool test_mysql_fetch_all();
   bool test_mysql_fetch_lengths();
   bool test_mysql_fetch_object();
   bool test_mysql_result();
@@ -18,6 +18,8 @@
 #include <runtime/ext/ext_preg.h>
 #include <runtime/ext/ext_array.h>
 #include <runtime/ext/ext_string.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/preg.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -39,6 +41,8 @@ bool TestExtPreg::RunTests(const std::string &which) {
   RUN_TEST(test_split);
   RUN_TEST(test_spliti);
   RUN_TEST(test_sql_regcase);
+  RUN_TEST(test_preg_cache_lru);
+  RUN_TEST(test_preg_cache_lifetime);
 
   return ret;
 }
@@ -433,3 +437,41 @@ bool TestExtPreg::test_sql_regcase() {
   VS(f_sql_regcase("Foo - bar."), "[Ff][Oo][Oo] - [Bb][Aa][Rr].");
   return Count(true);
 }
+
+static String lru_pattern(int i) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "/lru%d/", i);
+  return String(buf, CopyString);
+}
+
+bool TestExtPreg::test_preg_cache_lru() {
+  int cacheSize = RuntimeOption::PregCacheSize;
+  RuntimeOption::PregCacheSize = 8;
+  preg_clear_cache();
+  for (int i = 0; i < 8; i++) {
+    VS(f_preg_match(lru_pattern(i), lru_pattern(i)), 1);
+  }
+  VS(f_preg_match(lru_pattern(0), lru_pattern(0)), 1);
+  // full: drops the least recently used quarter and then some, not lru0
+  VS(f_preg_match(lru_pattern(8), lru_pattern(8)), 1);
+  RuntimeOption::PregCacheSize = cacheSize;
+
+  VERIFY(!preg_is_cached(lru_pattern(1)));
+  VERIFY(!preg_is_cached(lru_pattern(2)));
+  VERIFY(!preg_is_cached(lru_pattern(3)));
+  VERIFY(preg_is_cached(lru_pattern(0)));
+  for (int i = 4; i <= 8; i++) {
+    VERIFY(preg_is_cached(lru_pattern(i)));
+  }
+  return Count(true);
+}
+
+bool TestExtPreg::test_preg_cache_lifetime() {
+  // the callback drops every cached pattern, including the one in use, and
+  // compiles others in its place
+  String text = f_preg_replace_callback("/(\\d+)/", "test_preg_evict",
+                                        "1 2 3");
+  VS(text, "2 4 6");
+  VERIFY(!preg_is_cached("/(\\d+)/"));
+  return Count(true);
+}
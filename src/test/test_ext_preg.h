@@ -42,6 +42,8 @@ class TestExtPreg : public TestCppExt {
   bool test_split();
   bool test_spliti();
   bool test_sql_regcase();
+  bool test_preg_cache_lru();
+  bool test_preg_cache_lifetime();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
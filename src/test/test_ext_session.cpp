@@ -16,6 +16,8 @@
 
 #include <test/test_ext_session.h>
 #include <runtime/ext/ext_session.h>
+#include <runtime/ext/ext_options.h>
+#include <runtime/base/shared/shared_store.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -42,6 +44,11 @@ bool TestExtSession::RunTests(const std::string &which) {
   RUN_TEST(test_session_register);
   RUN_TEST(test_session_unregister);
   RUN_TEST(test_session_is_registered);
+  RUN_TEST(test_memory_session_round_trip);
+  RUN_TEST(test_memory_session_unlocked_write);
+  RUN_TEST(test_memory_session_regenerate_id);
+  RUN_TEST(test_memory_session_lock_timeout);
+  RUN_TEST(test_memory_session_gc);
 
   return ret;
 }
@@ -71,6 +78,8 @@ bool TestExtSession::test_session_name() {
 }
 
 bool TestExtSession::test_session_module_name() {
+  VS(f_session_module_name("memory"), "files");
+  VS(f_session_module_name("files"), "memory");
   return Count(true);
 }
 
@@ -154,3 +163,153 @@ bool TestExtSession::test_session_is_registered() {
   }
   return Count(false);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// session.save_handler = memory
+
+static void write_memory_session(CStrRef id, CVarRef data) {
+  SystemGlobals *g = (SystemGlobals*)get_global_variables();
+  f_session_id(id);
+  f_session_start();
+  g->gv__SESSION = data;
+  f_session_write_close();
+}
+
+static Variant read_memory_session(CStrRef id) {
+  SystemGlobals *g = (SystemGlobals*)get_global_variables();
+  g->gv__SESSION.reset();
+  f_session_id(id);
+  f_session_start();
+  Variant data = g->gv__SESSION;
+  f_session_write_close();
+  return data;
+}
+
+bool TestExtSession::test_memory_session_round_trip() {
+  f_session_module_name("memory");
+  write_memory_session("roundtrip", CREATE_MAP2("a", 1, "b", "bb"));
+  VS(read_memory_session("roundtrip"), CREATE_MAP2("a", 1, "b", "bb"));
+
+  // php_binary, unless session.serialize_handler is set
+  VS(f_ini_get("session.serialize_handler"), "php");
+  Variant data;
+  VERIFY(s_apc_store[SHARED_STORE_SESSION].get("roundtrip", data));
+  VS(data, "\x01" "ai:1;" "\x01" "bs:2:\"bb\";");
+  f_ini_set("session.serialize_handler", "php");
+  write_memory_session("roundtrip", CREATE_MAP1("a", 1));
+  VERIFY(s_apc_store[SHARED_STORE_SESSION].get("roundtrip", data));
+  VS(data, "a|i:1;");
+  VS(read_memory_session("roundtrip"), CREATE_MAP1("a", 1));
+
+  s_apc_store[SHARED_STORE_SESSION].erase("roundtrip");
+  f_session_module_name("files");
+  return Count(true);
+}
+
+bool TestExtSession::test_memory_session_unlocked_write() {
+  SystemGlobals *g = (SystemGlobals*)get_global_variables();
+  f_session_module_name("memory");
+  f_ini_set("session.lock_timeout", "0");
+  write_memory_session("unlocked", CREATE_MAP1("a", 1));
+
+  // held by another request: nothing is read and nothing is written back
+  VERIFY(session_memory_lock("unlocked", 0));
+  g->gv__SESSION.reset();
+  f_session_id("unlocked");
+  f_session_start();
+  VERIFY(g->gv__SESSION.isNull());
+  g->gv__SESSION = CREATE_MAP1("a", 2);
+  f_session_write_close();
+  session_memory_unlock("unlocked");
+
+  VS(read_memory_session("unlocked"), CREATE_MAP1("a", 1));
+
+  s_apc_store[SHARED_STORE_SESSION].erase("unlocked");
+  f_ini_set("session.lock_timeout", "30");
+  f_session_module_name("files");
+  return Count(true);
+}
+
+bool TestExtSession::test_memory_session_regenerate_id() {
+  SystemGlobals *g = (SystemGlobals*)get_global_variables();
+  f_session_module_name("memory");
+  f_ini_set("session.lock_timeout", "0");
+  for (int delete_old = 0; delete_old < 2; delete_old++) {
+    write_memory_session("regenerate", CREATE_MAP1("a", 1));
+
+    // written under the new id, which takes over the lock
+    f_session_id("regenerate");
+    f_session_start();
+    g->gv__SESSION = CREATE_MAP1("a", 2);
+    VERIFY(f_session_regenerate_id(delete_old));
+    String id = f_session_id();
+    VERIFY(id != "regenerate");
+    f_session_write_close();
+    VERIFY(session_memory_lock(id, 0));
+    session_memory_unlock(id);
+    VERIFY(session_memory_lock("regenerate", 0));
+    session_memory_unlock("regenerate");
+
+    VS(read_memory_session(id), CREATE_MAP1("a", 2));
+    Variant data;
+    VS(s_apc_store[SHARED_STORE_SESSION].get("regenerate", data),
+       !delete_old);
+    s_apc_store[SHARED_STORE_SESSION].erase(id);
+    s_apc_store[SHARED_STORE_SESSION].erase("regenerate");
+  }
+
+  f_ini_set("session.lock_timeout", "30");
+  f_session_module_name("files");
+  return Count(true);
+}
+
+bool TestExtSession::test_memory_session_lock_timeout() {
+  // another id does not wait
+  VERIFY(session_memory_lock("lock1", 0));
+  VERIFY(session_memory_lock("lock2", 0));
+
+  // the same one times out
+  time_t start = time(NULL);
+  VERIFY(!session_memory_lock("lock1", 1));
+  VERIFY(time(NULL) - start >= 1);
+
+  // and is there once released
+  session_memory_unlock("lock1");
+  VERIFY(session_memory_lock("lock1", 0));
+
+  session_memory_unlock("lock1");
+  session_memory_unlock("lock2");
+  return Count(true);
+}
+
+bool TestExtSession::test_memory_session_gc() {
+  SharedStore &store = s_apc_store[SHARED_STORE_SESSION];
+  store.clear();
+  f_session_module_name("memory");
+  f_ini_set("session.gc_maxlifetime", "1");
+  write_memory_session("expired", CREATE_MAP1("a", 1));
+  f_ini_set("session.gc_maxlifetime", "1440");
+  write_memory_session("live", CREATE_MAP1("a", 2));
+  sleep(2);
+
+  int reachable, expired, persistent;
+  store.count(reachable, expired, persistent);
+  VS(expired, 1);
+  VS(store.size(), 2);
+
+  // session_start() always collecting
+  f_ini_set("session.gc_probability", "1");
+  f_ini_set("session.gc_divisor", "1");
+  VS(read_memory_session("live"), CREATE_MAP1("a", 2));
+  store.count(reachable, expired, persistent);
+  VS(expired, 0);
+  VS(store.size(), 1);
+  Variant data;
+  VERIFY(!store.get("expired", data));
+
+  store.clear();
+  f_ini_set("session.gc_probability", "1");
+  f_ini_set("session.gc_divisor", "100");
+  f_session_module_name("files");
+  return Count(true);
+}
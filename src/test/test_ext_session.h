@@ -47,6 +47,11 @@ class TestExtSession : public TestCppExt {
   bool test_session_register();
   bool test_session_unregister();
   bool test_session_is_registered();
+  bool test_memory_session_round_trip();
+  bool test_memory_session_unlocked_write();
+  bool test_memory_session_regenerate_id();
+  bool test_memory_session_lock_timeout();
+  bool test_memory_session_gc();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -344,6 +344,36 @@ bool TestExtVariable::test_unserialize() {
     Variant v2 = f_unserialize("a:3:{s:1:\"a\";s:5:\"apple\";s:1:\"b\";i:2;s:1:\"c\";a:3:{i:0;i:1;i:1;s:1:\"y\";i:2;i:3;}}");
     VS(v1, v2);
   }
+  {
+    // rows of the same shape
+    Variant v = f_unserialize("a:2:{i:0;a:2:{s:2:\"id\";i:1;s:4:\"name\";s:1:\"a\";}i:1;a:2:{s:2:\"id\";i:-2;s:4:\"name\";s:1:\"b\";}}");
+    VS(v, CREATE_VECTOR2(CREATE_MAP2("id", 1, "name", "a"),
+                         CREATE_MAP2("id", -2, "name", "b")));
+  }
+  {
+    VS(f_unserialize("d:1.5E+25;"), 1.5e25);
+    double inf = f_unserialize("d:-INF;").toDouble();
+    VERIFY(isinf(inf) && inf < 0);
+    VERIFY(isnan(f_unserialize("d:NAN;").toDouble()));
+  }
+  {
+    // truncated in the middle of a string
+    VERIFY(same(f_unserialize("a:1:{i:0;s:5:\"ab"), false));
+  }
+  {
+    VS(f_unserialize("i:9223372036854775807;"), 9223372036854775807LL);
+    VS(f_unserialize("i:-9223372036854775808;"),
+       (int64)(-9223372036854775807LL - 1));
+    VERIFY(same(f_unserialize("i:9223372036854775808;"), false));
+    VERIFY(same(f_unserialize("i:-9223372036854775809;"), false));
+    VERIFY(same(f_unserialize("a:18446744073709551617:{}"), false));
+  }
+  {
+    // longer than readDouble()'s stack buffer
+    std::string zeros(97, '0');
+    VS(f_unserialize(String("d:0." + zeros + "15E+98;")), 1.5);
+    VS(f_unserialize(String("d:1" + zeros + ";")), 1e97);
+  }
   return Count(true);
 }
 
@@ -19,7 +19,10 @@
 #include <runtime/ext/ext_string.h>
 #include <runtime/ext/ext_network.h>
 #include <runtime/ext/ext_soap.h>
+#include <runtime/ext/ext_preg.h>
+#include <runtime/base/preg.h>
 #include <runtime/base/program_functions.h>
+#include <runtime/base/dynamic_call_cache.h>
 #include <system/gen/sys/system_globals.h>
 
 using namespace std;
@@ -133,6 +136,18 @@ Variant invoke(const char *function, CArrRef params, int64 hash,
     return matches[1].toString() + String(matches[2].toInt32() + 1);
   }
 
+  // for TestExtPreg::test_preg_cache_lifetime
+  if (strcasecmp(function, "test_preg_evict") == 0) {
+    preg_clear_cache();
+    for (int i = 0; i < 16; i++) {
+      char pattern[16];
+      snprintf(pattern, sizeof(pattern), "/evict%d/", i);
+      f_preg_match(String(pattern, CopyString), "");
+    }
+    Array matches = params[0].toArray();
+    return String(matches[1].toInt32() * 2);
+  }
+
   // for TestExtArray::test_array_filter
   if (strcasecmp(function, "odd") == 0) {
     return params[0].toInt32() & 1;
@@ -281,6 +296,11 @@ Variant invoke(const char *function, CArrRef params, int64 hash,
   return true;
 }
 
+const DynamicCallTarget *get_dynamic_call_target(const char *s,
+                                                 int64 hash) {
+  return NULL;
+}
+
 Variant invoke_static_method(const char* cls, MethodIndex, const char *function,
                              CArrRef params, bool fatal) {
   return null;
@@ -0,0 +1,99 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <test/test_package.h>
+#include <compiler/package.h>
+#include <utime.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+
+TestPackage::TestPackage() {
+}
+
+bool TestPackage::RunTests(const std::string &which) {
+  bool ret = true;
+  RUN_TEST(TestInputCache);
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static bool write_file(const string &path, const char *content,
+                       time_t mtime) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (!f) return false;
+  fputs(content, f);
+  fclose(f);
+  struct utimbuf t;
+  t.actime = t.modtime = mtime;
+  return utime(path.c_str(), &t) == 0;
+}
+
+static bool check_input_cache(const string &root, const string &cache,
+                              const char *key, bool addNewFile = false) {
+  Package package(root.c_str());
+  package.addSourceFile("a.php");
+  package.addSourceFile("b.php");
+  if (addNewFile) package.addSourceFile("c.php");
+  return package.checkInputCache(cache.c_str(), key);
+}
+
+static bool save_input_cache(const string &root, const string &cache,
+                             const char *key) {
+  Package package(root.c_str());
+  package.addSourceFile("a.php");
+  package.addSourceFile("b.php");
+  return package.saveInputCache(cache.c_str(), key);
+}
+
+bool TestPackage::TestInputCache() {
+  char dir[] = "/tmp/test_package.XXXXXX";
+  VERIFY(mkdtemp(dir));
+  string root = string(dir) + "/";
+  string cache = root + "hphp_inputs.cache";
+  time_t now = time(NULL);
+
+  VERIFY(write_file(root + "a.php", "<?php echo 1;", now));
+  VERIFY(write_file(root + "b.php", "<?php echo 2;", now));
+  VERIFY(write_file(root + "c.php", "<?php echo 3;", now));
+  VERIFY(!check_input_cache(root, cache, "key"));
+  VERIFY(save_input_cache(root, cache, "key"));
+  VERIFY(check_input_cache(root, cache, "key"));
+  VERIFY(!check_input_cache(root, cache, "another key"));
+  VERIFY(!check_input_cache(root, cache, "key", true));
+
+  // editing one file, without changing its size
+  VERIFY(write_file(root + "b.php", "<?php echo 4;", now + 10));
+  VERIFY(!check_input_cache(root, cache, "key"));
+  VERIFY(save_input_cache(root, cache, "key"));
+  VERIFY(check_input_cache(root, cache, "key"));
+
+  // touching it only
+  VERIFY(write_file(root + "b.php", "<?php echo 4;", now + 20));
+  VERIFY(check_input_cache(root, cache, "key"));
+
+  // deleting it
+  unlink((root + "b.php").c_str());
+  VERIFY(!check_input_cache(root, cache, "key"));
+
+  unlink((root + "a.php").c_str());
+  unlink((root + "c.php").c_str());
+  unlink(cache.c_str());
+  rmdir(dir);
+  return Count(true);
+}
@@ -20,6 +20,9 @@
 #include <util/logger.h>
 #include <runtime/base/shared/shared_string.h>
 #include <runtime/base/zend/zend_string.h>
+#include <util/job_queue.h>
+#include <util/async_log.h>
+#include <util/async_func.h>
 
 using namespace std;
 
@@ -43,6 +46,13 @@ bool TestUtil::RunTests(const std::string &which) {
   //RUN_TEST(TestLFUTable);
   RUN_TEST(TestSharedString);
   RUN_TEST(TestCanonicalize);
+  RUN_TEST(TestJobQueue);
+  RUN_TEST(TestJobQueueBlockedWorker);
+  RUN_TEST(TestAsyncLogWraparound);
+  RUN_TEST(TestAsyncLogOverflow);
+  RUN_TEST(TestAsyncLogThreads);
+  RUN_TEST(TestAsyncLogStop);
+  RUN_TEST(TestAsyncLogNewOutput);
   return ret;
 }
 
@@ -260,3 +270,316 @@ bool TestUtil::TestCanonicalize() {
   VERIFY(Util::canonicalize("./../../") == "../../");
   return Count(true);
 }
+
+class TestJobQueueWorker : public JobQueueWorker<int> {
+public:
+  static int s_sum;
+  static int s_count;
+  virtual void doJob(int job) {
+    atomic_add(s_sum, job);
+    atomic_inc(s_count);
+  }
+};
+int TestJobQueueWorker::s_sum;
+int TestJobQueueWorker::s_count;
+
+bool TestUtil::TestJobQueue() {
+  for (int stealing = 0; stealing < 2; stealing++) {
+    TestJobQueueWorker::s_sum = 0;
+    TestJobQueueWorker::s_count = 0;
+    {
+      JobQueueDispatcher<int, TestJobQueueWorker> dispatcher(4, NULL,
+                                                             stealing);
+      dispatcher.start();
+      for (int i = 1; i <= 1000; i++) {
+        dispatcher.enqueue(i);
+      }
+      dispatcher.stop(); // only returns after the queue is drained
+      VERIFY(dispatcher.getQueuedJobs() == 0);
+    }
+    VERIFY(TestJobQueueWorker::s_count == 1000);
+    VERIFY(TestJobQueueWorker::s_sum == 500500);
+  }
+  return Count(true);
+}
+
+class TestBlockingJobQueueWorker : public JobQueueWorker<int> {
+public:
+  static volatile bool s_blocked;
+  static volatile bool s_release;
+  static int s_count;
+  virtual void doJob(int job) {
+    if (job == 0) {
+      s_blocked = true;
+      while (!s_release) usleep(1000);
+      return;
+    }
+    atomic_inc(s_count);
+  }
+};
+volatile bool TestBlockingJobQueueWorker::s_blocked;
+volatile bool TestBlockingJobQueueWorker::s_release;
+int TestBlockingJobQueueWorker::s_count;
+
+/**
+ * Jobs queued behind a worker stuck on a long job have to be done by the
+ * others, even when they all prefer the stuck one and the others are asleep.
+ */
+bool TestUtil::TestJobQueueBlockedWorker() {
+  typedef TestBlockingJobQueueWorker Worker;
+  Worker::s_blocked = false;
+  Worker::s_release = false;
+  Worker::s_count = 0;
+  bool done = false;
+  {
+    JobQueueDispatcher<int, Worker> dispatcher(4, NULL, true);
+    dispatcher.start();
+    dispatcher.enqueue(0, 0, 1);
+    for (int i = 0; i < 10000 && !Worker::s_blocked; i++) usleep(1000);
+    for (int i = 0; i < 1000; i++) {
+      dispatcher.enqueue(1, 0, 1);
+      if (i % 100 == 0) usleep(1000); // let workers go idle in between
+    }
+    for (int i = 0; i < 10000 && !done; i++) {
+      done = Worker::s_count == 1000;
+      if (!done) usleep(1000);
+    }
+    Worker::s_release = true;
+    dispatcher.stop();
+  }
+  VERIFY(Worker::s_blocked);
+  VERIFY(done);
+  return Count(true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A log file for AsyncLogWriter, with the writer running on 4K buffers.
+ */
+class TestAsyncLog {
+public:
+  TestAsyncLog(int flushInterval, bool block) {
+    char path[] = "/tmp/test_async_log.XXXXXX";
+    close(mkstemp(path));
+    m_path = path;
+    m_file = fopen(path, "w");
+    m_written = AsyncLogWriter::GetWrittenCount();
+    m_dropped = AsyncLogWriter::GetDroppedCount();
+    AsyncLogWriter::Enabled = true;
+    AsyncLogWriter::BufferSize = 4096;
+    AsyncLogWriter::FlushInterval = flushInterval;
+    AsyncLogWriter::Block = block;
+    AsyncLogWriter::Start();
+  }
+  ~TestAsyncLog() {
+    AsyncLogWriter::Stop();
+    AsyncLogWriter::Enabled = false;
+    fclose(m_file);
+    unlink(m_path.c_str());
+  }
+
+  bool write(const std::string &line) {
+    return AsyncLogWriter::Write(m_file, line.data(), line.size());
+  }
+
+  std::string read() {
+    std::ifstream f(m_path.c_str());
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+  }
+
+  int64 written() const {
+    return AsyncLogWriter::GetWrittenCount() - m_written;
+  }
+  int64 dropped() const {
+    return AsyncLogWriter::GetDroppedCount() - m_dropped;
+  }
+
+private:
+  std::string m_path;
+  FILE *m_file;
+  int64 m_written;
+  int64 m_dropped;
+};
+
+static std::string log_line(int thread, int i) {
+  char buf[64];
+  // lengths vary, so lines and headers end up split at the end of the ring
+  snprintf(buf, sizeof(buf), "%d %d %.*s\n", thread, i, i % 37,
+           "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+  return buf;
+}
+
+bool TestUtil::TestAsyncLogWraparound() {
+  TestAsyncLog log(1, true);
+  std::string expected;
+  for (int i = 0; i < 2000; i++) {
+    std::string line = log_line(0, i);
+    VERIFY(log.write(line));
+    expected += line;
+  }
+  AsyncLogWriter::Flush();
+  VERIFY(log.read() == expected);
+  VERIFY(log.written() == 2000);
+  VERIFY(log.dropped() == 0);
+  return Count(true);
+}
+
+bool TestUtil::TestAsyncLogOverflow() {
+  std::string huge(5000, 'x');
+  {
+    // never fits, whatever the policy
+    TestAsyncLog log(1, true);
+    VERIFY(!log.write(huge));
+    VERIFY(log.dropped() == 1);
+  }
+  {
+    // a full ring drops lines, and only those
+    TestAsyncLog log(60000, false);
+    std::string expected;
+    int ok = 0;
+    for (int i = 0; i < 2000; i++) {
+      std::string line = log_line(0, i) + std::string(100, '.');
+      if (log.write(line)) {
+        expected += line;
+        ok++;
+      }
+    }
+    AsyncLogWriter::Stop();
+    VERIFY(log.read() == expected);
+    VERIFY(log.written() == ok);
+    VERIFY(log.dropped() == 2000 - ok);
+  }
+  {
+    // unless it waits for room
+    TestAsyncLog log(60000, true);
+    for (int i = 0; i < 2000; i++) {
+      VERIFY(log.write(log_line(0, i) + std::string(100, '.')));
+    }
+    AsyncLogWriter::Stop();
+    VERIFY(log.written() == 2000);
+    VERIFY(log.dropped() == 0);
+  }
+  return Count(true);
+}
+
+class TestAsyncLogThread {
+public:
+  TestAsyncLogThread() : log(NULL), thread(0) {}
+  void run() {
+    for (int i = 0; i < 1000; i++) {
+      log->write(log_line(thread, i));
+    }
+  }
+  TestAsyncLog *log;
+  int thread;
+};
+
+bool TestUtil::TestAsyncLogThreads() {
+  const int count = 8;
+  TestAsyncLog log(1, true);
+  std::vector<TestAsyncLogThread> threads(count);
+  std::vector<AsyncFunc<TestAsyncLogThread> *> funcs;
+  for (int i = 0; i < count; i++) {
+    threads[i].log = &log;
+    threads[i].thread = i;
+    funcs.push_back(new AsyncFunc<TestAsyncLogThread>
+                    (&threads[i], &TestAsyncLogThread::run));
+  }
+  for (int i = 0; i < count; i++) funcs[i]->start();
+  for (int i = 0; i < count; i++) {
+    funcs[i]->waitForEnd();
+    delete funcs[i];
+  }
+  AsyncLogWriter::Stop();
+  VERIFY(log.written() == count * 1000);
+  VERIFY(log.dropped() == 0);
+
+  // every line whole, and each thread's in the order it wrote them
+  std::vector<int> next(count);
+  std::istringstream lines(log.read());
+  std::string line;
+  while (getline(lines, line)) {
+    int thread = atoi(line.c_str());
+    VERIFY(thread >= 0 && thread < count);
+    VERIFY(line + "\n" == log_line(thread, next[thread]));
+    next[thread]++;
+  }
+  for (int i = 0; i < count; i++) {
+    VERIFY(next[i] == 1000);
+  }
+  return Count(true);
+}
+
+bool TestUtil::TestAsyncLogStop() {
+  TestAsyncLog log(60000, false);
+  std::string expected;
+  for (int i = 0; i < 10; i++) {
+    std::string line = log_line(0, i);
+    VERIFY(log.write(line));
+    expected += line;
+  }
+  // the writer won't wake up for a minute, but stopping writes it all out
+  AsyncLogWriter::Stop();
+  VERIFY(log.read() == expected);
+  // and later lines are written right away
+  VERIFY(log.write("after\n"));
+  VERIFY(log.read() == expected + "after\n");
+  return Count(true);
+}
+
+class TestAsyncLogLogger {
+public:
+  TestAsyncLogLogger() : done(false) {}
+  void run() {
+    for (int i = 0; i < 2000; i++) {
+      Logger::Info("line %d", i);
+    }
+    done = true;
+  }
+  volatile bool done;
+};
+
+static int count_lines(const char *path) {
+  std::ifstream f(path);
+  std::string line;
+  int count = 0;
+  while (getline(f, line)) count++;
+  return count;
+}
+
+bool TestUtil::TestAsyncLogNewOutput() {
+  // only for the writer's settings and lifetime
+  TestAsyncLog log(1, true);
+  FILE *saved = Logger::Output;
+  Logger::LogLevelType level = Logger::LogLevel;
+  Logger::LogLevel = Logger::LogInfo;
+  const char *paths[] = {
+    "/tmp/test_async_log_output.0", "/tmp/test_async_log_output.1"
+  };
+  fclose(fopen(paths[1], "w"));
+  Logger::Output = fopen(paths[0], "w");
+
+  // outputs switched while a thread logs: every line lands in one of them,
+  // and none goes to a file already closed
+  TestAsyncLogLogger logger;
+  AsyncFunc<TestAsyncLogLogger> func(&logger, &TestAsyncLogLogger::run);
+  func.start();
+  int switches = 0;
+  while (!logger.done) {
+    usleep(100);
+    Logger::SetNewOutput(fopen(paths[++switches % 2], "a"));
+  }
+  func.waitForEnd();
+  VERIFY(switches > 0);
+  AsyncLogWriter::Stop();
+  fclose(Logger::Output);
+  Logger::Output = saved;
+  Logger::LogLevel = level;
+  VERIFY(count_lines(paths[0]) + count_lines(paths[1]) == 2000);
+  unlink(paths[0]);
+  unlink(paths[1]);
+  return Count(true);
+}
@@ -31,6 +31,13 @@ class TestUtil : public TestBase {
   bool TestLFUTable();
   bool TestSharedString();
   bool TestCanonicalize();
+  bool TestJobQueue();
+  bool TestJobQueueBlockedWorker();
+  bool TestAsyncLogWraparound();
+  bool TestAsyncLogOverflow();
+  bool TestAsyncLogThreads();
+  bool TestAsyncLogStop();
+  bool TestAsyncLogNewOutput();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,324 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "async_log.h"
+#include "async_func.h"
+#include "synchronizable.h"
+#include "mutex.h"
+#include "lock.h"
+#include "atomic.h"
+
+using namespace std;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+bool AsyncLogWriter::Enabled = false;
+int AsyncLogWriter::BufferSize = 64 * 1024;
+int AsyncLogWriter::FlushInterval = 10;
+bool AsyncLogWriter::Block = false;
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Lines one thread has logged and the writer has not written yet, each one
+ * a LineHeader and the bytes, back to back. Only the thread
+ * owning the ring moves m_head, and only the writer moves m_tail, so neither
+ * side needs a lock. Positions only ever grow; they are masked when used.
+ */
+struct LineHeader {
+  FILE *file;
+  int32 len;
+};
+
+typedef std::pair<const char *, uint32> LinePiece;
+typedef map<FILE *, vector<LinePiece> > LinePieceMap;
+
+class AsyncLogRing {
+public:
+  AsyncLogRing(uint32 size)
+    : m_size(size), m_head(0), m_tail(0), m_owned(true), m_next(NULL) {
+    ASSERT((size & (size - 1)) == 0);
+    m_data = (char *)malloc(size);
+  }
+
+  uint32 size() const { return m_size;}
+  bool empty() const { return m_head == m_tail;}
+
+  bool put(FILE *f, const char *data, int32 len) {
+    uint64 head = m_head;
+    if (head + sizeof(LineHeader) + len - m_tail > m_size) return false;
+    LineHeader header;
+    header.file = f;
+    header.len = len;
+    copyIn(head, (const char *)&header, sizeof(header));
+    copyIn(head + sizeof(header), data, len);
+    __sync_synchronize(); // line has to be complete before it is visible
+    m_head = head + sizeof(header) + len;
+    return true;
+  }
+
+  /**
+   * Adds all lines up to head to files, in one or two pieces each.
+   */
+  int collect(uint64 head, LinePieceMap &files) const {
+    int count = 0;
+    for (uint64 pos = m_tail; pos < head; count++) {
+      LineHeader header;
+      copyOut(pos, (char *)&header, sizeof(header));
+      pos += sizeof(header);
+      vector<LinePiece> &pieces = files[header.file];
+      uint32 offset = pos & (m_size - 1);
+      uint32 first = min((uint32)header.len, m_size - offset);
+      addPiece(pieces, m_data + offset, first);
+      addPiece(pieces, m_data, header.len - first);
+      pos += header.len;
+    }
+    return count;
+  }
+
+  char *m_data;
+  uint32 m_size;
+  volatile uint64 m_head;
+  volatile uint64 m_tail;
+  volatile bool m_owned;  // false once its thread has exited
+  AsyncLogRing *m_next;
+
+private:
+  void copyIn(uint64 pos, const char *data, uint32 len) {
+    uint32 offset = pos & (m_size - 1);
+    uint32 first = min(len, m_size - offset);
+    memcpy(m_data + offset, data, first);
+    memcpy(m_data, data + first, len - first);
+  }
+
+  void copyOut(uint64 pos, char *data, uint32 len) const {
+    uint32 offset = pos & (m_size - 1);
+    uint32 first = min(len, m_size - offset);
+    memcpy(data, m_data + offset, first);
+    memcpy(data + first, m_data, len - first);
+  }
+
+  static void addPiece(vector<LinePiece> &pieces, const char *data,
+                       uint32 len) {
+    if (len) pieces.push_back(LinePiece(data, len));
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class AsyncLogWriterImpl {
+public:
+  AsyncLogWriterImpl()
+    : m_func(this, &AsyncLogWriterImpl::run), m_running(false),
+      m_stopping(false), m_rings(NULL), m_written(0), m_dropped(0) {
+    pthread_key_create(&m_key, OnThreadExit);
+  }
+
+  bool running() const { return m_running;}
+
+  void start() {
+    if (m_running) return;
+    m_stopping = false;
+    m_running = true;
+    m_func.start();
+  }
+
+  void stop() {
+    if (!m_running) return;
+    m_running = false; // from now on Write() writes synchronously
+    {
+      Lock lock(m_monitor.getMutex());
+      m_stopping = true;
+      m_monitor.notify();
+    }
+    m_func.waitForEnd();
+    drain(); // whatever was appended while the writer was stopping
+  }
+
+  void flush() {
+    if (!m_running) return;
+    vector<pair<AsyncLogRing *, uint64> > heads;
+    for (AsyncLogRing *ring = m_rings; ring; ring = ring->m_next) {
+      heads.push_back(make_pair(ring, ring->m_head));
+    }
+    for (unsigned int i = 0; i < heads.size(); i++) {
+      while (heads[i].first->m_tail < heads[i].second && !m_stopping) {
+        wake();
+        usleep(1000);
+      }
+    }
+  }
+
+  bool append(FILE *f, const char *data, int len) {
+    AsyncLogRing *ring = s_ring ? s_ring : getRing();
+    while (!ring->put(f, data, len)) {
+      if (!AsyncLogWriter::Block || m_stopping ||
+          len + sizeof(LineHeader) > ring->size()) {
+        atomic_add(m_dropped, (int64)1);
+        return false;
+      }
+      wake();
+      usleep(1000);
+    }
+    if (ring->m_head - ring->m_tail > ring->size() / 2) {
+      wake(); // don't wait out FlushInterval with a buffer filling up
+    }
+    return true;
+  }
+
+  int64 written() const { return m_written;}
+  int64 dropped() const { return m_dropped;}
+
+private:
+  AsyncFunc<AsyncLogWriterImpl> m_func;
+  Synchronizable m_monitor;
+  volatile bool m_running;
+  volatile bool m_stopping;
+
+  Mutex m_mutex;                    // for claiming and adding rings
+  AsyncLogRing * volatile m_rings;  // never freed, only ever prepended to
+  pthread_key_t m_key;
+
+  int64 m_written;
+  int64 m_dropped;
+
+  static __thread AsyncLogRing *s_ring;
+
+  static void OnThreadExit(void *p) {
+    // the writer still drains it; another thread takes it over once empty
+    ((AsyncLogRing *)p)->m_owned = false;
+  }
+
+  AsyncLogRing *getRing() {
+    Lock lock(m_mutex);
+    AsyncLogRing *ring = NULL;
+    for (AsyncLogRing *r = m_rings; r; r = r->m_next) {
+      if (!r->m_owned && r->empty()) {
+        ring = r;
+        ring->m_owned = true;
+        break;
+      }
+    }
+    if (ring == NULL) {
+      uint32 size = 4096;
+      while (size < (uint32)AsyncLogWriter::BufferSize && size < (1U << 30)) {
+        size <<= 1;
+      }
+      ring = new AsyncLogRing(size);
+      ring->m_next = m_rings;
+      __sync_synchronize(); // the writer walks m_rings without the lock
+      m_rings = ring;
+    }
+    pthread_setspecific(m_key, ring);
+    s_ring = ring;
+    return ring;
+  }
+
+  void wake() {
+    Lock lock(m_monitor.getMutex());
+    m_monitor.notify();
+  }
+
+  void run() {
+    long long interval = AsyncLogWriter::FlushInterval > 0 ?
+      AsyncLogWriter::FlushInterval : 1;
+    while (true) {
+      bool stopping = m_stopping;
+      drain();
+      if (stopping) break;
+      Lock lock(m_monitor.getMutex());
+      if (!m_stopping) {
+        m_monitor.wait(interval / 1000, (interval % 1000) * 1000000);
+      }
+    }
+  }
+
+  /**
+   * Writes out everything appended so far, grouped by file, and only then
+   * gives the space back to the threads logging.
+   */
+  void drain() {
+    LinePieceMap files;
+    vector<pair<AsyncLogRing *, uint64> > heads;
+    int count = 0;
+    for (AsyncLogRing *ring = m_rings; ring; ring = ring->m_next) {
+      uint64 head = ring->m_head;
+      if (head == ring->m_tail) continue;
+      __sync_synchronize(); // lines are complete up to head
+      count += ring->collect(head, files);
+      heads.push_back(make_pair(ring, head));
+    }
+    if (count == 0) return;
+
+    for (LinePieceMap::const_iterator iter = files.begin();
+         iter != files.end(); ++iter) {
+      WriteAll(iter->first, iter->second);
+    }
+    __sync_synchronize();
+    for (unsigned int i = 0; i < heads.size(); i++) {
+      heads[i].first->m_tail = heads[i].second;
+    }
+    atomic_add(m_written, (int64)count);
+  }
+
+  static void WriteAll(FILE *f, const vector<LinePiece> &pieces) {
+    flockfile(f); // nothing else written to f gets in between
+    for (unsigned int i = 0; i < pieces.size(); i++) {
+      fwrite(pieces[i].first, pieces[i].second, 1, f);
+    }
+    fflush(f);
+    funlockfile(f);
+  }
+};
+
+__thread AsyncLogRing *AsyncLogWriterImpl::s_ring = NULL;
+
+static AsyncLogWriterImpl s_writer;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void AsyncLogWriter::Start() {
+  if (Enabled) s_writer.start();
+}
+
+void AsyncLogWriter::Stop() {
+  s_writer.stop();
+}
+
+void AsyncLogWriter::Flush() {
+  s_writer.flush();
+}
+
+bool AsyncLogWriter::Write(FILE *f, const char *data, int len) {
+  if (!s_writer.running() || f == stdout || f == stderr) {
+    fwrite(data, len, 1, f);
+    fflush(f);
+    return true;
+  }
+  return s_writer.append(f, data, len);
+}
+
+int64 AsyncLogWriter::GetWrittenCount() {
+  return s_writer.written();
+}
+
+int64 AsyncLogWriter::GetDroppedCount() {
+  return s_writer.dropped();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
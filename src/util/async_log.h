@@ -0,0 +1,67 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010 Facebook, Inc. (http://www.facebook.com)          |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __ASYNC_LOG_H__
+#define __ASYNC_LOG_H__
+
+#include "base.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Writes log lines from a thread of its own, so threads logging never wait on
+ * a slow disk or pipe. Each thread appends its lines to a ring buffer only it
+ * writes to, without any locking, and the writer thread drains all of them
+ * every FlushInterval milliseconds. Lines go out through each FILE's own
+ * stdio buffer, under its lock, so they keep their order with anything else
+ * written to the same FILE, and each file is flushed once per drain.
+ *
+ * A thread whose buffer is full either drops the line, counting it, or waits
+ * for the writer to make room, if Block is on. Until Start() and after
+ * Stop(), and always for stdout and stderr, Write() writes right away.
+ */
+class AsyncLogWriter {
+public:
+  static bool Enabled;
+  static int BufferSize;    // per thread, in bytes
+  static int FlushInterval; // in milliseconds
+  static bool Block;
+
+  static void Start();
+  /**
+   * Writes out everything buffered, then stops the writer thread.
+   */
+  static void Stop();
+  /**
+   * Waits until everything buffered so far is written, e.g. before closing
+   * a file lines may still be pending for.
+   */
+  static void Flush();
+
+  /**
+   * Returns false if the line was dropped.
+   */
+  static bool Write(FILE *f, const char *data, int len);
+
+  static int64 GetWrittenCount();
+  static int64 GetDroppedCount();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __ASYNC_LOG_H__
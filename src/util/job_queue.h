@@ -60,6 +60,9 @@ namespace HPHP {
  * store prepared jobs. With JobQueueDispatcher, job queue is normally empty
  * initially and new jobs are pushed into the queue over time. Also, workers
  * can be stopped individually.
+ *
+ * Passing workStealing = true to JobQueueDispatcher gives each worker its own
+ * queue instead of sharing one (see WorkStealingJobQueue).
  */
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -79,22 +82,34 @@ public:
    */
   JobQueue() : m_stopped(false), m_workerCount(0) {
   }
+  virtual ~JobQueue() {
+  }
 
   /**
    * Put a job into the queue and notify a worker to pick it up.
    */
-  void enqueue(TJob job) {
+  virtual void enqueue(TJob job) {
     Lock lock(getMutex());
     m_jobs.push_back(job);
     notify();
   }
 
+  /**
+   * Same, but preferring workers first .. first + count - 1, for queues that
+   * know which worker a job goes to.
+   */
+  virtual void enqueue(TJob job, int first, int count) {
+    enqueue(job);
+  }
+
   /**
    * Grab a job from the queue for processing. Since the job was not created
    * by this queue class, it's up to a worker class on whether to deallocate
-   * the job object correctly.
+   * the job object correctly. The worker's id tells which queue to look at
+   * first for queues that have more than one, and stolen is set when the
+   * job came from another worker's.
    */
-  TJob dequeue() {
+  virtual TJob dequeue(int id, bool &stolen) {
     Lock lock(getMutex());
     while (m_jobs.empty()) {
       if (m_stopped) {
@@ -104,18 +119,31 @@ public:
     }
     TJob job = m_jobs.front();
     m_jobs.pop_front();
+    stolen = false;
     return job;
   }
 
   /**
    * Purely for making sure no new jobs are queued when we are stopping.
    */
-  void stop() {
+  virtual void stop() {
     Lock lock(getMutex());
     m_stopped = true;
     notifyAll(); // so all waiting threads can find out queue is stopped
   }
 
+  /**
+   * How many jobs are waiting for a worker, and how many were taken by a
+   * worker they were not queued for.
+   */
+  virtual int getQueuedJobs() {
+    Lock lock(getMutex());
+    return m_jobs.size();
+  }
+  virtual int getStolenJobs() {
+    return 0;
+  }
+
   /**
    * Keeps track of how many active workers are working on the queue.
    */
@@ -129,14 +157,232 @@ public:
     return m_workerCount;
   }
 
+ protected:
+  bool m_stopped;
+
  private:
   std::deque<TJob> m_jobs;
-  bool m_stopped;
   int m_workerCount;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * A job queue with one deque per worker, so enqueue() and dequeue() don't
+ * all go through the same lock:
+ *
+ *  1. A new job goes to the worker that went idle most recently, whose
+ *     thread and caches are the warmest, and only that worker is woken up.
+ *     With no idle worker, jobs are spread over the workers' deques in turn.
+ *     When enqueue() is given preferred workers, an idle one of them comes
+ *     first, then any idle worker, and only then the preferred workers'
+ *     deques.
+ *  2. A worker takes jobs from its own deque first, oldest first. When that
+ *     is empty, it steals the oldest job of the first other deque it can
+ *     lock without waiting, before going idle.
+ *  3. A job queued behind a busy worker wakes up an idle one, from all the
+ *     workers, to steal it, so it doesn't wait for a long request to end.
+ *     A worker going idle looks for jobs to steal once more after joining
+ *     the idle list, and doesn't go to sleep while a deque it wanted to look
+ *     at was locked, so no job is missed by both.
+ *
+ * The idle list is the only state shared by all workers, and it's only
+ * touched by enqueue() when someone is idle, and by workers going idle.
+ */
+template<typename TJob>
+class WorkStealingJobQueue : public JobQueue<TJob> {
+public:
+  typedef typename JobQueue<TJob>::StopSignal StopSignal;
+
+  WorkStealingJobQueue(int workerCount)
+    : m_next(0), m_queued(0), m_stolen(0) {
+    ASSERT(workerCount >= 1);
+    m_workers.resize(workerCount);
+    for (int i = 0; i < workerCount; i++) {
+      m_workers[i] = new Worker();
+    }
+  }
+  virtual ~WorkStealingJobQueue() {
+    for (unsigned int i = 0; i < m_workers.size(); i++) {
+      delete m_workers[i];
+    }
+  }
+
+  virtual void enqueue(TJob job) {
+    enqueue(job, 0, m_workers.size());
+  }
+
+  virtual void enqueue(TJob job, int first, int count) {
+    ASSERT(first >= 0 && count > 0 && first + count <= (int)m_workers.size());
+    int id = popIdle(first, count);
+    if (id < 0 && count < (int)m_workers.size()) {
+      id = popIdle(0, m_workers.size()); // better than waiting
+    }
+    bool busy = id < 0;
+    if (busy) {
+      id = first + (unsigned int)atomic_inc(m_next) % count;
+    }
+    {
+      Worker &worker = *m_workers[id];
+      Lock lock(worker.getMutex());
+      worker.jobs.push_back(job);
+      atomic_inc(m_queued);
+      worker.notify();
+    }
+    if (busy) {
+      int thief = popIdle(0, m_workers.size());
+      if (thief >= 0) {
+        Worker &worker = *m_workers[thief];
+        Lock lock(worker.getMutex());
+        worker.notify();
+      }
+    }
+  }
+
+  virtual TJob dequeue(int id, bool &stolen) {
+    Worker &worker = *m_workers[id];
+    TJob job;
+    stolen = false;
+    while (true) {
+      if (take(worker, job)) break;
+      StealResult result = steal(id, job);
+      if (result == Stolen) {
+        stolen = true;
+        break;
+      }
+      if (result == Contended) continue;
+
+      Lock lock(worker.getMutex());
+      if (!worker.jobs.empty()) continue;
+      if (this->m_stopped) {
+        throw StopSignal();
+      }
+      if (!worker.idle) {
+        {
+          Lock idleLock(m_idleMutex);
+          worker.idle = true;
+          m_idle.push_back(id);
+        }
+        // jobs queued before we were on the idle list didn't wake anyone
+        result = steal(id, job);
+        if (result == Stolen) {
+          stolen = true;
+          break;
+        }
+        if (result == Contended) continue;
+      }
+      worker.wait();
+    }
+    if (stolen) {
+      atomic_inc(m_stolen);
+    }
+    if (worker.idle) {
+      removeIdle(id); // woken up by stop() or spuriously, but found work
+    }
+    return job;
+  }
+
+  virtual void stop() {
+    for (unsigned int i = 0; i < m_workers.size(); i++) {
+      Worker &worker = *m_workers[i];
+      Lock lock(worker.getMutex());
+      this->m_stopped = true;
+      worker.notify();
+    }
+  }
+
+  virtual int getQueuedJobs() {
+    return m_queued;
+  }
+  virtual int getStolenJobs() {
+    return m_stolen;
+  }
+
+private:
+  class Worker : public Synchronizable {
+  public:
+    Worker() : idle(false) {}
+    std::deque<TJob> jobs; // guarded by getMutex()
+    volatile bool idle;    // set by its worker, cleared under m_idleMutex
+  };
+
+  std::vector<Worker *> m_workers;
+  Mutex m_idleMutex;
+  std::vector<int> m_idle; // most recently idle worker at the back
+  int m_next;
+  int m_queued;
+  int m_stolen;
+
+  bool take(Worker &worker, TJob &job) {
+    Lock lock(worker.getMutex());
+    if (worker.jobs.empty()) return false;
+    job = worker.jobs.front();
+    worker.jobs.pop_front();
+    atomic_dec(m_queued);
+    return true;
+  }
+
+  enum StealResult {
+    Stolen,
+    Contended, // nothing found, but some deques couldn't be looked at
+    NotFound,
+  };
+
+  /**
+   * Never waits for a lock, so it can be called holding the thief's own.
+   */
+  StealResult steal(int id, TJob &job) {
+    int count = m_workers.size();
+    bool contended = false;
+    for (int i = 1; i < count; i++) {
+      Worker &victim = *m_workers[(id + i) % count];
+      if (victim.jobs.empty()) continue; // racy peek, saves the locking
+      Mutex &mutex = victim.getMutex();
+      if (!mutex.tryLock()) {
+        contended = true;
+        continue;
+      }
+      bool found = !victim.jobs.empty();
+      if (found) {
+        job = victim.jobs.front();
+        victim.jobs.pop_front();
+        atomic_dec(m_queued);
+      }
+      mutex.unlock();
+      if (found) return Stolen;
+    }
+    return contended ? Contended : NotFound;
+  }
+
+  int popIdle(int first, int count) {
+    Lock lock(m_idleMutex);
+    for (int i = m_idle.size() - 1; i >= 0; i--) {
+      int id = m_idle[i];
+      if (id >= first && id < first + count) {
+        m_idle.erase(m_idle.begin() + i);
+        m_workers[id]->idle = false;
+        return id;
+      }
+    }
+    return -1;
+  }
+
+  void removeIdle(int id) {
+    Lock lock(m_idleMutex);
+    Worker &worker = *m_workers[id];
+    if (!worker.idle) return;
+    worker.idle = false;
+    for (unsigned int i = 0; i < m_idle.size(); i++) {
+      if (m_idle[i] == id) {
+        m_idle.erase(m_idle.begin() + i);
+        break;
+      }
+    }
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
 /**
  * Base class for a customized worker.
  */
@@ -146,7 +392,8 @@ public:
   /**
    * Default constructor.
    */
-  JobQueueWorker() : m_opaque(NULL), m_queue(NULL), m_stopped(false) {
+  JobQueueWorker()
+    : m_opaque(NULL), m_jobStolen(false), m_queue(NULL), m_stopped(false) {
   }
 
   virtual ~JobQueueWorker() {
@@ -178,7 +425,7 @@ public:
     onThreadEnter();
     while (!m_stopped) {
       try {
-        TJob job = m_queue->dequeue();
+        TJob job = m_queue->dequeue(m_id, m_jobStolen);
         if (countActive) m_queue->incActiveWorker();
         doJob(job);
         if (countActive) m_queue->decActiveWorker();
@@ -199,6 +446,7 @@ public:
 protected:
   int m_id;
   void *m_opaque;
+  bool m_jobStolen; // whether the job being done was queued for another
 
 private:
 
@@ -217,13 +465,19 @@ public:
   /**
    * Constructor.
    */
-  JobQueueDispatcher(int threadCount, void *opaque) : m_stopped(true) {
+  JobQueueDispatcher(int threadCount, void *opaque,
+                     bool workStealing = false) : m_stopped(true) {
     ASSERT(threadCount >= 1);
+    if (workStealing) {
+      m_queue = new WorkStealingJobQueue<TJob>(threadCount);
+    } else {
+      m_queue = new JobQueue<TJob>();
+    }
     m_workers.resize(threadCount);
     m_funcs.resize(threadCount);
     for (int i = 0; i < threadCount; i++) {
       TWorker &worker = m_workers[i];
-      worker.create(i, &m_queue, opaque);
+      worker.create(i, m_queue, opaque);
       m_funcs[i] = new AsyncFunc<TWorker>(&worker, &TWorker::start);
     }
   }
@@ -233,13 +487,20 @@ public:
     for (unsigned int i = 0; i < m_funcs.size(); i++) {
       delete m_funcs[i];
     }
+    delete m_queue;
   }
 
   std::vector<TWorker> &getWorkers() {
     return m_workers;
   }
   int getActiveWorker() {
-    return m_queue.getActiveWorker();
+    return m_queue->getActiveWorker();
+  }
+  int getQueuedJobs() {
+    return m_queue->getQueuedJobs();
+  }
+  int getStolenJobs() {
+    return m_queue->getStolenJobs();
   }
 
   /**
@@ -256,7 +517,10 @@ public:
    * Enqueue a new job.
    */
   void enqueue(TJob job) {
-    m_queue.enqueue(job);
+    m_queue->enqueue(job);
+  }
+  void enqueue(TJob job, int first, int count) {
+    m_queue->enqueue(job, first, count);
   }
 
   /**
@@ -267,7 +531,7 @@ public:
     if (m_stopped) return;
     m_stopped = true;
 
-    m_queue.stop();
+    m_queue->stop();
     bool exceptioned = false;
     std::exception exception;
     for (unsigned int i = 0; i < m_funcs.size(); i++) {
@@ -285,7 +549,7 @@ public:
 
 private:
   bool m_stopped;
-  JobQueue<TJob> m_queue;
+  JobQueue<TJob> *m_queue;
   std::vector<TWorker> m_workers;
   std::vector<AsyncFunc<TWorker> *> m_funcs;
 };
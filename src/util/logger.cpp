@@ -21,6 +21,7 @@
 #include "exception.h"
 #include "log_aggregator.h"
 #include "text_color.h"
+#include "async_log.h"
 
 using namespace std;
 
@@ -156,8 +157,6 @@ void Logger::log(const std::string &msg, const StackTrace *stackTrace,
     LogAggregator::TheLogAggregator.log(*stackTrace, msg);
   }
   if (UseLogFile) {
-    FILE *f = Output ? Output : stdout;
-
     string header, sheader;
     if (LogHeader) {
       header = GetHeader();
@@ -169,11 +168,16 @@ void Logger::log(const std::string &msg, const StackTrace *stackTrace,
     }
     const char *escaped = escape ? EscapeString(msg) : msg.c_str();
     const char *ending = escapeMore ? "\\n" : "\n";
+    // read right before the line is queued, see SetNewOutput()
+    FILE *f = Output ? Output : stdout;
     bool color = (f == stdout && Util::s_stderr_color);
-    fprintf(f, "%s%s%s%s%s",
-            color ? Util::s_stderr_color : "",
-            sheader.c_str(), escaped, ending,
-            color ? ANSI_COLOR_END : "");
+    string line;
+    if (color) line += Util::s_stderr_color;
+    line += sheader;
+    line += escaped;
+    line += ending;
+    if (color) line += ANSI_COLOR_END;
+    AsyncLogWriter::Write(f, line.data(), line.size());
     FILE *tf = threadData->log;
     if (tf) {
       fprintf(tf, "%s%s%s", header.c_str(), escaped, ending);
@@ -185,8 +189,6 @@ void Logger::log(const std::string &msg, const StackTrace *stackTrace,
     if (escape) {
       free((void*)escaped);
     }
-
-    fflush(f);
   }
 }
 
@@ -262,8 +264,15 @@ void Logger::SetNewOutput(FILE *output) {
     fclose(threadData->log);
     threadData->log = output;
   } else {
-    if (Output) fclose(Output);
+    // switched first, so lines logged while the old file's are flushed
+    // are queued for the new one, and none for a closed FILE
+    FILE *old = Output;
     Output = output;
+    __sync_synchronize();
+    if (old) {
+      AsyncLogWriter::Flush();
+      fclose(old);
+    }
   }
 }
 
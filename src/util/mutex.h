@@ -52,6 +52,9 @@ public:
   void lock() {
     pthread_mutex_lock(&m_mutex);
   }
+  bool tryLock() {
+    return pthread_mutex_trylock(&m_mutex) == 0;
+  }
   void unlock() {
     pthread_mutex_unlock(&m_mutex);
   }